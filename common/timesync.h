@@ -0,0 +1,395 @@
+/**
+ * @file timesync.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Frame format of the ESP32 to STM32 time link, shared by both ends
+ * @date 2023-01-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Frame, multi-byte fields little-endian:
+ *
+ *   0  sync      2  TIMESYNC_SYNC_0, TIMESYNC_SYNC_1
+ *   2  version   1  TIMESYNC_VERSION
+ *   3  type      1  TIMESYNC_TYPE_*
+ *   4  length    1  payload bytes
+ *   5  sequence  1  incremented by the sender for every frame
+ *   6  payload   length
+ *   .  crc       2  CRC-16 of every byte before it
+ *
+ * Every SPI exchange is TIMESYNC_EXCHANGE_LEN bytes in both directions. The
+ * ESP32 clocks a time frame out while the STM32 clocks a telemetry frame
+ * back, each starting at the first byte and padded with zeros.
+ *
+ * Time transfer is the NTP four-timestamp exchange with the STM32 end of
+ * the exchange as both T2 and T3. The ESP32 stamps T1 into the time frame
+ * just before the exchange and T4 when it returns, and sends T4 - T1 in
+ * the next frame. The STM32 stamps the end of each exchange (NSS rising)
+ * on its RTC as T2 and takes its offset as T1 + (T4 - T1) / 2 - T2.
+ *
+ * Several STM32 may share the bus, each with its own chip select. A time
+ * frame may then go to all of them in one exchange, the telemetry clocked
+ * back is not readable and each node is read on its own with a poll frame.
+ * A poll frame has no payload, the STM32 only answers it with telemetry.
+ *
+ * A content frame patches the display of the STM32: text for a run of
+ * cells of one row, held for a number of seconds or until overwritten. Its
+ * payload length varies with the text.
+ *
+ * The CRC is CRC-16/CCITT-FALSE: TIMESYNC_CRC16_POLY, MSB first, initial
+ * value 0xFFFF, no final XOR. A frame is only accepted with its CRC checked.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TIMESYNC_SYNC_0             (0xA5U)
+#define TIMESYNC_SYNC_1             (0x5AU)
+#define TIMESYNC_VERSION            (3U)
+#define TIMESYNC_CRC16_POLY         (0x1021U)   /* Hamming distance 4 up to 4095 bytes, every 1 to 3 bit error in a frame is caught */
+
+#define TIMESYNC_HEADER_LEN         (6U)
+#define TIMESYNC_CRC_LEN            (2U)
+
+#define TIMESYNC_TYPE_TIME          (1U)
+#define TIMESYNC_TIME_PAYLOAD_LEN   (20U)
+#define TIMESYNC_TIME_FRAME_LEN     (TIMESYNC_HEADER_LEN + TIMESYNC_TIME_PAYLOAD_LEN + TIMESYNC_CRC_LEN)
+
+#define TIMESYNC_TYPE_TELEMETRY     (2U)
+#define TIMESYNC_TELEMETRY_PAYLOAD_LEN  (28U)
+#define TIMESYNC_TELEMETRY_FRAME_LEN    (TIMESYNC_HEADER_LEN + TIMESYNC_TELEMETRY_PAYLOAD_LEN + TIMESYNC_CRC_LEN)
+
+#define TIMESYNC_TYPE_POLL          (3U)
+#define TIMESYNC_POLL_FRAME_LEN     (TIMESYNC_HEADER_LEN + TIMESYNC_CRC_LEN)
+
+#define TIMESYNC_TYPE_CONTENT       (4U)
+#define TIMESYNC_CONTENT_HEADER_LEN (4U)        /* Row, column and TTL ahead of the text */
+#define TIMESYNC_CONTENT_MAX_TEXT   (TIMESYNC_EXCHANGE_LEN - TIMESYNC_HEADER_LEN - TIMESYNC_CONTENT_HEADER_LEN - TIMESYNC_CRC_LEN)
+
+/* The longest of the frames */
+#define TIMESYNC_EXCHANGE_LEN       (TIMESYNC_TELEMETRY_FRAME_LEN)
+
+#define TIMESYNC_FLAG_DST           (0x01U)     /* utc_offset_min includes daylight saving time */
+
+#define TIMESYNC_TELEMETRY_FLAG_RTC_SYNCED  (0x01U) /* The RTC was set from a time frame */
+#define TIMESYNC_TELEMETRY_FLAG_RTC_PRECISE (0x02U) /* rtc_offset_us is from a four-timestamp exchange */
+#define TIMESYNC_TELEMETRY_FLAG_PPS         (0x04U) /* The RTC phase follows the PPS edges */
+#define TIMESYNC_NO_READING         (INT16_MIN) /* Temperature of a missing sensor */
+
+enum timesync_status
+{
+	TIMESYNC_OK = 0,
+	TIMESYNC_ERR_LENGTH,        /* Buffer shorter than the frame */
+	TIMESYNC_ERR_SYNC,          /* Not at the start of a frame */
+	TIMESYNC_ERR_VERSION,
+	TIMESYNC_ERR_TYPE,
+	TIMESYNC_ERR_CRC,
+};
+
+/**
+ * @brief Payload of a TIMESYNC_TYPE_TIME frame
+ */
+struct timesync_time
+{
+	uint64_t seconds;           /* Since 1970 UTC, T1 of this exchange */
+	uint32_t fraction;          /* Of a second, in 2^-32 s as in NTP */
+	int16_t utc_offset_min;     /* Local time minus UTC */
+	uint8_t flags;              /* TIMESYNC_FLAG_* */
+	uint32_t round_trip_us;     /* T4 - T1 of the previous exchange, 0 if unknown */
+};
+
+/**
+ * @brief Payload of a TIMESYNC_TYPE_CONTENT frame
+ */
+struct timesync_content
+{
+	uint8_t row;                /* From 0 */
+	uint8_t column;             /* From 0, of the first cell */
+	uint16_t ttl_s;             /* Seconds the text is shown, 0 until overwritten */
+	uint8_t length;             /* Cells, up to TIMESYNC_CONTENT_MAX_TEXT */
+	const uint8_t *text;        /* Character codes of the display. Decoded, it points into the frame */
+};
+
+/**
+ * @brief Payload of a TIMESYNC_TYPE_TELEMETRY frame, the state of the STM32
+ */
+struct timesync_telemetry
+{
+	int16_t temperature[2];     /* Hundredths of a degree Celsius, indoor and outdoor. TIMESYNC_NO_READING if absent */
+	uint32_t pressure;          /* Pa, 0 if not measured */
+	uint32_t rtc_seconds;       /* RTC local time, seconds since 1970 */
+	int32_t rtc_offset_us;      /* Received time minus the RTC at the last time frame */
+	int32_t drift_ppb;          /* RTC rate error, positive when fast. 0 until estimated */
+	uint16_t crc_errors;        /* Link counters of the STM32, saturating */
+	uint16_t framing_errors;
+	uint16_t dropped;
+	uint8_t ack_sequence;       /* Sequence of the last valid time frame */
+	uint8_t flags;              /* TIMESYNC_TELEMETRY_FLAG_* */
+};
+
+static inline uint16_t timesync_crc16(const uint8_t *data, size_t len)
+{
+	uint16_t crc = 0xFFFFU;
+	for (size_t i = 0; i < len; i++)
+	{
+		crc ^= (uint16_t)(data[i] << 8);
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ TIMESYNC_CRC16_POLY) : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+static inline void timesync_put_le(uint8_t *buf, uint64_t value, uint8_t bytes)
+{
+	for (uint8_t i = 0; i < bytes; i++)
+	{
+		buf[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static inline uint64_t timesync_get_le(const uint8_t *buf, uint8_t bytes)
+{
+	uint64_t value = 0;
+	for (uint8_t i = 0; i < bytes; i++)
+	{
+		value |= (uint64_t)buf[i] << (8 * i);
+	}
+	return value;
+}
+
+static inline void timesync_put_crc(uint8_t *frame, size_t frame_len)
+{
+	timesync_put_le(&frame[frame_len - TIMESYNC_CRC_LEN], timesync_crc16(frame, frame_len - TIMESYNC_CRC_LEN), TIMESYNC_CRC_LEN);
+}
+
+static inline void timesync_put_header(uint8_t *frame, uint8_t type, uint8_t payload_len, uint8_t sequence)
+{
+	frame[0] = TIMESYNC_SYNC_0;
+	frame[1] = TIMESYNC_SYNC_1;
+	frame[2] = TIMESYNC_VERSION;
+	frame[3] = type;
+	frame[4] = payload_len;
+	frame[5] = sequence;
+}
+
+static inline enum timesync_status timesync_check_header(const uint8_t *frame, size_t len, uint8_t type, uint8_t payload_len)
+{
+	size_t frame_len = TIMESYNC_HEADER_LEN + payload_len + TIMESYNC_CRC_LEN;
+
+	if (len < frame_len)
+	{
+		return TIMESYNC_ERR_LENGTH;
+	}
+	if (frame[0] != TIMESYNC_SYNC_0 || frame[1] != TIMESYNC_SYNC_1)
+	{
+		return TIMESYNC_ERR_SYNC;
+	}
+	if (frame[2] != TIMESYNC_VERSION)
+	{
+		return TIMESYNC_ERR_VERSION;
+	}
+	if (frame[3] != type || frame[4] != payload_len)
+	{
+		return TIMESYNC_ERR_TYPE;
+	}
+	if (timesync_get_le(&frame[frame_len - TIMESYNC_CRC_LEN], TIMESYNC_CRC_LEN) != timesync_crc16(frame, frame_len - TIMESYNC_CRC_LEN))
+	{
+		return TIMESYNC_ERR_CRC;
+	}
+	return TIMESYNC_OK;
+}
+
+/**
+ * @brief Build a time frame, CRC included
+ *
+ * @param frame At least TIMESYNC_TIME_FRAME_LEN bytes
+ * @param sequence Sequence number of the frame
+ * @param time Time to send
+ * @return size_t Frame length
+ */
+static inline size_t timesync_encode_time(uint8_t *frame, uint8_t sequence, const struct timesync_time *time)
+{
+	uint8_t *payload = &frame[TIMESYNC_HEADER_LEN];
+
+	timesync_put_header(frame, TIMESYNC_TYPE_TIME, TIMESYNC_TIME_PAYLOAD_LEN, sequence);
+	timesync_put_le(&payload[0], time->seconds, 8);
+	timesync_put_le(&payload[8], time->fraction, 4);
+	timesync_put_le(&payload[12], (uint16_t)time->utc_offset_min, 2);
+	payload[14] = time->flags;
+	payload[15] = 0;
+	timesync_put_le(&payload[16], time->round_trip_us, 4);
+	timesync_put_crc(frame, TIMESYNC_TIME_FRAME_LEN);
+	return TIMESYNC_TIME_FRAME_LEN;
+}
+
+/**
+ * @brief Parse a time frame
+ *
+ * @param frame Received bytes, starting at the sync word
+ * @param len Bytes in frame, at least TIMESYNC_TIME_FRAME_LEN
+ * @param sequence Populated with the sequence number
+ * @param time Populated with the time
+ * @return enum timesync_status TIMESYNC_OK if the frame is valid
+ */
+static inline enum timesync_status timesync_decode_time(const uint8_t *frame, size_t len, uint8_t *sequence,
+														struct timesync_time *time)
+{
+	const uint8_t *payload = &frame[TIMESYNC_HEADER_LEN];
+	enum timesync_status status = timesync_check_header(frame, len, TIMESYNC_TYPE_TIME, TIMESYNC_TIME_PAYLOAD_LEN);
+
+	if (status != TIMESYNC_OK)
+	{
+		return status;
+	}
+
+	*sequence = frame[5];
+	time->seconds = timesync_get_le(&payload[0], 8);
+	time->fraction = (uint32_t)timesync_get_le(&payload[8], 4);
+	time->utc_offset_min = (int16_t)timesync_get_le(&payload[12], 2);
+	time->flags = payload[14];
+	time->round_trip_us = (uint32_t)timesync_get_le(&payload[16], 4);
+	return TIMESYNC_OK;
+}
+
+/**
+ * @brief Build a poll frame, CRC included
+ *
+ * @param frame At least TIMESYNC_POLL_FRAME_LEN bytes
+ * @param sequence Sequence number of the frame
+ * @return size_t Frame length
+ */
+static inline size_t timesync_encode_poll(uint8_t *frame, uint8_t sequence)
+{
+	timesync_put_header(frame, TIMESYNC_TYPE_POLL, 0, sequence);
+	timesync_put_crc(frame, TIMESYNC_POLL_FRAME_LEN);
+	return TIMESYNC_POLL_FRAME_LEN;
+}
+
+/**
+ * @brief Build a content frame, CRC included
+ *
+ * @param frame At least TIMESYNC_EXCHANGE_LEN bytes
+ * @param sequence Sequence number of the frame
+ * @param content Patch to send, text longer than TIMESYNC_CONTENT_MAX_TEXT is cut
+ * @return size_t Frame length
+ */
+static inline size_t timesync_encode_content(uint8_t *frame, uint8_t sequence, const struct timesync_content *content)
+{
+	uint8_t *payload = &frame[TIMESYNC_HEADER_LEN];
+	uint8_t length = (content->length > TIMESYNC_CONTENT_MAX_TEXT) ? TIMESYNC_CONTENT_MAX_TEXT : content->length;
+	size_t frame_len = TIMESYNC_HEADER_LEN + TIMESYNC_CONTENT_HEADER_LEN + length + TIMESYNC_CRC_LEN;
+
+	timesync_put_header(frame, TIMESYNC_TYPE_CONTENT, (uint8_t)(TIMESYNC_CONTENT_HEADER_LEN + length), sequence);
+	payload[0] = content->row;
+	payload[1] = content->column;
+	timesync_put_le(&payload[2], content->ttl_s, 2);
+	for (uint8_t i = 0; i < length; i++)
+	{
+		payload[TIMESYNC_CONTENT_HEADER_LEN + i] = content->text[i];
+	}
+	timesync_put_crc(frame, frame_len);
+	return frame_len;
+}
+
+/**
+ * @brief Parse a content frame, the text is left in place
+ *
+ * @param frame Received bytes, starting at the sync word
+ * @param len Bytes in frame, at least the whole frame
+ * @param sequence Populated with the sequence number
+ * @param content Populated with the patch, its text points into frame
+ * @return enum timesync_status TIMESYNC_OK if the frame is valid
+ */
+static inline enum timesync_status timesync_decode_content(const uint8_t *frame, size_t len, uint8_t *sequence,
+														   struct timesync_content *content)
+{
+	const uint8_t *payload = &frame[TIMESYNC_HEADER_LEN];
+
+	if (len < TIMESYNC_HEADER_LEN)
+	{
+		return TIMESYNC_ERR_LENGTH;
+	}
+	uint8_t payload_len = frame[4];
+	if (payload_len < TIMESYNC_CONTENT_HEADER_LEN || payload_len > TIMESYNC_CONTENT_HEADER_LEN + TIMESYNC_CONTENT_MAX_TEXT)
+	{
+		payload_len = TIMESYNC_CONTENT_HEADER_LEN;  /* Differs from frame[4], caught as a wrong type */
+	}
+	enum timesync_status status = timesync_check_header(frame, len, TIMESYNC_TYPE_CONTENT, payload_len);
+	if (status != TIMESYNC_OK)
+	{
+		return status;
+	}
+
+	*sequence = frame[5];
+	content->row = payload[0];
+	content->column = payload[1];
+	content->ttl_s = (uint16_t)timesync_get_le(&payload[2], 2);
+	content->length = (uint8_t)(payload_len - TIMESYNC_CONTENT_HEADER_LEN);
+	content->text = &payload[TIMESYNC_CONTENT_HEADER_LEN];
+	return TIMESYNC_OK;
+}
+
+/**
+ * @brief Build a telemetry frame, CRC included
+ *
+ * @param frame At least TIMESYNC_TELEMETRY_FRAME_LEN bytes
+ * @param sequence Sequence number of the frame
+ * @param telemetry State to send
+ * @return size_t Frame length
+ */
+static inline size_t timesync_encode_telemetry(uint8_t *frame, uint8_t sequence, const struct timesync_telemetry *telemetry)
+{
+	uint8_t *payload = &frame[TIMESYNC_HEADER_LEN];
+
+	timesync_put_header(frame, TIMESYNC_TYPE_TELEMETRY, TIMESYNC_TELEMETRY_PAYLOAD_LEN, sequence);
+	timesync_put_le(&payload[0], (uint16_t)telemetry->temperature[0], 2);
+	timesync_put_le(&payload[2], (uint16_t)telemetry->temperature[1], 2);
+	timesync_put_le(&payload[4], telemetry->pressure, 4);
+	timesync_put_le(&payload[8], telemetry->rtc_seconds, 4);
+	timesync_put_le(&payload[12], (uint32_t)telemetry->rtc_offset_us, 4);
+	timesync_put_le(&payload[16], (uint32_t)telemetry->drift_ppb, 4);
+	timesync_put_le(&payload[20], telemetry->crc_errors, 2);
+	timesync_put_le(&payload[22], telemetry->framing_errors, 2);
+	timesync_put_le(&payload[24], telemetry->dropped, 2);
+	payload[26] = telemetry->ack_sequence;
+	payload[27] = telemetry->flags;
+	timesync_put_crc(frame, TIMESYNC_TELEMETRY_FRAME_LEN);
+	return TIMESYNC_TELEMETRY_FRAME_LEN;
+}
+
+/**
+ * @brief Parse a telemetry frame
+ *
+ * @param frame Received bytes, starting at the sync word
+ * @param len Bytes in frame, at least TIMESYNC_TELEMETRY_FRAME_LEN
+ * @param sequence Populated with the sequence number
+ * @param telemetry Populated with the state of the STM32
+ * @return enum timesync_status TIMESYNC_OK if the frame is valid
+ */
+static inline enum timesync_status timesync_decode_telemetry(const uint8_t *frame, size_t len, uint8_t *sequence,
+															 struct timesync_telemetry *telemetry)
+{
+	const uint8_t *payload = &frame[TIMESYNC_HEADER_LEN];
+	enum timesync_status status = timesync_check_header(frame, len, TIMESYNC_TYPE_TELEMETRY, TIMESYNC_TELEMETRY_PAYLOAD_LEN);
+
+	if (status != TIMESYNC_OK)
+	{
+		return status;
+	}
+
+	*sequence = frame[5];
+	telemetry->temperature[0] = (int16_t)timesync_get_le(&payload[0], 2);
+	telemetry->temperature[1] = (int16_t)timesync_get_le(&payload[2], 2);
+	telemetry->pressure = (uint32_t)timesync_get_le(&payload[4], 4);
+	telemetry->rtc_seconds = (uint32_t)timesync_get_le(&payload[8], 4);
+	telemetry->rtc_offset_us = (int32_t)timesync_get_le(&payload[12], 4);
+	telemetry->drift_ppb = (int32_t)timesync_get_le(&payload[16], 4);
+	telemetry->crc_errors = (uint16_t)timesync_get_le(&payload[20], 2);
+	telemetry->framing_errors = (uint16_t)timesync_get_le(&payload[22], 2);
+	telemetry->dropped = (uint16_t)timesync_get_le(&payload[24], 2);
+	telemetry->ack_sequence = payload[26];
+	telemetry->flags = payload[27];
+	return TIMESYNC_OK;
+}
@@ -0,0 +1,139 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+
+#include "disc_clock.h"
+
+/* UTC = ref_utc_us + (uptime - ref_uptime_us) * (1 - rate_ppb / 1e9) */
+struct disc_clock_state
+{
+	int64_t ref_utc_us;
+	int64_t ref_uptime_us;
+	int64_t update_uptime_us; /* Of the last reply */
+	int32_t rate_ppb;
+	bool is_rate_valid;
+	bool is_valid;
+};
+
+/*
+ * Published without a lock, the readers are the link work queue and the
+ * PPS thread and must never wait on the sync work queue of the NTP polls. The writer fills the slot not
+ * being read and then advances the sequence, whose low bit names the
+ * current slot. A reader copies the current slot and retries only if a
+ * publish completed meanwhile, which may have reused its slot. It never
+ * waits on a publish in progress, so a reader preempting the writer
+ * cannot spin.
+ */
+static struct disc_clock_state slots[2];
+static atomic_t sequence;
+
+/* Only touched by the writer */
+static struct disc_clock_state state;
+static int64_t anchor_utc_us; /* Reply the rate is measured from */
+static int64_t anchor_uptime_us;
+
+int64_t disc_clock_uptime_us(void)
+{
+	return (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void publish(void)
+{
+	atomic_val_t current = atomic_get(&sequence);
+	slots[(current + 1) & 1] = state;
+	barrier_dmem_fence_full();
+	atomic_set(&sequence, current + 1);
+}
+
+static void snapshot(struct disc_clock_state *copy)
+{
+	atomic_val_t before;
+	do
+	{
+		before = atomic_get(&sequence);
+		barrier_dmem_fence_full();
+		*copy = slots[before & 1];
+		barrier_dmem_fence_full();
+	} while (atomic_get(&sequence) != before);
+}
+
+static int64_t utc_at(const struct disc_clock_state *clock, int64_t at_uptime_us)
+{
+	int64_t elapsed_us = at_uptime_us - clock->ref_uptime_us;
+	return clock->ref_utc_us + elapsed_us - ((elapsed_us * clock->rate_ppb) / 1000000000LL);
+}
+
+bool disc_clock_update(int64_t utc_us, int64_t at_uptime_us, int64_t *offset_us)
+{
+	*offset_us = state.is_valid ? utc_us - utc_at(&state, at_uptime_us) : 0;
+	bool is_step = !state.is_valid || *offset_us <= -DISC_CLOCK_STEP_US || *offset_us >= DISC_CLOCK_STEP_US;
+
+	if (is_step)
+	{
+		/* First reply or a jump of the server, start over from this one */
+		state.ref_utc_us = utc_us;
+		anchor_utc_us = utc_us;
+		anchor_uptime_us = at_uptime_us;
+		state.is_valid = true;
+	}
+	else
+	{
+		/* A quarter of the offset per reply, averaging out the jitter of the network */
+		state.ref_utc_us = utc_at(&state, at_uptime_us) + (*offset_us / 4);
+	}
+	state.ref_uptime_us = at_uptime_us;
+	state.update_uptime_us = at_uptime_us;
+
+	int64_t interval_us = at_uptime_us - anchor_uptime_us;
+	if (interval_us >= DISC_CLOCK_RATE_INTERVAL_US)
+	{
+		/* Uptime gained over UTC since the anchor */
+		int64_t measured_ppb = (((interval_us - (utc_us - anchor_utc_us)) * 1000000000LL) / interval_us);
+		int64_t rate = state.is_rate_valid ? state.rate_ppb + ((measured_ppb - state.rate_ppb) / 4) : measured_ppb;
+		state.rate_ppb = (int32_t)CLAMP(rate, -DISC_CLOCK_MAX_RATE_PPB, DISC_CLOCK_MAX_RATE_PPB);
+		state.is_rate_valid = true;
+		anchor_utc_us = utc_us;
+		anchor_uptime_us = at_uptime_us;
+	}
+	publish();
+	return is_step;
+}
+
+bool disc_clock_now(int64_t at_uptime_us, int64_t *utc_us)
+{
+	struct disc_clock_state clock;
+	snapshot(&clock);
+	*utc_us = utc_at(&clock, at_uptime_us);
+	return clock.is_valid;
+}
+
+bool disc_clock_to_uptime(int64_t utc_us, int64_t *at_uptime_us)
+{
+	struct disc_clock_state clock;
+	snapshot(&clock);
+	/* To first order in the rate, which is well within a microsecond over any interval used */
+	int64_t elapsed_us = utc_us - clock.ref_utc_us;
+	*at_uptime_us = clock.ref_uptime_us + elapsed_us + ((elapsed_us * clock.rate_ppb) / 1000000000LL);
+	return clock.is_valid;
+}
+
+bool disc_clock_has_rate(void)
+{
+	struct disc_clock_state clock;
+	snapshot(&clock);
+	return clock.is_rate_valid;
+}
+
+int32_t disc_clock_rate_ppb(void)
+{
+	struct disc_clock_state clock;
+	snapshot(&clock);
+	return clock.rate_ppb;
+}
+
+int64_t disc_clock_age_us(void)
+{
+	struct disc_clock_state clock;
+	snapshot(&clock);
+	return clock.is_valid ? disc_clock_uptime_us() - clock.update_uptime_us : -1;
+}
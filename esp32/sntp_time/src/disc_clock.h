@@ -0,0 +1,76 @@
+/*
+ * Software clock disciplined by SNTP replies
+ *
+ * UTC is interpolated from the uptime with the offset and the rate of the
+ * uptime clock found from the replies, so the time stays current between
+ * replies and keeps its rate when they stop.
+ */
+#ifndef DISC_CLOCK_H
+#define DISC_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Offsets beyond this are stepped, smaller ones are filtered in */
+#define DISC_CLOCK_STEP_US (128000)
+
+/* Shortest interval the rate is measured over, replies jitter by milliseconds */
+#define DISC_CLOCK_RATE_INTERVAL_US (64 * 1000000LL)
+
+/* Limit of the rate estimate, beyond any crystal */
+#define DISC_CLOCK_MAX_RATE_PPB (500000)
+
+/**
+ * @brief Uptime in microseconds, to the resolution of the system tick
+ */
+int64_t disc_clock_uptime_us(void);
+
+/**
+ * @brief Feed a reply of the time server
+ * Only ever called from one thread, the readers are lock-free.
+ *
+ * @param utc_us Time of the reply, in microseconds since 1970 UTC
+ * @param at_uptime_us Uptime the reply was current at
+ * @param offset_us Set to the offset of the reply from the clock, 0 for the first
+ * @return true if the clock was stepped, always for the first reply
+ */
+bool disc_clock_update(int64_t utc_us, int64_t at_uptime_us, int64_t *offset_us);
+
+/**
+ * @brief Time at the given uptime
+ *
+ * @param at_uptime_us Uptime, from disc_clock_uptime_us()
+ * @param utc_us Set to microseconds since 1970 UTC
+ * @return false before the first reply
+ */
+bool disc_clock_now(int64_t at_uptime_us, int64_t *utc_us);
+
+/**
+ * @brief Uptime at which the clock reaches the given time
+ *
+ * @param utc_us Microseconds since 1970 UTC
+ * @param at_uptime_us Set to the uptime, from disc_clock_uptime_us()
+ * @return false before the first reply
+ */
+bool disc_clock_to_uptime(int64_t utc_us, int64_t *at_uptime_us);
+
+/**
+ * @brief Whether the rate of the uptime clock was measured yet
+ */
+bool disc_clock_has_rate(void);
+
+/**
+ * @brief Rate of the uptime clock, positive when it is fast
+ *
+ * @return int32_t Parts per billion, 0 until measured
+ */
+int32_t disc_clock_rate_ppb(void);
+
+/**
+ * @brief Time since the last reply
+ *
+ * @return int64_t Microseconds, -1 before the first reply
+ */
+int64_t disc_clock_age_us(void);
+
+#endif /* DISC_CLOCK_H */
@@ -1,17 +1,22 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
-#include <zephyr/drivers/spi.h>
-#include <zephyr/net/sntp.h>
 #include <zephyr/sys/timeutil.h>
 
 #include <esp_wifi.h>
 
-#define SPI2_NODE DT_NODELABEL(spi2)
-
-#define SNTP_PORT 123
+#include "timesync.h"
+#include "disc_clock.h"
+#include "ntp_client.h"
+#include "wifi_conn.h"
+#include "node_link.h"
+#include "tz_rule.h"
 
-#define SERVER_ADDR "129.6.15.28"
+/* PPS and request lines, see esp32.overlay */
+#define PPS_NODE DT_PATH(zephyr_user)
 
 /* size of stack area used by each thread */
 #define STACKSIZE (2048)
@@ -19,111 +24,297 @@
 /* scheduling priority used by each thread */
 #define PRIORITY 7
 
+/* Above the NTP polls, an exchange the STM32 asks for never waits on the network */
+#define LINK_PRIORITY (PRIORITY - 1)
+
+/* Cooperative, the wait for the second boundary is never preempted by the other threads */
+#define PPS_PRIORITY K_PRIO_COOP(2)
+
+/* Width of the PPS pulse */
+#define PPS_PULSE_MS (100)
+
+/* Between exchanges the STM32 did not ask for, it asks for the time as it needs it */
+#define SPI_FALLBACK_INTERVAL_MS (60000)
+
+/* After the exchange of a new NTP sample, the next one gives the STM32 its round trip */
+#define SPI_COMPLETE_INTERVAL_MS (100)
+
+/* Check of the WiFi connection while it is down */
+#define WIFI_WAIT_INTERVAL_MS (1000)
+
+/* Offset of the last NTP sample on the displays, right end of the third row */
+#define STATUS_ROW (2)
+#define STATUS_COLUMN (14)
+#define STATUS_LENGTH (6)
+
 /**
- * @brief Connect to the given WiFi network and retrieve
- * 	the time from the SNTP server
+ * @brief Poll the NTP servers for the time whenever
+ * 	the WiFi connection is up, a new sample is handed
+ * 	to the link queue to go to the STM32 at once
  */
-void connect_sntp();
+static void ntp_work_handler(struct k_work *work);
 
 /**
- * @brief Send the retreived time via the SPI interface
+ * @brief Send the retreived time to the display nodes, as
+ * 	timesync.h frames, and read back their telemetry
  */
-void spi_send_data();
+static void spi_work_handler(struct k_work *work);
 
-K_MUTEX_DEFINE(mutex_sntp_time);
+/**
+ * @brief Drive the PPS GPIO high at every UTC second boundary of
+ * 	the SNTP time, for the STM32 to align its RTC to
+ */
+void pps_output();
 
-static struct sntp_time sntp_time_val;
+static const struct gpio_dt_spec pps_gpio = GPIO_DT_SPEC_GET(PPS_NODE, pps_gpios);
+static const struct gpio_dt_spec request_gpio = GPIO_DT_SPEC_GET(PPS_NODE, request_gpios);
+static struct gpio_callback request_cb;
 
 static char dayofweek[7][10] = {"Sunday", "Monday", "Tuesday", "Wednesday",
 								"Thursday", "Friday", "Saturday"};
 
-void connect_sntp()
+/* The NTP polls and the Wi-Fi connection, a poll blocks on its replies */
+K_THREAD_STACK_DEFINE(sync_stack, STACKSIZE);
+static struct k_work_q sync_work_q;
+static K_WORK_DELAYABLE_DEFINE(ntp_work, ntp_work_handler);
+
+/* The SPI exchanges, the only thread talking to the nodes */
+K_THREAD_STACK_DEFINE(link_stack, STACKSIZE);
+static struct k_work_q link_work_q;
+static K_WORK_DELAYABLE_DEFINE(spi_work, spi_work_handler);
+
+static struct ntp_poll poll_state;
+static int64_t last_uptime_us = -1; /* Of the last sample fed to the clock */
+
+/* Of the last sample, from the NTP queue to the link queue */
+struct sync_status
 {
-	wifi_config_t wifi_config = {
-		.sta =
-			{
-				.ssid = "<Your_WiFi_SSID>",
-				.password = "<Your_WiFi_Password>",
-			},
-	};
+	int64_t offset_us;
+	uint16_t ttl_s;
+	bool is_step;
+	bool is_shown;	/* On the displays already */
+	bool is_sent;	/* Exchanged with the STM32 already */
+};
+static struct k_spinlock status_lock;
+static struct sync_status status = {.is_shown = true, .is_sent = true};
+
+static int node_count;
 
-	esp_err_t ret = esp_wifi_set_mode(ESP32_WIFI_MODE_STA);
+/**
+ * @brief Show the offset of a new sample on every display
+ * It is shown for two poll intervals, it goes when the polls stop.
+ */
+static void show_sync_status(const struct sync_status *sync)
+{
+	char text[STATUS_LENGTH + 1];
+	int64_t offset_us = sync->offset_us;
+	int64_t magnitude_us = (offset_us < 0) ? -offset_us : offset_us;
 
-	ret |= esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
-	ret |= esp_wifi_connect();
-	if (ret != ESP_OK)
+	if (sync->is_step || magnitude_us >= USEC_PER_SEC)
+	{
+		strcpy(text, "  step");
+	}
+	else if (magnitude_us >= USEC_PER_MSEC)
+	{
+		snprintk(text, sizeof(text), "%+4dms", (int)(offset_us / USEC_PER_MSEC));
+	}
+	else
 	{
-		printk("connection failed\n");
+		snprintk(text, sizeof(text), "%+4dus", (int)offset_us);
 	}
-	struct sntp_ctx ctx;
-	struct sockaddr_in addr;
-	int rv;
 
-	/* ipv4 */
-	memset(&addr, 0, sizeof(addr));
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(SNTP_PORT);
-	inet_pton(AF_INET, SERVER_ADDR, &addr.sin_addr);
+	struct timesync_content content = {
+		.row = STATUS_ROW,
+		.column = STATUS_COLUMN,
+		.ttl_s = sync->ttl_s,
+		.length = STATUS_LENGTH,
+		.text = (const uint8_t *)text,
+	};
+	node_link_send_content(NODE_LINK_ALL, &content);
+}
+
+static void ntp_work_handler(struct k_work *work)
+{
+	int64_t utc_us;
+	int64_t at_uptime_us;
+	int64_t offset_us = 0;
 
-	rv = sntp_init(&ctx, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
-	if (rv < 0)
+	/* No query is sent into a link that is down */
+	if (!wifi_conn_wait_ready(K_NO_WAIT))
 	{
-		printk("Failed to init SNTP IPv4 ctx: %d\n", rv);
-		goto end;
+		k_work_reschedule_for_queue(&sync_work_q, &ntp_work, K_MSEC(WIFI_WAIT_INTERVAL_MS));
+		return;
 	}
 
-	printk("Sending SNTP IPv4 request...\n");
-	while (1)
+	/* Awake for the exchanges, replies held back for a sleeping radio would skew the delay */
+	esp_wifi_set_ps(WIFI_PS_NONE);
+	int selected = ntp_client_poll(&utc_us, &at_uptime_us);
+	esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
+	if (selected < 0)
 	{
-	start:
-		k_mutex_lock(&mutex_sntp_time, K_FOREVER);
-		rv = sntp_query(&ctx, 4 * MSEC_PER_SEC, &sntp_time_val);
-		k_mutex_unlock(&mutex_sntp_time);
-		if (rv < 0)
-		{
-			printk("SNTP IPv4 request failed: %d\n", rv);
-			goto start;
-		}
+		ntp_poll_update(&poll_state, NTP_POLL_MISSED, false, 0);
+		printk("No NTP server agrees with the others, next poll in %u s\n", ntp_poll_interval_s(&poll_state));
+		k_work_reschedule_for_queue(&sync_work_q, &ntp_work, K_SECONDS(ntp_poll_interval_s(&poll_state)));
+		return;
+	}
+	const struct ntp_peer *peer = ntp_client_peer(selected);
+	/* The filter may keep its sample over several polls, it is only used once */
+	if (at_uptime_us > last_uptime_us)
+	{
+		bool is_step = disc_clock_update(utc_us, at_uptime_us, &offset_us);
+		ntp_poll_update(&poll_state, is_step ? NTP_POLL_STEP : NTP_POLL_OK,
+						peer->count == NTP_FILTER_STAGES && disc_clock_has_rate(), offset_us);
+		last_uptime_us = at_uptime_us;
 
-		struct tm tm = {
-			/* Initialize an unset field */
-			.tm_isdst = 1234,
+		k_spinlock_key_t key = k_spin_lock(&status_lock);
+		status = (struct sync_status){
+			.offset_us = offset_us,
+			.ttl_s = (uint16_t)MIN(2U * ntp_poll_interval_s(&poll_state), UINT16_MAX),
+			.is_step = is_step,
 		};
-		time_t time = (time_t)(sntp_time_val.seconds - 14400);
-		struct tm *tp = gmtime(&time);
-		printk("%02d/%02d/%04d %s %02d:%02d:%02d\n", tp->tm_mon, tp->tm_mday,
-			   (1900 + tp->tm_year), dayofweek[tp->tm_wday], tp->tm_hour, tp->tm_min,
-			   tp->tm_sec);
-		k_msleep(1000);
+		k_spin_unlock(&status_lock, key);
+		k_work_reschedule_for_queue(&link_work_q, &spi_work, K_NO_WAIT);
 	}
 
-end:
-	sntp_close(&ctx);
+	bool is_dst;
+	int64_t utc_s = utc_us / USEC_PER_SEC;
+	time_t time = (time_t)(utc_s + (tz_rule_offset_min(utc_s, &is_dst) * 60));
+	struct tm *tp = gmtime(&time);
+	printk("%02d/%02d/%04d %s %02d:%02d:%02d%s from %s, offset %lld us, delay %lld us, jitter %lld us, "
+		   "clock rate %d ppb, next poll in %u s\n",
+		   tp->tm_mon, tp->tm_mday, (1900 + tp->tm_year), dayofweek[tp->tm_wday], tp->tm_hour,
+		   tp->tm_min, tp->tm_sec, is_dst ? " DST" : "", ntp_client_server_name(selected), (long long)offset_us,
+		   (long long)peer->delay_us, (long long)peer->jitter_us, disc_clock_rate_ppb(),
+		   ntp_poll_interval_s(&poll_state));
+	k_work_reschedule_for_queue(&sync_work_q, &ntp_work, K_SECONDS(ntp_poll_interval_s(&poll_state)));
 }
 
-void spi_send_data()
+static void spi_work_handler(struct k_work *work)
 {
-	const struct device *spi2_dev = DEVICE_DT_GET(SPI2_NODE);
+	uint32_t next_ms = SPI_FALLBACK_INTERVAL_MS;
+	uint32_t updated;
 
-	const struct spi_config spi_cfg = {
-		.frequency = 1562500U,
-		.operation = SPI_WORD_SET(8) | SPI_TRANSFER_MSB | SPI_OP_MODE_MASTER};
+	k_spinlock_key_t key = k_spin_lock(&status_lock);
+	struct sync_status sync = status;
+	status.is_shown = true;
+	k_spin_unlock(&status_lock, key);
+	if (!sync.is_shown)
+	{
+		show_sync_status(&sync);
+	}
 
-	struct spi_buf tx_bufs[] = {
-		{.buf = (uint8_t *)&(sntp_time_val.seconds), .len = 8},
-	};
+	/* Nothing to send before the first SNTP reply, the clock holds over any outage after it */
+	int rv = node_link_exchange(&updated);
+	if (rv == 0 && !sync.is_sent)
+	{
+		key = k_spin_lock(&status_lock);
+		/* A newer sample that came meanwhile still needs its own exchange */
+		status.is_sent = status.is_shown;
+		k_spin_unlock(&status_lock, key);
+		next_ms = SPI_COMPLETE_INTERVAL_MS;
+	}
 
-	struct spi_buf_set tx = {.buffers = tx_bufs, .count = 1};
+	for (int i = 0; i < node_count; i++)
+	{
+		struct timesync_telemetry telemetry;
+		struct node_link_stats stats;
+		if (!(updated & BIT(i)) || !node_link_get(i, &telemetry, &stats))
+		{
+			continue;
+		}
+		printk("Node %d: %d.%02d C, %u Pa, RTC offset %d us%s, drift %d ppb, "
+			   "errors %u/%u/%u, ack lag %u, failed %u/%u/%u\n",
+			   i, telemetry.temperature[0] / 100, abs(telemetry.temperature[0] % 100), telemetry.pressure,
+			   telemetry.rtc_offset_us,
+			   (telemetry.flags & TIMESYNC_TELEMETRY_FLAG_RTC_PRECISE) ? "" : " one way",
+			   telemetry.drift_ppb, telemetry.crc_errors, telemetry.framing_errors, telemetry.dropped,
+			   stats.ack_lag, stats.failed, stats.bad_replies, stats.exchanges);
+	}
+	/* Leaves an exchange asked for while this one ran where it is */
+	k_work_schedule_for_queue(&link_work_q, &spi_work, K_MSEC(next_ms));
+}
+
+void pps_output()
+{
+	if (!gpio_is_ready_dt(&pps_gpio) || gpio_pin_configure_dt(&pps_gpio, GPIO_OUTPUT_INACTIVE) < 0)
+	{
+		printk("PPS GPIO not ready\n");
+		return;
+	}
 
 	while (1)
 	{
-		k_mutex_lock(&mutex_sntp_time, K_FOREVER);
-		spi_write(spi2_dev, &spi_cfg, &tx);
-		k_mutex_unlock(&mutex_sntp_time);
-		/* Send every 5 seconds */
-		k_msleep(5000);
+		int64_t now_us;
+		int64_t edge_uptime_us;
+		if (!disc_clock_now(disc_clock_uptime_us(), &now_us) ||
+			!disc_clock_to_uptime(now_us + (USEC_PER_SEC - (now_us % USEC_PER_SEC)), &edge_uptime_us))
+		{
+			k_msleep(1000);
+			continue;
+		}
+
+		/* Sleep to the last tick before the edge, the rest is timed to the microsecond */
+		k_sleep(K_TIMEOUT_ABS_TICKS(k_us_to_ticks_floor64(edge_uptime_us)));
+		int64_t left_us = edge_uptime_us - disc_clock_uptime_us();
+		if (left_us > 0)
+		{
+			k_busy_wait((uint32_t)left_us);
+		}
+		gpio_pin_set_dt(&pps_gpio, 1);
+		k_msleep(PPS_PULSE_MS);
+		gpio_pin_set_dt(&pps_gpio, 0);
+	}
+}
+
+/**
+ * @brief Rising edge of the request line, the STM32 asks for a time frame
+ */
+static void request_handler(const struct device *port, struct gpio_callback *cb, gpio_port_pins_t pins)
+{
+	k_work_reschedule_for_queue(&link_work_q, &spi_work, K_NO_WAIT);
+}
+
+int main(void)
+{
+	k_work_queue_start(&sync_work_q, sync_stack, K_THREAD_STACK_SIZEOF(sync_stack), PRIORITY, NULL);
+	k_thread_name_set(&sync_work_q.thread, "sync");
+	k_work_queue_start(&link_work_q, link_stack, K_THREAD_STACK_SIZEOF(link_stack), LINK_PRIORITY, NULL);
+	k_thread_name_set(&link_work_q.thread, "link");
+	wifi_conn_start(&sync_work_q);
+
+	ntp_poll_init(&poll_state);
+	int count = ntp_client_init();
+	if (count < 0)
+	{
+		printk("Failed to init NTP client: %d\n", count);
+	}
+	else
+	{
+		printk("Polling %d NTP servers...\n", count);
+		k_work_reschedule_for_queue(&sync_work_q, &ntp_work, K_NO_WAIT);
+	}
+	node_count = node_link_init();
+	if (node_count < 0)
+	{
+		printk("Failed to init the display link: %d\n", node_count);
+		node_count = 0;
+	}
+	else
+	{
+		printk("Sending to %d display nodes\n", node_count);
+		k_work_reschedule_for_queue(&link_work_q, &spi_work, K_NO_WAIT);
+	}
+
+	if (!gpio_is_ready_dt(&request_gpio) || gpio_pin_configure_dt(&request_gpio, GPIO_INPUT) < 0)
+	{
+		printk("Request GPIO not ready, sending every %d s\n", SPI_FALLBACK_INTERVAL_MS / 1000);
+		return 0;
 	}
+	gpio_init_callback(&request_cb, request_handler, BIT(request_gpio.pin));
+	gpio_add_callback(request_gpio.port, &request_cb);
+	gpio_pin_interrupt_configure_dt(&request_gpio, GPIO_INT_EDGE_TO_ACTIVE);
+	return 0;
 }
 
-K_THREAD_DEFINE(spi_send_data_id, STACKSIZE, spi_send_data, NULL, NULL, NULL, 8, 0, 0);
-K_THREAD_DEFINE(connect_sntp_id, STACKSIZE, connect_sntp, NULL, NULL, NULL, PRIORITY, 0, 0);
\ No newline at end of file
+K_THREAD_DEFINE(pps_output_id, STACKSIZE, pps_output, NULL, NULL, NULL, PPS_PRIORITY, 0, 0);
\ No newline at end of file
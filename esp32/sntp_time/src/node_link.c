@@ -0,0 +1,291 @@
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/spi.h>
+
+#include "node_link.h"
+#include "disc_clock.h"
+#include "tz_rule.h"
+
+#define SPI2_NODE DT_NODELABEL(spi2)
+
+/* Chip selects, see esp32.overlay */
+#define NODES_NODE DT_PATH(zephyr_user)
+
+#define NODE_CS_GPIO(node_id, prop, idx) GPIO_DT_SPEC_GET_BY_IDX(node_id, prop, idx),
+
+struct node_state
+{
+	struct timesync_telemetry telemetry;
+	bool is_telemetry_valid;
+	struct node_link_stats stats;
+	/* Of its own time exchanges, unused when broadcasting */
+	uint8_t sequence;
+	uint32_t round_trip_us; /* Of the previous exchange, 0 if it failed */
+};
+
+static const struct gpio_dt_spec cs_gpios[] = {DT_FOREACH_PROP_ELEM(NODES_NODE, node_cs_gpios, NODE_CS_GPIO)};
+
+static const struct spi_config spi_cfg = {
+	.frequency = 1562500U,
+	.operation = SPI_WORD_SET(8) | SPI_TRANSFER_MSB | SPI_OP_MODE_MASTER};
+
+/* Guards the telemetry and the counters of the nodes against node_link_get() */
+K_MUTEX_DEFINE(node_link_mutex);
+
+static struct node_state nodes[NODE_LINK_MAX_NODES];
+static int node_count;
+static const struct device *cs_port;
+static gpio_port_pins_t all_cs_pins;
+
+/* Both directions are a full exchange, each frame padded with zeros */
+static uint8_t tx_exchange[TIMESYNC_EXCHANGE_LEN];
+static uint8_t rx_exchange[TIMESYNC_EXCHANGE_LEN];
+
+/* Of the broadcast time frames */
+static uint8_t broadcast_sequence;
+static uint32_t broadcast_round_trip_us;
+static uint8_t poll_sequence;
+static uint8_t content_sequence;
+static int next_poll; /* Node read after the next broadcast */
+
+/**
+ * @brief One exchange of tx_exchange with the given nodes selected
+ *
+ * @param cs_pins Chip selects on cs_port
+ * @param is_read Whether MISO is read into rx_exchange, it is not while several nodes drive it
+ */
+static int transfer(gpio_port_pins_t cs_pins, bool is_read)
+{
+	const struct device *spi2_dev = DEVICE_DT_GET(SPI2_NODE);
+	struct spi_buf tx_buf = {.buf = tx_exchange, .len = sizeof(tx_exchange)};
+	struct spi_buf rx_buf = {.buf = rx_exchange, .len = sizeof(rx_exchange)};
+	struct spi_buf_set tx = {.buffers = &tx_buf, .count = 1};
+	struct spi_buf_set rx = {.buffers = &rx_buf, .count = 1};
+
+	/* Active low, checked by node_link_init(). One write so every node sees the same edges */
+	gpio_port_clear_bits_raw(cs_port, cs_pins);
+	k_busy_wait(NODE_LINK_CS_SETUP_US);
+	int rv = spi_transceive(spi2_dev, &spi_cfg, &tx, is_read ? &rx : NULL);
+	gpio_port_set_bits_raw(cs_port, cs_pins);
+	return rv;
+}
+
+/**
+ * @brief Time frame exchange, T1 taken just before it
+ *
+ * @param round_trip_us Of the previous exchange with the same nodes, set to the one of this exchange
+ * @return int -EAGAIN before the clock is set, otherwise the result of the transfer
+ */
+static int send_time(gpio_port_pins_t cs_pins, bool is_read, uint8_t sequence, uint32_t *round_trip_us)
+{
+	int64_t t1_uptime_us = disc_clock_uptime_us();
+	int64_t t1_us;
+
+	if (!disc_clock_now(t1_uptime_us, &t1_us))
+	{
+		return -EAGAIN;
+	}
+	bool is_dst;
+	int16_t utc_offset_min = tz_rule_offset_min(t1_us / USEC_PER_SEC, &is_dst);
+	struct timesync_time time = {
+		.seconds = (uint32_t)(t1_us / USEC_PER_SEC),
+		.fraction = (uint32_t)(((uint64_t)(t1_us % USEC_PER_SEC) << 32) / USEC_PER_SEC),
+		.utc_offset_min = utc_offset_min,
+		.flags = is_dst ? TIMESYNC_FLAG_DST : 0,
+		.round_trip_us = *round_trip_us,
+	};
+	memset(tx_exchange, 0, sizeof(tx_exchange));
+	timesync_encode_time(tx_exchange, sequence, &time);
+
+	int rv = transfer(cs_pins, is_read);
+	/* T4, sent with the next frame for the STM32 to complete this exchange. 0 is kept for a failed one */
+	*round_trip_us = (rv == 0) ? MAX((uint32_t)(disc_clock_uptime_us() - t1_uptime_us), 1U) : 0;
+	return rv;
+}
+
+/**
+ * @brief Account for an exchange read from one node
+ *
+ * @param rv Result of its transfer
+ * @param last_sequence Of the last time frame the node could have acknowledged, the one before this exchange
+ * @return true if it returned valid telemetry
+ */
+static bool take_telemetry(int index, int rv, uint8_t last_sequence)
+{
+	struct node_state *node = &nodes[index];
+	struct timesync_telemetry telemetry;
+	uint8_t telemetry_sequence;
+	/* The STM32 staged its frame before this exchange */
+	bool is_valid = (rv == 0) && timesync_decode_telemetry(rx_exchange, sizeof(rx_exchange), &telemetry_sequence,
+														   &telemetry) == TIMESYNC_OK;
+
+	k_mutex_lock(&node_link_mutex, K_FOREVER);
+	node->stats.exchanges++;
+	if (rv != 0)
+	{
+		node->stats.failed++;
+	}
+	else if (!is_valid)
+	{
+		node->stats.bad_replies++;
+	}
+	else
+	{
+		node->telemetry = telemetry;
+		node->is_telemetry_valid = true;
+		node->stats.ack_lag = (uint8_t)(last_sequence - telemetry.ack_sequence);
+	}
+	k_mutex_unlock(&node_link_mutex);
+	return is_valid;
+}
+
+/**
+ * @brief One time frame to every node, then the telemetry of the next node in turn
+ * A round costs two transfers however many nodes there are.
+ */
+static int exchange_broadcast(uint32_t *updated)
+{
+	uint8_t sequence = broadcast_sequence;
+	int rv = send_time(all_cs_pins, false, sequence, &broadcast_round_trip_us);
+	if (rv == -EAGAIN)
+	{
+		return rv;
+	}
+	broadcast_sequence++;
+
+	int index = next_poll;
+	next_poll = (next_poll + 1) % node_count;
+	memset(tx_exchange, 0, sizeof(tx_exchange));
+	timesync_encode_poll(tx_exchange, poll_sequence++);
+	if (take_telemetry(index, transfer(BIT(cs_gpios[index].pin), true), (uint8_t)(sequence - 1U)))
+	{
+		*updated |= BIT(index);
+	}
+	return rv;
+}
+
+/**
+ * @brief A time exchange with each node in turn, each returns its telemetry
+ */
+static int exchange_each(uint32_t *updated)
+{
+	int result = 0;
+
+	for (int i = 0; i < node_count; i++)
+	{
+		struct node_state *node = &nodes[i];
+		uint8_t sequence = node->sequence;
+		int rv = send_time(BIT(cs_gpios[i].pin), true, sequence, &node->round_trip_us);
+		if (rv == -EAGAIN)
+		{
+			return rv;
+		}
+		node->sequence++;
+
+		if (take_telemetry(i, rv, (uint8_t)(sequence - 1U)))
+		{
+			*updated |= BIT(i);
+		}
+		if (rv != 0)
+		{
+			result = rv;
+		}
+	}
+	return result;
+}
+
+int node_link_init(void)
+{
+	if (!device_is_ready(DEVICE_DT_GET(SPI2_NODE)))
+	{
+		return -ENODEV;
+	}
+
+	node_count = MIN(ARRAY_SIZE(cs_gpios), NODE_LINK_MAX_NODES);
+	for (int i = 0; i < node_count; i++)
+	{
+		const struct gpio_dt_spec *cs = &cs_gpios[i];
+		/* Released together by one port write */
+		if (cs->port != cs_gpios[0].port || !(cs->dt_flags & GPIO_ACTIVE_LOW))
+		{
+			return -EINVAL;
+		}
+		if (!gpio_is_ready_dt(cs))
+		{
+			return -ENODEV;
+		}
+		int rv = gpio_pin_configure_dt(cs, GPIO_OUTPUT_INACTIVE);
+		if (rv < 0)
+		{
+			return rv;
+		}
+		all_cs_pins |= BIT(cs->pin);
+	}
+	cs_port = cs_gpios[0].port;
+	return node_count;
+}
+
+int node_link_exchange(uint32_t *updated)
+{
+	*updated = 0;
+	if (node_count == 0)
+	{
+		return -ENODEV;
+	}
+	if (IS_ENABLED(CONFIG_TIMESYNC_BROADCAST))
+	{
+		return exchange_broadcast(updated);
+	}
+	return exchange_each(updated);
+}
+
+int node_link_send_content(int index, const struct timesync_content *content)
+{
+	if (node_count == 0)
+	{
+		return -ENODEV;
+	}
+	if (index >= node_count || index < NODE_LINK_ALL)
+	{
+		return -EINVAL;
+	}
+	memset(tx_exchange, 0, sizeof(tx_exchange));
+	timesync_encode_content(tx_exchange, content_sequence++, content);
+
+	if (index != NODE_LINK_ALL)
+	{
+		return transfer(BIT(cs_gpios[index].pin), false);
+	}
+	if (IS_ENABLED(CONFIG_TIMESYNC_BROADCAST))
+	{
+		return transfer(all_cs_pins, false);
+	}
+	/* The frame is left in tx_exchange by each transfer */
+	int result = 0;
+	for (int i = 0; i < node_count; i++)
+	{
+		int rv = transfer(BIT(cs_gpios[i].pin), false);
+		if (rv != 0)
+		{
+			result = rv;
+		}
+	}
+	return result;
+}
+
+bool node_link_get(int index, struct timesync_telemetry *telemetry, struct node_link_stats *stats)
+{
+	k_mutex_lock(&node_link_mutex, K_FOREVER);
+	bool is_valid = nodes[index].is_telemetry_valid;
+	*telemetry = nodes[index].telemetry;
+	if (stats)
+	{
+		*stats = nodes[index].stats;
+	}
+	k_mutex_unlock(&node_link_mutex);
+	return is_valid;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPI link to the STM32 display nodes
+ *
+ * Every node has its own chip select, node-cs-gpios of esp32.overlay, all
+ * on one GPIO port and driven here rather than by the SPI driver. With
+ * CONFIG_TIMESYNC_BROADCAST the time frame goes to every node in one
+ * transfer and one port write releases all the chip selects, so every
+ * node stamps the same edge and their RTCs tick together. The nodes share
+ * MISO open-drain (APP_LINK_SHARED_BUS on the STM32) and what comes back
+ * is not read, the telemetry of one node is read with a poll frame after
+ * each broadcast. Otherwise each node gets its own time exchange and
+ * returns its telemetry in it.
+ *
+ * Content frames patch the text of the displays between time frames, they
+ * go out as they are pushed and are not answered.
+ */
+#ifndef NODE_LINK_H
+#define NODE_LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "timesync.h"
+
+/* Nodes beyond these are ignored */
+#define NODE_LINK_MAX_NODES (8)
+
+/* Index of node_link_send_content() addressing every node */
+#define NODE_LINK_ALL (-1)
+
+/* Chip select to first clock, the STM32 hands MISO to the SPI from its NSS interrupt */
+#define NODE_LINK_CS_SETUP_US (20)
+
+/**
+ * @brief Quality of the link to a node
+ */
+struct node_link_stats
+{
+	uint32_t exchanges;	  /* Addressed to the node alone */
+	uint32_t failed;	  /* Not completed by the SPI driver */
+	uint32_t bad_replies; /* Completed without a valid telemetry frame */
+	uint8_t ack_lag;	  /* Time frames the node has not acknowledged, 0 while it keeps up */
+};
+
+/**
+ * @brief Configure the chip selects and the SPI
+ *
+ * @return int Number of nodes, negative errno on failure
+ */
+int node_link_init(void);
+
+/**
+ * @brief Send the time to every node and read the telemetry of one or all
+ * T1 of each time frame is the disciplined clock just before its transfer,
+ * the local time offset is the one of the time zone rule at T1.
+ *
+ * @param updated Set to a bit per node whose telemetry was read
+ * @return int 0 if the time went out, -EAGAIN before the clock is set, other negative errno
+ */
+int node_link_exchange(uint32_t *updated);
+
+/**
+ * @brief Send a text patch to the display of a node or of every node
+ * Only one thread may exchange with the nodes, the one of node_link_exchange().
+ *
+ * @param index From 0 to the count returned by node_link_init(), or NODE_LINK_ALL
+ * @param content Patch to show, text beyond TIMESYNC_CONTENT_MAX_TEXT is cut
+ * @return int 0 if it went out to every addressed node, negative errno otherwise
+ */
+int node_link_send_content(int index, const struct timesync_content *content);
+
+/**
+ * @brief Last telemetry of a node and the quality of its link
+ *
+ * @param index From 0 to the count returned by node_link_init()
+ * @param telemetry Populated with the last valid telemetry
+ * @param stats Populated with the link counters, may be NULL
+ * @return false if no valid telemetry came from the node yet
+ */
+bool node_link_get(int index, struct timesync_telemetry *telemetry, struct node_link_stats *stats);
+
+#endif /* NODE_LINK_H */
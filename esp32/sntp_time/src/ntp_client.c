@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "ntp_client.h"
+#include "disc_clock.h"
+
+#define NTP_PORT 123
+#define NTP_PACKET_LEN 48
+
+/* Seconds from 1900, the NTP era, to 1970 */
+#define NTP_UNIX_OFFSET_S 2208988800LL
+
+#define NTP_LI_ALARM 3 /* The server is not synchronized */
+#define NTP_VERSION 4
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_MAX_STRATUM 15
+
+struct ntp_server
+{
+	char name[24];
+	struct sockaddr_in addr;
+	struct ntp_peer peer;
+};
+
+static struct ntp_server servers[NTP_CLIENT_MAX_SERVERS];
+static int server_count;
+static int sock = -1;
+
+/**
+ * @brief 64 bit NTP timestamp of a local time, the uptime goes in as seconds since 1900
+ */
+static void put_timestamp(uint8_t *buf, int64_t local_us)
+{
+	sys_put_be32((uint32_t)(local_us / USEC_PER_SEC), buf);
+	sys_put_be32((uint32_t)(((uint64_t)(local_us % USEC_PER_SEC) << 32) / USEC_PER_SEC), buf + 4);
+}
+
+/**
+ * @brief Server timestamp to microseconds since 1970 UTC
+ */
+static int64_t get_timestamp(const uint8_t *buf)
+{
+	int64_t seconds = (int64_t)sys_get_be32(buf) - NTP_UNIX_OFFSET_S;
+	return seconds * USEC_PER_SEC + (int64_t)(((uint64_t)sys_get_be32(buf + 4) * USEC_PER_SEC) >> 32);
+}
+
+/**
+ * @brief NTP short format, 16.16 seconds, to microseconds
+ */
+static int64_t get_short(const uint8_t *buf)
+{
+	return (int64_t)(((uint64_t)sys_get_be32(buf) * USEC_PER_SEC) >> 16);
+}
+
+static int parse_server(const char *entry, struct ntp_server *server)
+{
+	char host[16];
+	const char *colon = strchr(entry, ':');
+	size_t host_len = colon ? (size_t)(colon - entry) : strlen(entry);
+
+	if (host_len == 0 || host_len >= sizeof(host) || strlen(entry) >= sizeof(server->name))
+	{
+		return -EINVAL;
+	}
+	memcpy(host, entry, host_len);
+	host[host_len] = '\0';
+
+	memset(server, 0, sizeof(*server));
+	strcpy(server->name, entry);
+	server->addr.sin_family = AF_INET;
+	server->addr.sin_port = htons(colon ? (uint16_t)strtoul(colon + 1, NULL, 10) : NTP_PORT);
+	if (inet_pton(AF_INET, host, &server->addr.sin_addr) != 1 || server->addr.sin_port == 0)
+	{
+		return -EINVAL;
+	}
+	ntp_peer_reset(&server->peer);
+	return 0;
+}
+
+int ntp_client_init(void)
+{
+	char list[] = CONFIG_NTP_SERVERS;
+	char *saveptr;
+
+	server_count = 0;
+	for (char *entry = strtok_r(list, ", ", &saveptr); entry && server_count < NTP_CLIENT_MAX_SERVERS;
+		 entry = strtok_r(NULL, ", ", &saveptr))
+	{
+		if (parse_server(entry, &servers[server_count]) == 0)
+		{
+			server_count++;
+		}
+		else
+		{
+			printk("Ignoring NTP server %s\n", entry);
+		}
+	}
+	if (server_count == 0)
+	{
+		return -EINVAL;
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0)
+	{
+		return -errno;
+	}
+	return server_count;
+}
+
+/**
+ * @brief One exchange with a server
+ * Replies that do not echo this request, late replies to an earlier one
+ * among them, are dropped.
+ */
+static int query(struct ntp_server *server, struct ntp_sample *sample)
+{
+	uint8_t request[NTP_PACKET_LEN] = {0};
+	uint8_t reply[NTP_PACKET_LEN];
+
+	request[0] = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+	int64_t t1_us = disc_clock_uptime_us();
+	put_timestamp(&request[40], t1_us);
+	if (sendto(sock, request, sizeof(request), 0, (struct sockaddr *)&server->addr, sizeof(server->addr)) < 0)
+	{
+		return -errno;
+	}
+
+	int64_t deadline_us = t1_us + (NTP_CLIENT_TIMEOUT_MS * USEC_PER_MSEC);
+	while (1)
+	{
+		int64_t left_us = deadline_us - disc_clock_uptime_us();
+		struct pollfd fds = {.fd = sock, .events = POLLIN};
+		if (left_us <= 0 || poll(&fds, 1, (int)(left_us / USEC_PER_MSEC) + 1) <= 0)
+		{
+			return -ETIMEDOUT;
+		}
+		ssize_t len = recv(sock, reply, sizeof(reply), 0);
+		int64_t t4_us = disc_clock_uptime_us();
+		if (len < NTP_PACKET_LEN || (reply[0] & 0x07) != NTP_MODE_SERVER ||
+			memcmp(&reply[24], &request[40], 8) != 0)
+		{
+			continue;
+		}
+		if ((reply[0] >> 6) == NTP_LI_ALARM || reply[1] == 0 || reply[1] > NTP_MAX_STRATUM ||
+			sys_get_be32(&reply[40]) == 0)
+		{
+			return -EAGAIN;
+		}
+
+		int64_t t2_us = get_timestamp(&reply[32]);
+		int64_t t3_us = get_timestamp(&reply[40]);
+		sample->offset_us = ((t2_us - t1_us) + (t3_us - t4_us)) / 2;
+		sample->delay_us = MAX((t4_us - t1_us) - (t3_us - t2_us), NTP_FILTER_PRECISION_US);
+		/* Precision of the server, a power of two in seconds, and of the uptime */
+		int8_t precision = (int8_t)reply[3];
+		sample->dispersion_us = NTP_FILTER_PRECISION_US +
+								((precision < 0 && precision > -32) ? (int64_t)(USEC_PER_SEC >> -precision) : USEC_PER_SEC);
+		sample->local_us = t4_us;
+
+		server->peer.stratum = reply[1];
+		server->peer.root_delay_us = get_short(&reply[4]);
+		server->peer.root_dispersion_us = get_short(&reply[8]);
+		return 0;
+	}
+}
+
+int ntp_client_poll(int64_t *utc_us, int64_t *at_uptime_us)
+{
+	const struct ntp_peer *peers[NTP_CLIENT_MAX_SERVERS];
+
+	for (int i = 0; i < server_count; i++)
+	{
+		struct ntp_sample sample;
+		int rv = query(&servers[i], &sample);
+		if (rv < 0)
+		{
+			printk("NTP server %s: %d\n", servers[i].name, rv);
+		}
+		ntp_peer_poll(&servers[i].peer, (rv == 0) ? &sample : NULL, disc_clock_uptime_us(), disc_clock_rate_ppb());
+	}
+
+	for (int i = 0; i < server_count; i++)
+	{
+		peers[i] = &servers[i].peer;
+	}
+	int selected = ntp_select(peers, server_count, disc_clock_uptime_us());
+	if (selected >= 0)
+	{
+		/* As measured, the clock finds its rate from these and must not be fed its own */
+		*at_uptime_us = peers[selected]->update_us;
+		*utc_us = *at_uptime_us + peers[selected]->update_offset_us;
+	}
+	return selected;
+}
+
+const struct ntp_peer *ntp_client_peer(int index)
+{
+	return &servers[index].peer;
+}
+
+const char *ntp_client_server_name(int index)
+{
+	return servers[index].name;
+}
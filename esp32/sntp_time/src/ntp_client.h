@@ -0,0 +1,55 @@
+/*
+ * NTP client polling the servers of CONFIG_NTP_SERVERS
+ *
+ * Requests and replies are stamped on the uptime, each exchange gives the
+ * offset of the server clock from the uptime and the round trip delay
+ * from the four NTP timestamps. These go through the clock filter of the
+ * server, and the best server is selected from those that agree.
+ */
+#ifndef NTP_CLIENT_H
+#define NTP_CLIENT_H
+
+#include <stdint.h>
+
+#include "ntp_filter.h"
+
+/* Servers taken from CONFIG_NTP_SERVERS, the rest are ignored */
+#define NTP_CLIENT_MAX_SERVERS (4)
+
+/* Wait for each reply */
+#define NTP_CLIENT_TIMEOUT_MS (1000)
+
+/**
+ * @brief Parse the server list and open the socket
+ *
+ * @return int Number of servers, negative errno on failure
+ */
+int ntp_client_init(void);
+
+/**
+ * @brief Query every server once and select the best
+ * The time returned is the sample the filter of the selected server
+ * chose, at the uptime it was taken. That sample may be the one returned
+ * by an earlier poll.
+ *
+ * @param utc_us Set to the time of the selected server at at_uptime_us
+ * @param at_uptime_us Set to the uptime utc_us was measured at
+ * @return int Index of the selected server, negative if none was selected
+ */
+int ntp_client_poll(int64_t *utc_us, int64_t *at_uptime_us);
+
+/**
+ * @brief State of a server
+ *
+ * @param index From 0 to the count returned by ntp_client_init()
+ */
+const struct ntp_peer *ntp_client_peer(int index);
+
+/**
+ * @brief Address of a server as configured
+ *
+ * @param index From 0 to the count returned by ntp_client_init()
+ */
+const char *ntp_client_server_name(int index);
+
+#endif /* NTP_CLIENT_H */
@@ -0,0 +1,231 @@
+#include <math.h>
+#include <stddef.h>
+
+#include "ntp_filter.h"
+
+static int64_t sample_dispersion(const struct ntp_sample *sample, int64_t now_us)
+{
+	return sample->dispersion_us + (((now_us - sample->local_us) * NTP_FILTER_PHI_PPM) / 1000000);
+}
+
+/**
+ * @brief Offset of a sample carried forward to now, a fast local clock gains on the server
+ */
+static int64_t sample_offset(const struct ntp_sample *sample, int64_t now_us, int32_t rate_ppb)
+{
+	return sample->offset_us - (((now_us - sample->local_us) * rate_ppb) / 1000000000LL);
+}
+
+void ntp_peer_reset(struct ntp_peer *peer)
+{
+	peer->count = 0;
+	peer->next = 0;
+	peer->reach = 0;
+}
+
+/**
+ * @brief Clock filter, the sample of least delay has the least error
+ * The dispersion weighs the samples by delay, the jitter is the RMS
+ * of their offsets from the one used.
+ */
+static void peer_filter(struct ntp_peer *peer, int64_t now_us, int32_t rate_ppb)
+{
+	const struct ntp_sample *order[NTP_FILTER_STAGES];
+	uint8_t n = peer->count;
+
+	for (uint8_t i = 0; i < n; i++)
+	{
+		const struct ntp_sample *sample = &peer->samples[i];
+		uint8_t j = i;
+		while (j > 0 && order[j - 1]->delay_us > sample->delay_us)
+		{
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = sample;
+	}
+
+	int64_t offset_us = sample_offset(order[0], now_us, rate_ppb);
+	int64_t dispersion_us = 0;
+	double jitter = 0;
+	for (uint8_t i = n; i > 0; i--)
+	{
+		dispersion_us = (dispersion_us + sample_dispersion(order[i - 1], now_us)) / 2;
+		double difference = (double)(sample_offset(order[i - 1], now_us, rate_ppb) - offset_us);
+		jitter += difference * difference;
+	}
+	peer->offset_us = offset_us;
+	peer->delay_us = order[0]->delay_us;
+	peer->dispersion_us = dispersion_us;
+	peer->jitter_us = (n > 1) ? (int64_t)sqrt(jitter / (n - 1)) : NTP_FILTER_PRECISION_US;
+	peer->update_us = order[0]->local_us;
+	peer->update_offset_us = order[0]->offset_us;
+}
+
+void ntp_peer_poll(struct ntp_peer *peer, const struct ntp_sample *sample, int64_t now_us, int32_t rate_ppb)
+{
+	peer->reach <<= 1;
+	if (!sample)
+	{
+		return;
+	}
+	peer->reach |= 1U;
+	peer->samples[peer->next] = *sample;
+	peer->next = (peer->next + 1) % NTP_FILTER_STAGES;
+	if (peer->count < NTP_FILTER_STAGES)
+	{
+		peer->count++;
+	}
+	peer_filter(peer, now_us, rate_ppb);
+}
+
+int64_t ntp_peer_distance(const struct ntp_peer *peer, int64_t now_us)
+{
+	int64_t age_dispersion_us = ((now_us - peer->update_us) * NTP_FILTER_PHI_PPM) / 1000000;
+	return ((peer->root_delay_us + peer->delay_us) / 2) + peer->root_dispersion_us + peer->dispersion_us +
+		   age_dispersion_us + peer->jitter_us;
+}
+
+int ntp_select(const struct ntp_peer *const peers[], int count, int64_t now_us)
+{
+	if (count <= 0)
+	{
+		return -1;
+	}
+	int candidates[count];
+	int64_t low[count];
+	int64_t high[count];
+	int n = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!peers[i]->reach || !peers[i]->count)
+		{
+			continue;
+		}
+		int64_t distance_us = ntp_peer_distance(peers[i], now_us);
+		if (distance_us >= NTP_FILTER_MAX_DISTANCE_US)
+		{
+			continue;
+		}
+		candidates[n] = i;
+		low[n] = peers[i]->offset_us - distance_us;
+		high[n] = peers[i]->offset_us + distance_us;
+		n++;
+	}
+
+	/* Intersection, allowing for ever more falsetickers while they stay a minority */
+	for (int falsetickers = 0; 2 * falsetickers < n; falsetickers++)
+	{
+		int needed = n - falsetickers;
+		bool has_lower = false;
+		bool has_upper = false;
+		int64_t lower = 0;
+		int64_t upper = 0;
+
+		/* The lowest and highest points inside enough intervals are interval ends */
+		for (int i = 0; i < n; i++)
+		{
+			int lower_count = 0;
+			int upper_count = 0;
+			for (int j = 0; j < n; j++)
+			{
+				lower_count += (low[j] <= low[i] && low[i] <= high[j]);
+				upper_count += (low[j] <= high[i] && high[i] <= high[j]);
+			}
+			if (lower_count >= needed && (!has_lower || low[i] < lower))
+			{
+				lower = low[i];
+				has_lower = true;
+			}
+			if (upper_count >= needed && (!has_upper || high[i] > upper))
+			{
+				upper = high[i];
+				has_upper = true;
+			}
+		}
+		if (!has_lower || !has_upper || lower > upper)
+		{
+			continue;
+		}
+
+		/* Truechimers have their offset in the intersection, the closest to UTC of them wins */
+		int best = -1;
+		int64_t best_distance_us = 0;
+		for (int i = 0; i < n; i++)
+		{
+			const struct ntp_peer *peer = peers[candidates[i]];
+			if (peer->offset_us < lower || peer->offset_us > upper)
+			{
+				continue;
+			}
+			int64_t distance_us = ntp_peer_distance(peer, now_us);
+			if (best < 0 || distance_us < best_distance_us)
+			{
+				best = candidates[i];
+				best_distance_us = distance_us;
+			}
+		}
+		if (best >= 0)
+		{
+			return best;
+		}
+	}
+	return -1;
+}
+
+void ntp_poll_init(struct ntp_poll *poll)
+{
+	poll->exponent = NTP_POLL_FAST_EXP;
+	poll->count = 0;
+}
+
+void ntp_poll_update(struct ntp_poll *poll, enum ntp_poll_result result, bool is_settled, int64_t offset_us)
+{
+	int64_t magnitude_us = (offset_us < 0) ? -offset_us : offset_us;
+
+	if (result == NTP_POLL_STEP || (result == NTP_POLL_OK && !is_settled))
+	{
+		poll->exponent = NTP_POLL_FAST_EXP;
+		poll->count = 0;
+		return;
+	}
+	if (result == NTP_POLL_MISSED)
+	{
+		if (poll->exponent > NTP_POLL_MIN_EXP)
+		{
+			poll->exponent = NTP_POLL_MIN_EXP;
+		}
+		poll->count = 0;
+		return;
+	}
+	if (poll->exponent < NTP_POLL_MIN_EXP)
+	{
+		/* Settled, leave fast polling */
+		poll->exponent = NTP_POLL_MIN_EXP;
+		poll->count = 0;
+		return;
+	}
+	if (magnitude_us > NTP_POLL_BUDGET_US)
+	{
+		/* The rate is off by more than the interval allows for */
+		if (poll->exponent > NTP_POLL_MIN_EXP)
+		{
+			poll->exponent--;
+		}
+		poll->count = 0;
+	}
+	else if (magnitude_us < NTP_POLL_BUDGET_US / 2 && ++poll->count >= NTP_POLL_HOLD)
+	{
+		if (poll->exponent < NTP_POLL_MAX_EXP)
+		{
+			poll->exponent++;
+		}
+		poll->count = 0;
+	}
+}
+
+uint32_t ntp_poll_interval_s(const struct ntp_poll *poll)
+{
+	return 1U << poll->exponent;
+}
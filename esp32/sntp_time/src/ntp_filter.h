@@ -0,0 +1,142 @@
+/*
+ * NTP clock filter and source selection, after RFC 5905
+ *
+ * Free of any OS dependency. Offsets are of the server clock relative to
+ * the local timescale the request and reply were stamped on, all values
+ * are in microseconds.
+ */
+#ifndef NTP_FILTER_H
+#define NTP_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Samples kept per server, the one of least delay is used */
+#define NTP_FILTER_STAGES (8)
+
+/* Growth of the dispersion of a sample with its age, 15 ppm as in RFC 5905 */
+#define NTP_FILTER_PHI_PPM (15)
+
+/* Resolution of the local timescale */
+#define NTP_FILTER_PRECISION_US (100)
+
+/* Servers further than this from UTC, by their own account, are not selected */
+#define NTP_FILTER_MAX_DISTANCE_US (1500000)
+
+/* Poll interval, as a power of two seconds */
+#define NTP_POLL_FAST_EXP (3) /* 8 s, until the filters are full and the clock rate is known */
+#define NTP_POLL_MIN_EXP (6)  /* 64 s */
+#define NTP_POLL_MAX_EXP (10) /* 1024 s */
+
+/* Clock error allowed to build up between polls */
+#define NTP_POLL_BUDGET_US (2000)
+
+/* Polls in a row well within the budget before the interval doubles */
+#define NTP_POLL_HOLD (4)
+
+enum ntp_poll_result
+{
+	NTP_POLL_OK,
+	NTP_POLL_MISSED, /* No server was selected */
+	NTP_POLL_STEP,	 /* The clock was stepped */
+};
+
+struct ntp_poll
+{
+	uint8_t exponent;
+	uint8_t count;
+};
+
+struct ntp_sample
+{
+	int64_t offset_us;
+	int64_t delay_us;
+	int64_t dispersion_us; /* When taken */
+	int64_t local_us;	   /* Local time it was taken at */
+};
+
+struct ntp_peer
+{
+	struct ntp_sample samples[NTP_FILTER_STAGES];
+	uint8_t count;
+	uint8_t next;
+	uint8_t reach; /* Shift register of the last 8 polls, 1 for a reply */
+	uint8_t stratum;
+	int64_t root_delay_us;
+	int64_t root_dispersion_us;
+
+	/* Of the filter, updated with each sample */
+	int64_t offset_us; /* Carried forward to the last poll */
+	int64_t delay_us;
+	int64_t dispersion_us;
+	int64_t jitter_us;
+	int64_t update_us;		  /* Local time of the sample used */
+	int64_t update_offset_us; /* Offset of the sample used, as measured */
+};
+
+/**
+ * @brief Forget all samples of a server
+ */
+void ntp_peer_reset(struct ntp_peer *peer);
+
+/**
+ * @brief Record a poll of a server
+ * The local timescale may run at a rate of its own, older samples are
+ * carried forward at that rate before they are compared.
+ *
+ * @param peer Server polled
+ * @param sample Result of the exchange, NULL if there was no valid reply
+ * @param now_us Local time
+ * @param rate_ppb Rate of the local timescale over UTC, positive when it is fast
+ */
+void ntp_peer_poll(struct ntp_peer *peer, const struct ntp_sample *sample, int64_t now_us, int32_t rate_ppb);
+
+/**
+ * @brief Error bound of a server, from its reply and its distance to UTC
+ *
+ * @param peer Server
+ * @param now_us Local time, the dispersion grows with the age of the sample
+ * @return int64_t Root distance in microseconds
+ */
+int64_t ntp_peer_distance(const struct ntp_peer *peer, int64_t now_us);
+
+/**
+ * @brief Pick the best server
+ * Servers whose intervals of offset +- root distance do not intersect
+ * with those of the majority are falsetickers. Of the rest, the one
+ * with the least root distance is selected.
+ *
+ * @param peers Servers
+ * @param count Number of servers
+ * @param now_us Local time
+ * @return int Index of the selected server, -1 if no majority agrees
+ */
+int ntp_select(const struct ntp_peer *const peers[], int count, int64_t now_us);
+
+/**
+ * @brief Start polling fast
+ */
+void ntp_poll_init(struct ntp_poll *poll);
+
+/**
+ * @brief Adjust the poll interval to the last poll
+ * Polls come fast until the clock has settled. From then on the interval
+ * doubles from 64 s up to 1024 s while the offsets stay well within the
+ * budget, and halves when they exceed it. A step starts over fast, a
+ * missed poll drops to 64 s.
+ *
+ * @param poll Interval to adjust
+ * @param result Outcome of the poll
+ * @param is_settled The filter of the selected server is full and the clock rate is known
+ * @param offset_us Offset the clock was corrected by
+ */
+void ntp_poll_update(struct ntp_poll *poll, enum ntp_poll_result result, bool is_settled, int64_t offset_us);
+
+/**
+ * @brief Current poll interval
+ *
+ * @return uint32_t Seconds
+ */
+uint32_t ntp_poll_interval_s(const struct ntp_poll *poll);
+
+#endif /* NTP_FILTER_H */
@@ -0,0 +1,90 @@
+#include "tz_rule.h"
+
+#if defined(CONFIG_TZ_DST_US) || defined(CONFIG_TZ_DST_EU)
+#define TZ_RULE_HAS_DST
+#endif
+
+#ifdef TZ_RULE_HAS_DST
+#define SECONDS_PER_DAY (86400)
+#define SECONDS_PER_HOUR (3600)
+
+/* Days are counted from 1970-01-01, a Thursday */
+#define EPOCH_WEEKDAY (4)
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * @brief Days from 1970 to a date of the proleptic Gregorian calendar
+ * Years are counted from March so the leap day ends the year.
+ */
+static int64_t days_from_civil(int64_t year, int month, int day)
+{
+	year -= (month <= 2);
+	int64_t era = floor_div(year, 400);
+	int64_t year_of_era = year - (era * 400);
+	int64_t day_of_year = ((153 * (month + ((month > 2) ? -3 : 9))) + 2) / 5 + day - 1;
+	int64_t day_of_era = (year_of_era * 365) + (year_of_era / 4) - (year_of_era / 100) + day_of_year;
+	return (era * 146097) + day_of_era - 719468;
+}
+
+/**
+ * @brief Calendar year of a day from 1970, the inverse of days_from_civil()
+ */
+static int64_t year_from_days(int64_t days)
+{
+	days += 719468;
+	int64_t era = floor_div(days, 146097);
+	int64_t day_of_era = days - (era * 146097);
+	int64_t year_of_era = (day_of_era - (day_of_era / 1460) + (day_of_era / 36524) - (day_of_era / 146096)) / 365;
+	int64_t day_of_year = day_of_era - ((365 * year_of_era) + (year_of_era / 4) - (year_of_era / 100));
+	/* Day 306 of a year from March is January 1st */
+	return year_of_era + (era * 400) + (day_of_year >= 306);
+}
+
+/* 0 for Sunday */
+static int64_t weekday(int64_t days)
+{
+	return days - (floor_div(days + EPOCH_WEEKDAY, 7) * 7) + EPOCH_WEEKDAY;
+}
+
+/**
+ * @brief Day from 1970 of the nth Sunday of a month, the last one for n = 0
+ */
+static int64_t sunday_of_month(int64_t year, int month, int n)
+{
+	if (n == 0)
+	{
+		int64_t last = days_from_civil(year + (month / 12), (month % 12) + 1, 1) - 1;
+		return last - weekday(last);
+	}
+	int64_t first = days_from_civil(year, month, 1);
+	return first + ((7 - weekday(first)) % 7) + (7 * (n - 1));
+}
+
+#endif /* TZ_RULE_HAS_DST */
+
+int16_t tz_rule_offset_min(int64_t utc_s, bool *is_dst)
+{
+	*is_dst = false;
+#ifdef TZ_RULE_HAS_DST
+	int64_t std_offset_s = (int64_t)CONFIG_TZ_STD_OFFSET_MIN * 60;
+
+	/* Changes are months away from the new year, the year of standard time is the one of the rule */
+	int64_t year = year_from_days(floor_div(utc_s + std_offset_s, SECONDS_PER_DAY));
+#if defined(CONFIG_TZ_DST_US)
+	/* From 2:00 standard time on the second Sunday of March to 2:00 daylight time on the first Sunday of November */
+	int64_t start_s = (sunday_of_month(year, 3, 2) * SECONDS_PER_DAY) + (2 * SECONDS_PER_HOUR) - std_offset_s;
+	int64_t end_s = (sunday_of_month(year, 11, 1) * SECONDS_PER_DAY) + (2 * SECONDS_PER_HOUR) - std_offset_s -
+					(TZ_RULE_DST_SHIFT_MIN * 60);
+#else
+	/* From 1:00 UTC on the last Sunday of March to 1:00 UTC on the last Sunday of October */
+	int64_t start_s = (sunday_of_month(year, 3, 0) * SECONDS_PER_DAY) + SECONDS_PER_HOUR;
+	int64_t end_s = (sunday_of_month(year, 10, 0) * SECONDS_PER_DAY) + SECONDS_PER_HOUR;
+#endif
+	*is_dst = (utc_s >= start_s) && (utc_s < end_s);
+#endif
+	return (int16_t)(CONFIG_TZ_STD_OFFSET_MIN + (*is_dst ? TZ_RULE_DST_SHIFT_MIN : 0));
+}
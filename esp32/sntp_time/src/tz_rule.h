@@ -0,0 +1,26 @@
+/*
+ * Local time of the displays
+ *
+ * The standard offset and the daylight saving time rule are set in the
+ * Kconfig of the app. The offset sent to the STM32 with each time frame
+ * follows the rule, so the displays change over on their own.
+ */
+#ifndef TZ_RULE_H
+#define TZ_RULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Daylight saving time is standard time plus this */
+#define TZ_RULE_DST_SHIFT_MIN (60)
+
+/**
+ * @brief Offset of local time from UTC at a point in time
+ *
+ * @param utc_s Seconds since 1970 UTC
+ * @param is_dst Set to true while daylight saving time is in effect
+ * @return int16_t Local time minus UTC, in minutes
+ */
+int16_t tz_rule_offset_min(int64_t utc_s, bool *is_dst);
+
+#endif /* TZ_RULE_H */
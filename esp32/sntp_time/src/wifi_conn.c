@@ -0,0 +1,164 @@
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_event.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/wifi_mgmt.h>
+
+#include "wifi_conn.h"
+
+#define WIFI_EVENTS (NET_EVENT_WIFI_CONNECT_RESULT | NET_EVENT_WIFI_DISCONNECT_RESULT)
+#define IPV4_EVENTS (NET_EVENT_IPV4_ADDR_ADD | NET_EVENT_IPV4_ADDR_DEL)
+
+/* Exposed through wifi_conn_wait_ready() */
+#define EVENT_READY BIT(0)
+/* State, set and cleared only by the event handlers */
+#define EVENT_LINK_UP BIT(1)
+#define EVENT_ADDRESS BIT(2)
+/* Result of the current attempt, cleared before each one */
+#define EVENT_LINK_FAILED BIT(3)
+
+K_EVENT_DEFINE(wifi_conn_events);
+
+static struct net_mgmt_event_callback wifi_cb;
+static struct net_mgmt_event_callback ipv4_cb;
+static struct net_if *iface;
+
+/* Only touched by the connect work */
+static struct k_work_q *work_q;
+static struct k_work_delayable connect_work;
+static bool is_attempting; /* A connect request is out, its result or timeout is due */
+static uint32_t backoff_ms = WIFI_CONN_BACKOFF_MIN_MS;
+static int attempt_result; /* Of the connect request */
+
+static const struct wifi_connect_req_params params = {
+	.ssid = (const uint8_t *)CONFIG_WIFI_SSID,
+	.ssid_length = sizeof(CONFIG_WIFI_SSID) - 1,
+	.psk = (const uint8_t *)CONFIG_WIFI_PASSWORD,
+	.psk_length = sizeof(CONFIG_WIFI_PASSWORD) - 1,
+	.channel = WIFI_CHANNEL_ANY,
+	.security = (sizeof(CONFIG_WIFI_PASSWORD) > 1) ? WIFI_SECURITY_TYPE_PSK : WIFI_SECURITY_TYPE_NONE,
+};
+
+/**
+ * @brief Ready once both the link and an address are up, called from the handlers
+ */
+static void update_ready(void)
+{
+	if (k_event_test(&wifi_conn_events, EVENT_LINK_UP | EVENT_ADDRESS) == (EVENT_LINK_UP | EVENT_ADDRESS))
+	{
+		k_event_post(&wifi_conn_events, EVENT_READY);
+	}
+	else
+	{
+		k_event_clear(&wifi_conn_events, EVENT_READY);
+	}
+}
+
+/**
+ * @brief Starts an attempt, or ends it once it is up, refused or timed out
+ * Scheduled by the event handlers and by itself, it never blocks.
+ */
+static void connect_work_handler(struct k_work *work)
+{
+	if (k_event_test(&wifi_conn_events, EVENT_LINK_UP))
+	{
+		if (is_attempting)
+		{
+			printk("Wi-Fi connected to %s\n", CONFIG_WIFI_SSID);
+		}
+		is_attempting = false;
+		backoff_ms = WIFI_CONN_BACKOFF_MIN_MS;
+		return;
+	}
+
+	if (is_attempting)
+	{
+		/* A timed out attempt may still be running, it would refuse the next one */
+		net_mgmt(NET_REQUEST_WIFI_DISCONNECT, iface, NULL, 0);
+		int rv = (attempt_result != 0) ? attempt_result :
+			k_event_test(&wifi_conn_events, EVENT_LINK_FAILED) ? -ECONNREFUSED : -ETIMEDOUT;
+		printk("Wi-Fi connection to %s failed (%d), retry in %u ms\n", CONFIG_WIFI_SSID, rv, backoff_ms);
+		is_attempting = false;
+		k_work_reschedule_for_queue(work_q, &connect_work, K_MSEC(backoff_ms));
+		backoff_ms = MIN(backoff_ms * 2, WIFI_CONN_BACKOFF_MAX_MS);
+		return;
+	}
+
+	/* The result event ends the attempt early, a refused request at once */
+	is_attempting = true;
+	k_event_clear(&wifi_conn_events, EVENT_LINK_FAILED);
+	attempt_result = net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, (void *)&params, sizeof(params));
+	if (attempt_result == 0)
+	{
+		k_work_reschedule_for_queue(work_q, &connect_work, K_MSEC(WIFI_CONN_TIMEOUT_MS));
+	}
+	else
+	{
+		k_work_reschedule_for_queue(work_q, &connect_work, K_NO_WAIT);
+	}
+}
+
+static void wifi_event_handler(struct net_mgmt_event_callback *cb, uint32_t mgmt_event, struct net_if *event_iface)
+{
+	if (mgmt_event == NET_EVENT_WIFI_CONNECT_RESULT)
+	{
+		const struct wifi_status *status = (const struct wifi_status *)cb->info;
+		if (status->status == 0)
+		{
+			k_event_post(&wifi_conn_events, EVENT_LINK_UP);
+		}
+		else
+		{
+			k_event_post(&wifi_conn_events, EVENT_LINK_FAILED);
+		}
+		/* Ends the attempt without waiting out its timeout */
+		k_work_reschedule_for_queue(work_q, &connect_work, K_NO_WAIT);
+	}
+	else if (mgmt_event == NET_EVENT_WIFI_DISCONNECT_RESULT)
+	{
+		/* Only a link that was up reconnects at once, the end of a failed attempt waits out its backoff */
+		if (k_event_clear(&wifi_conn_events, EVENT_LINK_UP) & EVENT_LINK_UP)
+		{
+			printk("Wi-Fi disconnected, reconnecting\n");
+			k_work_reschedule_for_queue(work_q, &connect_work, K_NO_WAIT);
+		}
+	}
+	update_ready();
+}
+
+static void ipv4_event_handler(struct net_mgmt_event_callback *cb, uint32_t mgmt_event, struct net_if *event_iface)
+{
+	/* A static address is bound from boot, one from DHCP with each connection */
+	if (net_if_ipv4_get_global_addr(iface, NET_ADDR_PREFERRED) != NULL)
+	{
+		k_event_post(&wifi_conn_events, EVENT_ADDRESS);
+	}
+	else
+	{
+		k_event_clear(&wifi_conn_events, EVENT_ADDRESS);
+	}
+	update_ready();
+}
+
+void wifi_conn_start(struct k_work_q *queue)
+{
+	iface = net_if_get_default();
+	work_q = queue;
+	k_work_init_delayable(&connect_work, connect_work_handler);
+
+	net_mgmt_init_event_callback(&wifi_cb, wifi_event_handler, WIFI_EVENTS);
+	net_mgmt_add_event_callback(&wifi_cb);
+	net_mgmt_init_event_callback(&ipv4_cb, ipv4_event_handler, IPV4_EVENTS);
+	net_mgmt_add_event_callback(&ipv4_cb);
+	/* Bound before the callback was added, no event will tell */
+	ipv4_event_handler(&ipv4_cb, NET_EVENT_IPV4_ADDR_ADD, iface);
+
+	k_work_reschedule_for_queue(work_q, &connect_work, K_NO_WAIT);
+}
+
+bool wifi_conn_wait_ready(k_timeout_t timeout)
+{
+	return k_event_wait(&wifi_conn_events, EVENT_READY, false, timeout) != 0;
+}
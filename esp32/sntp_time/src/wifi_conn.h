@@ -0,0 +1,41 @@
+/*
+ * Wi-Fi connection manager
+ *
+ * Joins the network of CONFIG_WIFI_SSID and keeps rejoining it, the
+ * connection and the IPv4 address of the interface are followed from the
+ * net_mgmt events. Failed attempts are retried with an exponential
+ * backoff. It runs as delayable work on a queue of the caller, scheduled
+ * by the events and the timeouts, without a thread of its own. Other
+ * threads wait on the readiness signal instead of sending into a link
+ * that is down.
+ */
+#ifndef WIFI_CONN_H
+#define WIFI_CONN_H
+
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+
+/* Wait for the result of a connection attempt */
+#define WIFI_CONN_TIMEOUT_MS (15000)
+
+/* Wait after a failed attempt, doubled at each failure up to the maximum */
+#define WIFI_CONN_BACKOFF_MIN_MS (1000)
+#define WIFI_CONN_BACKOFF_MAX_MS (64000)
+
+/**
+ * @brief Connect, and reconnect for ever from the work queue
+ *
+ * @param queue Runs the connection work, which never blocks on the network
+ */
+void wifi_conn_start(struct k_work_q *queue);
+
+/**
+ * @brief Wait for the station to be connected with an IPv4 address
+ *
+ * @param timeout K_FOREVER, K_NO_WAIT or a time
+ * @return true if ready, false on timeout
+ */
+bool wifi_conn_wait_ready(k_timeout_t timeout);
+
+#endif /* WIFI_CONN_H */
@@ -11,6 +11,8 @@
 #pragma once
 
 #include "main.h"
+#include "bmp280_types.h"
+#include "bmp280_bus.h"
 
 
 /**
@@ -21,6 +23,7 @@ typedef struct
     uint8_t tStandby;           /* Inactive duration (standby time) in normal mode */
     uint8_t filter;             /* Filter settings */
     uint8_t tempOversampling;   /* Temperature oversampling. */
+    uint8_t pressOversampling;  /* Pressure oversampling. BMP280_SAMPLING_NONE skips pressure */
     uint8_t mode;               /* Device mode */
 }bmp280_config_t;
 
@@ -34,50 +37,171 @@ typedef struct
 	int16_t dig_T3;             /* 0x8C(LSB)/0x8D(MSB) */
 }bmp280_temp_calib_t;
 
+/**
+ * @brief Struct to store the pressure calibration values
+ */
+typedef struct
+{
+	uint16_t dig_P1;            /* 0x8E(LSB)/0x8F(MSB) */
+	int16_t dig_P2;             /* 0x90(LSB)/0x91(MSB) */
+	int16_t dig_P3;             /* 0x92(LSB)/0x93(MSB) */
+	int16_t dig_P4;             /* 0x94(LSB)/0x95(MSB) */
+	int16_t dig_P5;             /* 0x96(LSB)/0x97(MSB) */
+	int16_t dig_P6;             /* 0x98(LSB)/0x99(MSB) */
+	int16_t dig_P7;             /* 0x9A(LSB)/0x9B(MSB) */
+	int16_t dig_P8;             /* 0x9C(LSB)/0x9D(MSB) */
+	int16_t dig_P9;             /* 0x9E(LSB)/0x9F(MSB) */
+}bmp280_press_calib_t;
+
 /**
  * @brief BMP280 Object
  */
 typedef struct
 {
-    uint8_t i2cAddress;                 /* I2C address of the sensor */
+    bmp280_bus_t *bus;                  /* Transport to the sensor */
     bmp280_config_t config;             /* Config settings */
     bmp280_temp_calib_t temp_calib;     /* Calibration settings */
+    bmp280_press_calib_t press_calib;   /* Pressure calibration settings */
     double temperatureC;                /* Temperature in Celsius */
+    uint32_t measTimeUs;                /* Forced mode conversion time for the current config */
+    uint32_t triggerTick;               /* HAL tick at which the last forced conversion was started */
+    uint8_t isConversionPending;        /* TRUE while a forced conversion may still be running */
 }bmp280_t;
 
 /**
  * @brief BMP280 Initialization
- * 
+ * The transport must already be initialized and must outlive dev. The chip ID
+ * and calibration come from the backup SRAM cache on a warm boot.
+ * @param dev Pointer to bmp280_t to initialize
+ * @param bus I2C or SPI transport to the sensor
  * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
  */
-App_StatusTypeDef BMP280_Init();
+App_StatusTypeDef BMP280_Init(bmp280_t * dev, bmp280_bus_t * bus);
 
 /**
  * @brief Read bmp280_config_t and write it to the passed in pointer
  * 
+ * @param dev Pointer to an initialized bmp280_t
  * @param config Pointer to bmp280_config_t to be populated
  * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
  */
-App_StatusTypeDef BMP280_GetConfig(bmp280_config_t * config);
+App_StatusTypeDef BMP280_GetConfig(bmp280_t * dev, bmp280_config_t * config);
 
 /**
  * @brief Set BMP280 config values with the one passed in
  * 
+ * @param dev Pointer to an initialized bmp280_t
  * @param config Pointer to bmp280_config_t to set
  * @return App_StatusTypeDef 
  */
-App_StatusTypeDef BMP280_SetConfig(bmp280_config_t * config);
+App_StatusTypeDef BMP280_SetConfig(bmp280_t * dev, bmp280_config_t * config);
+
+/**
+ * @brief Maximum time a forced mode conversion takes with the given config
+ * 
+ * @param config Pointer to bmp280_config_t to compute the conversion time for
+ * @return uint32_t Conversion time in microseconds
+ */
+uint32_t BMP280_GetMeasurementTimeUs(bmp280_config_t * config);
+
+/**
+ * @brief Start a single forced mode conversion
+ * The result is ready BMP280_GetMeasurementTimeUs() later. A read issued
+ * before that waits for the conversion to complete.
+ * @param dev Pointer to an initialized bmp280_t
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_TriggerForcedMeasurement(bmp280_t * dev);
+
+/**
+ * @brief Non-blocking BMP280_TriggerForcedMeasurement()
+ * Completion is reported through the transport callback.
+ * @param dev Pointer to an initialized bmp280_t
+ * @return App_StatusTypeDef APP_OK if the transfer was started. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_TriggerForcedMeasurement_IT(bmp280_t * dev);
+
+/**
+ * @brief Read the raw temperature ADC value
+ * 
+ * @param dev Pointer to an initialized bmp280_t
+ * @param tempAdc Pointer to be populated with the 20-bit ADC value
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_ReadRawTemperature(bmp280_t * dev, int32_t * tempAdc);
+
+/**
+ * @brief Read the raw pressure and temperature ADC values in one burst
+ * 
+ * @param dev Pointer to an initialized bmp280_t
+ * @param tempAdc Pointer to be populated with the 20-bit temperature ADC value
+ * @param pressAdc Pointer to be populated with the 20-bit pressure ADC value
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_ReadRaw(bmp280_t * dev, int32_t * tempAdc, int32_t * pressAdc);
+
+/**
+ * @brief Non-blocking BMP280_ReadRaw()
+ * Completion is reported through the transport callback, after which
+ * BMP280_GetRawFromBuffer() returns the values.
+ * @param dev Pointer to an initialized bmp280_t
+ * @return App_StatusTypeDef APP_OK if the transfer was started. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_ReadRaw_IT(bmp280_t * dev);
+
+/**
+ * @brief Decode the raw values fetched by BMP280_ReadRaw_IT()
+ * 
+ * @param dev Pointer to an initialized bmp280_t
+ * @param tempAdc Pointer to be populated with the 20-bit temperature ADC value
+ * @param pressAdc Pointer to be populated with the 20-bit pressure ADC value
+ */
+void BMP280_GetRawFromBuffer(bmp280_t * dev, int32_t * tempAdc, int32_t * pressAdc);
+
+/**
+ * @brief Convert a raw temperature ADC value using the stored calibration
+ * 
+ * @param dev Pointer to an initialized bmp280_t
+ * @param tempAdc 20-bit ADC value
+ * @return int32_t Temperature in hundredths of a degree Celsius
+ */
+int32_t BMP280_CompensateTemperature(bmp280_t * dev, int32_t tempAdc);
+
+/**
+ * @brief Convert arrays of raw ADC values using the stored calibration
+ * Pressure compensation needs the temperature taken with the same
+ * conversion, so pressAdc[i] is paired with tempAdc[i].
+ * @param dev Pointer to the initialized bmp280_t the samples came from
+ * @param tempAdc count raw temperature ADC values
+ * @param pressAdc count raw pressure ADC values. NULL to skip pressure
+ * @param temperature Populated with count temperatures in hundredths of a degree Celsius
+ * @param pressure Populated with count pressures in Pa. Ignored when pressAdc is NULL
+ * @param count Number of samples
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_CompensateBatch(bmp280_t * dev, const int32_t * tempAdc, const int32_t * pressAdc,
+                                         int32_t * temperature, uint32_t * pressure, uint32_t count);
 
 /**
  * @brief Read temperature and return as a Double
  * 
+ * @param dev Pointer to an initialized bmp280_t
  * @return double Temperature in Celsius
  */
-double BMP280_ReadTemperatureC();
+double BMP280_ReadTemperatureC(bmp280_t * dev);
 
 /**
  * @brief Read temperature and return the value as a String
  * 
+ * @param dev Pointer to an initialized bmp280_t
+ * @return char* String pointer to the temperature value
+ */
+char * BMP280_GetTemperatureString(bmp280_t * dev);
+
+/**
+ * @brief Format a temperature the same way as BMP280_GetTemperatureString()
+ * 
+ * @param temperatureC Temperature in Celsius
  * @return char* String pointer to the temperature value
  */
-char * BMP280_GetTemperatureString();
+char * BMP280_TemperatureToString(double temperatureC);
@@ -0,0 +1,113 @@
+/**
+ * @file bmp280_bus.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the BMP280 bus transports
+ * @date 2022-12-04
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include "main.h"
+#include "bmp280_types.h"
+
+#define BMP280_BUS_MAX_ASYNC_LEN    (BMP280_RAW_DATA_LEN)   /* Longest non-blocking transfer */
+#define BMP280_BUS_MAX_ACTIVE       (4)                     /* Handles with a transfer in flight at once */
+#define BMP280_SPI_READ             (0x80)                  /* Register address bit 7 selects a read */
+#define BMP280_SPI_WRITE_MASK       (0x7F)                  /* and is cleared for a write */
+
+typedef struct bmp280_bus bmp280_bus_t;
+
+/**
+ * @brief Completion callback of the non-blocking operations
+ * Called from interrupt context.
+ */
+typedef void (*bmp280BusCallback_t)(void *context, App_StatusTypeDef status);
+
+/**
+ * @brief Register level operations of a transport
+ */
+typedef struct
+{
+    App_StatusTypeDef (*read)(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len);
+    App_StatusTypeDef (*write)(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+    App_StatusTypeDef (*readAsync)(bmp280_bus_t *bus, uint8_t regAddr, uint16_t len);
+    App_StatusTypeDef (*writeAsync)(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+}bmp280_bus_ops_t;
+
+/**
+ * @brief Transport of one sensor
+ */
+struct bmp280_bus
+{
+    const bmp280_bus_ops_t *ops;                    /* Backend operations */
+    void *handle;                                   /* I2C, FMPI2C or SPI handle */
+    uint8_t i2cAddress;                             /* I2C address. I2C only */
+    GPIO_TypeDef *csPort;                           /* Chip select port. SPI only */
+    uint16_t csPin;                                 /* Chip select pin. SPI only */
+    uint8_t dataOffset;                             /* Position of the first data byte in rxBuf */
+    uint32_t busId;                                 /* Peripheral base address, stable across resets */
+    uint32_t devId;                                 /* Address or chip select of the sensor on its bus */
+    uint8_t txBuf[BMP280_BUS_MAX_ASYNC_LEN + 1];    /* Transfer buffers of the non-blocking operations */
+    uint8_t rxBuf[BMP280_BUS_MAX_ASYNC_LEN + 1];
+    bmp280BusCallback_t callback;                   /* Completion callback */
+    void *context;                                  /* Passed back to the callback */
+};
+
+extern const bmp280_bus_ops_t BMP280_Bus_I2COps;
+extern const bmp280_bus_ops_t BMP280_Bus_SPIOps;
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+extern const bmp280_bus_ops_t BMP280_Bus_FMPI2COps;
+#endif
+
+/**
+ * @brief Set up an I2C transport
+ *
+ * @param bus Pointer to bmp280_bus_t to initialize
+ * @param hi2c Initialized I2C bus the sensor is on
+ * @param i2cAddress BMP280_I2C_ADDRESS_0 or BMP280_I2C_ADDRESS_1
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_Bus_InitI2C(bmp280_bus_t * bus, I2C_HandleTypeDef * hi2c, uint8_t i2cAddress);
+
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+/**
+ * @brief Set up an FMPI2C transport, for Fast-mode Plus up to 1 MHz
+ *
+ * @param bus Pointer to bmp280_bus_t to initialize
+ * @param hfmpi2c Initialized FMPI2C bus the sensor is on
+ * @param i2cAddress BMP280_I2C_ADDRESS_0 or BMP280_I2C_ADDRESS_1
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_Bus_InitFMPI2C(bmp280_bus_t * bus, FMPI2C_HandleTypeDef * hfmpi2c, uint8_t i2cAddress);
+#endif
+
+/**
+ * @brief Set up a 4-wire SPI transport
+ * The SPI must be a master in mode 0 or 3 at up to 10 MHz, with DMA linked
+ * for the non-blocking operations. The chip select pin must be an output.
+ * @param bus Pointer to bmp280_bus_t to initialize
+ * @param hspi Initialized SPI bus the sensor is on
+ * @param csPort Chip select port
+ * @param csPin Chip select pin
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_Bus_InitSPI(bmp280_bus_t * bus, SPI_HandleTypeDef * hspi, GPIO_TypeDef * csPort, uint16_t csPin);
+
+/**
+ * @brief Set the callback of the non-blocking operations
+ *
+ * @param bus Pointer to an initialized bmp280_bus_t
+ * @param callback Completion callback. NULL to ignore completions
+ * @param context Passed back to the callback
+ */
+void BMP280_Bus_SetCallback(bmp280_bus_t * bus, bmp280BusCallback_t callback, void * context);
+
+/**
+ * @brief Data of the last completed non-blocking read
+ *
+ * @param bus Pointer to an initialized bmp280_bus_t
+ * @return uint8_t* Pointer to the bytes read
+ */
+uint8_t * BMP280_Bus_GetData(bmp280_bus_t * bus);
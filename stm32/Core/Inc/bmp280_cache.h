@@ -0,0 +1,39 @@
+/**
+ * @file bmp280_cache.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the BMP280 calibration cache in backup SRAM
+ * @date 2022-12-17
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+#pragma once
+
+#include "main.h"
+#include "bmp280_types.h"
+
+#define BMP280_CACHE_MAGIC          (0x42503238)    /* "BP28" */
+#define BMP280_CACHE_VERSION        (1)             /* Bump when the entry layout changes */
+#define BMP280_CACHE_ENTRIES        (4)             /* One per registered sensor */
+
+/**
+ * @brief Look up the cached calibration of a sensor
+ * The backup SRAM keeps its contents across resets but not across power
+ * cycles, so a hit means a warm boot with the same sensor wired in.
+ * @param busId Identifies the bus the sensor is on
+ * @param devId Identifies the sensor on its bus
+ * @param calib Populated with BMP280_CALIB_DATA_LEN raw calibration bytes
+ * @return App_StatusTypeDef APP_OK on a valid entry. APP_ERROR otherwise
+ */
+App_StatusTypeDef BMP280_Cache_Load(uint32_t busId, uint32_t devId, uint8_t * calib);
+
+/**
+ * @brief Store the calibration of a sensor, replacing any previous entry for it
+ * 
+ * @param busId Identifies the bus the sensor is on
+ * @param devId Identifies the sensor on its bus
+ * @param chipId Chip ID read from the sensor
+ * @param calib BMP280_CALIB_DATA_LEN raw calibration bytes
+ * @return App_StatusTypeDef APP_OK if stored. APP_ERROR if the cache is full
+ */
+App_StatusTypeDef BMP280_Cache_Store(uint32_t busId, uint32_t devId, uint8_t chipId, const uint8_t * calib);
@@ -21,14 +21,19 @@ enum
     BMP280_REG_DIG_T1 = 0x88,
     BMP280_REG_DIG_T2 = 0x8A,
     BMP280_REG_DIG_T3 = 0x8C,
+    BMP280_REG_DIG_P1 = 0x8E,
     BMP280_REG_CHIPID = 0xD0,
     BMP280_REG_SOFTRESET = 0xE0,
     BMP280_REG_STATUS = 0xF3,
     BMP280_REG_CONTROL = 0xF4,
     BMP280_REG_CONFIG = 0xF5,
+    BMP280_REG_PRESSDATA = 0xF7,
     BMP280_REG_TEMPDATA = 0xFA,
 };
 
+#define BMP280_CALIB_DATA_LEN           (24)        /* dig_T1 (0x88) to dig_P9 (0x9F) */
+#define BMP280_RAW_DATA_LEN             (6)         /* press_msb (0xF7) to temp_xlsb (0xFC) */
+
 #define BMP280_CHIPID                   (0x58)      /* Default Chip ID */
 
 /**
@@ -36,6 +41,8 @@ enum
  */
 #define BMP280_SAMPLING_MASK            0xE0
 #define BMP280_SAMPLING_SHIFT           (5)
+#define BMP280_PRESS_SAMPLING_MASK      0x1C
+#define BMP280_PRESS_SAMPLING_SHIFT     (2)
 /**
  * @brief Sampling Rate
  */
@@ -46,6 +53,13 @@ enum
 #define BMP280_SAMPLING_X8              0x04        /* 8x over-sampling. */
 #define BMP280_SAMPLING_X16             0x05        /* 16x over-sampling. */
 
+/**
+ * @brief Measurement time in forced mode (datasheet 3.8.1, maximum values in us)
+ */
+#define BMP280_MEAS_TIME_BASE_US        (1250)  /* Fixed conversion overhead. */
+#define BMP280_MEAS_TIME_PER_OS_US      (2300)  /* Per oversampling step. */
+#define BMP280_MEAS_TIME_PRESS_US       (575)   /* Pressure conversion overhead. */
+
 /**
  * @brief Operating Mode register mask and shift
  */
@@ -0,0 +1,30 @@
+/**
+ * @file content.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the display content pushed by the ESP32
+ * @date 2023-01-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include "main.h"
+#include "timesync.h"
+#include "lcd.h"
+
+/**
+ * @brief Write a content patch into the LCD frame buffer
+ * The cells are held against the local text until the TTL of the patch runs
+ * out, or until another patch covers them when it has none. Matches
+ * timeLinkContentCallback_t. Shown by the next LCD_Flush().
+ * @param content Decoded content frame, cells off the panel are dropped
+ */
+void Content_Apply(const struct timesync_content * content);
+
+/**
+ * @brief Release the cells whose TTL ran out, the local text shows again
+ * where it is written next. Meant to be called from the main loop.
+ * @return uint8_t TRUE if cells were released
+ */
+uint8_t Content_Expire(void);
@@ -0,0 +1,58 @@
+/**
+ * @file decimator.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the fixed-point FIR decimation filter
+ * @date 2022-11-20
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+#pragma once
+
+#include "main.h"
+
+#define DECIMATOR_MAX_TAPS          (32)    /* Upper bound on the FIR length */
+#define DECIMATOR_COEFF_SHIFT       (15)    /* Coefficients are Q15 */
+
+/**
+ * @brief Default low-pass taps for a decimation factor of 16
+ * 32-tap Hamming windowed sinc with the cutoff at the output Nyquist
+ * frequency. The taps sum to 1.0 (32768) so the DC gain is exactly 1.
+ */
+#define DECIMATOR_DEFAULT_FACTOR    (16)
+#define DECIMATOR_DEFAULT_TAPS      (32)
+extern const int16_t Decimator_DefaultCoeffs[DECIMATOR_DEFAULT_TAPS];
+
+/**
+ * @brief Decimator Object
+ */
+typedef struct
+{
+    const int16_t *coeffs;                      /* Q15 FIR taps, numTaps long */
+    uint16_t numTaps;                           /* Number of taps. Must be even */
+    uint16_t factor;                            /* Decimation factor */
+    uint16_t head;                              /* Index of the oldest sample in the history */
+    uint16_t phase;                             /* Input samples since the last output */
+    int16_t history[2 * DECIMATOR_MAX_TAPS];    /* Input history, stored twice so every window is contiguous */
+}decimator_t;
+
+/**
+ * @brief Decimator Initialization
+ * 
+ * @param decimator Pointer to decimator_t to initialize
+ * @param coeffs Q15 FIR taps. Must stay valid for the lifetime of the decimator
+ * @param numTaps Number of taps. Must be even and at most DECIMATOR_MAX_TAPS
+ * @param factor Decimation factor. One output is produced for every factor inputs
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef Decimator_Init(decimator_t * decimator, const int16_t * coeffs, uint16_t numTaps, uint16_t factor);
+
+/**
+ * @brief Push an input sample into the decimator
+ * The FIR is only evaluated on the samples that produce an output.
+ * @param decimator Pointer to an initialized decimator_t
+ * @param sample New input sample
+ * @param output Populated with the filtered value when one is produced
+ * @return uint8_t TRUE when output has been written. FALSE otherwise
+ */
+uint8_t Decimator_Push(decimator_t * decimator, int16_t sample, int16_t * output);
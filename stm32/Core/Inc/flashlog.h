@@ -0,0 +1,85 @@
+/**
+ * @file flashlog.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the flash data logger
+ * @date 2022-12-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include "main.h"
+#include "tscodec.h"
+
+/* Must match the FLASHLOG region of STM32F446RETx_FLASH.ld */
+#define FLASHLOG_BASE               (0x08020000U)       /* Sector 5 */
+#define FLASHLOG_FIRST_SECTOR       (FLASH_SECTOR_5)
+#define FLASHLOG_SECTORS            (3)                 /* Sectors 5 to 7 */
+#define FLASHLOG_SECTOR_SIZE        (0x20000U)          /* 128 KB */
+
+#define FLASHLOG_PAGE_SIZE          (512U)              /* Records are staged in backup SRAM and programmed a page at a time */
+#define FLASHLOG_PAGES_PER_SECTOR   (FLASHLOG_SECTOR_SIZE / FLASHLOG_PAGE_SIZE)    /* Page 0 holds the sector header */
+#define FLASHLOG_PRESSURE_STEP_PA   (10)                /* Pressure is logged to 0.1 hPa, finer steps are sensor noise */
+
+/**
+ * @brief One logged sample, timestamp in seconds since 1970 on the RTC clock
+ * Stored compressed, each page is a tscodec block.
+ */
+typedef tsSample_t flashLogRecord_t;
+
+/**
+ * @brief Counters since FlashLog_Init()
+ * bytesLogged / bytesProgrammed is the compression ratio, headers included.
+ */
+typedef struct
+{
+    uint32_t recordsLogged;
+    uint32_t bytesLogged;       /* Record bytes accepted, before compression */
+    uint32_t bytesProgrammed;   /* Bytes written to flash, headers included */
+    uint32_t pagesLost;         /* Pages that failed to verify and were skipped */
+    uint32_t erases;
+}flashLogStats_t;
+
+/**
+ * @brief Recover the log from flash. Committed pages are kept, pages torn
+ * by a reset while programming are skipped. Erases a sector if the log is empty.
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef FlashLog_Init(void);
+
+/**
+ * @brief Add a record to the staged page. A full page is programmed to flash
+ * first, erasing the oldest sector when the current one is full.
+ * @param timestamp Seconds since 1970, must be later than the last record
+ * @param temperature Hundredths of a degree Celsius
+ * @param pressure Pa, 0 if not measured. Rounded to FLASHLOG_PRESSURE_STEP_PA
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef FlashLog_Append(uint32_t timestamp, int16_t temperature, uint32_t pressure);
+
+/**
+ * @brief Program the staged page to flash even if it is not full
+ *
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef FlashLog_Flush(void);
+
+/**
+ * @brief Records within a time range, oldest first, including those of the staged page
+ * Pages are located by a binary search on their first timestamp and
+ * decode independently of each other.
+ * @param fromTime Earliest timestamp, inclusive
+ * @param toTime Latest timestamp, inclusive
+ * @param records Populated with the records found
+ * @param maxRecords Capacity of records
+ * @return uint16_t Number of records populated
+ */
+uint16_t FlashLog_Query(uint32_t fromTime, uint32_t toTime, flashLogRecord_t * records, uint16_t maxRecords);
+
+/**
+ * @brief Counters since FlashLog_Init()
+ *
+ * @param stats Populated with the counters
+ */
+void FlashLog_GetStats(flashLogStats_t * stats);
@@ -0,0 +1,37 @@
+/**
+ * @file fmpi2c.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the FMPI2C interface
+ * @date 2022-12-10
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+#pragma once
+
+#include "main.h"
+
+#define FMPI2C_CLOCK_SOURCE         RCC_FMPI2C1CLKSOURCE_SYSCLK /* Kernel clock, the timing is computed from it */
+#define FMPI2C_RISE_TIME_NS         (100)   /* SCL/SDA rise time with short traces and 1k pull-ups */
+#define FMPI2C_FALL_TIME_NS         (10)    /* SCL/SDA fall time */
+#define FMPI2C_FILTER_DELAY_NS      (50)    /* Minimum delay of the analog noise filter */
+
+/**
+ * @brief Initialize FMPI2C1 as a master at the given bus speed
+ * Fast-mode Plus drive is enabled on the pins above 400 kHz.
+ * @param hfmpi2c Handle to initialize
+ * @param busHz SCL frequency, up to 1 MHz
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef FMPI2C_Init(FMPI2C_HandleTypeDef * hfmpi2c, uint32_t busHz);
+
+/**
+ * @brief Compute the TIMINGR value for a bus speed
+ * Picks the smallest prescaler that meets the SCL low/high minimums,
+ * data setup and hold times of the speed mode, taking the edge times and
+ * the input synchronization into account.
+ * @param kernelClockHz FMPI2C kernel clock
+ * @param busHz SCL frequency, up to 1 MHz
+ * @return uint32_t TIMINGR value. 0 if the speed can not be met
+ */
+uint32_t FMPI2C_ComputeTiming(uint32_t kernelClockHz, uint32_t busHz);
@@ -0,0 +1,101 @@
+/**
+ * @file history.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the temperature history
+ * @date 2022-12-24
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+#pragma once
+
+#include "main.h"
+
+#define HISTORY_MINUTES             (1440)  /* One sample per minute for 24 h */
+#define HISTORY_HOURS               (24)    /* Completed hour rollups kept */
+#define HISTORY_DAYS                (7)     /* Completed day rollups kept */
+#define HISTORY_WINDOW_MINUTES      (60)    /* Sliding window of History_GetWindowStats() */
+#define HISTORY_RAM_BUDGET          (4096)  /* Upper bound on the RAM used, checked at build time */
+
+/**
+ * @brief Statistics over a span of minute samples
+ */
+typedef struct
+{
+    int16_t min;        /* Hundredths of a degree Celsius */
+    int16_t max;        /* Hundredths of a degree Celsius */
+    int16_t mean;       /* Hundredths of a degree Celsius */
+    uint16_t count;     /* Minute samples in the span */
+}historyStats_t;
+
+/**
+ * @brief Called with every minute sample as it is committed
+ */
+typedef void (*historyMinuteCallback_t)(int16_t temperature, uint32_t epochMinute);
+
+/**
+ * @brief Feed a reading. Readings within the same minute are averaged
+ * into one sample, which is committed once a reading for another minute
+ * arrives. Hour and day rollups close on the clock boundaries.
+ * @param temperature Hundredths of a degree Celsius
+ * @param epochMinute Minutes since 1970 of the reading, in the local time of the RTC
+ */
+void History_AddReading(int16_t temperature, uint32_t epochMinute);
+
+/**
+ * @brief Bring the history up to a minute without a reading
+ * Commits the minute in progress, closes the hours and days up to
+ * epochMinute and drops the window samples that are older than the
+ * window by then. Earlier minutes than the last sample are ignored.
+ * @param epochMinute Minutes since 1970, in the local time of the RTC
+ */
+void History_AdvanceTo(uint32_t epochMinute);
+
+/**
+ * @brief Set the callback of committed minute samples
+ * 
+ * @param callback Called from History_AddReading(). NULL for none
+ */
+void History_SetMinuteCallback(historyMinuteCallback_t callback);
+
+/**
+ * @brief Number of minute samples held, up to HISTORY_MINUTES
+ * 
+ * @return uint16_t Sample count
+ */
+uint16_t History_GetMinuteCount(void);
+
+/**
+ * @brief Committed minute sample
+ * 
+ * @param minutesAgo 0 for the latest sample
+ * @param temperature Populated with the sample in hundredths of a degree Celsius
+ * @return App_StatusTypeDef APP_OK if the sample exists. APP_ERROR otherwise
+ */
+App_StatusTypeDef History_GetMinute(uint16_t minutesAgo, int16_t * temperature);
+
+/**
+ * @brief Min, max and mean of the samples of the last HISTORY_WINDOW_MINUTES minutes in O(1)
+ * 
+ * @param stats Populated with the window statistics
+ * @return App_StatusTypeDef APP_OK if there is at least one sample. APP_ERROR otherwise
+ */
+App_StatusTypeDef History_GetWindowStats(historyStats_t * stats);
+
+/**
+ * @brief Statistics of a clock hour
+ * 
+ * @param hoursAgo 0 for the hour in progress, 1 for the last completed one
+ * @param stats Populated with the hour statistics
+ * @return App_StatusTypeDef APP_OK if the hour has samples. APP_ERROR otherwise
+ */
+App_StatusTypeDef History_GetHourStats(uint8_t hoursAgo, historyStats_t * stats);
+
+/**
+ * @brief Statistics of a day, built from the hour rollups
+ * 
+ * @param daysAgo 0 for today, 1 for the last completed day
+ * @param stats Populated with the day statistics
+ * @return App_StatusTypeDef APP_OK if the day has samples. APP_ERROR otherwise
+ */
+App_StatusTypeDef History_GetDayStats(uint8_t daysAgo, historyStats_t * stats);
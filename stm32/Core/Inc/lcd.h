@@ -36,9 +36,17 @@
 #define LCD_CMD_INCADD              0x06 
 #define LCD_CMD_DISP_CLR            0x01 
 #define LCD_CMD_DISP_RET_HOME       0x02 
+#define LCD_CMD_SET_CGRAM_ADDR      0x40
+#define LCD_CMD_SET_DDRAM_ADDR      0x80
+
+/* Panel size */
+#define LCD_ROWS                    4
+#define LCD_COLUMNS                 20
 
 /* LCD Special Characters */
 #define LCD_DEGREES_CHAR_CODE       ((char)223)
+#define LCD_CUSTOM_CHARS            8       /* Codes 8 to 15, 0 to 7 show the same but 0 ends a string */
+#define LCD_CUSTOM_CHAR_CODE(index) ((char)(8 + (index)))
 
 /**
  * @brief LCD Initialization Function
@@ -65,7 +73,7 @@ App_StatusTypeDef LCD_SendData(uint8_t user_data);
 
 /**
  * @brief Clear the LCD Display
- * 
+ * The frame buffer is cleared with it and every held cell released.
  */
 void LCD_DisplayClear(void);
 
@@ -88,3 +96,45 @@ void LCD_PrintString(char * message);
  * @param column column number (1 to 20) LCD is a 4x20
  */
 void LCD_SetCursor(uint8_t row, uint8_t column);
+
+/**
+ * @brief Write text into the frame buffer
+ * Cells held by LCD_WriteHeld() are skipped and the text is cut at the end
+ * of the row. Nothing reaches the panel before LCD_Flush().
+ * @param row row number (1 to 4)
+ * @param column column number of the first character (1 to 20)
+ * @param text NUL terminated
+ */
+void LCD_WriteText(uint8_t row, uint8_t column, const char * text);
+
+/**
+ * @brief Write character codes into the frame buffer and hold their cells
+ * Held cells keep these codes against LCD_WriteText() until released.
+ * @param row row number (1 to 4)
+ * @param column column number of the first character (1 to 20)
+ * @param data Character codes, cut at the end of the row
+ * @param length Codes in data
+ */
+void LCD_WriteHeld(uint8_t row, uint8_t column, const uint8_t * data, uint8_t length);
+
+/**
+ * @brief Release held cells, blank until written again
+ * @param row row number (1 to 4)
+ * @param column column number of the first cell (1 to 20)
+ * @param length Cells to release
+ */
+void LCD_Release(uint8_t row, uint8_t column, uint8_t length);
+
+/**
+ * @brief Define the pattern of a custom character
+ * Cells already showing its code change at once. Leaves the cursor on the first cell.
+ * @param index 0 to LCD_CUSTOM_CHARS - 1, shown by LCD_CUSTOM_CHAR_CODE(index)
+ * @param pattern Eight rows from the top, five pixels each in the low bits
+ */
+void LCD_DefineChar(uint8_t index, const uint8_t pattern[8]);
+
+/**
+ * @brief Send the cells changed since the last flush to the panel
+ * Each run of changed cells costs one cursor move, unchanged cells cost nothing.
+ */
+void LCD_Flush(void);
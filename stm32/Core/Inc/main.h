@@ -14,6 +14,11 @@
 #define TRUE 1
 #define FALSE 0
 
+/* Backup SRAM map. Kept across resets, not across power cycles */
+#define BKPSRAM_BMP280_CACHE_OFFSET     (0x000U)    /* Sensor calibration cache */
+#define BKPSRAM_BMP280_CACHE_SIZE       (0x400U)
+#define BKPSRAM_FLASHLOG_OFFSET         (0x400U)    /* Flash log page not yet programmed */
+
 /**
 * @brief App Status structures definition  
 * 
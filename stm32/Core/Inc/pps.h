@@ -0,0 +1,40 @@
+/**
+ * @file pps.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the PPS phase detector
+ * @date 2023-01-11
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include "main.h"
+#include "rtc.h"
+
+#define PPS_AVERAGE_EDGES           (8U)            /* Edges per offset, averages out the 122 us RTC step */
+#define PPS_MAX_EDGE_AGE_US         (500U)          /* Edges served later than this are not used */
+
+/**
+ * @brief Start timestamping the PPS edges of the ESP32 on PA0
+ * Each rising edge marks a second boundary. It is captured by TIM2 and
+ * read against the RTC in the capture interrupt, the subseconds the RTC
+ * shows at the edge are its phase error. Needs the RTC running.
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef PPS_Init(void);
+
+/**
+ * @brief Get the phase offset averaged over the last PPS_AVERAGE_EDGES edges
+ * Never blocks, meant to be called from the main loop.
+ * @param pOffsetUs Populated with the correction to shift the RTC by, within half a second
+ * @return App_StatusTypeDef APP_OK if a new offset is ready. APP_ERROR otherwise
+ */
+App_StatusTypeDef PPS_GetOffset(int32_t * pOffsetUs);
+
+/**
+ * @brief Drop the edges averaged so far
+ * To be called after every correction of the RTC, the edges before it were
+ * measured against the old phase.
+ */
+void PPS_Discard(void);
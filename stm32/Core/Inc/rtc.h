@@ -11,6 +11,23 @@
 
 #include "main.h"
 
+/* ck_spre = 32768 / ((RTC_ASYNCH_PREDIV + 1) * (RTC_SYNCH_PREDIV + 1)) = 1 Hz with the LSE */
+#define RTC_ASYNCH_PREDIV	(3U)
+#define RTC_SYNCH_PREDIV	(8191U)		/* Subseconds and shifts in steps of 122 us */
+
+#define RTC_DAYS_TO_2000	(10957U)	/* From 1970-01-01 to 2000-01-01, the RTC year 0 */
+
+typedef void (*rtcCallback_t)(void);
+
+/**
+ * @brief RTC reading with its subseconds
+ */
+typedef struct
+{
+	RTC_TimeTypeDef time;
+	RTC_DateTypeDef date;
+}rtcStamp_t;
+
 /**
  * @brief RTC Initialization Function
  * 
@@ -42,6 +59,48 @@ App_StatusTypeDef RTC_GetDateTime(RTC_TimeTypeDef * pTime, RTC_DateTypeDef * pDa
  */
 App_StatusTypeDef RTC_SetDateTime(RTC_TimeTypeDef * pTime, RTC_DateTypeDef * pDate, uint32_t Format);
 
+/**
+ * @brief Read the RTC with its subseconds
+ * Short enough to be called from an interrupt to timestamp an event.
+ * @param pStamp Populated with the reading
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR if the RTC is not initialized yet
+ */
+App_StatusTypeDef RTC_GetStamp(rtcStamp_t * pStamp);
+
+/**
+ * @brief Days since 1970 of an RTC date
+ * Integer arithmetic only, unlike mktime() it is safe in an interrupt.
+ * @param pDate Date in binary format
+ * @return uint32_t Days
+ */
+uint32_t RTC_DateToDays(const RTC_DateTypeDef * pDate);
+
+/**
+ * @brief Convert a reading to microseconds since 1970 on the RTC clock
+ *
+ * @param pStamp Reading from RTC_GetStamp()
+ * @return int64_t Microseconds
+ */
+int64_t RTC_StampToMicros(const rtcStamp_t * pStamp);
+
+/**
+ * @brief Move the RTC by less than a second without stopping it
+ * Uses the shift control register, rounded to the subsecond step.
+ * @param micros Positive to advance the clock, negative to hold it back. Less than a second either way
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef RTC_Shift(int32_t micros);
+
+/**
+ * @brief Call back at every second of the RTC
+ * Alarm A with every field and the subseconds masked goes off as the
+ * seconds count, in step with the RTC through its shifts and steps.
+ * The callback runs in interrupt context.
+ * @param callback Function to call on every second
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef RTC_StartSecondTick(rtcCallback_t callback);
+
 /**
  * @brief Gets the weekday and returns it as a string
  * 
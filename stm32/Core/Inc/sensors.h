@@ -0,0 +1,105 @@
+/**
+ * @file sensors.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the BMP280 sensor registry
+ * @date 2022-11-27
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+#pragma once
+
+#include "main.h"
+#include "bmp280.h"
+
+#define SENSORS_MAX_COUNT           (4)     /* Two addresses per bus, up to two buses */
+#define SENSORS_MAX_BUSES           (2)
+#define SENSORS_BUS_TIME_US         (350)   /* Bus time of one trigger plus one burst read, I2C at 400 kHz */
+#define SENSORS_FMPI2C_BUS_TIME_US  (150)   /* Same on FMPI2C at 1 MHz */
+#define SENSORS_SPI_BUS_TIME_US     (50)    /* Same on SPI at 6.25 MHz, including chip select and DMA setup */
+
+/**
+ * @brief Registry entry of a sensor
+ */
+typedef struct
+{
+    bmp280_bus_t bus;               /* Transport */
+    bmp280_t dev;                   /* Driver handle */
+    volatile int32_t temperature;   /* Latest temperature in hundredths of a degree Celsius */
+    volatile uint32_t pressure;     /* Latest pressure in Pa. 0 when pressure is skipped */
+    volatile uint8_t isValid;       /* TRUE once a reading has been taken */
+}sensorEntry_t;
+
+/**
+ * @brief Initialize a sensor on I2C, apply config and add it to the registry
+ * 
+ * @param hi2c Initialized I2C bus the sensor is on
+ * @param i2cAddress BMP280_I2C_ADDRESS_0 or BMP280_I2C_ADDRESS_1
+ * @param config Config to apply. Read back to confirm it has been set
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef Sensors_RegisterI2C(I2C_HandleTypeDef * hi2c, uint8_t i2cAddress, bmp280_config_t * config);
+
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+/**
+ * @brief Initialize a sensor on FMPI2C, apply config and add it to the registry
+ * 
+ * @param hfmpi2c Initialized FMPI2C bus the sensor is on
+ * @param i2cAddress BMP280_I2C_ADDRESS_0 or BMP280_I2C_ADDRESS_1
+ * @param config Config to apply. Read back to confirm it has been set
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef Sensors_RegisterFMPI2C(FMPI2C_HandleTypeDef * hfmpi2c, uint8_t i2cAddress, bmp280_config_t * config);
+#endif
+
+/**
+ * @brief Initialize a sensor on SPI, apply config and add it to the registry
+ * 
+ * @param hspi Initialized SPI bus the sensor is on, see BMP280_Bus_InitSPI()
+ * @param csPort Chip select port
+ * @param csPin Chip select pin
+ * @param config Config to apply. Read back to confirm it has been set
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef Sensors_RegisterSPI(SPI_HandleTypeDef * hspi, GPIO_TypeDef * csPort, uint16_t csPin, bmp280_config_t * config);
+
+/**
+ * @brief Number of registered sensors
+ * 
+ * @return uint8_t Sensor count
+ */
+uint8_t Sensors_GetCount(void);
+
+/**
+ * @brief Driver handle of a registered sensor
+ * Only for blocking access while no acquisition round is running.
+ * @param index Registration order, starting at 0
+ * @return bmp280_t* Driver handle. NULL if index is out of range
+ */
+bmp280_t * Sensors_GetDevice(uint8_t index);
+
+/**
+ * @brief How far ahead of its use a round must be started
+ * Covers the longest conversion plus the transfers on the busiest bus.
+ * @return uint32_t Lead time in microseconds
+ */
+uint32_t Sensors_GetLeadTimeUs(void);
+
+/**
+ * @brief Start an acquisition round on every sensor without blocking
+ * Each bus triggers its sensors back to back, waits out the conversion
+ * and then reads them back to back, all driven by interrupts or DMA.
+ * Buses run in parallel.
+ * @return App_StatusTypeDef APP_OK if the round was started. APP_ERROR otherwise
+ */
+App_StatusTypeDef Sensors_StartRound(void);
+
+/**
+ * @brief Latest reading of a sensor
+ * 
+ * @param index Registration order, starting at 0
+ * @param temperature Populated with the temperature in hundredths of a degree Celsius
+ * @param pressure Populated with the pressure in Pa. May be NULL
+ * @return App_StatusTypeDef APP_OK if a reading is available. APP_ERROR otherwise
+ */
+App_StatusTypeDef Sensors_GetReading(uint8_t index, int32_t * temperature, uint32_t * pressure);
@@ -0,0 +1,109 @@
+/**
+ * @file timelink.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the ESP32 time link
+ * @date 2023-01-04
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include "main.h"
+#include "timesync.h"
+#include "rtc.h"
+
+#define TIMELINK_NSS_PORT           GPIOA
+#define TIMELINK_NSS_PIN            GPIO_PIN_15     /* SPI3_NSS, its rising edge ends a frame */
+#define TIMELINK_MISO_PORT          GPIOC
+#define TIMELINK_MISO_PIN           GPIO_PIN_11     /* SPI3_MISO, open-drain on a shared bus */
+#define TIMELINK_REQ_PORT           GPIOA
+#define TIMELINK_REQ_PIN            GPIO_PIN_1      /* To the ESP32, raising it asks for a frame */
+#define TIMELINK_RX_BUF_SIZE        (128U)          /* Circular DMA ring, several exchanges deep */
+#define TIMELINK_REQ_MIN_LOW_MS     (2U)            /* Ticks the request line is low before it is raised, at least 1 ms */
+#define TIMELINK_IRQ_PRIORITY       (12U)           /* NSS EXTI, SPI3 and its DMA streams, none preempts another */
+
+/**
+ * @brief Counters since TimeLink_Init()
+ */
+typedef struct
+{
+	uint32_t frames;            /* Valid time frames */
+	uint32_t contents;          /* Valid content frames */
+	uint32_t crcErrors;
+	uint32_t framingErrors;     /* Exchanges of the wrong length or without the sync word, the SPI is reset */
+	uint32_t dropped;           /* Frames that arrived while both buffers waited for the parser */
+}timeLinkStats_t;
+
+/**
+ * @brief A time frame with the RTC reading taken as its exchange ended
+ */
+typedef struct
+{
+	struct timesync_time time;
+	uint8_t sequence;
+	uint8_t isStamped;          /* FALSE if the RTC was not running yet */
+	rtcStamp_t received;        /* T2 of the exchange */
+}timeLinkFrame_t;
+
+/**
+ * @brief Called with every valid content frame
+ * The text points into the frame buffer, valid until the callback returns.
+ */
+typedef void (*timeLinkContentCallback_t)(const struct timesync_content * content);
+
+/**
+ * @brief Start exchanging frames with the ESP32
+ * The SPI is a hardware NSS slave receiving into a DMA ring that is never
+ * stopped. Each NSS rising edge copies the bytes clocked in since the last
+ * one into one of two frame buffers for TimeLink_GetTime() to parse, and
+ * queues the latest telemetry frame for the next exchange.
+ * On a bus shared with other nodes MISO is open-drain, pulled up on the
+ * board, and only driven while this node is selected. Time frames sent to
+ * every node at once then leave it to the wired AND of their telemetry.
+ * The request line is open-drain too and raised by pulling it low, the
+ * lines of all the nodes are tied together.
+ * @param hspi Initialized SPI3 handle, NSS_HARD_INPUT with a circular RX and a normal TX DMA linked
+ * @param isSharedBus TRUE if other nodes share the SPI bus
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef TimeLink_Init(SPI_HandleTypeDef * hspi, uint8_t isSharedBus);
+
+/**
+ * @brief Parse the frames received since the last call
+ * Never blocks, meant to be called from the main loop. Also raises the
+ * request line of a TimeLink_RequestTime() that had to wait.
+ * @param frame Populated with the newest valid time frame
+ * @return App_StatusTypeDef APP_OK if a valid time frame was received. APP_ERROR otherwise
+ */
+App_StatusTypeDef TimeLink_GetTime(timeLinkFrame_t * frame);
+
+/**
+ * @brief Set the callback of content frames
+ *
+ * @param callback Called from TimeLink_GetTime(). NULL to drop content frames
+ */
+void TimeLink_SetContentCallback(timeLinkContentCallback_t callback);
+
+/**
+ * @brief Ask the ESP32 for a time frame now
+ * Raises the request line, the end of the next exchange lowers it. The
+ * ESP32 only sees the edge that raises it, so a line still raised by an
+ * unanswered request is lowered here and raised by TimeLink_GetTime() once
+ * it has been low for TIMELINK_REQ_MIN_LOW_MS. Never waits.
+ */
+void TimeLink_RequestTime(void);
+
+/**
+ * @brief Stage the telemetry returned on the next exchange
+ * The link counters and the acknowledged sequence are filled in here.
+ * @param telemetry State of the node
+ */
+void TimeLink_SetTelemetry(struct timesync_telemetry * telemetry);
+
+/**
+ * @brief Counters since TimeLink_Init()
+ *
+ * @param stats Populated with the counters
+ */
+void TimeLink_GetStats(timeLinkStats_t * stats);
@@ -11,10 +11,18 @@
 
 #include "main.h"
 
+typedef void (*timerCallback_t)(void);
+typedef void (*timerCaptureCallback_t)(uint32_t captureUs);
+
 typedef struct
 {
 	TIM_HandleTypeDef htimer6;
+	uint32_t counterClockHz;
 	volatile uint8_t hasTimerExpired;
+	TIM_HandleTypeDef htimer7;
+	timerCallback_t samplingCallback;
+	TIM_HandleTypeDef htimer2;
+	timerCaptureCallback_t captureCallback;
 }timerLocalData_t;
 
 /**
@@ -37,3 +45,41 @@ App_StatusTypeDef Timer_Start(void);
  * @return uint8_t TRUE when timer has expired. FALSE otherwise
  */
 uint8_t Timer_HasTimerExpired(void);
+
+/**
+ * @brief Expire the timer now and start its next period from here
+ * Called at every RTC second, the frame showing a new second is composed
+ * as it begins instead of up to a period late.
+ */
+void Timer_Rephase(void);
+
+/**
+ * @brief Return the time left until the timer expires next
+ * 
+ * @return uint32_t Time to the next expiry in microseconds
+ */
+uint32_t Timer_GetTimeToExpiryUs(void);
+
+/**
+ * @brief Initialize and start the sampling timer
+ * The callback runs in interrupt context once every period.
+ * @param periodUs Sampling period in microseconds
+ * @param callback Function to call on every period
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef Timer_StartSampling(uint32_t periodUs, timerCallback_t callback);
+
+/**
+ * @brief Start the free-running microsecond counter and capture its value on rising edges of PA0
+ * The callback runs in interrupt context with the counter latched at the edge.
+ * @param callback Function to call on every edge
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR otherwise
+ */
+App_StatusTypeDef Timer_StartCapture(timerCaptureCallback_t callback);
+
+/**
+ * @brief Read the counter of the capture timer
+ * 
+ * @return uint32_t Microseconds, wrapping every 71 minutes
+ */
+uint32_t Timer_GetCaptureCounterUs(void);
@@ -0,0 +1,108 @@
+/**
+ * @file tscodec.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the time-series codec
+ * @date 2022-12-29
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include "main.h"
+
+/**
+ * @brief One sample of the time series
+ */
+typedef struct
+{
+    uint32_t timestamp;     /* Seconds */
+    int16_t temperature;    /* Hundredths of a degree Celsius */
+    uint32_t pressure;      /* Pa, 0 if not measured */
+}tsSample_t;
+
+/**
+ * @brief Writes samples into a block. A block decodes on its own, the
+ * first sample is stored whole and the rest as differences to it.
+ */
+typedef struct
+{
+    uint8_t *buf;           /* Zeroed by TsCodec_InitEncoder() */
+    uint32_t capacityBits;
+    uint32_t bitPos;
+    uint16_t count;         /* Samples in the block */
+    tsSample_t prev;
+    uint32_t prevDelta;     /* Time step between the last two samples */
+}tsEncoder_t;
+
+/**
+ * @brief Reads samples back from a block
+ */
+typedef struct
+{
+    const uint8_t *buf;
+    uint32_t lengthBits;
+    uint32_t bitPos;
+    uint16_t remaining;     /* Samples not yet decoded */
+    uint16_t count;         /* Samples decoded */
+    tsSample_t prev;
+    uint32_t prevDelta;
+}tsDecoder_t;
+
+/**
+ * @brief Start a block
+ *
+ * @param enc Pointer to tsEncoder_t to initialize
+ * @param buf Block storage, cleared here
+ * @param capacity Size of buf in bytes
+ */
+void TsCodec_InitEncoder(tsEncoder_t * enc, uint8_t * buf, uint16_t capacity);
+
+/**
+ * @brief Continue a block written by an earlier encoder, such as one kept across a reset
+ *
+ * @param enc Pointer to tsEncoder_t to initialize
+ * @param buf Block storage holding length bytes of encoded samples
+ * @param capacity Size of buf in bytes
+ * @param length Bytes of the block, from TsCodec_GetLength()
+ * @param count Samples in the block
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR if the block does not decode
+ */
+App_StatusTypeDef TsCodec_ResumeEncoder(tsEncoder_t * enc, uint8_t * buf, uint16_t capacity, uint16_t length, uint16_t count);
+
+/**
+ * @brief Append a sample to the block
+ * The timestamp takes 1 bit when the sampling interval is steady, a
+ * reading 1 bit when unchanged and 4 bits for a change of one count.
+ * @param enc Pointer to an initialized tsEncoder_t
+ * @param sample Sample to append, timestamps must not decrease
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR if the block is full, it is left unchanged
+ */
+App_StatusTypeDef TsCodec_Encode(tsEncoder_t * enc, const tsSample_t * sample);
+
+/**
+ * @brief Bytes of the block in use
+ *
+ * @param enc Pointer to an initialized tsEncoder_t
+ * @return uint16_t Length in bytes
+ */
+uint16_t TsCodec_GetLength(const tsEncoder_t * enc);
+
+/**
+ * @brief Start reading a block
+ *
+ * @param dec Pointer to tsDecoder_t to initialize
+ * @param buf Block written by the encoder
+ * @param length Bytes of the block, from TsCodec_GetLength()
+ * @param count Samples in the block
+ */
+void TsCodec_InitDecoder(tsDecoder_t * dec, const uint8_t * buf, uint16_t length, uint16_t count);
+
+/**
+ * @brief Read the next sample of the block
+ *
+ * @param dec Pointer to an initialized tsDecoder_t
+ * @param sample Populated with the sample
+ * @return App_StatusTypeDef APP_OK if successful. APP_ERROR at the end of the block or if it is corrupt
+ */
+App_StatusTypeDef TsCodec_Decode(tsDecoder_t * dec, tsSample_t * sample);
@@ -0,0 +1,96 @@
+/**
+ * @file widget.h
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Header file of the LCD widgets
+ * @date 2023-01-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include "main.h"
+#include "lcd.h"
+
+#define WIDGET_NO_VALUE             INT32_MIN   /* Gap in the values of Widget_FormatBars() */
+
+/**
+ * @brief Version of the data of a widget
+ * Called for every widget at every Widget_Render(), so it only reads cached
+ * values. It changes whenever the rendered text would.
+ */
+typedef uint32_t (*widgetVersion_t)(void);
+
+/**
+ * @brief Render the text of a widget
+ * @param text Buffer of LCD_COLUMNS + 1 characters, to fill with a NUL terminated text
+ * @param width Cells of the widget, a shorter text is padded with spaces and a longer one cut
+ */
+typedef void (*widgetRender_t)(char * text, uint8_t width);
+
+/**
+ * @brief Region of the panel, meant for a const table
+ */
+typedef struct
+{
+	uint8_t row;                /* 1 to LCD_ROWS */
+	uint8_t column;             /* 1 to LCD_COLUMNS, of the first cell */
+	uint8_t width;              /* Cells, cut at the end of the row */
+	uint32_t periodMs;          /* Rendered at least this often, 0 only on a new version */
+	widgetVersion_t version;    /* NULL to render on the period alone */
+	widgetRender_t render;
+}widget_t;
+
+/**
+ * @brief What was last rendered for a widget, one per entry of the table
+ */
+typedef struct
+{
+	uint32_t version;
+	uint32_t renderTick;        /* HAL tick of the last render */
+	uint8_t isRendered;         /* FALSE to render at the next Widget_Render() */
+}widgetState_t;
+
+/**
+ * @brief Define the custom characters of Widget_FormatBars()
+ * Call once the LCD is initialized.
+ */
+void Widget_Init(void);
+
+/**
+ * @brief Render the widgets that are due into the LCD frame buffer
+ * A widget is due on a new version of its data, when its period elapsed
+ * and on its first render. The others cost one call to their version.
+ * Nothing reaches the panel before LCD_Flush().
+ * @param layout Table of widgets
+ * @param state Zero initialized, as many entries as the table
+ * @param count Entries of the table
+ */
+void Widget_Render(const widget_t * layout, widgetState_t * state, uint8_t count);
+
+/**
+ * @brief Render every widget at the next Widget_Render()
+ * For when cells under the widgets were written by something else.
+ * @param state Of the table
+ * @param count Entries of the table
+ */
+void Widget_Invalidate(widgetState_t * state, uint8_t count);
+
+/**
+ * @brief Format a temperature without floating point
+ *
+ * @param text Populated with the NUL terminated text, at least 8 characters
+ * @param temperature Hundredths of a degree Celsius
+ * @param decimals 1 or 2
+ * @return char* text
+ */
+char * Widget_FormatTemperature(char * text, int32_t temperature, uint8_t decimals);
+
+/**
+ * @brief Format values as a bar per cell, scaled from their minimum to their maximum
+ *
+ * @param text Populated with count characters and a NUL
+ * @param values WIDGET_NO_VALUE for an empty cell
+ * @param count Values, one cell each
+ */
+void Widget_FormatBars(char * text, const int32_t * values, uint8_t count);
@@ -12,64 +12,70 @@
 #include <math.h>
 #include "bmp280.h"
 #include "bmp280_types.h"
+#include "bmp280_cache.h"
 
-I2C_HandleTypeDef hi2c1;
+static void UpdateCalibrationValues(bmp280_t *dev, const uint8_t *buf);
+static void WaitForMeasurement(bmp280_t *dev);
+static uint8_t GetControlValue(bmp280_config_t *config, uint8_t mode);
+static App_StatusTypeDef ReadRegisters(bmp280_t *dev, uint8_t regAddr, uint8_t *buf, uint16_t len);
+static App_StatusTypeDef WriteRegister(bmp280_t *dev, uint8_t regAddr, uint8_t regVal);
+static void DecodeRaw(const uint8_t *buf, int32_t *tempAdc, int32_t *pressAdc);
+static int32_t CompensateTFine(int32_t tempAdc, const bmp280_temp_calib_t *calib);
+static uint32_t CompensatePressure(int32_t pressAdc, int32_t t_fine, const bmp280_press_calib_t *calib);
 
-static bmp280_t bmp280;
-
-static void UpdateCalibrationValues();
-static App_StatusTypeDef BMP280_I2C1_Init(void);
-
-App_StatusTypeDef BMP280_Init()
+App_StatusTypeDef BMP280_Init(bmp280_t *dev, bmp280_bus_t *bus)
 {
-    uint8_t regVal = 0x00;
-    uint8_t regAddr = 0x00;
-    memset(&bmp280, 0, sizeof(bmp280));
-    bmp280.i2cAddress = BMP280_I2C_ADDRESS_0;
-    if (APP_OK != BMP280_I2C1_Init())
+    if (!dev || !bus || !bus->ops)
     {
         return APP_ERROR;
     }
+    uint8_t regVal = 0x00;
+    uint8_t calib[BMP280_CALIB_DATA_LEN];
+    memset(dev, 0, sizeof(*dev));
+    dev->bus = bus;
 
-    /* Read Device ID */
-    regAddr = (uint8_t)BMP280_REG_CHIPID;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, &regAddr, 1, HAL_MAX_DELAY))
-    {
-        return APP_ERROR;
-    }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, &regVal, 1, HAL_MAX_DELAY))
+    /* On a warm boot the chip ID and calibration are still in backup SRAM */
+    if (APP_OK != BMP280_Cache_Load(bus->busId, bus->devId, calib))
     {
-        return APP_ERROR;
+        /* Read Device ID */
+        if (APP_OK != ReadRegisters(dev, (uint8_t)BMP280_REG_CHIPID, &regVal, 1))
+        {
+            return APP_ERROR;
+        }
+        /* Check Device ID */
+        if (regVal != BMP280_CHIPID)
+        {
+            return APP_ERROR;
+        }
+        /* Read Calibration values in a single burst */
+        if (APP_OK != ReadRegisters(dev, (uint8_t)BMP280_REG_DIG_T1, calib, BMP280_CALIB_DATA_LEN))
+        {
+            return APP_ERROR;
+        }
+        /* A full cache only costs the reads on the next boot */
+        BMP280_Cache_Store(bus->busId, bus->devId, regVal, calib);
     }
-    /* Check Device ID */
-    if (regVal != BMP280_CHIPID)
+    UpdateCalibrationValues(dev, calib);
+
+    /* Update Config values */
+    if (APP_OK != BMP280_GetConfig(dev, &dev->config))
     {
         return APP_ERROR;
     }
-
-    /* Read Calibration values */
-    UpdateCalibrationValues();
-
-    /* Update Config values */
-    return BMP280_GetConfig(&bmp280.config);
+    dev->measTimeUs = BMP280_GetMeasurementTimeUs(&dev->config);
+    return APP_OK;
 }
 
-App_StatusTypeDef BMP280_GetConfig(bmp280_config_t *config)
+App_StatusTypeDef BMP280_GetConfig(bmp280_t *dev, bmp280_config_t *config)
 {
-    if (!config)
+    if (!dev || !config)
     {
         return APP_ERROR;
     }
     uint8_t regVal = 0x00;
-    uint8_t regAddr = 0x00;
 
     /* Read Config Register */
-    regAddr = (uint8_t)BMP280_REG_CONFIG;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, &regAddr, 1, HAL_MAX_DELAY))
-    {
-        return APP_ERROR;
-    }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, &regVal, 1, HAL_MAX_DELAY))
+    if (APP_OK != ReadRegisters(dev, (uint8_t)BMP280_REG_CONFIG, &regVal, 1))
     {
         return APP_ERROR;
     }
@@ -77,35 +83,26 @@ App_StatusTypeDef BMP280_GetConfig(bmp280_config_t *config)
     config->filter = (regVal & BMP280_FILTER_MASK) >> BMP280_FILTER_SHIFT;
 
     /* Read Control Register */
-    regAddr = (uint8_t)BMP280_REG_CONTROL;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, &regAddr, 1, HAL_MAX_DELAY))
-    {
-        return APP_ERROR;
-    }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, &regVal, 1, HAL_MAX_DELAY))
+    if (APP_OK != ReadRegisters(dev, (uint8_t)BMP280_REG_CONTROL, &regVal, 1))
     {
         return APP_ERROR;
     }
     config->tempOversampling = (regVal & BMP280_SAMPLING_MASK) >> BMP280_SAMPLING_SHIFT;
+    config->pressOversampling = (regVal & BMP280_PRESS_SAMPLING_MASK) >> BMP280_PRESS_SAMPLING_SHIFT;
     config->mode = (regVal & BMP280_MODE_MASK) >> BMP280_MODE_SHIFT;
     return APP_OK;
 }
 
-App_StatusTypeDef BMP280_SetConfig(bmp280_config_t *config)
+App_StatusTypeDef BMP280_SetConfig(bmp280_t *dev, bmp280_config_t *config)
 {
-    if (!config)
+    if (!dev || !config)
     {
         return APP_ERROR;
     }
     uint8_t regVal = 0x00;
-    uint8_t buf[2];
+
     /* Read config register */
-    buf[0] = (uint8_t)BMP280_REG_CONTROL;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 1, HAL_MAX_DELAY))
-    {
-        return APP_ERROR;
-    }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, &regVal, 1, HAL_MAX_DELAY))
+    if (APP_OK != ReadRegisters(dev, (uint8_t)BMP280_REG_CONFIG, &regVal, 1))
     {
         return APP_ERROR;
     }
@@ -116,78 +113,197 @@ App_StatusTypeDef BMP280_SetConfig(bmp280_config_t *config)
     regVal |= ((config->filter << BMP280_FILTER_SHIFT) & BMP280_FILTER_MASK);
 
     /* Write to the Config register with the modified values */
-    buf[0] = (uint8_t)BMP280_REG_CONFIG;
-    buf[1] = regVal;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 2, HAL_MAX_DELAY))
+    if (APP_OK != WriteRegister(dev, (uint8_t)BMP280_REG_CONFIG, regVal))
+    {
+        return APP_ERROR;
+    }
+
+    /* Every field of the control register is set from config, no need to read it first */
+    if (APP_OK != WriteRegister(dev, (uint8_t)BMP280_REG_CONTROL, GetControlValue(config, config->mode)))
     {
         return APP_ERROR;
     }
 
-    /* Read control register */
-    buf[0] = (uint8_t)BMP280_REG_CONTROL;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 1, HAL_MAX_DELAY))
+    /* Keep a copy so forced conversions can be started without reading back */
+    dev->config = *config;
+    dev->measTimeUs = BMP280_GetMeasurementTimeUs(config);
+    if (config->mode == BMP280_MODE_FORCED)
+    {
+        /* Writing forced mode has started a conversion */
+        dev->triggerTick = HAL_GetTick();
+        dev->isConversionPending = TRUE;
+    }
+    return APP_OK;
+}
+
+uint32_t BMP280_GetMeasurementTimeUs(bmp280_config_t *config)
+{
+    uint32_t measTimeUs = BMP280_MEAS_TIME_BASE_US;
+    if (!config)
+    {
+        return measTimeUs;
+    }
+    /* Oversampling codes 1..5 map to 1, 2, 4, 8 and 16 samples */
+    if (config->tempOversampling != BMP280_SAMPLING_NONE)
+    {
+        measTimeUs += BMP280_MEAS_TIME_PER_OS_US * (1U << (config->tempOversampling - BMP280_SAMPLING_X1));
+    }
+    if (config->pressOversampling != BMP280_SAMPLING_NONE)
+    {
+        measTimeUs += BMP280_MEAS_TIME_PRESS_US;
+        measTimeUs += BMP280_MEAS_TIME_PER_OS_US * (1U << (config->pressOversampling - BMP280_SAMPLING_X1));
+    }
+    return measTimeUs;
+}
+
+App_StatusTypeDef BMP280_TriggerForcedMeasurement(bmp280_t *dev)
+{
+    if (!dev)
     {
         return APP_ERROR;
     }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, &regVal, 1, HAL_MAX_DELAY))
+    /* Control register is rebuilt from the cached config to save a read */
+    if (APP_OK != WriteRegister(dev, (uint8_t)BMP280_REG_CONTROL, GetControlValue(&dev->config, BMP280_MODE_FORCED)))
     {
         return APP_ERROR;
     }
-    /* Clear the Sampling and Mode values while preserving the other areas */
-    regVal &= ~(BMP280_SAMPLING_MASK | BMP280_MODE_MASK);
-    /* Update the Sampling and Mode register values */
-    regVal |= ((config->tempOversampling << BMP280_SAMPLING_SHIFT) & BMP280_SAMPLING_MASK);
-    regVal |= ((config->mode << BMP280_MODE_SHIFT) & BMP280_MODE_MASK);
-    buf[0] = (uint8_t)BMP280_REG_CONTROL;
-    buf[1] = regVal;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 2, HAL_MAX_DELAY))
+    dev->triggerTick = HAL_GetTick();
+    dev->isConversionPending = TRUE;
+    return APP_OK;
+}
+
+App_StatusTypeDef BMP280_TriggerForcedMeasurement_IT(bmp280_t *dev)
+{
+    if (!dev)
     {
         return APP_ERROR;
     }
+    if (APP_OK != dev->bus->ops->writeAsync(dev->bus, (uint8_t)BMP280_REG_CONTROL,
+                                            GetControlValue(&dev->config, BMP280_MODE_FORCED)))
+    {
+        return APP_ERROR;
+    }
+    /* The conversion starts once the transfer completes, this is a lower bound */
+    dev->triggerTick = HAL_GetTick();
+    dev->isConversionPending = TRUE;
     return APP_OK;
 }
 
-double BMP280_ReadTemperatureC()
+App_StatusTypeDef BMP280_ReadRawTemperature(bmp280_t *dev, int32_t *tempAdc)
 {
+    if (!dev || !tempAdc)
+    {
+        return APP_ERROR;
+    }
     uint8_t buf[3];
-    int32_t temp_adc = 0;
-    double temperatureC;
-    int32_t var1 = 0;
-    int32_t var2 = 0;
-    int32_t t_fine;
+
+    /* Make sure a forced conversion has finished before reading the result */
+    WaitForMeasurement(dev);
 
     /* Read the temperature ADC registers */
-    buf[0] = (uint8_t)BMP280_REG_TEMPDATA;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 1, HAL_MAX_DELAY))
+    if (APP_OK != ReadRegisters(dev, (uint8_t)BMP280_REG_TEMPDATA, buf, 3))
     {
-        return -1;
+        return APP_ERROR;
     }
 
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, buf, 3, HAL_MAX_DELAY))
+    /* Format the value read from the ADC. The 4 LSBs are in the upper nibble of xlsb */
+    *tempAdc = ((int32_t)buf[0] << 12) | ((int32_t)buf[1] << 4) | ((int32_t)buf[2] >> 4);
+    return APP_OK;
+}
+
+App_StatusTypeDef BMP280_ReadRaw(bmp280_t *dev, int32_t *tempAdc, int32_t *pressAdc)
+{
+    if (!dev || !tempAdc || !pressAdc)
     {
-        return -1;
+        return APP_ERROR;
     }
 
-    /* Format the value read from the ADC */
-    temp_adc |= buf[0] << 12;
-    temp_adc |= buf[1] << 4;
-    buf[2] &= 0x0F;
-    temp_adc |= buf[2];
+    /* Make sure a forced conversion has finished before reading the result */
+    WaitForMeasurement(dev);
 
-    /* Convert the raw value */
-    var1 = ((((temp_adc >> 3) - ((int32_t)bmp280.temp_calib.dig_T1 << 1))) * ((int32_t)bmp280.temp_calib.dig_T2)) >> 11;
-    var2 = (((((temp_adc >> 4) - ((int32_t)bmp280.temp_calib.dig_T1)) * ((temp_adc >> 4) - ((int32_t)bmp280.temp_calib.dig_T1))) >> 12) * ((int32_t)bmp280.temp_calib.dig_T3)) >> 14;
-    t_fine = var1 + var2;
-    temperatureC = (t_fine * 5 + 128) >> 8;
-    temperatureC /= 100;
+    /* Burst read so both values come from the same conversion */
+    uint8_t buf[BMP280_RAW_DATA_LEN];
+    if (APP_OK != ReadRegisters(dev, (uint8_t)BMP280_REG_PRESSDATA, buf, BMP280_RAW_DATA_LEN))
+    {
+        return APP_ERROR;
+    }
+    DecodeRaw(buf, tempAdc, pressAdc);
+    return APP_OK;
+}
 
-    return temperatureC;
+App_StatusTypeDef BMP280_ReadRaw_IT(bmp280_t *dev)
+{
+    if (!dev)
+    {
+        return APP_ERROR;
+    }
+    if (APP_OK != dev->bus->ops->readAsync(dev->bus, (uint8_t)BMP280_REG_PRESSDATA, BMP280_RAW_DATA_LEN))
+    {
+        return APP_ERROR;
+    }
+    dev->isConversionPending = FALSE;
+    return APP_OK;
 }
 
-char *BMP280_GetTemperatureString()
+void BMP280_GetRawFromBuffer(bmp280_t *dev, int32_t *tempAdc, int32_t *pressAdc)
+{
+    DecodeRaw(BMP280_Bus_GetData(dev->bus), tempAdc, pressAdc);
+}
+
+int32_t BMP280_CompensateTemperature(bmp280_t *dev, int32_t tempAdc)
+{
+    int32_t t_fine = CompensateTFine(tempAdc, &dev->temp_calib);
+    return (t_fine * 5 + 128) >> 8;
+}
+
+App_StatusTypeDef BMP280_CompensateBatch(bmp280_t *dev, const int32_t *tempAdc, const int32_t *pressAdc,
+                                         int32_t *temperature, uint32_t *pressure, uint32_t count)
+{
+    if (!dev || !tempAdc || !temperature || (pressAdc && !pressure))
+    {
+        return APP_ERROR;
+    }
+
+    /* Work on local copies so the calibration stays in registers across the loop */
+    const bmp280_temp_calib_t tempCalib = dev->temp_calib;
+    const bmp280_press_calib_t pressCalib = dev->press_calib;
+
+    if (!pressAdc)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            int32_t t_fine = CompensateTFine(tempAdc[i], &tempCalib);
+            temperature[i] = (t_fine * 5 + 128) >> 8;
+        }
+        return APP_OK;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t t_fine = CompensateTFine(tempAdc[i], &tempCalib);
+        temperature[i] = (t_fine * 5 + 128) >> 8;
+        pressure[i] = CompensatePressure(pressAdc[i], t_fine, &pressCalib);
+    }
+    return APP_OK;
+}
+
+double BMP280_ReadTemperatureC(bmp280_t *dev)
+{
+    int32_t temp_adc = 0;
+    if (APP_OK != BMP280_ReadRawTemperature(dev, &temp_adc))
+    {
+        return -1;
+    }
+    return (double)BMP280_CompensateTemperature(dev, temp_adc) / 100;
+}
+
+char *BMP280_GetTemperatureString(bmp280_t *dev)
+{
+    return BMP280_TemperatureToString(BMP280_ReadTemperatureC(dev));
+}
+
+char *BMP280_TemperatureToString(double temperatureC)
 {
     static char buf[20];
-    double temperatureC = BMP280_ReadTemperatureC();
     char *tmpSign = (temperatureC < 0) ? "-" : "";
     float tmpVal = (temperatureC < 0) ? -temperatureC : temperatureC;
 
@@ -201,65 +317,120 @@ char *BMP280_GetTemperatureString()
 }
 
 /**
- * @brief Read and store temperature calibration data
+ * @brief Decode and store temperature and pressure calibration data
+ * The calibration words are little endian.
  */
-static void UpdateCalibrationValues()
+static void UpdateCalibrationValues(bmp280_t *dev, const uint8_t *buf)
 {
-    uint8_t buf[2];
-    /* Read dig_T1(0x88/0x89) */
-    buf[0] = (uint8_t)BMP280_REG_DIG_T1;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 1, HAL_MAX_DELAY))
-    {
-        return;
-    }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, buf, 2, HAL_MAX_DELAY))
-    {
-        return;
-    }
-    bmp280.temp_calib.dig_T1 = (uint16_t)buf[0] << 8 | (uint16_t)buf[1];
+    dev->temp_calib.dig_T1 = (uint16_t)buf[1] << 8 | (uint16_t)buf[0];
+    dev->temp_calib.dig_T2 = (int16_t)((uint16_t)buf[3] << 8 | (uint16_t)buf[2]);
+    dev->temp_calib.dig_T3 = (int16_t)((uint16_t)buf[5] << 8 | (uint16_t)buf[4]);
 
-    /* Read dig_T2(0x8A/0x8B) */
-    buf[0] = (uint8_t)BMP280_REG_DIG_T2;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 1, HAL_MAX_DELAY))
-    {
-        return;
-    }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, buf, 2, HAL_MAX_DELAY))
+    dev->press_calib.dig_P1 = (uint16_t)buf[7] << 8 | (uint16_t)buf[6];
+    dev->press_calib.dig_P2 = (int16_t)((uint16_t)buf[9] << 8 | (uint16_t)buf[8]);
+    dev->press_calib.dig_P3 = (int16_t)((uint16_t)buf[11] << 8 | (uint16_t)buf[10]);
+    dev->press_calib.dig_P4 = (int16_t)((uint16_t)buf[13] << 8 | (uint16_t)buf[12]);
+    dev->press_calib.dig_P5 = (int16_t)((uint16_t)buf[15] << 8 | (uint16_t)buf[14]);
+    dev->press_calib.dig_P6 = (int16_t)((uint16_t)buf[17] << 8 | (uint16_t)buf[16]);
+    dev->press_calib.dig_P7 = (int16_t)((uint16_t)buf[19] << 8 | (uint16_t)buf[18]);
+    dev->press_calib.dig_P8 = (int16_t)((uint16_t)buf[21] << 8 | (uint16_t)buf[20]);
+    dev->press_calib.dig_P9 = (int16_t)((uint16_t)buf[23] << 8 | (uint16_t)buf[22]);
+}
+
+/**
+ * @brief Build the control register value for the given config and mode
+ */
+static uint8_t GetControlValue(bmp280_config_t *config, uint8_t mode)
+{
+    uint8_t regVal = 0x00;
+    regVal |= ((config->tempOversampling << BMP280_SAMPLING_SHIFT) & BMP280_SAMPLING_MASK);
+    regVal |= ((config->pressOversampling << BMP280_PRESS_SAMPLING_SHIFT) & BMP280_PRESS_SAMPLING_MASK);
+    regVal |= ((mode << BMP280_MODE_SHIFT) & BMP280_MODE_MASK);
+    return regVal;
+}
+
+/**
+ * @brief Read len consecutive registers starting at regAddr
+ */
+static App_StatusTypeDef ReadRegisters(bmp280_t *dev, uint8_t regAddr, uint8_t *buf, uint16_t len)
+{
+    return dev->bus->ops->read(dev->bus, regAddr, buf, len);
+}
+
+/**
+ * @brief Write a single register
+ */
+static App_StatusTypeDef WriteRegister(bmp280_t *dev, uint8_t regAddr, uint8_t regVal)
+{
+    return dev->bus->ops->write(dev->bus, regAddr, regVal);
+}
+
+/**
+ * @brief Decode a burst of the pressure and temperature data registers
+ * The 4 LSBs of each value are in the upper nibble of xlsb.
+ */
+static void DecodeRaw(const uint8_t *buf, int32_t *tempAdc, int32_t *pressAdc)
+{
+    *pressAdc = ((int32_t)buf[0] << 12) | ((int32_t)buf[1] << 4) | ((int32_t)buf[2] >> 4);
+    *tempAdc = ((int32_t)buf[3] << 12) | ((int32_t)buf[4] << 4) | ((int32_t)buf[5] >> 4);
+}
+
+/**
+ * @brief Fine temperature used by both compensation formulas (datasheet 3.11.3)
+ */
+static inline int32_t CompensateTFine(int32_t tempAdc, const bmp280_temp_calib_t *calib)
+{
+    int32_t var1 = ((((tempAdc >> 3) - ((int32_t)calib->dig_T1 << 1))) * ((int32_t)calib->dig_T2)) >> 11;
+    int32_t var2 = (((((tempAdc >> 4) - ((int32_t)calib->dig_T1)) * ((tempAdc >> 4) - ((int32_t)calib->dig_T1))) >> 12) * ((int32_t)calib->dig_T3)) >> 14;
+    return var1 + var2;
+}
+
+/**
+ * @brief 32-bit fixed point pressure compensation (datasheet 8.2)
+ * Avoids the 64-bit variant, which is much slower on the M4.
+ * @return uint32_t Pressure in Pa
+ */
+static inline uint32_t CompensatePressure(int32_t pressAdc, int32_t t_fine, const bmp280_press_calib_t *calib)
+{
+    int32_t var1 = (t_fine >> 1) - (int32_t)64000;
+    int32_t var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)calib->dig_P6);
+    var2 = var2 + ((var1 * ((int32_t)calib->dig_P5)) << 1);
+    var2 = (var2 >> 2) + (((int32_t)calib->dig_P4) << 16);
+    var1 = (((calib->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)calib->dig_P2) * var1) >> 1)) >> 18;
+    var1 = ((((32768 + var1)) * ((int32_t)calib->dig_P1)) >> 15);
+    if (var1 == 0)
     {
-        return;
+        /* Avoid a division by zero on an uncalibrated device */
+        return 0;
     }
-    bmp280.temp_calib.dig_T2 = (int16_t)((uint16_t)buf[0] << 8 | (uint16_t)buf[1]);
-
-    /* Read dig_T3(0x8C/0x8D) */
-    buf[0] = (uint8_t)BMP280_REG_DIG_T3;
-    if (HAL_OK != HAL_I2C_Master_Transmit(&hi2c1, bmp280.i2cAddress, buf, 1, HAL_MAX_DELAY))
+    uint32_t p = (((uint32_t)(((int32_t)1048576) - pressAdc) - (var2 >> 12))) * 3125;
+    if (p < 0x80000000)
     {
-        return;
+        p = (p << 1) / ((uint32_t)var1);
     }
-    if (HAL_OK != HAL_I2C_Master_Receive(&hi2c1, bmp280.i2cAddress, buf, 2, HAL_MAX_DELAY))
+    else
     {
-        return;
+        p = (p / (uint32_t)var1) * 2;
     }
-    bmp280.temp_calib.dig_T3 = (int16_t)((uint16_t)buf[0] << 8 | (uint16_t)buf[1]);
+    var1 = (((int32_t)calib->dig_P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((int32_t)(p >> 2)) * ((int32_t)calib->dig_P8)) >> 13;
+    return (uint32_t)((int32_t)p + ((var1 + var2 + calib->dig_P7) >> 4));
 }
 
 /**
- * @brief I2C1 Initialization Function
+ * @brief Block until a pending forced conversion is guaranteed to be complete
+ * Returns immediately when the conversion was scheduled early enough.
  */
-static App_StatusTypeDef BMP280_I2C1_Init(void)
+static void WaitForMeasurement(bmp280_t *dev)
 {
-    hi2c1.Instance = I2C1;
-    hi2c1.Init.ClockSpeed = 400000;
-    hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
-    hi2c1.Init.OwnAddress1 = 0;
-    hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
-    hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
-    hi2c1.Init.OwnAddress2 = 0;
-    hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
-    hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
-    if (HAL_I2C_Init(&hi2c1) != HAL_OK)
+    if (!dev->isConversionPending)
     {
-        return APP_ERROR;
+        return;
     }
-    return APP_OK;
+    /* The tick may advance right after the trigger, so wait one extra tick */
+    uint32_t measTimeMs = (dev->measTimeUs + 999U) / 1000U;
+    while ((HAL_GetTick() - dev->triggerTick) <= measTimeMs)
+    {
+    }
+    dev->isConversionPending = FALSE;
 }
@@ -0,0 +1,385 @@
+/**
+ * @file bmp280_bus.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the BMP280 bus transports
+ * @date 2022-12-04
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "bmp280_bus.h"
+
+static App_StatusTypeDef I2C_Read(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len);
+static App_StatusTypeDef I2C_Write(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+static App_StatusTypeDef I2C_ReadAsync(bmp280_bus_t *bus, uint8_t regAddr, uint16_t len);
+static App_StatusTypeDef I2C_WriteAsync(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+static App_StatusTypeDef FMPI2C_Read(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len);
+static App_StatusTypeDef FMPI2C_Write(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+static App_StatusTypeDef FMPI2C_ReadAsync(bmp280_bus_t *bus, uint8_t regAddr, uint16_t len);
+static App_StatusTypeDef FMPI2C_WriteAsync(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+#endif
+static App_StatusTypeDef SPI_Read(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len);
+static App_StatusTypeDef SPI_Write(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+static App_StatusTypeDef SPI_ReadAsync(bmp280_bus_t *bus, uint8_t regAddr, uint16_t len);
+static App_StatusTypeDef SPI_WriteAsync(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal);
+static App_StatusTypeDef SPI_StartDMA(bmp280_bus_t *bus, uint16_t len);
+static App_StatusTypeDef AddActive(bmp280_bus_t *bus);
+static bmp280_bus_t *TakeActive(void *handle);
+static void Complete(void *handle, App_StatusTypeDef status);
+
+const bmp280_bus_ops_t BMP280_Bus_I2COps = {I2C_Read, I2C_Write, I2C_ReadAsync, I2C_WriteAsync};
+const bmp280_bus_ops_t BMP280_Bus_SPIOps = {SPI_Read, SPI_Write, SPI_ReadAsync, SPI_WriteAsync};
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+const bmp280_bus_ops_t BMP280_Bus_FMPI2COps = {FMPI2C_Read, FMPI2C_Write, FMPI2C_ReadAsync, FMPI2C_WriteAsync};
+#endif
+
+/* Transport with a non-blocking transfer in flight, one per HAL handle */
+static bmp280_bus_t *volatile activeBuses[BMP280_BUS_MAX_ACTIVE];
+
+App_StatusTypeDef BMP280_Bus_InitI2C(bmp280_bus_t *bus, I2C_HandleTypeDef *hi2c, uint8_t i2cAddress)
+{
+    if (!bus || !hi2c)
+    {
+        return APP_ERROR;
+    }
+    memset(bus, 0, sizeof(*bus));
+    bus->ops = &BMP280_Bus_I2COps;
+    bus->handle = hi2c;
+    bus->i2cAddress = i2cAddress;
+    bus->busId = (uint32_t)(uintptr_t)hi2c->Instance;
+    bus->devId = i2cAddress;
+    return APP_OK;
+}
+
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+App_StatusTypeDef BMP280_Bus_InitFMPI2C(bmp280_bus_t *bus, FMPI2C_HandleTypeDef *hfmpi2c, uint8_t i2cAddress)
+{
+    if (!bus || !hfmpi2c)
+    {
+        return APP_ERROR;
+    }
+    memset(bus, 0, sizeof(*bus));
+    bus->ops = &BMP280_Bus_FMPI2COps;
+    bus->handle = hfmpi2c;
+    bus->i2cAddress = i2cAddress;
+    bus->busId = (uint32_t)(uintptr_t)hfmpi2c->Instance;
+    bus->devId = i2cAddress;
+    return APP_OK;
+}
+#endif
+
+App_StatusTypeDef BMP280_Bus_InitSPI(bmp280_bus_t *bus, SPI_HandleTypeDef *hspi, GPIO_TypeDef *csPort, uint16_t csPin)
+{
+    if (!bus || !hspi || !csPort)
+    {
+        return APP_ERROR;
+    }
+    memset(bus, 0, sizeof(*bus));
+    bus->ops = &BMP280_Bus_SPIOps;
+    bus->handle = hspi;
+    bus->csPort = csPort;
+    bus->csPin = csPin;
+    bus->busId = (uint32_t)(uintptr_t)hspi->Instance;
+    /* GPIO ports are 1 KB apart, so the port index lands in the upper half */
+    bus->devId = (((uint32_t)(uintptr_t)csPort >> 10) << 16) | csPin;
+    /* The first byte clocked in is the address phase */
+    bus->dataOffset = 1;
+    HAL_GPIO_WritePin(csPort, csPin, GPIO_PIN_SET);
+    return APP_OK;
+}
+
+void BMP280_Bus_SetCallback(bmp280_bus_t *bus, bmp280BusCallback_t callback, void *context)
+{
+    bus->callback = callback;
+    bus->context = context;
+}
+
+uint8_t *BMP280_Bus_GetData(bmp280_bus_t *bus)
+{
+    return &bus->rxBuf[bus->dataOffset];
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    Complete(hi2c, APP_OK);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    Complete(hi2c, APP_OK);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    Complete(hi2c, APP_ERROR);
+}
+
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+void HAL_FMPI2C_MemTxCpltCallback(FMPI2C_HandleTypeDef *hfmpi2c)
+{
+    Complete(hfmpi2c, APP_OK);
+}
+
+void HAL_FMPI2C_MemRxCpltCallback(FMPI2C_HandleTypeDef *hfmpi2c)
+{
+    Complete(hfmpi2c, APP_OK);
+}
+
+void HAL_FMPI2C_ErrorCallback(FMPI2C_HandleTypeDef *hfmpi2c)
+{
+    Complete(hfmpi2c, APP_ERROR);
+}
+#endif
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    Complete(hspi, APP_OK);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+    Complete(hspi, APP_ERROR);
+}
+
+static App_StatusTypeDef I2C_Read(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len)
+{
+    if (HAL_OK != HAL_I2C_Mem_Read(bus->handle, bus->i2cAddress, regAddr, I2C_MEMADD_SIZE_8BIT, buf, len, HAL_MAX_DELAY))
+    {
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+static App_StatusTypeDef I2C_Write(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal)
+{
+    if (HAL_OK != HAL_I2C_Mem_Write(bus->handle, bus->i2cAddress, regAddr, I2C_MEMADD_SIZE_8BIT, &regVal, 1, HAL_MAX_DELAY))
+    {
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+static App_StatusTypeDef I2C_ReadAsync(bmp280_bus_t *bus, uint8_t regAddr, uint16_t len)
+{
+    if (len > BMP280_BUS_MAX_ASYNC_LEN || APP_OK != AddActive(bus))
+    {
+        return APP_ERROR;
+    }
+    if (HAL_OK != HAL_I2C_Mem_Read_IT(bus->handle, bus->i2cAddress, regAddr, I2C_MEMADD_SIZE_8BIT, bus->rxBuf, len))
+    {
+        TakeActive(bus->handle);
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+static App_StatusTypeDef I2C_WriteAsync(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal)
+{
+    if (APP_OK != AddActive(bus))
+    {
+        return APP_ERROR;
+    }
+    bus->txBuf[0] = regVal;
+    if (HAL_OK != HAL_I2C_Mem_Write_IT(bus->handle, bus->i2cAddress, regAddr, I2C_MEMADD_SIZE_8BIT, bus->txBuf, 1))
+    {
+        TakeActive(bus->handle);
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+static App_StatusTypeDef FMPI2C_Read(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len)
+{
+    if (HAL_OK != HAL_FMPI2C_Mem_Read(bus->handle, bus->i2cAddress, regAddr, FMPI2C_MEMADD_SIZE_8BIT, buf, len, HAL_MAX_DELAY))
+    {
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+static App_StatusTypeDef FMPI2C_Write(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal)
+{
+    if (HAL_OK != HAL_FMPI2C_Mem_Write(bus->handle, bus->i2cAddress, regAddr, FMPI2C_MEMADD_SIZE_8BIT, &regVal, 1, HAL_MAX_DELAY))
+    {
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+static App_StatusTypeDef FMPI2C_ReadAsync(bmp280_bus_t *bus, uint8_t regAddr, uint16_t len)
+{
+    if (len > BMP280_BUS_MAX_ASYNC_LEN || APP_OK != AddActive(bus))
+    {
+        return APP_ERROR;
+    }
+    if (HAL_OK != HAL_FMPI2C_Mem_Read_IT(bus->handle, bus->i2cAddress, regAddr, FMPI2C_MEMADD_SIZE_8BIT, bus->rxBuf, len))
+    {
+        TakeActive(bus->handle);
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+static App_StatusTypeDef FMPI2C_WriteAsync(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal)
+{
+    if (APP_OK != AddActive(bus))
+    {
+        return APP_ERROR;
+    }
+    bus->txBuf[0] = regVal;
+    if (HAL_OK != HAL_FMPI2C_Mem_Write_IT(bus->handle, bus->i2cAddress, regAddr, FMPI2C_MEMADD_SIZE_8BIT, bus->txBuf, 1))
+    {
+        TakeActive(bus->handle);
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+#endif
+
+static App_StatusTypeDef SPI_Read(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len)
+{
+    App_StatusTypeDef status = APP_OK;
+    uint8_t addr = regAddr | BMP280_SPI_READ;
+
+    /* The register address auto-increments for as long as chip select is held */
+    HAL_GPIO_WritePin(bus->csPort, bus->csPin, GPIO_PIN_RESET);
+    if (HAL_OK != HAL_SPI_Transmit(bus->handle, &addr, 1, HAL_MAX_DELAY) ||
+        HAL_OK != HAL_SPI_Receive(bus->handle, buf, len, HAL_MAX_DELAY))
+    {
+        status = APP_ERROR;
+    }
+    HAL_GPIO_WritePin(bus->csPort, bus->csPin, GPIO_PIN_SET);
+    return status;
+}
+
+static App_StatusTypeDef SPI_Write(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal)
+{
+    App_StatusTypeDef status = APP_OK;
+    uint8_t buf[2] = {regAddr & BMP280_SPI_WRITE_MASK, regVal};
+
+    HAL_GPIO_WritePin(bus->csPort, bus->csPin, GPIO_PIN_RESET);
+    if (HAL_OK != HAL_SPI_Transmit(bus->handle, buf, sizeof(buf), HAL_MAX_DELAY))
+    {
+        status = APP_ERROR;
+    }
+    HAL_GPIO_WritePin(bus->csPort, bus->csPin, GPIO_PIN_SET);
+    return status;
+}
+
+static App_StatusTypeDef SPI_ReadAsync(bmp280_bus_t *bus, uint8_t regAddr, uint16_t len)
+{
+    if (len > BMP280_BUS_MAX_ASYNC_LEN)
+    {
+        return APP_ERROR;
+    }
+    /* Address byte followed by dummy bytes that clock the data in */
+    memset(bus->txBuf, 0, len + 1);
+    bus->txBuf[0] = regAddr | BMP280_SPI_READ;
+    return SPI_StartDMA(bus, len + 1);
+}
+
+static App_StatusTypeDef SPI_WriteAsync(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal)
+{
+    bus->txBuf[0] = regAddr & BMP280_SPI_WRITE_MASK;
+    bus->txBuf[1] = regVal;
+    return SPI_StartDMA(bus, 2);
+}
+
+/**
+ * @brief Run a full duplex DMA transfer of txBuf into rxBuf with chip select held low
+ * Both directions go through DMA so the completion fires only once every
+ * byte has been clocked, at which point chip select can be released.
+ */
+static App_StatusTypeDef SPI_StartDMA(bmp280_bus_t *bus, uint16_t len)
+{
+    if (APP_OK != AddActive(bus))
+    {
+        return APP_ERROR;
+    }
+    HAL_GPIO_WritePin(bus->csPort, bus->csPin, GPIO_PIN_RESET);
+    if (HAL_OK != HAL_SPI_TransmitReceive_DMA(bus->handle, bus->txBuf, bus->rxBuf, len))
+    {
+        HAL_GPIO_WritePin(bus->csPort, bus->csPin, GPIO_PIN_SET);
+        TakeActive(bus->handle);
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+/**
+ * @brief Record bus as the owner of the transfer on its handle
+ */
+static App_StatusTypeDef AddActive(bmp280_bus_t *bus)
+{
+    App_StatusTypeDef status = APP_ERROR;
+    int8_t freeSlot = -1;
+
+    /* Transfers are started from both thread and interrupt context */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t i = 0; i < BMP280_BUS_MAX_ACTIVE; i++)
+    {
+        if (!activeBuses[i])
+        {
+            if (freeSlot < 0)
+            {
+                freeSlot = i;
+            }
+        }
+        else if (activeBuses[i]->handle == bus->handle)
+        {
+            /* A transfer is already in flight on this handle */
+            freeSlot = -1;
+            break;
+        }
+    }
+    if (freeSlot >= 0)
+    {
+        activeBuses[freeSlot] = bus;
+        status = APP_OK;
+    }
+    __set_PRIMASK(primask);
+    return status;
+}
+
+/**
+ * @brief Find and release the owner of the transfer on a handle
+ * @return bmp280_bus_t* NULL if the transfer was not started from here
+ */
+static bmp280_bus_t *TakeActive(void *handle)
+{
+    for (uint8_t i = 0; i < BMP280_BUS_MAX_ACTIVE; i++)
+    {
+        bmp280_bus_t *bus = activeBuses[i];
+        if (bus && bus->handle == handle)
+        {
+            activeBuses[i] = NULL;
+            return bus;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finish the transfer on a handle and report it to its owner
+ */
+static void Complete(void *handle, App_StatusTypeDef status)
+{
+    bmp280_bus_t *bus = TakeActive(handle);
+    if (!bus)
+    {
+        return;
+    }
+    if (bus->csPort)
+    {
+        HAL_GPIO_WritePin(bus->csPort, bus->csPin, GPIO_PIN_SET);
+    }
+    /* The callback may start the next transfer on the same handle */
+    if (bus->callback)
+    {
+        bus->callback(bus->context, status);
+    }
+}
@@ -0,0 +1,134 @@
+/**
+ * @file bmp280_cache.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the BMP280 calibration cache in backup SRAM
+ * @date 2022-12-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stddef.h>
+#include <string.h>
+#include "bmp280_cache.h"
+
+/**
+ * @brief Cached calibration of one sensor
+ */
+typedef struct
+{
+    uint32_t busId;                         /* Bus the sensor is on */
+    uint32_t devId;                         /* Sensor on its bus */
+    uint8_t chipId;                         /* Chip ID read on the cold boot */
+    uint8_t calib[BMP280_CALIB_DATA_LEN];   /* Raw calibration burst */
+    uint8_t reserved[3];
+    uint32_t crc;                           /* CRC-32 of everything above */
+}bmp280CacheEntry_t;
+
+/**
+ * @brief Layout at the start of the backup SRAM
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    bmp280CacheEntry_t entries[BMP280_CACHE_ENTRIES];
+}bmp280CacheLayout_t;
+
+_Static_assert(sizeof(bmp280CacheLayout_t) <= BKPSRAM_BMP280_CACHE_SIZE, "Cache exceeds its backup SRAM area");
+
+static bmp280CacheLayout_t *const cache = (bmp280CacheLayout_t *)(BKPSRAM_BASE + BKPSRAM_BMP280_CACHE_OFFSET);
+static uint8_t isCacheEnabled;
+
+static void Cache_Enable(void);
+static uint32_t Cache_EntryCrc(const bmp280CacheEntry_t *entry);
+
+App_StatusTypeDef BMP280_Cache_Load(uint32_t busId, uint32_t devId, uint8_t *calib)
+{
+    Cache_Enable();
+    for (uint8_t i = 0; i < BMP280_CACHE_ENTRIES; i++)
+    {
+        const bmp280CacheEntry_t *entry = &cache->entries[i];
+        if (entry->busId == busId && entry->devId == devId &&
+            entry->chipId == BMP280_CHIPID && entry->crc == Cache_EntryCrc(entry))
+        {
+            memcpy(calib, entry->calib, BMP280_CALIB_DATA_LEN);
+            return APP_OK;
+        }
+    }
+    return APP_ERROR;
+}
+
+App_StatusTypeDef BMP280_Cache_Store(uint32_t busId, uint32_t devId, uint8_t chipId, const uint8_t *calib)
+{
+    Cache_Enable();
+    /* Reuse the entry of the sensor, else the first one that does not hold a valid entry */
+    bmp280CacheEntry_t *slot = NULL;
+    for (uint8_t i = 0; i < BMP280_CACHE_ENTRIES; i++)
+    {
+        bmp280CacheEntry_t *entry = &cache->entries[i];
+        if (entry->busId == busId && entry->devId == devId)
+        {
+            slot = entry;
+            break;
+        }
+        if (!slot && entry->crc != Cache_EntryCrc(entry))
+        {
+            slot = entry;
+        }
+    }
+    if (!slot)
+    {
+        return APP_ERROR;
+    }
+
+    bmp280CacheEntry_t entry = {0};
+    entry.busId = busId;
+    entry.devId = devId;
+    entry.chipId = chipId;
+    memcpy(entry.calib, calib, BMP280_CALIB_DATA_LEN);
+    entry.crc = Cache_EntryCrc(&entry);
+    *slot = entry;
+    return APP_OK;
+}
+
+/**
+ * @brief Turn on the backup SRAM and wipe it if it holds another layout
+ */
+static void Cache_Enable(void)
+{
+    if (isCacheEnabled)
+    {
+        return;
+    }
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPSRAM_CLK_ENABLE();
+
+    /* Random after power-up. Clearing makes every entry fail its CRC check */
+    if (cache->magic != BMP280_CACHE_MAGIC || cache->version != BMP280_CACHE_VERSION)
+    {
+        memset(cache, 0, sizeof(*cache));
+        cache->magic = BMP280_CACHE_MAGIC;
+        cache->version = BMP280_CACHE_VERSION;
+    }
+    isCacheEnabled = TRUE;
+}
+
+/**
+ * @brief Bitwise CRC-32 (IEEE 802.3), an entry is only a few dozen bytes
+ * A zeroed entry never matches since its CRC is not 0.
+ */
+static uint32_t Cache_EntryCrc(const bmp280CacheEntry_t *entry)
+{
+    const uint8_t *data = (const uint8_t *)entry;
+    uint32_t crc = 0xFFFFFFFFU;
+    for (uint32_t i = 0; i < offsetof(bmp280CacheEntry_t, crc); i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1U));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file content.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the display content pushed by the ESP32
+ * @date 2023-01-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "content.h"
+
+_Static_assert(LCD_COLUMNS <= 32, "A row of cells must fit the masks");
+
+/* HAL tick at which each timed cell is released */
+static uint32_t cellExpiry[LCD_ROWS][LCD_COLUMNS];
+static uint32_t timedCells[LCD_ROWS];
+
+void Content_Apply(const struct timesync_content *content)
+{
+	if (content->row >= LCD_ROWS || content->column >= LCD_COLUMNS)
+	{
+		return;
+	}
+	uint8_t length = content->length;
+	if (length > LCD_COLUMNS - content->column)
+	{
+		length = LCD_COLUMNS - content->column;
+	}
+	uint32_t expiry = HAL_GetTick() + (uint32_t)content->ttl_s * 1000U;
+
+	/* The frame counts from 0, the panel from 1 */
+	LCD_WriteHeld(content->row + 1, content->column + 1, content->text, length);
+	for (uint8_t i = content->column; i < content->column + length; i++)
+	{
+		if (content->ttl_s)
+		{
+			cellExpiry[content->row][i] = expiry;
+			timedCells[content->row] |= (1UL << i);
+		}
+		else
+		{
+			timedCells[content->row] &= ~(1UL << i);
+		}
+	}
+}
+
+uint8_t Content_Expire(void)
+{
+	uint32_t now = HAL_GetTick();
+	uint8_t isReleased = FALSE;
+
+	for (uint8_t row = 0; row < LCD_ROWS; row++)
+	{
+		for (uint8_t column = 0; timedCells[row] && column < LCD_COLUMNS; column++)
+		{
+			/* Wrap safe, TTLs are far shorter than half the tick range */
+			if ((timedCells[row] & (1UL << column)) && (int32_t)(now - cellExpiry[row][column]) >= 0)
+			{
+				timedCells[row] &= ~(1UL << column);
+				LCD_Release(row + 1, column + 1, 1);
+				isReleased = TRUE;
+			}
+		}
+	}
+	return isReleased;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file decimator.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the fixed-point FIR decimation filter
+ * @date 2022-11-20
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "decimator.h"
+
+const int16_t Decimator_DefaultCoeffs[DECIMATOR_DEFAULT_TAPS] = {
+       6,   23,   51,  104,  189,  313,  482,  692,
+     940, 1213, 1497, 1774, 2026, 2234, 2382, 2458,
+    2458, 2382, 2234, 2026, 1774, 1497, 1213,  940,
+     692,  482,  313,  189,  104,   51,   23,    6,
+};
+
+static int32_t Decimator_DotProduct(const int16_t *samples, const int16_t *coeffs, uint16_t numTaps);
+
+App_StatusTypeDef Decimator_Init(decimator_t *decimator, const int16_t *coeffs, uint16_t numTaps, uint16_t factor)
+{
+    if (!decimator || !coeffs || factor == 0)
+    {
+        return APP_ERROR;
+    }
+    /* Taps are consumed in pairs by the dual 16-bit MAC */
+    if (numTaps == 0 || numTaps > DECIMATOR_MAX_TAPS || (numTaps & 1U))
+    {
+        return APP_ERROR;
+    }
+    memset(decimator, 0, sizeof(*decimator));
+    decimator->coeffs = coeffs;
+    decimator->numTaps = numTaps;
+    decimator->factor = factor;
+    return APP_OK;
+}
+
+uint8_t Decimator_Push(decimator_t *decimator, int16_t sample, int16_t *output)
+{
+    /* Overwrite the oldest sample in both copies of the history */
+    decimator->history[decimator->head] = sample;
+    decimator->history[decimator->head + decimator->numTaps] = sample;
+    decimator->head++;
+    if (decimator->head == decimator->numTaps)
+    {
+        decimator->head = 0;
+    }
+
+    decimator->phase++;
+    if (decimator->phase < decimator->factor)
+    {
+        return FALSE;
+    }
+    decimator->phase = 0;
+
+    /* history[head] is now the oldest sample, the window runs oldest to newest */
+    int32_t acc = Decimator_DotProduct(&decimator->history[decimator->head], decimator->coeffs, decimator->numTaps);
+    acc = (acc + (1 << (DECIMATOR_COEFF_SHIFT - 1))) >> DECIMATOR_COEFF_SHIFT;
+    if (acc > INT16_MAX)
+    {
+        acc = INT16_MAX;
+    }
+    else if (acc < INT16_MIN)
+    {
+        acc = INT16_MIN;
+    }
+    *output = (int16_t)acc;
+    return TRUE;
+}
+
+/**
+ * @brief Multiply-accumulate numTaps samples with the taps
+ * Uses the Cortex-M4 dual 16-bit MAC when available. The plain C loop is
+ * the reference implementation and gives bit-identical results, since no
+ * intermediate can overflow for Q15 taps that sum to 1.0.
+ */
+static int32_t Decimator_DotProduct(const int16_t *samples, const int16_t *coeffs, uint16_t numTaps)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    uint32_t acc = 0;
+    uint32_t samplePair;
+    uint32_t coeffPair;
+    for (uint16_t i = 0; i < numTaps; i += 2)
+    {
+        /* The window start is only halfword aligned */
+        memcpy(&samplePair, &samples[i], sizeof(samplePair));
+        memcpy(&coeffPair, &coeffs[i], sizeof(coeffPair));
+        acc = __SMLAD(samplePair, coeffPair, acc);
+    }
+    return (int32_t)acc;
+#else
+    int32_t acc = 0;
+    for (uint16_t i = 0; i < numTaps; i++)
+    {
+        acc += (int32_t)samples[i] * coeffs[i];
+    }
+    return acc;
+#endif
+}
@@ -0,0 +1,513 @@
+/**
+ * @file flashlog.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the flash data logger
+ * @date 2022-12-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * The log is append only. Each sector starts with a header carrying an
+ * erase sequence number, the sector with the highest one is being written.
+ * Records are compressed into a page staged in backup SRAM, which is
+ * programmed into the next erased page slot when full. Once a sector is
+ * full the one with the lowest sequence is erased and reopened, so erases
+ * rotate evenly over the sectors.
+ *
+ * Flash bits only go from 1 to 0, which makes every step detectable after
+ * a reset: the header fields are programmed first so a used slot never
+ * reads as erased, and a commit word is programmed last so a torn page
+ * or sector header is never taken as valid.
+ */
+#include <string.h>
+#include <stddef.h>
+#include "flashlog.h"
+
+#define FLASHLOG_MAGIC              (0x474F4C46U)   /* "FLOG" */
+#define FLASHLOG_COMMIT             (0x54494D43U)   /* "CMIT" */
+#define FLASHLOG_ERASED             (0xFFFFFFFFU)
+#define FLASHLOG_PROGRAM_ATTEMPTS   (2)             /* Page slots tried before giving up on a write */
+
+/**
+ * @brief Start of each sector, in the slot of page 0
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;      /* Increases by one for every sector opened */
+    uint32_t eraseCount;    /* Wear of this sector */
+    uint32_t commit;        /* Programmed last */
+}flashLogSectorHeader_t;
+
+typedef struct
+{
+    uint32_t firstTime;     /* Programmed first, marks the slot as used */
+    uint32_t lastTime;
+    uint16_t count;         /* Records in the payload */
+    uint16_t length;        /* Payload bytes, a tscodec block */
+    uint32_t crc;           /* CRC-32 of the fields above and the payload */
+    uint32_t commit;        /* Programmed last */
+}flashLogPageHeader_t;
+
+typedef struct
+{
+    flashLogPageHeader_t header;
+    uint8_t payload[FLASHLOG_PAGE_SIZE - sizeof(flashLogPageHeader_t)];
+}flashLogPage_t;
+
+_Static_assert(sizeof(flashLogPage_t) == FLASHLOG_PAGE_SIZE, "Page must fill its slot");
+_Static_assert(sizeof(flashLogSectorHeader_t) <= FLASHLOG_PAGE_SIZE, "Sector header must fit in page 0");
+_Static_assert(BKPSRAM_FLASHLOG_OFFSET + sizeof(flashLogPage_t) <= 0x1000U, "Staged page must fit in the 4 KB backup SRAM");
+
+typedef struct
+{
+    uint32_t sequence;      /* 0 if the sector has no committed header */
+    uint32_t eraseCount;
+    uint16_t usedPages;     /* Slots after the header that are not erased, committed or torn */
+}flashLogSector_t;
+
+static struct
+{
+    flashLogSector_t sectors[FLASHLOG_SECTORS];
+    uint8_t active;
+    uint8_t isReady;
+    uint32_t lastTime;      /* Timestamp of the newest record */
+    tsEncoder_t encoder;    /* Writes the payload of the staged page */
+    flashLogStats_t stats;
+}flashLog;
+
+/* Records not yet in flash. Kept in backup SRAM so a reset does not lose them */
+static flashLogPage_t *const stagedPage = (flashLogPage_t *)(BKPSRAM_BASE + BKPSRAM_FLASHLOG_OFFSET);
+
+static App_StatusTypeDef FlashLog_OpenSector(uint8_t sector, uint32_t sequence);
+static App_StatusTypeDef FlashLog_ProgramPage(uint32_t address);
+static App_StatusTypeDef FlashLog_ProgramWord(uint32_t address, uint32_t word);
+static void FlashLog_ResetDataCache(void);
+static uint16_t FlashLog_CountUsedPages(uint8_t sector);
+static uint16_t FlashLog_QuerySector(uint8_t sector, uint32_t fromTime, uint32_t toTime, flashLogRecord_t *records, uint16_t found, uint16_t maxRecords);
+static uint16_t FlashLog_CollectPage(const flashLogPage_t *page, uint32_t fromTime, uint32_t toTime, flashLogRecord_t *records, uint16_t found, uint16_t maxRecords);
+static uint8_t FlashLog_IsPageValid(const flashLogPage_t *page);
+static uint32_t FlashLog_PageCrc(const flashLogPage_t *page);
+
+static inline uint32_t FlashLog_PageAddress(uint8_t sector, uint16_t page)
+{
+    return FLASHLOG_BASE + (sector * FLASHLOG_SECTOR_SIZE) + (page * FLASHLOG_PAGE_SIZE);
+}
+
+static inline const flashLogSectorHeader_t *FlashLog_SectorHeader(uint8_t sector)
+{
+    return (const flashLogSectorHeader_t *)(uintptr_t)FlashLog_PageAddress(sector, 0);
+}
+
+static inline const flashLogPage_t *FlashLog_Page(uint8_t sector, uint16_t page)
+{
+    return (const flashLogPage_t *)(uintptr_t)FlashLog_PageAddress(sector, page);
+}
+
+App_StatusTypeDef FlashLog_Init()
+{
+    memset(&flashLog, 0, sizeof(flashLog));
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPSRAM_CLK_ENABLE();
+
+    /* The sector table is the index of the log: sequence order and fill level */
+    uint32_t newestSequence = 0;
+    for (uint8_t i = 0; i < FLASHLOG_SECTORS; i++)
+    {
+        const flashLogSectorHeader_t *header = FlashLog_SectorHeader(i);
+        if (header->magic != FLASHLOG_MAGIC || header->commit != FLASHLOG_COMMIT)
+        {
+            continue;
+        }
+        flashLog.sectors[i].sequence = header->sequence;
+        flashLog.sectors[i].eraseCount = header->eraseCount;
+        flashLog.sectors[i].usedPages = FlashLog_CountUsedPages(i);
+        if (header->sequence > newestSequence)
+        {
+            newestSequence = header->sequence;
+            flashLog.active = i;
+        }
+
+        /* Newest committed record, skipping torn pages at the end */
+        for (uint16_t page = flashLog.sectors[i].usedPages; page > 0; page--)
+        {
+            const flashLogPage_t *p = FlashLog_Page(i, page);
+            if (FlashLog_IsPageValid(p))
+            {
+                if (p->header.lastTime > flashLog.lastTime)
+                {
+                    flashLog.lastTime = p->header.lastTime;
+                }
+                break;
+            }
+        }
+    }
+
+    if (!newestSequence && APP_OK != FlashLog_OpenSector(0, 1))
+    {
+        return APP_ERROR;
+    }
+
+    /* Resume a page staged before the reset, unless it was programmed or is random power-up contents */
+    flashLogPageHeader_t *header = &stagedPage->header;
+    if (header->count && header->length <= sizeof(stagedPage->payload) &&
+        header->crc == FlashLog_PageCrc(stagedPage) && header->firstTime > flashLog.lastTime &&
+        APP_OK == TsCodec_ResumeEncoder(&flashLog.encoder, stagedPage->payload, sizeof(stagedPage->payload), header->length, header->count))
+    {
+        flashLog.lastTime = header->lastTime;
+    }
+    else
+    {
+        memset(header, 0, sizeof(*header));
+        TsCodec_InitEncoder(&flashLog.encoder, stagedPage->payload, sizeof(stagedPage->payload));
+    }
+    flashLog.isReady = TRUE;
+    return APP_OK;
+}
+
+App_StatusTypeDef FlashLog_Append(uint32_t timestamp, int16_t temperature, uint32_t pressure)
+{
+    /* Pages are searched by time, so records must arrive in order */
+    if (!flashLog.isReady || timestamp <= flashLog.lastTime || timestamp == FLASHLOG_ERASED)
+    {
+        return APP_ERROR;
+    }
+    pressure = ((pressure + (FLASHLOG_PRESSURE_STEP_PA / 2)) / FLASHLOG_PRESSURE_STEP_PA) * FLASHLOG_PRESSURE_STEP_PA;
+    flashLogRecord_t record = {.timestamp = timestamp, .temperature = temperature, .pressure = pressure};
+    if (APP_OK != TsCodec_Encode(&flashLog.encoder, &record))
+    {
+        /* Page full */
+        if (APP_OK != FlashLog_Flush() || APP_OK != TsCodec_Encode(&flashLog.encoder, &record))
+        {
+            return APP_ERROR;
+        }
+    }
+
+    flashLogPageHeader_t *header = &stagedPage->header;
+    if (!header->count)
+    {
+        header->firstTime = timestamp;
+    }
+    header->lastTime = timestamp;
+    header->count++;
+    header->length = TsCodec_GetLength(&flashLog.encoder);
+    header->crc = FlashLog_PageCrc(stagedPage);
+
+    flashLog.lastTime = timestamp;
+    flashLog.stats.recordsLogged++;
+    flashLog.stats.bytesLogged += sizeof(record);
+    return APP_OK;
+}
+
+App_StatusTypeDef FlashLog_Flush()
+{
+    if (!flashLog.isReady)
+    {
+        return APP_ERROR;
+    }
+    if (!stagedPage->header.count)
+    {
+        return APP_OK;
+    }
+    stagedPage->header.commit = FLASHLOG_COMMIT;
+
+    for (uint8_t attempt = 0; attempt < FLASHLOG_PROGRAM_ATTEMPTS; attempt++)
+    {
+        if (flashLog.sectors[flashLog.active].usedPages == FLASHLOG_PAGES_PER_SECTOR - 1)
+        {
+            /* Reuse the oldest sector. One without a committed header has sequence 0 */
+            uint8_t oldest = 0;
+            for (uint8_t i = 1; i < FLASHLOG_SECTORS; i++)
+            {
+                if (flashLog.sectors[i].sequence < flashLog.sectors[oldest].sequence)
+                {
+                    oldest = i;
+                }
+            }
+            if (APP_OK != FlashLog_OpenSector(oldest, flashLog.sectors[flashLog.active].sequence + 1))
+            {
+                return APP_ERROR;
+            }
+        }
+
+        /* A slot is used up even if programming fails, it can not be rewritten */
+        flashLogSector_t *sector = &flashLog.sectors[flashLog.active];
+        uint32_t address = FlashLog_PageAddress(flashLog.active, sector->usedPages + 1);
+        sector->usedPages++;
+        if (APP_OK == FlashLog_ProgramPage(address))
+        {
+            memset(&stagedPage->header, 0, sizeof(stagedPage->header));
+            TsCodec_InitEncoder(&flashLog.encoder, stagedPage->payload, sizeof(stagedPage->payload));
+            return APP_OK;
+        }
+        flashLog.stats.pagesLost++;
+    }
+    return APP_ERROR;
+}
+
+uint16_t FlashLog_Query(uint32_t fromTime, uint32_t toTime, flashLogRecord_t *records, uint16_t maxRecords)
+{
+    if (!flashLog.isReady || !records || fromTime > toTime)
+    {
+        return 0;
+    }
+
+    /* Visit the sectors oldest first */
+    uint16_t found = 0;
+    uint32_t prevSequence = 0;
+    while (found < maxRecords)
+    {
+        int8_t next = -1;
+        for (uint8_t i = 0; i < FLASHLOG_SECTORS; i++)
+        {
+            uint32_t sequence = flashLog.sectors[i].sequence;
+            if (sequence > prevSequence && (next < 0 || sequence < flashLog.sectors[next].sequence))
+            {
+                next = i;
+            }
+        }
+        if (next < 0)
+        {
+            break;
+        }
+        prevSequence = flashLog.sectors[next].sequence;
+        found = FlashLog_QuerySector(next, fromTime, toTime, records, found, maxRecords);
+    }
+
+    if (stagedPage->header.count)
+    {
+        found = FlashLog_CollectPage(stagedPage, fromTime, toTime, records, found, maxRecords);
+    }
+    return found;
+}
+
+void FlashLog_GetStats(flashLogStats_t *stats)
+{
+    if (stats)
+    {
+        *stats = flashLog.stats;
+    }
+}
+
+/**
+ * @brief Erase a sector and commit its header
+ * Stalls the CPU for the sector erase time, 1 to 2 s for 128 KB.
+ */
+static App_StatusTypeDef FlashLog_OpenSector(uint8_t sector, uint32_t sequence)
+{
+    uint32_t eraseCount = flashLog.sectors[sector].eraseCount + 1;
+    flashLog.sectors[sector] = (flashLogSector_t){0};
+
+    FLASH_EraseInitTypeDef erase = {0};
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = FLASHLOG_FIRST_SECTOR + sector;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+    uint32_t sectorError;
+    uint32_t address = FlashLog_PageAddress(sector, 0);
+
+    HAL_FLASH_Unlock();
+    /* An erase cut short can leave the header and some pages readable, so the
+       sector is dropped from the log before it is erased */
+    App_StatusTypeDef status = APP_OK;
+    if (FlashLog_SectorHeader(sector)->commit == FLASHLOG_COMMIT)
+    {
+        status = FlashLog_ProgramWord(address + offsetof(flashLogSectorHeader_t, commit), 0);
+    }
+    if (APP_OK == status)
+    {
+        status = (HAL_OK == HAL_FLASHEx_Erase(&erase, &sectorError)) ? APP_OK : APP_ERROR;
+    }
+    if (APP_OK == status)
+    {
+        flashLog.stats.erases++;
+        status = FlashLog_ProgramWord(address + offsetof(flashLogSectorHeader_t, magic), FLASHLOG_MAGIC);
+    }
+    if (APP_OK == status)
+    {
+        status = FlashLog_ProgramWord(address + offsetof(flashLogSectorHeader_t, sequence), sequence);
+    }
+    if (APP_OK == status)
+    {
+        status = FlashLog_ProgramWord(address + offsetof(flashLogSectorHeader_t, eraseCount), eraseCount);
+    }
+    if (APP_OK == status)
+    {
+        status = FlashLog_ProgramWord(address + offsetof(flashLogSectorHeader_t, commit), FLASHLOG_COMMIT);
+    }
+    HAL_FLASH_Lock();
+    FlashLog_ResetDataCache();
+
+    const flashLogSectorHeader_t *header = FlashLog_SectorHeader(sector);
+    if (APP_OK != status || header->sequence != sequence || header->commit != FLASHLOG_COMMIT)
+    {
+        return APP_ERROR;
+    }
+    flashLog.sectors[sector].sequence = sequence;
+    flashLog.sectors[sector].eraseCount = eraseCount;
+    flashLog.active = sector;
+    return APP_OK;
+}
+
+/**
+ * @brief Program the RAM page into an erased slot and read it back
+ */
+static App_StatusTypeDef FlashLog_ProgramPage(uint32_t address)
+{
+    const uint32_t *words = (const uint32_t *)stagedPage;
+    uint32_t wordCount = (sizeof(flashLogPageHeader_t) + stagedPage->header.length + 3) / 4;
+    uint32_t commitWord = offsetof(flashLogPageHeader_t, commit) / 4;
+
+    HAL_FLASH_Unlock();
+    App_StatusTypeDef status = APP_OK;
+    for (uint32_t i = 0; i < wordCount && APP_OK == status; i++)
+    {
+        if (i != commitWord)
+        {
+            status = FlashLog_ProgramWord(address + (i * 4), words[i]);
+        }
+    }
+    if (APP_OK == status)
+    {
+        status = FlashLog_ProgramWord(address + (commitWord * 4), words[commitWord]);
+    }
+    HAL_FLASH_Lock();
+    FlashLog_ResetDataCache();
+
+    if (APP_OK != status || memcmp((const void *)(uintptr_t)address, words, wordCount * 4))
+    {
+        return APP_ERROR;
+    }
+    return APP_OK;
+}
+
+static App_StatusTypeDef FlashLog_ProgramWord(uint32_t address, uint32_t word)
+{
+    if (HAL_OK != HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address, word))
+    {
+        return APP_ERROR;
+    }
+    flashLog.stats.bytesProgrammed += sizeof(word);
+    return APP_OK;
+}
+
+/**
+ * @brief Drop data cache lines of the log read before it was programmed
+ * HAL_FLASHEx_Erase() does this itself, HAL_FLASH_Program() does not.
+ */
+static void FlashLog_ResetDataCache()
+{
+    if (READ_BIT(FLASH->ACR, FLASH_ACR_DCEN))
+    {
+        __HAL_FLASH_DATA_CACHE_DISABLE();
+        __HAL_FLASH_DATA_CACHE_RESET();
+        __HAL_FLASH_DATA_CACHE_ENABLE();
+    }
+}
+
+/**
+ * @brief Slots are used in order, so the used ones are found by a binary
+ * search for the first erased slot
+ */
+static uint16_t FlashLog_CountUsedPages(uint8_t sector)
+{
+    uint16_t lo = 1;
+    uint16_t hi = FLASHLOG_PAGES_PER_SECTOR;
+    while (lo < hi)
+    {
+        uint16_t mid = lo + ((hi - lo) / 2);
+        if (FlashLog_Page(sector, mid)->header.firstTime == FLASHLOG_ERASED)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    return lo - 1;
+}
+
+static uint16_t FlashLog_QuerySector(uint8_t sector, uint32_t fromTime, uint32_t toTime, flashLogRecord_t *records, uint16_t found, uint16_t maxRecords)
+{
+    /* Pages are in time order. Start at the last one beginning at or before fromTime */
+    uint16_t usedPages = flashLog.sectors[sector].usedPages;
+    uint16_t lo = 1;
+    uint16_t hi = usedPages + 1;
+    while (lo < hi)
+    {
+        uint16_t mid = lo + ((hi - lo) / 2);
+        if (FlashLog_Page(sector, mid)->header.firstTime > fromTime)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+
+    for (uint16_t page = (lo > 1) ? lo - 1 : 1; page <= usedPages && found < maxRecords; page++)
+    {
+        const flashLogPage_t *p = FlashLog_Page(sector, page);
+        if (!FlashLog_IsPageValid(p))
+        {
+            continue;
+        }
+        if (p->header.firstTime > toTime)
+        {
+            break;
+        }
+        found = FlashLog_CollectPage(p, fromTime, toTime, records, found, maxRecords);
+    }
+    return found;
+}
+
+static uint16_t FlashLog_CollectPage(const flashLogPage_t *page, uint32_t fromTime, uint32_t toTime, flashLogRecord_t *records, uint16_t found, uint16_t maxRecords)
+{
+    if (page->header.lastTime < fromTime)
+    {
+        return found;
+    }
+    tsDecoder_t dec;
+    flashLogRecord_t record;
+    TsCodec_InitDecoder(&dec, page->payload, page->header.length, page->header.count);
+    while (found < maxRecords && APP_OK == TsCodec_Decode(&dec, &record))
+    {
+        if (record.timestamp > toTime)
+        {
+            break;
+        }
+        if (record.timestamp >= fromTime)
+        {
+            records[found++] = record;
+        }
+    }
+    return found;
+}
+
+static uint8_t FlashLog_IsPageValid(const flashLogPage_t *page)
+{
+    return page->header.commit == FLASHLOG_COMMIT &&
+           page->header.length <= sizeof(page->payload) &&
+           page->header.crc == FlashLog_PageCrc(page);
+}
+
+/**
+ * @brief Bitwise CRC-32 (IEEE 802.3) of the header fields before the CRC and the payload
+ */
+static uint32_t FlashLog_PageCrc(const flashLogPage_t *page)
+{
+    const uint8_t *header = (const uint8_t *)&page->header;
+    uint32_t headerLen = offsetof(flashLogPageHeader_t, crc);
+    uint32_t crc = 0xFFFFFFFFU;
+    for (uint32_t i = 0; i < headerLen + page->header.length; i++)
+    {
+        crc ^= (i < headerLen) ? header[i] : page->payload[i - headerLen];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1U));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file fmpi2c.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the FMPI2C interface
+ * @date 2022-12-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include "fmpi2c.h"
+
+/**
+ * @brief I2C specification limits of a speed mode
+ */
+typedef struct
+{
+	uint32_t maxBusHz;
+	uint32_t lowMinNs;		/* tLOW */
+	uint32_t highMinNs;		/* tHIGH */
+	uint32_t dataSetupMinNs;	/* tSU;DAT */
+}fmpi2cModeTiming_t;
+
+static const fmpi2cModeTiming_t modeTimings[] =
+{
+	{100000, 4700, 4000, 250},	/* Standard-mode */
+	{400000, 1300, 600, 100},	/* Fast-mode */
+	{1000000, 500, 260, 50},	/* Fast-mode Plus */
+};
+
+/**
+ * @brief Local helper for a rounded up division of a possibly negative numerator
+ *
+ * @return uint32_t 0 if num is not positive
+ */
+static uint32_t FMPI2C_DivCeil(int32_t num, uint32_t den);
+
+App_StatusTypeDef FMPI2C_Init(FMPI2C_HandleTypeDef *hfmpi2c, uint32_t busHz)
+{
+	uint32_t timing = FMPI2C_ComputeTiming(HAL_RCC_GetSysClockFreq(), busHz);
+	if (!timing)
+	{
+		return APP_ERROR;
+	}
+
+	hfmpi2c->Instance = FMPI2C1;
+	hfmpi2c->Init.Timing = timing;
+	hfmpi2c->Init.OwnAddress1 = 0;
+	hfmpi2c->Init.AddressingMode = FMPI2C_ADDRESSINGMODE_7BIT;
+	hfmpi2c->Init.DualAddressMode = FMPI2C_DUALADDRESS_DISABLE;
+	hfmpi2c->Init.OwnAddress2 = 0;
+	hfmpi2c->Init.OwnAddress2Masks = FMPI2C_OA2_NOMASK;
+	hfmpi2c->Init.GeneralCallMode = FMPI2C_GENERALCALL_DISABLE;
+	hfmpi2c->Init.NoStretchMode = FMPI2C_NOSTRETCH_DISABLE;
+	if (HAL_OK != HAL_FMPI2C_Init(hfmpi2c))
+	{
+		return APP_ERROR;
+	}
+	/* The timing assumes the analog filter delay */
+	if (HAL_OK != HAL_FMPI2CEx_ConfigAnalogFilter(hfmpi2c, FMPI2C_ANALOGFILTER_ENABLE))
+	{
+		return APP_ERROR;
+	}
+	if (busHz > modeTimings[1].maxBusHz)
+	{
+		HAL_FMPI2CEx_EnableFastModePlus(FMPI2C_FASTMODEPLUS_SCL | FMPI2C_FASTMODEPLUS_SDA);
+	}
+	return APP_OK;
+}
+
+uint32_t FMPI2C_ComputeTiming(uint32_t kernelClockHz, uint32_t busHz)
+{
+	const uint8_t modeCount = sizeof(modeTimings) / sizeof(modeTimings[0]);
+	if (!kernelClockHz || busHz < 1000 || busHz > modeTimings[modeCount - 1].maxBusHz)
+	{
+		return 0;
+	}
+	const fmpi2cModeTiming_t *mode = &modeTimings[0];
+	while (busHz > mode->maxBusHz)
+	{
+		mode++;
+	}
+
+	/* Work in picoseconds to keep the HSI period (62.5 ns) exact */
+	uint32_t clockPs = 1000000000U / (kernelClockHz / 1000U);
+	uint32_t periodPs = 1000000000U / (busHz / 1000U);
+
+	/* Each SCL phase is stretched by its edge and by the input synchronization,
+	 * the analog filter plus 3 kernel clocks (RM0390 FMPI2C master clock generation) */
+	int32_t syncLowPs = (int32_t)((FMPI2C_FALL_TIME_NS + FMPI2C_FILTER_DELAY_NS) * 1000U + 3U * clockPs);
+	int32_t syncHighPs = (int32_t)((FMPI2C_RISE_TIME_NS + FMPI2C_FILTER_DELAY_NS) * 1000U + 3U * clockPs);
+
+	for (uint32_t presc = 0; presc < 16; presc++)
+	{
+		uint32_t prescPs = (presc + 1) * clockPs;
+
+		/* Counts that meet the minimum low and high times, at least one each */
+		uint32_t sclLow = FMPI2C_DivCeil((int32_t)(mode->lowMinNs * 1000U) - syncLowPs, prescPs);
+		uint32_t sclHigh = FMPI2C_DivCeil((int32_t)(mode->highMinNs * 1000U) - syncHighPs, prescPs);
+		sclLow = sclLow ? sclLow : 1;
+		sclHigh = sclHigh ? sclHigh : 1;
+
+		/* Stretch both phases to bring the period down to the requested speed */
+		uint32_t sclCount = FMPI2C_DivCeil((int32_t)periodPs - syncLowPs - syncHighPs, prescPs);
+		if (sclCount > sclLow + sclHigh)
+		{
+			uint32_t extra = sclCount - sclLow - sclHigh;
+			sclLow += (extra + 1) / 2;
+			sclHigh += extra / 2;
+		}
+
+		/* Data setup covers the rise of SDA, data hold covers the fall of SCL */
+		uint32_t sclDel = FMPI2C_DivCeil((int32_t)((FMPI2C_RISE_TIME_NS + mode->dataSetupMinNs) * 1000U), prescPs);
+		uint32_t sdaDel = FMPI2C_DivCeil((int32_t)(FMPI2C_FALL_TIME_NS * 1000U) -
+										 (int32_t)(FMPI2C_FILTER_DELAY_NS * 1000U + 3U * clockPs), prescPs);
+		sclDel = sclDel ? sclDel : 1;
+
+		if (sclLow > 256 || sclHigh > 256 || sclDel > 16 || sdaDel > 15)
+		{
+			continue;
+		}
+		return (presc << 28) | ((sclDel - 1) << 20) | (sdaDel << 16) | ((sclHigh - 1) << 8) | (sclLow - 1);
+	}
+	return 0;
+}
+
+static uint32_t FMPI2C_DivCeil(int32_t num, uint32_t den)
+{
+	if (num <= 0)
+	{
+		return 0;
+	}
+	return ((uint32_t)num + den - 1) / den;
+}
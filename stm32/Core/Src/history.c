@@ -0,0 +1,382 @@
+/**
+ * @file history.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the temperature history
+ * @date 2022-12-24
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "history.h"
+
+/* The oldest window sample must still be in the ring when it leaves the window */
+_Static_assert(HISTORY_WINDOW_MINUTES < HISTORY_MINUTES, "Window must be shorter than the minute ring");
+/* Window stamps are kept by ring index modulo the window, also across the ring wrap */
+_Static_assert(!(HISTORY_MINUTES % HISTORY_WINDOW_MINUTES), "Minute ring must be a multiple of the window");
+
+/**
+ * @brief Running aggregate of a span of samples
+ */
+typedef struct
+{
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    uint16_t count;
+}historyRollup_t;
+
+/**
+ * @brief Ring of sample indices whose values are monotonic from front to back
+ */
+typedef struct
+{
+    uint16_t idx[HISTORY_WINDOW_MINUTES];
+    uint16_t head;                      /* Position of the front */
+    uint16_t count;
+}historyDeque_t;
+
+typedef struct
+{
+    int16_t minutes[HISTORY_MINUTES];   /* Minute samples, oldest overwritten first */
+    uint16_t minuteHead;                /* Where the next sample goes */
+    uint16_t minuteCount;
+
+    int32_t accSum;                     /* Readings of the minute in progress */
+    uint16_t accCount;
+    uint32_t accMinute;
+    uint32_t lastMinute;                /* Epoch minute the rollups are at, of the last sample or later */
+
+    int32_t windowSum;                  /* Sliding window over the newest samples */
+    uint16_t windowCount;
+    uint32_t windowStamps[HISTORY_WINDOW_MINUTES];  /* Epoch minute of ring index i at i % HISTORY_WINDOW_MINUTES */
+    historyDeque_t minDeque;            /* Increasing values, front is the window minimum */
+    historyDeque_t maxDeque;            /* Decreasing values, front is the window maximum */
+
+    historyRollup_t hours[HISTORY_HOURS];
+    uint8_t hourHead;
+    uint8_t hourCount;
+    historyRollup_t currentHour;
+
+    historyRollup_t days[HISTORY_DAYS];
+    uint8_t dayHead;
+    uint8_t dayCount;
+    historyRollup_t currentDay;         /* Completed hours of today */
+}historyData_t;
+
+_Static_assert(sizeof(historyData_t) <= HISTORY_RAM_BUDGET, "History exceeds its RAM budget");
+
+static historyData_t history;
+static historyMinuteCallback_t minuteCallback;
+
+static void History_FlushMinute(uint32_t epochMinute);
+static void History_CommitMinute(int16_t value, uint32_t epochMinute);
+static void History_MoveTo(uint32_t epochMinute);
+static void History_CloseHours(uint32_t fromHour, uint32_t toHour);
+static void History_CloseDays(uint32_t fromDay, uint32_t toDay);
+static void History_ExpireWindow(uint32_t epochMinute);
+static void History_PushWindow(int16_t value, uint16_t idx, uint32_t epochMinute);
+static void History_DequePush(historyDeque_t *deque, uint16_t idx, int16_t value, int8_t sign);
+static void Rollup_Add(historyRollup_t *rollup, int16_t value);
+static void Rollup_Merge(historyRollup_t *dst, const historyRollup_t *src);
+static App_StatusTypeDef Rollup_ToStats(const historyRollup_t *rollup, historyStats_t *stats);
+
+void History_AddReading(int16_t temperature, uint32_t epochMinute)
+{
+    History_FlushMinute(epochMinute);
+    history.accMinute = epochMinute;
+    history.accSum += temperature;
+    history.accCount++;
+}
+
+void History_AdvanceTo(uint32_t epochMinute)
+{
+    History_FlushMinute(epochMinute);
+    if (epochMinute > history.lastMinute)
+    {
+        History_MoveTo(epochMinute);
+    }
+}
+
+void History_SetMinuteCallback(historyMinuteCallback_t callback)
+{
+    minuteCallback = callback;
+}
+
+uint16_t History_GetMinuteCount()
+{
+    return history.minuteCount;
+}
+
+App_StatusTypeDef History_GetMinute(uint16_t minutesAgo, int16_t *temperature)
+{
+    if (!temperature || minutesAgo >= history.minuteCount)
+    {
+        return APP_ERROR;
+    }
+    uint16_t idx = (history.minuteHead + HISTORY_MINUTES - 1 - minutesAgo) % HISTORY_MINUTES;
+    *temperature = history.minutes[idx];
+    return APP_OK;
+}
+
+App_StatusTypeDef History_GetWindowStats(historyStats_t *stats)
+{
+    if (!stats || !history.windowCount)
+    {
+        return APP_ERROR;
+    }
+    stats->min = history.minutes[history.minDeque.idx[history.minDeque.head]];
+    stats->max = history.minutes[history.maxDeque.idx[history.maxDeque.head]];
+    stats->mean = (int16_t)(history.windowSum / history.windowCount);
+    stats->count = history.windowCount;
+    return APP_OK;
+}
+
+App_StatusTypeDef History_GetHourStats(uint8_t hoursAgo, historyStats_t *stats)
+{
+    if (!stats)
+    {
+        return APP_ERROR;
+    }
+    if (hoursAgo == 0)
+    {
+        return Rollup_ToStats(&history.currentHour, stats);
+    }
+    if (hoursAgo > history.hourCount)
+    {
+        return APP_ERROR;
+    }
+    return Rollup_ToStats(&history.hours[(history.hourHead + HISTORY_HOURS - hoursAgo) % HISTORY_HOURS], stats);
+}
+
+App_StatusTypeDef History_GetDayStats(uint8_t daysAgo, historyStats_t *stats)
+{
+    if (!stats)
+    {
+        return APP_ERROR;
+    }
+    if (daysAgo == 0)
+    {
+        historyRollup_t today = history.currentDay;
+        Rollup_Merge(&today, &history.currentHour);
+        return Rollup_ToStats(&today, stats);
+    }
+    if (daysAgo > history.dayCount)
+    {
+        return APP_ERROR;
+    }
+    return Rollup_ToStats(&history.days[(history.dayHead + HISTORY_DAYS - daysAgo) % HISTORY_DAYS], stats);
+}
+
+/**
+ * @brief Commit the minute in progress if epochMinute is another one
+ */
+static void History_FlushMinute(uint32_t epochMinute)
+{
+    if (history.accCount && epochMinute != history.accMinute)
+    {
+        History_CommitMinute((int16_t)(history.accSum / history.accCount), history.accMinute);
+        history.accSum = 0;
+        history.accCount = 0;
+    }
+}
+
+static void History_CommitMinute(int16_t value, uint32_t epochMinute)
+{
+    History_MoveTo(epochMinute);
+
+    uint16_t idx = history.minuteHead;
+    History_PushWindow(value, idx, epochMinute);
+    history.minutes[idx] = value;
+    history.minuteHead = (idx + 1) % HISTORY_MINUTES;
+    history.minuteCount += (history.minuteCount < HISTORY_MINUTES);
+    Rollup_Add(&history.currentHour, value);
+
+    if (minuteCallback)
+    {
+        minuteCallback(value, epochMinute);
+    }
+}
+
+/**
+ * @brief Roll hours and days over on the clock boundaries up to epochMinute
+ * Boundaries are of the epoch minute, so a step of the clock either way or a
+ * gap of any length closes what it crosses. Hours and days skipped by a gap
+ * are kept as empty, hoursAgo and daysAgo stay true to the clock.
+ */
+static void History_MoveTo(uint32_t epochMinute)
+{
+    if (history.minuteCount)
+    {
+        History_CloseHours(history.lastMinute / 60, epochMinute / 60);
+        History_CloseDays(history.lastMinute / HISTORY_MINUTES, epochMinute / HISTORY_MINUTES);
+        History_ExpireWindow(epochMinute);
+    }
+    history.lastMinute = epochMinute;
+}
+
+/**
+ * @brief Close the hour in progress if toHour is another one
+ * The hour joins its day first, the day is closed after.
+ */
+static void History_CloseHours(uint32_t fromHour, uint32_t toHour)
+{
+    if (toHour == fromHour)
+    {
+        return;
+    }
+    /* Back in time only the hour in progress closes */
+    uint32_t closed = (toHour > fromHour) ? (toHour - fromHour) : 1;
+    Rollup_Merge(&history.currentDay, &history.currentHour);
+    if (closed > HISTORY_HOURS)
+    {
+        /* Older than every hour kept, the gap fills the ring */
+        history.currentHour = (historyRollup_t){0};
+        closed = HISTORY_HOURS;
+    }
+    for (uint32_t i = 0; i < closed; i++)
+    {
+        history.hours[history.hourHead] = history.currentHour;
+        history.hourHead = (history.hourHead + 1) % HISTORY_HOURS;
+        history.hourCount += (history.hourCount < HISTORY_HOURS);
+        history.currentHour = (historyRollup_t){0};
+    }
+}
+
+static void History_CloseDays(uint32_t fromDay, uint32_t toDay)
+{
+    if (toDay == fromDay)
+    {
+        return;
+    }
+    uint32_t closed = (toDay > fromDay) ? (toDay - fromDay) : 1;
+    if (closed > HISTORY_DAYS)
+    {
+        history.currentDay = (historyRollup_t){0};
+        closed = HISTORY_DAYS;
+    }
+    for (uint32_t i = 0; i < closed; i++)
+    {
+        history.days[history.dayHead] = history.currentDay;
+        history.dayHead = (history.dayHead + 1) % HISTORY_DAYS;
+        history.dayCount += (history.dayCount < HISTORY_DAYS);
+        history.currentDay = (historyRollup_t){0};
+    }
+}
+
+/**
+ * @brief Drop the window samples HISTORY_WINDOW_MINUTES or more before epochMinute
+ * The window is the newest samples of the ring, oldest first. A step back
+ * of the clock leaves it out of order, it starts over from the next sample.
+ */
+static void History_ExpireWindow(uint32_t epochMinute)
+{
+    uint16_t newestIdx = (history.minuteHead + HISTORY_MINUTES - 1) % HISTORY_MINUTES;
+    if (history.windowCount && epochMinute <= history.windowStamps[newestIdx % HISTORY_WINDOW_MINUTES])
+    {
+        history.windowSum = 0;
+        history.windowCount = 0;
+        history.minDeque.count = 0;
+        history.maxDeque.count = 0;
+        return;
+    }
+    while (history.windowCount)
+    {
+        uint16_t outIdx = (history.minuteHead + HISTORY_MINUTES - history.windowCount) % HISTORY_MINUTES;
+        if (epochMinute - history.windowStamps[outIdx % HISTORY_WINDOW_MINUTES] < HISTORY_WINDOW_MINUTES)
+        {
+            break;
+        }
+        history.windowSum -= history.minutes[outIdx];
+        history.windowCount--;
+        /* Each index enters a deque once, so only the front can be the one leaving */
+        if (history.minDeque.count && history.minDeque.idx[history.minDeque.head] == outIdx)
+        {
+            history.minDeque.head = (history.minDeque.head + 1) % HISTORY_WINDOW_MINUTES;
+            history.minDeque.count--;
+        }
+        if (history.maxDeque.count && history.maxDeque.idx[history.maxDeque.head] == outIdx)
+        {
+            history.maxDeque.head = (history.maxDeque.head + 1) % HISTORY_WINDOW_MINUTES;
+            history.maxDeque.count--;
+        }
+    }
+}
+
+/**
+ * @brief Add the sample about to be written at idx to the window
+ * Stamps strictly increase within the window, after expiry it holds at most
+ * HISTORY_WINDOW_MINUTES - 1 samples and the stamp slot of idx is free.
+ */
+static void History_PushWindow(int16_t value, uint16_t idx, uint32_t epochMinute)
+{
+    history.windowStamps[idx % HISTORY_WINDOW_MINUTES] = epochMinute;
+    history.windowCount++;
+    history.windowSum += value;
+    History_DequePush(&history.minDeque, idx, value, 1);
+    History_DequePush(&history.maxDeque, idx, value, -1);
+}
+
+/**
+ * @brief Drop the samples the new one dominates from the back, then append it
+ * Amortized O(1), every index is pushed and popped at most once.
+ * @param sign 1 for a min deque, -1 for a max deque
+ */
+static void History_DequePush(historyDeque_t *deque, uint16_t idx, int16_t value, int8_t sign)
+{
+    while (deque->count)
+    {
+        uint16_t back = (deque->head + deque->count - 1) % HISTORY_WINDOW_MINUTES;
+        if (sign * (int32_t)history.minutes[deque->idx[back]] < sign * (int32_t)value)
+        {
+            break;
+        }
+        deque->count--;
+    }
+    deque->idx[(deque->head + deque->count) % HISTORY_WINDOW_MINUTES] = idx;
+    deque->count++;
+}
+
+static void Rollup_Add(historyRollup_t *rollup, int16_t value)
+{
+    if (!rollup->count || value < rollup->min)
+    {
+        rollup->min = value;
+    }
+    if (!rollup->count || value > rollup->max)
+    {
+        rollup->max = value;
+    }
+    rollup->sum += value;
+    rollup->count++;
+}
+
+static void Rollup_Merge(historyRollup_t *dst, const historyRollup_t *src)
+{
+    if (!src->count)
+    {
+        return;
+    }
+    if (!dst->count || src->min < dst->min)
+    {
+        dst->min = src->min;
+    }
+    if (!dst->count || src->max > dst->max)
+    {
+        dst->max = src->max;
+    }
+    dst->sum += src->sum;
+    dst->count += src->count;
+}
+
+static App_StatusTypeDef Rollup_ToStats(const historyRollup_t *rollup, historyStats_t *stats)
+{
+    if (!rollup->count)
+    {
+        return APP_ERROR;
+    }
+    stats->min = rollup->min;
+    stats->max = rollup->max;
+    stats->mean = (int16_t)(rollup->sum / rollup->count);
+    stats->count = rollup->count;
+    return APP_OK;
+}
@@ -10,8 +10,15 @@
 
 #include "main.h"
 #include "timer.h"
+#include "timelink.h"
+#include "rtc.h"
 
 extern timerLocalData_t timerLocalData;
+extern I2C_HandleTypeDef hi2c1;
+extern SPI_HandleTypeDef hspi2;
+extern SPI_HandleTypeDef hspi3;
+extern FMPI2C_HandleTypeDef hfmpi2c1;
+extern RTC_HandleTypeDef hrtc;
 
 /**
  * @brief This function handles System tick timer.
@@ -27,3 +34,73 @@ void TIM6_DAC_IRQHandler(void)
 {
 	HAL_TIM_IRQHandler(&timerLocalData.htimer6);
 }
+
+void TIM7_IRQHandler(void)
+{
+	HAL_TIM_IRQHandler(&timerLocalData.htimer7);
+}
+
+void TIM2_IRQHandler(void)
+{
+	HAL_TIM_IRQHandler(&timerLocalData.htimer2);
+}
+
+void I2C1_EV_IRQHandler(void)
+{
+	HAL_I2C_EV_IRQHandler(&hi2c1);
+}
+
+void I2C1_ER_IRQHandler(void)
+{
+	HAL_I2C_ER_IRQHandler(&hi2c1);
+}
+
+void SPI2_IRQHandler(void)
+{
+	HAL_SPI_IRQHandler(&hspi2);
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(hspi2.hdmarx);
+}
+
+void DMA1_Stream4_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(hspi2.hdmatx);
+}
+
+void SPI3_IRQHandler(void)
+{
+	HAL_SPI_IRQHandler(&hspi3);
+}
+
+void DMA1_Stream0_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(hspi3.hdmarx);
+}
+
+void DMA1_Stream5_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(hspi3.hdmatx);
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+	HAL_GPIO_EXTI_IRQHandler(TIMELINK_NSS_PIN);
+}
+
+void FMPI2C1_EV_IRQHandler(void)
+{
+	HAL_FMPI2C_EV_IRQHandler(&hfmpi2c1);
+}
+
+void FMPI2C1_ER_IRQHandler(void)
+{
+	HAL_FMPI2C_ER_IRQHandler(&hfmpi2c1);
+}
+
+void RTC_Alarm_IRQHandler(void)
+{
+	HAL_RTC_AlarmIRQHandler(&hrtc);
+}
@@ -7,8 +7,14 @@
  * @copyright Copyright (c) 2022
  *
  */
+#include <string.h>
 #include "lcd.h"
 
+/* Contents of the panel as last written, a bit per cell in the masks */
+static uint8_t frameBuffer[LCD_ROWS][LCD_COLUMNS];
+static uint32_t dirtyCells[LCD_ROWS];       /* Not sent to the panel yet */
+static uint32_t heldCells[LCD_ROWS];        /* Skipped by LCD_WriteText() */
+
 /**
  * @brief Write the value from data to teh LCD D7,D6,D5,D4 GPIOs
  *
@@ -28,6 +34,14 @@ static void LCD_Enable(void);
  */
 static void LCD_PrintChar(uint8_t data);
 
+/**
+ * @brief Store a character code in the frame buffer, marking the cell if it changes
+ *
+ * @param row Row index, from 0
+ * @param column Column index, from 0
+ */
+static void LCD_PutCell(uint8_t row, uint8_t column, uint8_t data);
+
 App_StatusTypeDef LCD_Init()
 {
 	__HAL_RCC_GPIOB_CLK_ENABLE();
@@ -130,6 +144,9 @@ void LCD_DisplayClear()
 	LCD_SendCommand(LCD_CMD_DISP_CLR);
 	/* Wait for command execution to complete*/
 	HAL_Delay(2U);
+	memset(frameBuffer, ' ', sizeof(frameBuffer));
+	memset(dirtyCells, 0, sizeof(dirtyCells));
+	memset(heldCells, 0, sizeof(heldCells));
 }
 
 void LCD_ReturnHome()
@@ -169,6 +186,94 @@ void LCD_SetCursor(uint8_t row, uint8_t column)
 	}
 }
 
+void LCD_WriteText(uint8_t row, uint8_t column, const char *text)
+{
+	if (row < 1 || row > LCD_ROWS || column < 1)
+	{
+		return;
+	}
+	row--;
+	for (uint8_t i = column - 1; i < LCD_COLUMNS && *text != '\0'; i++, text++)
+	{
+		if (!(heldCells[row] & (1UL << i)))
+		{
+			LCD_PutCell(row, i, (uint8_t)*text);
+		}
+	}
+}
+
+void LCD_WriteHeld(uint8_t row, uint8_t column, const uint8_t *data, uint8_t length)
+{
+	if (row < 1 || row > LCD_ROWS || column < 1)
+	{
+		return;
+	}
+	row--;
+	for (uint8_t i = column - 1; i < LCD_COLUMNS && length; i++, length--)
+	{
+		LCD_PutCell(row, i, *data++);
+		heldCells[row] |= (1UL << i);
+	}
+}
+
+void LCD_Release(uint8_t row, uint8_t column, uint8_t length)
+{
+	if (row < 1 || row > LCD_ROWS || column < 1)
+	{
+		return;
+	}
+	row--;
+	for (uint8_t i = column - 1; i < LCD_COLUMNS && length; i++, length--)
+	{
+		heldCells[row] &= ~(1UL << i);
+		LCD_PutCell(row, i, ' ');
+	}
+}
+
+void LCD_DefineChar(uint8_t index, const uint8_t pattern[8])
+{
+	LCD_SendCommand(LCD_CMD_SET_CGRAM_ADDR | ((index % LCD_CUSTOM_CHARS) << 3));
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		LCD_SendData(pattern[i]);
+	}
+	/* Back to the display RAM, data would go on into the patterns */
+	LCD_SendCommand(LCD_CMD_SET_DDRAM_ADDR);
+}
+
+void LCD_Flush(void)
+{
+	for (uint8_t row = 0; row < LCD_ROWS; row++)
+	{
+		uint8_t column = 0;
+		while (dirtyCells[row])
+		{
+			if (!(dirtyCells[row] & (1UL << column)))
+			{
+				column++;
+				continue;
+			}
+			/* The address counter moves on by itself through a run */
+			LCD_SetCursor(row + 1, column + 1);
+			while (column < LCD_COLUMNS && (dirtyCells[row] & (1UL << column)))
+			{
+				LCD_PrintChar(frameBuffer[row][column]);
+				dirtyCells[row] &= ~(1UL << column);
+				column++;
+			}
+		}
+	}
+}
+
+static void LCD_PutCell(uint8_t row, uint8_t column, uint8_t data)
+{
+	if (frameBuffer[row][column] != data)
+	{
+		frameBuffer[row][column] = data;
+		dirtyCells[row] |= (1UL << column);
+	}
+}
+
 static void LCD_WriteDataLines(uint8_t data)
 {
 	HAL_GPIO_WritePin(LCD_GPIO_PORT_2, LCD_GPIO_D7, (data & 0x08) ? GPIO_PIN_SET : GPIO_PIN_RESET);
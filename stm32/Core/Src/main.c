@@ -19,25 +19,162 @@
 #include "timer.h"
 #include "bmp280.h"
 #include "bmp280_types.h"
+#include "sensors.h"
+#include "decimator.h"
+#include "fmpi2c.h"
+#include "history.h"
+#include "flashlog.h"
+#include "tscodec.h"
+#include "timesync.h"
+#include "timelink.h"
+#include "pps.h"
+#include "content.h"
+#include "widget.h"
 
 /* Uncomment the following line to enable UART Debugging */
 //#define APP_DEBUG_UART
 
+/* Uncomment the following line to sample the BMP280 at a high rate through the decimation filter */
+//#define APP_BMP280_OVERSAMPLED
+
+/* Uncomment the following line to talk to the BMP280 over SPI2 instead of I2C1 */
+//#define APP_BMP280_SPI
+
+/* Uncomment the following line to talk to the BMP280 over FMPI2C1 at 1 MHz instead of I2C1 */
+//#define APP_BMP280_FMPI2C
+
+/* Uncomment the following line to align the RTC second to the PPS output of the ESP32 on PA0 */
+//#define APP_TIME_PPS
+
+/* Uncomment the following line when other displays share the SPI bus to the ESP32, MISO needs a pull-up */
+//#define APP_LINK_SHARED_BUS
+
+#if defined(APP_BMP280_SPI) && defined(APP_BMP280_FMPI2C)
+#error "SPI2 and FMPI2C1 share PB14/PB15, enable only one of them"
+#endif
+
+#define BMP280_FMPI2C_BUS_HZ		(1000000)
+#define BMP280_SPI_CS_PORT			GPIOB
+#define BMP280_SPI_CS_PIN			GPIO_PIN_12
+#define BMP280_SAMPLING_PERIOD_US	(5000)	/* Just above the normal mode cycle with X1 and 0.5 ms standby */
+#define BMP280_BENCHMARK_SAMPLES	(64)	/* Batch size of the compensation benchmark */
+#define BMP280_BENCHMARK_TRANSFERS	(32)	/* Transfers per size in the transport benchmark */
+#define HISTORY_RESTORE_CHUNK		(32)	/* Records read from the flash log at a time */
+#define CODEC_BENCHMARK_SAMPLES		(1024)	/* Upper bound on the samples of the codec benchmark */
+#define RENDER_BENCHMARK_FRAMES		(64)	/* Steady frames timed by the render benchmark */
+#define RTC_STEP_THRESHOLD_US		(1000000)	/* Offsets this large set the calendar, smaller ones are shifted out */
+#define RTC_SHIFT_THRESHOLD_US		(250)		/* Two subsecond steps, smaller offsets are left alone */
+#define LINK_MAX_ROUND_TRIP_US		(5000)		/* Slower exchanges were delayed on the ESP32, their offset is not trusted */
+#define PPS_LOCK_TIMEOUT_MS			(20000)		/* The PPS keeps the phase while it gave an offset this recently */
+#define LINK_REQUEST_INTERVAL_MS	(5000)		/* Between time frames asked of the ESP32 */
+#define LINK_REQUEST_RETRY_MS		(100)		/* An ESP32 without the time yet does not answer */
+#define DISPLAY_LINK_STALE_MS		(30000)		/* Without a time frame for this long the link is shown as down */
+#define DISPLAY_TREND_HOURS			(4)			/* Hourly means in the trend, one cell each */
+#define DISPLAY_TREND_PERIOD_MS		(60000)		/* The mean of the hour in progress moves with each minute sample */
+
 UART_HandleTypeDef huart1;
 SPI_HandleTypeDef hspi3;
+I2C_HandleTypeDef hi2c1;
+SPI_HandleTypeDef hspi2;
+FMPI2C_HandleTypeDef hfmpi2c1;
+
+/* Shown by the widgets, taken once per frame */
+static RTC_TimeTypeDef displayTime;
+static RTC_DateTypeDef displayDate;
+static int32_t displayTemperature[2];	/* Hundredths of a degree Celsius, indoor and outdoor */
+static uint8_t isDisplayTemperature[2];
+static uint32_t displayPressure;		/* Pa, 0 without a reading */
+
+static uint32_t todayEpoch;			/* Seconds since 1970 at midnight of the RTC date */
 
-static char lcdRow1String[20];
-static char lcdRow2String[20];
+static int64_t lastCorrectionUs;	/* Local time of the last RTC correction, 0 before the RTC is set */
+static uint8_t isLastCorrectionPrecise;
+static int32_t rtcOffsetUs;			/* Received time minus the RTC at the last time frame */
+static uint8_t isRtcOffsetPrecise;	/* The offset is from a full exchange, not a one way frame */
+static int32_t rtcDriftPpb;			/* From two precise corrections in a row, 0 until then */
+static uint32_t lastPpsTick;		/* HAL tick of the last PPS offset, 0 before the first */
+static uint32_t lastRequestTick;	/* HAL tick of the last time frame asked of the ESP32 */
+static uint32_t lastFrameTick;		/* HAL tick of the last time frame received */
 
 void SystemClock_Config(void);
 static void GPIO_Init(void);
 static void USART1_UART_Init(void);
 static void SPI3_SPI_Init(void);
+static void I2C1_Init(void);
+#ifdef APP_BMP280_SPI
+static void SPI2_Init(void);
+#endif
 static void PrintDateTimeOnLCD(void);
 static App_StatusTypeDef GetTimeFromESP32(time_t *);
+static int64_t SyncTimeToLocalMicros(const struct timesync_time *pSyncTime);
+static App_StatusTypeDef LocalTimeToRTC(time_t time, RTC_TimeTypeDef *pTime, RTC_DateTypeDef *pDate);
+static App_StatusTypeDef StepRTC(int64_t offsetUs);
+static void UpdateTimeFromESP32(void);
+static uint8_t IsPhaseFromPPS(void);
+#ifdef APP_TIME_PPS
+static void UpdateTimeFromPPS(void);
+#endif
+static void StageTelemetry(void);
+static uint32_t DateToEpoch(const RTC_DateTypeDef *pDate);
+static uint32_t DateTimeToEpoch(const RTC_TimeTypeDef *pTime, const RTC_DateTypeDef *pDate);
+static void RestoreHistoryFromLog(uint32_t now);
+static void LogMinute(int16_t temperature, uint32_t epochMinute);
 static void Error_Handler(void);
+static void FormatFields(char *text, const uint8_t *fields, uint8_t count, char separator);
+static void AppendCelsius(char *text, uint8_t width);
+static uint32_t TimeVersion(void);
+static void RenderTime(char *text, uint8_t width);
+static uint32_t DateVersion(void);
+static void RenderDate(char *text, uint8_t width);
+static void RenderWeekday(char *text, uint8_t width);
+static uint32_t IndoorVersion(void);
+static void RenderIndoor(char *text, uint8_t width);
+static uint32_t PressureVersion(void);
+static void RenderPressure(char *text, uint8_t width);
+static uint32_t OutdoorVersion(void);
+static void RenderOutdoor(char *text, uint8_t width);
+static uint32_t LinkVersion(void);
+static void RenderLink(char *text, uint8_t width);
+static uint32_t RangeVersion(void);
+static void RenderRange(char *text, uint8_t width);
+static void RenderTrend(char *text, uint8_t width);
+
+/* Layout of the panel, rows and columns from 1 */
+static const widget_t displayLayout[] =
+{
+	/* row, column, width, period ms, version, render */
+	{1, 1, 8, 0, TimeVersion, RenderTime},
+	{1, 10, 8, 0, DateVersion, RenderDate},
+	{2, 1, 3, 0, DateVersion, RenderWeekday},
+	{2, 5, 8, 0, IndoorVersion, RenderIndoor},
+	{2, 14, 7, 0, PressureVersion, RenderPressure},
+	{3, 1, 12, 0, OutdoorVersion, RenderOutdoor},
+	{3, 15, 6, 0, LinkVersion, RenderLink},		/* Under the sync status pushed by the ESP32 */
+	{4, 1, 16, 0, RangeVersion, RenderRange},
+	{4, 17, DISPLAY_TREND_HOURS, DISPLAY_TREND_PERIOD_MS, NULL, RenderTrend},
+};
+#define DISPLAY_WIDGETS (sizeof(displayLayout) / sizeof(displayLayout[0]))
+static widgetState_t displayState[DISPLAY_WIDGETS];
+
+#ifdef APP_BMP280_OVERSAMPLED
+static void SampleTemperature(void);
+static void SampleTemperatureRead(void *context, App_StatusTypeDef status);
+
+static decimator_t bmp280Decimator;
+static volatile int16_t filteredTemperature;	/* Hundredths of a degree Celsius */
+#else
+static void ScheduleSensorsRound(uint8_t isFrameDue);
+
+static uint32_t sensorsLeadTimeUs;		/* A round starts this long before the frame that shows it */
+static uint8_t isRoundScheduled;
+#endif
 
 #ifdef APP_DEBUG_UART
+static void BenchmarkCompensation(bmp280_t *dev);
+static void BenchmarkTransport(bmp280_t *dev);
+static void BenchmarkCodec(void);
+static void BenchmarkRender(void);
+
 void printmsg(char *format, ...)
 {
 	char str[80];
@@ -82,7 +219,6 @@ int main(void)
 #endif
 	
 	LCD_PrintString("Synchronizing...");
-	HAL_Delay(2500);
     SPI3_SPI_Init();
 	time_t time;
 	if(APP_OK != GetTimeFromESP32(&time))
@@ -92,88 +228,169 @@ int main(void)
 		LCD_PrintString("Failed sync!");
 		Error_Handler();
 	}
-	struct tm *tp = gmtime(&time);
-	if(!tp)
+
+	RTC_TimeTypeDef currTime = {0};
+	RTC_DateTypeDef currDate = {0};
+	if (APP_OK != LocalTimeToRTC(time, &currTime, &currDate))
 	{
 		Error_Handler();
 	}
 
 #ifdef APP_DEBUG_UART
-	char dayofweek[7][10] = {"Sunday",   "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
-	printmsg("%02d/%02d/%04d %s %02d:%02d:%02d\r\n", tp->tm_mon+1, tp->tm_mday,
-			(1900 + tp->tm_year), dayofweek[tp->tm_wday], tp->tm_hour, tp->tm_min,
-			tp->tm_sec);
+	printmsg("%02d/%02d/20%02d %02d:%02d:%02d\r\n", currDate.Month, currDate.Date, currDate.Year,
+			currTime.Hours, currTime.Minutes, currTime.Seconds);
 #endif
 
-	RTC_TimeTypeDef currTime = {0};
-	RTC_DateTypeDef currDate = {0};
-
-	currTime.Hours		= (uint8_t)(tp->tm_hour);
-	currTime.Minutes 	= (uint8_t)(tp->tm_min);
-	currTime.Seconds 	= (uint8_t)(tp->tm_sec);
-
-	currDate.WeekDay 	= (uint8_t)((tp->tm_wday == 0) ? RTC_WEEKDAY_SUNDAY :  tp->tm_wday);	/* Weekday in tm goes from 0-6. RTC struct expects 1-7 */
-	currDate.Month 		= (uint8_t)(tp->tm_mon + 1);	/* Month in tm goes from 0-11. RTC struct expects 1-12 */
-	currDate.Date 		= (uint8_t)(tp->tm_mday);
-	currDate.Year 		= (uint8_t)(tp->tm_year - 100); /* (1900 + tp->tm_year - 2000) */
-
 	// RTC Init
 	if (APP_OK != RTC_Init(&currTime, &currDate, RTC_FORMAT_BIN))
 	{
 		Error_Handler();
 	}
-
-	/* BMP280 Init */
-	if (APP_OK != BMP280_Init())
+	lastCorrectionUs = (int64_t)time * 1000000;
+	/* The display second changes as the RTC second does */
+	if (APP_OK != RTC_StartSecondTick(Timer_Rephase))
+	{
+		Error_Handler();
+	}
+#ifdef APP_TIME_PPS
+	if (APP_OK != PPS_Init())
 	{
 		Error_Handler();
 	}
+#endif
 
 	/* Set up the BMP280 Config Values */
 	bmp280_config_t bmp280_config;
-	bmp280_config.filter = BMP280_FILTER_X2;
+#ifdef APP_BMP280_OVERSAMPLED
+	/* Free-running at the fastest rate, smoothing is done by the decimator */
+	bmp280_config.filter = BMP280_FILTER_OFF;
 	bmp280_config.mode = BMP280_MODE_NORMAL;
 	bmp280_config.tempOversampling = BMP280_SAMPLING_X1;
+	bmp280_config.pressOversampling = BMP280_SAMPLING_NONE;
+	bmp280_config.tStandby = BMP280_STANDBY_MS_1;
+#else
+	bmp280_config.filter = BMP280_FILTER_X2;
+	bmp280_config.mode = BMP280_MODE_FORCED;
+	bmp280_config.tempOversampling = BMP280_SAMPLING_X1;
+	bmp280_config.pressOversampling = BMP280_SAMPLING_X1;	/* Logged with every minute sample */
 	bmp280_config.tStandby = BMP280_STANDBY_MS_500;
-	if (APP_OK != BMP280_SetConfig(&bmp280_config))
+#endif
+
+	/* BMP280 Init. The indoor sensor is required, the outdoor one (SDO high, I2C only) is optional */
+#if defined(APP_BMP280_SPI)
+	SPI2_Init();
+	App_StatusTypeDef sensorStatus = Sensors_RegisterSPI(&hspi2, BMP280_SPI_CS_PORT, BMP280_SPI_CS_PIN, &bmp280_config);
+#elif defined(APP_BMP280_FMPI2C)
+	if (APP_OK != FMPI2C_Init(&hfmpi2c1, BMP280_FMPI2C_BUS_HZ))
 	{
 		Error_Handler();
 	}
-	/* Confirm that the config values have been set corectly */
-	bmp280_config_t bmp280_read_config;
-	if (APP_OK != BMP280_GetConfig(&bmp280_read_config))
+	App_StatusTypeDef sensorStatus = Sensors_RegisterFMPI2C(&hfmpi2c1, BMP280_I2C_ADDRESS_0, &bmp280_config);
+#else
+	I2C1_Init();
+	App_StatusTypeDef sensorStatus = Sensors_RegisterI2C(&hi2c1, BMP280_I2C_ADDRESS_0, &bmp280_config);
+#endif
+	if (APP_OK != sensorStatus)
 	{
+#ifdef APP_DEBUG_UART
+		printmsg("BMP280 Init failed\r\n");
+#endif
 		Error_Handler();
 	}
-	if (bmp280_config.filter != bmp280_read_config.filter ||
-		bmp280_config.mode != bmp280_read_config.mode ||
-		bmp280_config.tempOversampling != bmp280_read_config.tempOversampling ||
-		bmp280_config.tStandby != bmp280_read_config.tStandby)
+#if defined(APP_BMP280_FMPI2C)
+	Sensors_RegisterFMPI2C(&hfmpi2c1, BMP280_I2C_ADDRESS_1, &bmp280_config);
+#elif !defined(APP_BMP280_SPI)
+	Sensors_RegisterI2C(&hi2c1, BMP280_I2C_ADDRESS_1, &bmp280_config);
+#endif
+
+	/* Reload the last day from the flash log, then log every new minute sample. Without the log only RAM history is kept */
+	if (APP_OK == FlashLog_Init())
 	{
+		RestoreHistoryFromLog(DateTimeToEpoch(&currTime, &currDate));
+		History_SetMinuteCallback(LogMinute);
+	}
 #ifdef APP_DEBUG_UART
-		printmsg("BMP280 Config values do not match\r\n");
-#endif
-		Error_Handler();
+	else
+	{
+		printmsg("Flash log init failed\r\n");
 	}
+#endif
 
 #ifdef APP_DEBUG_UART
 	printmsg("Day is %s...\r\n", RTC_GetDayString());
 	printmsg("Current Time is : %s\r\n", RTC_GetTimeString());
 	printmsg("Current Date is (DD-MM-YY): %s\r\n", RTC_GetDateString());
-	printmsg("Current Tempature = %s°C\r\n", BMP280_GetTemperatureString());
+	printmsg("Current Tempature = %s°C\r\n", BMP280_GetTemperatureString(Sensors_GetDevice(0)));
+	BenchmarkCompensation(Sensors_GetDevice(0));
+	BenchmarkTransport(Sensors_GetDevice(0));
+	BenchmarkCodec();
 #endif
 
 	LCD_DisplayClear();
 	LCD_ReturnHome();
 	LCD_SendCommand(LCD_CMD_DON_CUROFF_BLKOFF);
+	Widget_Init();
+#ifdef APP_DEBUG_UART
+	BenchmarkRender();
+#endif
+	/* Patches from the ESP32 go over the local text from here on */
+	TimeLink_SetContentCallback(Content_Apply);
+
+#ifdef APP_BMP280_OVERSAMPLED
+	if (APP_OK != Decimator_Init(&bmp280Decimator, Decimator_DefaultCoeffs, DECIMATOR_DEFAULT_TAPS, DECIMATOR_DEFAULT_FACTOR))
+	{
+		Error_Handler();
+	}
+	/* Prime the filter history so the first outputs do not ramp up from zero */
+	int32_t tempAdc;
+	if (APP_OK != BMP280_ReadRawTemperature(Sensors_GetDevice(0), &tempAdc))
+	{
+		Error_Handler();
+	}
+	int16_t initialTemperature = (int16_t)BMP280_CompensateTemperature(Sensors_GetDevice(0), tempAdc);
+	int16_t primedTemperature;
+	for (uint16_t i = 0; i < DECIMATOR_DEFAULT_TAPS; i++)
+	{
+		Decimator_Push(&bmp280Decimator, initialTemperature, &primedTemperature);
+	}
+	filteredTemperature = initialTemperature;
+	/* From here on the sensor is only accessed from the sampling interrupt and its read completion */
+	BMP280_Bus_SetCallback(Sensors_GetDevice(0)->bus, SampleTemperatureRead, Sensors_GetDevice(0));
+	if (APP_OK != Timer_StartSampling(BMP280_SAMPLING_PERIOD_US, SampleTemperature))
+	{
+		Error_Handler();
+	}
+#else
+	/* Start each round just early enough for every sensor to be read as the frame is composed */
+	sensorsLeadTimeUs = Sensors_GetLeadTimeUs();
+
+	/* Take a first reading before the first frame */
+	Sensors_StartRound();
+#endif
 
 	/* Infinite loop */
 	while (1)
 	{
-		if (Timer_HasTimerExpired())
+		UpdateTimeFromESP32();
+#ifdef APP_TIME_PPS
+		UpdateTimeFromPPS();
+#endif
+		/* Every 100 ms, and as every RTC second begins */
+		uint8_t isFrameDue = Timer_HasTimerExpired();
+#ifndef APP_BMP280_OVERSAMPLED
+		ScheduleSensorsRound(isFrameDue);
+#endif
+		if (isFrameDue)
 		{
 			PrintDateTimeOnLCD();
+			StageTelemetry();
+		}
+		if (Content_Expire())
+		{
+			/* Released cells are blank until the widgets under them render again */
+			Widget_Invalidate(displayState, DISPLAY_WIDGETS);
 		}
+		LCD_Flush();
 	}
 	return 0;
 }
@@ -269,10 +486,10 @@ static void SPI3_SPI_Init(void)
   hspi3.Init.DataSize = SPI_DATASIZE_8BIT;
   hspi3.Init.CLKPolarity = SPI_POLARITY_LOW;
   hspi3.Init.CLKPhase = SPI_PHASE_1EDGE;
-  hspi3.Init.NSS = SPI_NSS_SOFT;
+  hspi3.Init.NSS = SPI_NSS_HARD_INPUT;	/* The ESP32 frames every transfer with its chip select */
   hspi3.Init.FirstBit = SPI_FIRSTBIT_MSB;
   hspi3.Init.TIMode = SPI_TIMODE_DISABLE;
-  hspi3.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
+  hspi3.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;	/* The DMA never stops at a frame end for it, the CRC is checked in software */
   hspi3.Init.CRCPolynomial = 10;
   if (HAL_SPI_Init(&hspi3) != HAL_OK)
   {
@@ -280,6 +497,56 @@ static void SPI3_SPI_Init(void)
   }
 }
 
+/**
+ * @brief I2C1 Initialization Function
+ * @param None
+ * @retval None
+ */
+static void I2C1_Init(void)
+{
+	hi2c1.Instance = I2C1;
+	hi2c1.Init.ClockSpeed = 400000;
+	hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
+	hi2c1.Init.OwnAddress1 = 0;
+	hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+	hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+	hi2c1.Init.OwnAddress2 = 0;
+	hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+	hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+	if (HAL_I2C_Init(&hi2c1) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
+
+#ifdef APP_BMP280_SPI
+/**
+ * @brief SPI2 Initialization Function
+ * BMP280 master in mode 0 at 6.25 MHz, the fastest APB1 division under its 10 MHz limit
+ * @param None
+ * @retval None
+ */
+static void SPI2_Init(void)
+{
+	hspi2.Instance = SPI2;
+	hspi2.Init.Mode = SPI_MODE_MASTER;
+	hspi2.Init.Direction = SPI_DIRECTION_2LINES;
+	hspi2.Init.DataSize = SPI_DATASIZE_8BIT;
+	hspi2.Init.CLKPolarity = SPI_POLARITY_LOW;
+	hspi2.Init.CLKPhase = SPI_PHASE_1EDGE;
+	hspi2.Init.NSS = SPI_NSS_SOFT;
+	hspi2.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_4;
+	hspi2.Init.FirstBit = SPI_FIRSTBIT_MSB;
+	hspi2.Init.TIMode = SPI_TIMODE_DISABLE;
+	hspi2.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
+	hspi2.Init.CRCPolynomial = 10;
+	if (HAL_SPI_Init(&hspi2) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
+#endif
+
 /**
  * @brief GPIO Initialization Function
  * @param None
@@ -296,7 +563,9 @@ static void GPIO_Init(void)
 	usrLED.Pull = GPIO_NOPULL;
 	HAL_GPIO_Init(GPIOA, &usrLED);
 
-	HAL_NVIC_SetPriority(EXTI15_10_IRQn, 15, 0);
+	/* Time link NSS, the end of an exchange is T2. Above every other application interrupt, its RTC stamp waits at
+	 * most for a SPI3 or DMA handler of the link already running. They share the level, none preempts another */
+	HAL_NVIC_SetPriority(EXTI15_10_IRQn, TIMELINK_IRQ_PRIORITY, 0);
 	HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
 
 	__HAL_RCC_GPIOC_CLK_ENABLE();
@@ -304,59 +573,757 @@ static void GPIO_Init(void)
 	usrLED.Mode = GPIO_MODE_INPUT;
 	usrLED.Pull = GPIO_NOPULL;
 	HAL_GPIO_Init(GPIOC, &usrLED);
+
+#ifdef APP_BMP280_SPI
+	/* BMP280 chip select, idle high. Pulling it low latches the sensor into SPI mode */
+	__HAL_RCC_GPIOB_CLK_ENABLE();
+	HAL_GPIO_WritePin(BMP280_SPI_CS_PORT, BMP280_SPI_CS_PIN, GPIO_PIN_SET);
+	GPIO_InitTypeDef bmp280Cs = {0};
+	bmp280Cs.Pin = BMP280_SPI_CS_PIN;
+	bmp280Cs.Mode = GPIO_MODE_OUTPUT_PP;
+	bmp280Cs.Pull = GPIO_NOPULL;
+	bmp280Cs.Speed = GPIO_SPEED_FREQ_HIGH;
+	HAL_GPIO_Init(BMP280_SPI_CS_PORT, &bmp280Cs);
+#endif
 }
 
 void PrintDateTimeOnLCD()
 {
-	RTC_TimeTypeDef currTime = {0};
-	RTC_DateTypeDef currDate = {0};
-	memset(&currTime, 0, sizeof(currTime));
-	memset(&currDate, 0, sizeof(currDate));
-	if (APP_OK != RTC_GetDateTime(&currTime, &currDate))
+	if (APP_OK != RTC_GetDateTime(&displayTime, &displayDate))
 	{
 		Error_Handler();
 	}
+	todayEpoch = DateToEpoch(&displayDate);
+	uint32_t epochMinute = (todayEpoch / 60) + (displayTime.Hours * 60) + displayTime.Minutes;
 
-	/* Set Cursor to the beginning */
-	LCD_ReturnHome();
+#ifdef APP_BMP280_OVERSAMPLED
+	displayTemperature[0] = filteredTemperature;
+	isDisplayTemperature[0] = TRUE;
+#else
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		/* The outdoor sensor is not always fitted */
+		isDisplayTemperature[i] = (APP_OK == Sensors_GetReading(i, &displayTemperature[i], (0 == i) ? &displayPressure : NULL));
+	}
+	if (!isDisplayTemperature[0])
+	{
+		displayPressure = 0;
+	}
+#endif
+	if (isDisplayTemperature[0])
+	{
+		History_AddReading((int16_t)displayTemperature[0], epochMinute);
+	}
 
-	/* Prepare the LCD Strings */
-	sprintf(lcdRow1String, "%s %s", RTC_GetTimeString(), RTC_GetDateString());
-	sprintf(lcdRow2String, "%s %s%cC    ", RTC_GetDayString(), BMP280_GetTemperatureString(), LCD_DEGREES_CHAR_CODE);
+	/* Into the frame buffer, the main loop sends what changed */
+	Widget_Render(displayLayout, displayState, DISPLAY_WIDGETS);
+}
 
-	/* Write to LCD */
-	LCD_PrintString(lcdRow1String);
-	LCD_SetCursor(2, 1);
-	LCD_PrintString(lcdRow2String);
+/**
+ * @brief Two digit fields with a separator between them
+ */
+static void FormatFields(char *text, const uint8_t *fields, uint8_t count, char separator)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		*text++ = '0' + (fields[i] / 10) % 10;
+		*text++ = '0' + fields[i] % 10;
+		*text++ = separator;
+	}
+	*(text - 1) = '\0';
 }
 
+/**
+ * @brief Degrees sign and unit after a formatted temperature, left out if they do not fit in width
+ */
+static void AppendCelsius(char *text, uint8_t width)
+{
+	size_t length = strlen(text);
+	if (length + 2 > width)
+	{
+		return;
+	}
+	text += length;
+	*text++ = LCD_DEGREES_CHAR_CODE;
+	*text++ = 'C';
+	*text = '\0';
+}
+
+static uint32_t TimeVersion(void)
+{
+	return (displayTime.Hours * 3600U) + (displayTime.Minutes * 60U) + displayTime.Seconds;
+}
+
+static void RenderTime(char *text, uint8_t width)
+{
+	const uint8_t fields[] = {displayTime.Hours, displayTime.Minutes, displayTime.Seconds};
+	FormatFields(text, fields, 3, ':');
+}
+
+static uint32_t DateVersion(void)
+{
+	return todayEpoch;
+}
+
+static void RenderDate(char *text, uint8_t width)
+{
+	const uint8_t fields[] = {displayDate.Month, displayDate.Date, displayDate.Year};
+	FormatFields(text, fields, 3, '/');
+}
+
+static void RenderWeekday(char *text, uint8_t width)
+{
+	/* Once a day, reading the RTC again costs nothing */
+	strncpy(text, RTC_GetDayString(), width);
+	text[width] = '\0';
+}
+
+static uint32_t IndoorVersion(void)
+{
+	return isDisplayTemperature[0] ? (uint32_t)displayTemperature[0] : (uint32_t)WIDGET_NO_VALUE;
+}
+
+static void RenderIndoor(char *text, uint8_t width)
+{
+	if (isDisplayTemperature[0])
+	{
+		Widget_FormatTemperature(text, displayTemperature[0], 2);
+	}
+	else
+	{
+		strcpy(text, "--");
+	}
+	AppendCelsius(text, width);
+}
+
+static uint32_t PressureVersion(void)
+{
+	return (displayPressure + 50) / 100;
+}
+
+static void RenderPressure(char *text, uint8_t width)
+{
+	if (displayPressure)
+	{
+		snprintf(text, width + 1, "%luhPa", (unsigned long)PressureVersion());
+	}
+}
+
+static uint32_t OutdoorVersion(void)
+{
+	return isDisplayTemperature[1] ? (uint32_t)displayTemperature[1] : (uint32_t)WIDGET_NO_VALUE;
+}
+
+static void RenderOutdoor(char *text, uint8_t width)
+{
+	if (isDisplayTemperature[1])
+	{
+		strcpy(text, "Out ");
+		Widget_FormatTemperature(text + 4, displayTemperature[1], 2);
+		AppendCelsius(text, width);
+	}
+}
+
+static uint32_t LinkVersion(void)
+{
+	return (HAL_GetTick() - lastFrameTick) >= DISPLAY_LINK_STALE_MS;
+}
+
+static void RenderLink(char *text, uint8_t width)
+{
+	if (LinkVersion())
+	{
+		strcpy(text, "nolink");
+	}
+}
+
+static uint32_t RangeVersion(void)
+{
+	historyStats_t stats;
+	if (APP_OK != History_GetWindowStats(&stats))
+	{
+		return (uint32_t)WIDGET_NO_VALUE;
+	}
+	return ((uint32_t)(uint16_t)stats.min << 16) | (uint16_t)stats.max;
+}
+
+static void RenderRange(char *text, uint8_t width)
+{
+	/* Low and high of the last hour */
+	historyStats_t stats;
+	if (APP_OK != History_GetWindowStats(&stats))
+	{
+		return;
+	}
+	strcpy(text, "1h ");
+	Widget_FormatTemperature(text + strlen(text), stats.min, 1);
+	strcat(text, "/");
+	Widget_FormatTemperature(text + strlen(text), stats.max, 1);
+	AppendCelsius(text, width);
+}
+
+static void RenderTrend(char *text, uint8_t width)
+{
+	/* Hourly means, the oldest on the left */
+	int32_t means[DISPLAY_TREND_HOURS];
+	for (uint8_t i = 0; i < DISPLAY_TREND_HOURS; i++)
+	{
+		historyStats_t stats;
+		means[i] = (APP_OK == History_GetHourStats(DISPLAY_TREND_HOURS - 1 - i, &stats)) ? stats.mean : WIDGET_NO_VALUE;
+	}
+	Widget_FormatBars(text, means, DISPLAY_TREND_HOURS);
+}
+
+static uint32_t DateToEpoch(const RTC_DateTypeDef * pDate)
+{
+	/* Once a frame, integer days instead of mktime() */
+	return RTC_DateToDays(pDate) * 86400U;
+}
+
+static uint32_t DateTimeToEpoch(const RTC_TimeTypeDef * pTime, const RTC_DateTypeDef * pDate)
+{
+	return DateToEpoch(pDate) + (pTime->Hours * 3600) + (pTime->Minutes * 60) + pTime->Seconds;
+}
+
+static void RestoreHistoryFromLog(uint32_t now)
+{
+	flashLogRecord_t records[HISTORY_RESTORE_CHUNK];
+	uint32_t fromTime = now - (HISTORY_MINUTES * 60);
+	uint16_t count;
+	do
+	{
+		count = FlashLog_Query(fromTime, now, records, HISTORY_RESTORE_CHUNK);
+		for (uint16_t i = 0; i < count; i++)
+		{
+			History_AddReading(records[i].temperature, records[i].timestamp / 60);
+		}
+		if (count)
+		{
+			fromTime = records[count - 1].timestamp + 1;
+		}
+	} while (count == HISTORY_RESTORE_CHUNK);
+	/* The log may end long before now, what is older than the window by the RTC leaves it */
+	History_AdvanceTo(now / 60);
+}
+
+static void LogMinute(int16_t temperature, uint32_t epochMinute)
+{
+	/* Pressure is not kept by the history, log the latest reading with it */
+	int32_t latestTemperature;
+	uint32_t pressure = 0;
+	Sensors_GetReading(0, &latestTemperature, &pressure);
+
+	/* Fails for a minute already logged, such as the last one restored at boot */
+	FlashLog_Append(epochMinute * 60, temperature, pressure);
+}
+
+/**
+ * @brief Wait for a valid time frame from the ESP32
+ * Starts the link, which keeps receiving in the background from then on,
+ * and asks for a frame until one comes.
+ */
 static App_StatusTypeDef GetTimeFromESP32(time_t * pTime)
 {
 #ifdef APP_DEBUG_UART
 	printmsg("Waiting for data via SPI...\r\n");
 #endif
-	char rx_buf[8];
-	uint64_t epochSecs = 0;
-	uint64_t * pEpochSecs = &epochSecs;
-	/**
-	 * @brief Wait for time sync...
-	 * Ensure that epoch is within the millennium (2022 - 3022) :)
-	 */
-	while (!((*pEpochSecs > 1640995200) && (*pEpochSecs < 33197904000)))
+	timeLinkFrame_t frame;
+#ifdef APP_LINK_SHARED_BUS
+	App_StatusTypeDef linkStatus = TimeLink_Init(&hspi3, TRUE);
+#else
+	App_StatusTypeDef linkStatus = TimeLink_Init(&hspi3, FALSE);
+#endif
+	if (APP_OK != linkStatus)
 	{
-		memset(rx_buf,0,8);
-		if(HAL_OK != HAL_SPI_Receive(&hspi3, (uint8_t *)rx_buf, 8, HAL_MAX_DELAY))
+		return APP_ERROR;
+	}
+	while (APP_OK != TimeLink_GetTime(&frame))
+	{
+		if (HAL_GetTick() - lastRequestTick >= LINK_REQUEST_RETRY_MS)
 		{
-			return APP_ERROR;
+			TimeLink_RequestTime();
+			lastRequestTick = HAL_GetTick();
 		}
-		pEpochSecs = (uint64_t *)rx_buf;
+	}
+	lastFrameTick = HAL_GetTick();
+	*pTime = (time_t)(SyncTimeToLocalMicros(&frame.time) / 1000000);
+	return APP_OK;
+}
+
+static int64_t SyncTimeToLocalMicros(const struct timesync_time * pSyncTime)
+{
+	/* The RTC keeps local time */
+	int64_t seconds = (int64_t)pSyncTime->seconds + (pSyncTime->utc_offset_min * 60);
+	return (seconds * 1000000) + (int64_t)(((uint64_t)pSyncTime->fraction * 1000000U) >> 32);
+}
+
+static App_StatusTypeDef LocalTimeToRTC(time_t time, RTC_TimeTypeDef * pTime, RTC_DateTypeDef * pDate)
+{
+	struct tm *tp = gmtime(&time);
+	if (!tp)
+	{
+		return APP_ERROR;
+	}
+	pTime->Hours	= (uint8_t)(tp->tm_hour);
+	pTime->Minutes	= (uint8_t)(tp->tm_min);
+	pTime->Seconds	= (uint8_t)(tp->tm_sec);
+
+	pDate->WeekDay	= (uint8_t)((tp->tm_wday == 0) ? RTC_WEEKDAY_SUNDAY :  tp->tm_wday);	/* Weekday in tm goes from 0-6. RTC struct expects 1-7 */
+	pDate->Month	= (uint8_t)(tp->tm_mon + 1);	/* Month in tm goes from 0-11. RTC struct expects 1-12 */
+	pDate->Date		= (uint8_t)(tp->tm_mday);
+	pDate->Year		= (uint8_t)(tp->tm_year - 100); /* (1900 + tp->tm_year - 2000) */
+	return APP_OK;
+}
+
+/**
+ * @brief Move the RTC by an offset of any size
+ * Setting the calendar starts the current second over, the fraction of the
+ * target time is shifted in right after.
+ */
+static App_StatusTypeDef StepRTC(int64_t offsetUs)
+{
+	rtcStamp_t now;
+	RTC_TimeTypeDef newTime = {0};
+	RTC_DateTypeDef newDate = {0};
+	if (APP_OK != RTC_GetStamp(&now))
+	{
+		return APP_ERROR;
+	}
+	int64_t targetUs = RTC_StampToMicros(&now) + offsetUs;
+	if (APP_OK != LocalTimeToRTC((time_t)(targetUs / 1000000), &newTime, &newDate) ||
+		APP_OK != RTC_SetDateTime(&newTime, &newDate, RTC_FORMAT_BIN))
+	{
+		return APP_ERROR;
+	}
+	return RTC_Shift((int32_t)(targetUs % 1000000));
+}
+
+/**
+ * @brief Ask the ESP32 for time frames and apply them
+ * Each frame carries T1 of its own exchange and the round trip of the one
+ * before, which with the RTC reading taken as that exchange ended gives the
+ * offset of the RTC to within the asymmetry of the link. Such offsets are
+ * shifted out of the RTC without stopping it. A frame that can not be paired
+ * with the one before only corrects offsets of a second or more, the next
+ * frame is asked for at once to pair with it. A step of the calendar waits
+ * for a second frame to agree on the offset, one stamp taken late, as when
+ * a flash erase held off the interrupts, never steps the RTC. Two precise
+ * corrections in a row give the drift of the RTC.
+ */
+static void UpdateTimeFromESP32(void)
+{
+	static uint8_t isPrevValid;
+	static uint8_t prevSequence;
+	static int64_t prevTransmitUs;		/* T1 of the previous exchange */
+	static int64_t prevReceivedUs;		/* T2 of the previous exchange, on the RTC as corrected since */
+	static uint8_t isStepPending;
+	static int64_t pendingStepUs;		/* Offset of the last frame, to be agreed on by the next one */
+	timeLinkFrame_t frame;
+	int64_t offsetUs;
+	int64_t receivedUs = 0;
+	uint8_t isPrecise = FALSE;
+
+	if (HAL_GetTick() - lastRequestTick >= LINK_REQUEST_INTERVAL_MS)
+	{
+		TimeLink_RequestTime();
+		lastRequestTick = HAL_GetTick();
+	}
+	if (APP_OK != TimeLink_GetTime(&frame))
+	{
+		return;
+	}
+	/* Asked for by this node or another on the bus, it restarts the wait all the same */
+	lastRequestTick = HAL_GetTick();
+	lastFrameTick = lastRequestTick;
+	int64_t transmitUs = SyncTimeToLocalMicros(&frame.time);
+	if (frame.isStamped)
+	{
+		receivedUs = RTC_StampToMicros(&frame.received);
+	}
+
+	uint8_t isPaired = isPrevValid && frame.sequence == (uint8_t)(prevSequence + 1U);
+	if (!isPaired && frame.isStamped)
+	{
+		/* The next frame completes this exchange, no need to wait for the next round */
+		TimeLink_RequestTime();
+		lastRequestTick = HAL_GetTick();
+	}
+
+	if (isPaired && frame.time.round_trip_us && frame.time.round_trip_us <= LINK_MAX_ROUND_TRIP_US)
+	{
+		/* T2 = T3, the RTC was read as the exchange ended, halfway through the round trip */
+		offsetUs = prevTransmitUs + (frame.time.round_trip_us / 2) - prevReceivedUs;
+		isPrecise = TRUE;
+	}
+	else if (frame.isStamped)
+	{
+		/* One way only, short by the delay of the exchange */
+		offsetUs = transmitUs - receivedUs;
+	}
+	else
+	{
+		isPrevValid = FALSE;
+		return;
+	}
+	rtcOffsetUs = (offsetUs > INT32_MAX) ? INT32_MAX : ((offsetUs < INT32_MIN) ? INT32_MIN : (int32_t)offsetUs);
+	isRtcOffsetPrecise = isPrecise;
+
+	int64_t appliedUs = 0;
+	uint8_t isStep = (offsetUs <= -RTC_STEP_THRESHOLD_US || offsetUs >= RTC_STEP_THRESHOLD_US);
+	int64_t disagreementUs = offsetUs - pendingStepUs;
+	uint8_t isConfirmed = isStepPending && disagreementUs > -RTC_SHIFT_THRESHOLD_US && disagreementUs < RTC_SHIFT_THRESHOLD_US;
+	isStepPending = isStep && !isConfirmed;
+	pendingStepUs = offsetUs;
+	if (isStepPending)
+	{
+		/* The next frame confirms it, no need to wait for the next round */
+		TimeLink_RequestTime();
+		lastRequestTick = HAL_GetTick();
+	}
+	else if (isStep)
+	{
+		if (APP_OK == StepRTC(offsetUs))
+		{
+			appliedUs = offsetUs;
+		}
+	}
+	else if (isPrecise && !IsPhaseFromPPS() && (offsetUs <= -RTC_SHIFT_THRESHOLD_US || offsetUs >= RTC_SHIFT_THRESHOLD_US))
+	{
+		if (APP_OK == RTC_Shift((int32_t)offsetUs))
+		{
+			appliedUs = offsetUs;
+		}
+	}
+
+	if (appliedUs)
+	{
+		PPS_Discard();
+		if (isPrecise && isLastCorrectionPrecise && transmitUs > lastCorrectionUs)
+		{
+			/* A fast RTC is ahead, the offset comes out negative */
+			rtcDriftPpb = (int32_t)((-appliedUs * 1000000000LL) / (transmitUs - lastCorrectionUs));
+		}
+		lastCorrectionUs = transmitUs;
+		isLastCorrectionPrecise = isPrecise;
 #ifdef APP_DEBUG_UART
-		printmsg("Received: %x\r\n", (uint32_t)*pEpochSecs);
+		timeLinkStats_t stats;
+		TimeLink_GetStats(&stats);
+		printmsg("RTC off by %ld us%s, corrected. Link: %lu frames, %lu CRC, %lu framing, %lu dropped\r\n",
+				 (long)rtcOffsetUs, isPrecise ? "" : " one way",
+				 stats.frames, stats.crcErrors, stats.framingErrors, stats.dropped);
 #endif
-		*pTime = (time_t)(*pEpochSecs - 14400);
 	}
-	return APP_OK;
+
+	/* This exchange is completed by the round trip in the next frame */
+	isPrevValid = frame.isStamped;
+	prevSequence = frame.sequence;
+	prevTransmitUs = transmitUs;
+	prevReceivedUs = receivedUs + appliedUs;
+}
+
+/**
+ * @brief Whether the PPS edges keep the RTC phase
+ * The link then only corrects whole seconds, the edges are far more precise.
+ */
+static uint8_t IsPhaseFromPPS(void)
+{
+	return lastPpsTick && ((HAL_GetTick() - lastPpsTick) < PPS_LOCK_TIMEOUT_MS);
+}
+
+#ifdef APP_TIME_PPS
+/**
+ * @brief Shift the RTC onto the PPS edges
+ * Offsets under half a subsecond step round to no shift at all.
+ */
+static void UpdateTimeFromPPS(void)
+{
+	int32_t offsetUs;
+	if (APP_OK != PPS_GetOffset(&offsetUs))
+	{
+		return;
+	}
+	lastPpsTick = HAL_GetTick() | 1U;
+	if (APP_OK != RTC_Shift(offsetUs))
+	{
+		return;
+	}
+	PPS_Discard();
+#ifdef APP_DEBUG_UART
+	printmsg("RTC phase off by %ld us from PPS\r\n", (long)offsetUs);
+#endif
 }
+#endif
+
+/**
+ * @brief Stage the state of this node for the ESP32 to read on its next exchange
+ */
+static void StageTelemetry(void)
+{
+	struct timesync_telemetry telemetry = {0};
+	RTC_TimeTypeDef currTime = {0};
+	RTC_DateTypeDef currDate = {0};
+
+	telemetry.temperature[0] = TIMESYNC_NO_READING;
+	telemetry.temperature[1] = TIMESYNC_NO_READING;
+#ifdef APP_BMP280_OVERSAMPLED
+	telemetry.temperature[0] = filteredTemperature;
+#else
+	int32_t temperature;
+	uint32_t pressure = 0;
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		if (APP_OK == Sensors_GetReading(i, &temperature, i ? NULL : &pressure))
+		{
+			telemetry.temperature[i] = (int16_t)temperature;
+		}
+	}
+	telemetry.pressure = pressure;
+#endif
+	if (APP_OK == RTC_GetDateTime(&currTime, &currDate))
+	{
+		telemetry.rtc_seconds = DateTimeToEpoch(&currTime, &currDate);
+	}
+	telemetry.rtc_offset_us = rtcOffsetUs;
+	telemetry.drift_ppb = rtcDriftPpb;
+	telemetry.flags = (lastCorrectionUs ? TIMESYNC_TELEMETRY_FLAG_RTC_SYNCED : 0) |
+					  (isRtcOffsetPrecise ? TIMESYNC_TELEMETRY_FLAG_RTC_PRECISE : 0) |
+					  (IsPhaseFromPPS() ? TIMESYNC_TELEMETRY_FLAG_PPS : 0);
+	TimeLink_SetTelemetry(&telemetry);
+}
+
+#ifdef APP_BMP280_OVERSAMPLED
+/**
+ * @brief Sampling timer callback
+ * Starts the read of one sample and returns. Runs in interrupt context.
+ */
+static void SampleTemperature(void)
+{
+	/* A read still in flight on a slow bus makes the HAL refuse this one, the tick is skipped */
+	BMP280_ReadRaw_IT(Sensors_GetDevice(0));
+}
+
+/**
+ * @brief Completion of the sample read, feeds it to the decimator
+ * Runs in the interrupt context of the bus.
+ */
+static void SampleTemperatureRead(void *context, App_StatusTypeDef status)
+{
+	bmp280_t *dev = (bmp280_t *)context;
+	int32_t tempAdc;
+	int32_t pressAdc;
+	int16_t output;
+
+	if (APP_OK != status)
+	{
+		return;
+	}
+	BMP280_GetRawFromBuffer(dev, &tempAdc, &pressAdc);
+	if (Decimator_Push(&bmp280Decimator, (int16_t)BMP280_CompensateTemperature(dev, tempAdc), &output))
+	{
+		filteredTemperature = output;
+	}
+}
+#else
+/**
+ * @brief Start a round of sensor reads ahead of the frame that shows it
+ * Called on every pass of the main loop, before the frame is composed.
+ * @param isFrameDue A frame is composed on this pass
+ */
+static void ScheduleSensorsRound(uint8_t isFrameDue)
+{
+	if (!isRoundScheduled && (Timer_GetTimeToExpiryUs() <= sensorsLeadTimeUs))
+	{
+		isRoundScheduled = (APP_OK == Sensors_StartRound());
+	}
+	if (isFrameDue)
+	{
+		/* The previous frame overran the lead window, this frame shows the previous round */
+		if (!isRoundScheduled)
+		{
+			Sensors_StartRound();
+		}
+		isRoundScheduled = FALSE;
+	}
+}
+#endif
+
+#ifdef APP_DEBUG_UART
+/**
+ * @brief Measure the cost of BMP280_CompensateBatch() with the DWT cycle counter
+ * The batch is built around one real reading so the calibration paths are realistic.
+ */
+static void BenchmarkCompensation(bmp280_t *dev)
+{
+	static int32_t tempAdc[BMP280_BENCHMARK_SAMPLES];
+	static int32_t pressAdc[BMP280_BENCHMARK_SAMPLES];
+	static int32_t temperature[BMP280_BENCHMARK_SAMPLES];
+	static uint32_t pressure[BMP280_BENCHMARK_SAMPLES];
+	int32_t baseTempAdc;
+	int32_t basePressAdc;
+
+	if (APP_OK != BMP280_ReadRaw(dev, &baseTempAdc, &basePressAdc))
+	{
+		return;
+	}
+	/* Pressure may be skipped by the sensor config, use a mid-scale value instead */
+	basePressAdc = 0x80000;
+	for (uint32_t i = 0; i < BMP280_BENCHMARK_SAMPLES; i++)
+	{
+		tempAdc[i] = baseTempAdc + (int32_t)(i * 16);
+		pressAdc[i] = basePressAdc - (int32_t)(i * 16);
+	}
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	uint32_t start = DWT->CYCCNT;
+	BMP280_CompensateBatch(dev, tempAdc, NULL, temperature, NULL, BMP280_BENCHMARK_SAMPLES);
+	uint32_t tempCycles = DWT->CYCCNT - start;
+
+	start = DWT->CYCCNT;
+	BMP280_CompensateBatch(dev, tempAdc, pressAdc, temperature, pressure, BMP280_BENCHMARK_SAMPLES);
+	uint32_t bothCycles = DWT->CYCCNT - start;
+
+	printmsg("Compensation: %lu cycles/sample (temperature), %lu cycles/sample (temperature + pressure)\r\n",
+			 tempCycles / BMP280_BENCHMARK_SAMPLES, bothCycles / BMP280_BENCHMARK_SAMPLES);
+}
+
+static volatile uint8_t isBenchmarkTransferDone;
+
+static void BenchmarkTransferDone(void *context, App_StatusTypeDef status)
+{
+	isBenchmarkTransferDone = TRUE;
+}
+
+/**
+ * @brief Measure the throughput of the sensor transport
+ * Blocking burst reads of the calibration and data registers, then non-blocking
+ * reads of the data registers timed from start to completion callback.
+ * Must run before the first acquisition round.
+ */
+static void BenchmarkTransport(bmp280_t *dev)
+{
+	uint8_t buf[BMP280_CALIB_DATA_LEN];
+	uint8_t sizes[2] = {BMP280_CALIB_DATA_LEN, BMP280_RAW_DATA_LEN};
+	uint32_t usToCycles = SystemCoreClock / 1000000U;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	for (uint8_t i = 0; i < sizeof(sizes); i++)
+	{
+		uint32_t start = DWT->CYCCNT;
+		for (uint32_t n = 0; n < BMP280_BENCHMARK_TRANSFERS; n++)
+		{
+			dev->bus->ops->read(dev->bus, (uint8_t)BMP280_REG_DIG_T1, buf, sizes[i]);
+		}
+		uint32_t cycles = DWT->CYCCNT - start;
+		/* Thousandths of a byte per microsecond */
+		uint32_t rate = (sizes[i] * BMP280_BENCHMARK_TRANSFERS * 1000U * usToCycles) / cycles;
+		printmsg("Transport: %u byte reads, %lu.%03lu bytes/us\r\n", sizes[i], rate / 1000, rate % 1000);
+	}
+
+	/* Borrow the completion callback from the sensor registry for the duration */
+	bmp280BusCallback_t callback = dev->bus->callback;
+	void *context = dev->bus->context;
+	BMP280_Bus_SetCallback(dev->bus, BenchmarkTransferDone, NULL);
+	uint32_t start = DWT->CYCCNT;
+	for (uint32_t n = 0; n < BMP280_BENCHMARK_TRANSFERS; n++)
+	{
+		isBenchmarkTransferDone = FALSE;
+		if (APP_OK != dev->bus->ops->readAsync(dev->bus, (uint8_t)BMP280_REG_PRESSDATA, BMP280_RAW_DATA_LEN))
+		{
+			break;
+		}
+		while (!isBenchmarkTransferDone)
+		{
+		}
+	}
+	uint32_t cycles = DWT->CYCCNT - start;
+	BMP280_Bus_SetCallback(dev->bus, callback, context);
+	uint32_t rate = (BMP280_RAW_DATA_LEN * BMP280_BENCHMARK_TRANSFERS * 1000U * usToCycles) / cycles;
+	printmsg("Transport: %u byte async reads, %lu.%03lu bytes/us\r\n", BMP280_RAW_DATA_LEN, rate / 1000, rate % 1000);
+}
+
+/**
+ * @brief Measure the time-series codec on one flash log page of synthetic minute samples
+ */
+static void BenchmarkCodec(void)
+{
+	static uint8_t block[FLASHLOG_PAGE_SIZE];
+	tsEncoder_t enc;
+	tsDecoder_t dec;
+	tsSample_t sample = {.timestamp = 1672531200, .temperature = 2150, .pressure = 101325};
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	TsCodec_InitEncoder(&enc, block, sizeof(block));
+	uint32_t count = 0;
+	uint32_t start = DWT->CYCCNT;
+	while (count < CODEC_BENCHMARK_SAMPLES)
+	{
+		/* Slow drift with a little noise, like minute averages */
+		sample.timestamp += 60;
+		sample.temperature += (int16_t)((count * 7) % 5) - 2;
+		sample.pressure = sample.pressure + (count % 3) - 1;
+		if (APP_OK != TsCodec_Encode(&enc, &sample))
+		{
+			break;
+		}
+		count++;
+	}
+	uint32_t encodeCycles = DWT->CYCCNT - start;
+
+	TsCodec_InitDecoder(&dec, block, TsCodec_GetLength(&enc), count);
+	start = DWT->CYCCNT;
+	while (APP_OK == TsCodec_Decode(&dec, &sample))
+	{
+	}
+	uint32_t decodeCycles = DWT->CYCCNT - start;
+
+	printmsg("Codec: %lu samples/page, %lu bits/sample, %lu/%lu cycles/sample enc/dec\r\n",
+			 count, (TsCodec_GetLength(&enc) * 8U) / count, encodeCycles / count, decodeCycles / count);
+}
+
+/**
+ * @brief Measure a frame of the widgets with the DWT cycle counter
+ * A full frame renders every widget, a steady one finds nothing changed.
+ * Both include the date conversion of the frame, not the RTC and sensor reads.
+ */
+static void BenchmarkRender(void)
+{
+	if (APP_OK != RTC_GetDateTime(&displayTime, &displayDate))
+	{
+		return;
+	}
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	uint32_t start = DWT->CYCCNT;
+	todayEpoch = DateToEpoch(&displayDate);
+	Widget_Render(displayLayout, displayState, DISPLAY_WIDGETS);
+	uint32_t fullCycles = DWT->CYCCNT - start;
+
+	start = DWT->CYCCNT;
+	for (uint32_t n = 0; n < RENDER_BENCHMARK_FRAMES; n++)
+	{
+		todayEpoch = DateToEpoch(&displayDate);
+		Widget_Render(displayLayout, displayState, DISPLAY_WIDGETS);
+	}
+	uint32_t steadyCycles = (DWT->CYCCNT - start) / RENDER_BENCHMARK_FRAMES;
+
+	/* The first real frame renders everything again */
+	Widget_Invalidate(displayState, DISPLAY_WIDGETS);
+	printmsg("Render: %lu cycles full frame, %lu cycles (%lu us) steady frame\r\n",
+			 fullCycles, steadyCycles, steadyCycles / (SystemCoreClock / 1000000U));
+}
+#endif
 
 void Error_Handler(void)
 {
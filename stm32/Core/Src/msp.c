@@ -8,6 +8,8 @@
  *
  */
 #include "main.h"
+#include "fmpi2c.h"
+#include "timelink.h"
 
 /**
  * @brief Initializes the Global MSP.
@@ -54,6 +56,52 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef *hi2c)
 
 		/* Peripheral clock enable */
 		__HAL_RCC_I2C1_CLK_ENABLE();
+
+		/* Interrupts drive the non-blocking sensor transfers */
+		HAL_NVIC_SetPriority(I2C1_EV_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+		HAL_NVIC_SetPriority(I2C1_ER_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
+	}
+}
+
+/**
+ * @brief FMPI2C MSP Initialization
+ *
+ * @param hfmpi2c FMPI2C handle pointer
+ */
+void HAL_FMPI2C_MspInit(FMPI2C_HandleTypeDef *hfmpi2c)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+	RCC_PeriphCLKInitTypeDef PeriphClkInit = {0};
+	if (hfmpi2c->Instance == FMPI2C1)
+	{
+		/* Kernel clock the timing register was computed for */
+		PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_FMPI2C1;
+		PeriphClkInit.Fmpi2c1ClockSelection = FMPI2C_CLOCK_SOURCE;
+		HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit);
+
+		__HAL_RCC_GPIOB_CLK_ENABLE();
+		/**FMPI2C1 GPIO Configuration
+		PB14     ------> FMPI2C1_SDA
+		PB15     ------> FMPI2C1_SCL
+		PC6/PC7 are the other option on this package but PC6 drives the LCD
+		*/
+		GPIO_InitStruct.Pin = GPIO_PIN_14 | GPIO_PIN_15;
+		GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		GPIO_InitStruct.Alternate = GPIO_AF4_FMPI2C1;
+		HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+		/* Peripheral clock enable */
+		__HAL_RCC_FMPI2C1_CLK_ENABLE();
+
+		/* Interrupts drive the non-blocking sensor transfers */
+		HAL_NVIC_SetPriority(FMPI2C1_EV_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(FMPI2C1_EV_IRQn);
+		HAL_NVIC_SetPriority(FMPI2C1_ER_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(FMPI2C1_ER_IRQn);
 	}
 }
 
@@ -67,15 +115,29 @@ void HAL_SPI_MspInit(SPI_HandleTypeDef *hspi)
 	GPIO_InitTypeDef GPIO_InitStruct = {0};
 	if (hspi->Instance == SPI3)
 	{
+		static DMA_HandleTypeDef hdmaSpi3Rx;
+		static DMA_HandleTypeDef hdmaSpi3Tx;
+
 		/* Peripheral clock enable */
     __HAL_RCC_SPI3_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
 
+    __HAL_RCC_GPIOA_CLK_ENABLE();
     __HAL_RCC_GPIOC_CLK_ENABLE();
     /**SPI3 GPIO Configuration
+    PA15     ------> SPI3_NSS
     PC1     ------> SPI3_MOSI
     PC10     ------> SPI3_SCK
     PC11     ------> SPI3_MISO
     */
+    /* Pulled up so the slave stays deselected while the ESP32 boots */
+    GPIO_InitStruct.Pin = GPIO_PIN_15;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF6_SPI3;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
     GPIO_InitStruct.Pin = GPIO_PIN_1;
     GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
@@ -89,6 +151,87 @@ void HAL_SPI_MspInit(SPI_HandleTypeDef *hspi)
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
     GPIO_InitStruct.Alternate = GPIO_AF6_SPI3;
     HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+		/* SPI3_RX on DMA1 Stream 0 channel 0, circular so reception never stops */
+		hdmaSpi3Rx.Instance = DMA1_Stream0;
+		hdmaSpi3Rx.Init.Channel = DMA_CHANNEL_0;
+		hdmaSpi3Rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+		hdmaSpi3Rx.Init.PeriphInc = DMA_PINC_DISABLE;
+		hdmaSpi3Rx.Init.MemInc = DMA_MINC_ENABLE;
+		hdmaSpi3Rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+		hdmaSpi3Rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+		hdmaSpi3Rx.Init.Mode = DMA_CIRCULAR;
+		hdmaSpi3Rx.Init.Priority = DMA_PRIORITY_MEDIUM;
+		hdmaSpi3Rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+		HAL_DMA_Init(&hdmaSpi3Rx);
+		__HAL_LINKDMA(hspi, hdmarx, hdmaSpi3Rx);
+
+		/* SPI3_TX on DMA1 Stream 5 channel 0, one telemetry frame per exchange */
+		hdmaSpi3Tx.Instance = DMA1_Stream5;
+		hdmaSpi3Tx.Init = hdmaSpi3Rx.Init;
+		hdmaSpi3Tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+		hdmaSpi3Tx.Init.Mode = DMA_NORMAL;
+		HAL_DMA_Init(&hdmaSpi3Tx);
+		__HAL_LINKDMA(hspi, hdmatx, hdmaSpi3Tx);
+
+		/* Same level as the NSS EXTI, which restarts the link and the TX stream under these handles */
+		HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, TIMELINK_IRQ_PRIORITY, 0);
+		HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+		HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, TIMELINK_IRQ_PRIORITY, 0);
+		HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+		HAL_NVIC_SetPriority(SPI3_IRQn, TIMELINK_IRQ_PRIORITY, 0);
+		HAL_NVIC_EnableIRQ(SPI3_IRQn);
+	}
+	else if (hspi->Instance == SPI2)
+	{
+		static DMA_HandleTypeDef hdmaSpi2Rx;
+		static DMA_HandleTypeDef hdmaSpi2Tx;
+
+		/* Peripheral clock enable */
+		__HAL_RCC_SPI2_CLK_ENABLE();
+		__HAL_RCC_DMA1_CLK_ENABLE();
+
+		__HAL_RCC_GPIOB_CLK_ENABLE();
+		/**SPI2 GPIO Configuration
+		PB13     ------> SPI2_SCK
+		PB14     ------> SPI2_MISO
+		PB15     ------> SPI2_MOSI
+		*/
+		GPIO_InitStruct.Pin = GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15;
+		GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		GPIO_InitStruct.Alternate = GPIO_AF5_SPI2;
+		HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+		/* SPI2_RX on DMA1 Stream 3 and SPI2_TX on DMA1 Stream 4, both channel 0 */
+		hdmaSpi2Rx.Instance = DMA1_Stream3;
+		hdmaSpi2Rx.Init.Channel = DMA_CHANNEL_0;
+		hdmaSpi2Rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+		hdmaSpi2Rx.Init.PeriphInc = DMA_PINC_DISABLE;
+		hdmaSpi2Rx.Init.MemInc = DMA_MINC_ENABLE;
+		hdmaSpi2Rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+		hdmaSpi2Rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+		hdmaSpi2Rx.Init.Mode = DMA_NORMAL;
+		hdmaSpi2Rx.Init.Priority = DMA_PRIORITY_HIGH;
+		hdmaSpi2Rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+		HAL_DMA_Init(&hdmaSpi2Rx);
+		__HAL_LINKDMA(hspi, hdmarx, hdmaSpi2Rx);
+
+		hdmaSpi2Tx.Instance = DMA1_Stream4;
+		hdmaSpi2Tx.Init = hdmaSpi2Rx.Init;
+		hdmaSpi2Tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+		hdmaSpi2Tx.Init.Priority = DMA_PRIORITY_LOW;
+		HAL_DMA_Init(&hdmaSpi2Tx);
+		__HAL_LINKDMA(hspi, hdmatx, hdmaSpi2Tx);
+
+		/* Same level as I2C1, sensor transfers are chained from these */
+		HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+		HAL_NVIC_SetPriority(DMA1_Stream4_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(DMA1_Stream4_IRQn);
+		HAL_NVIC_SetPriority(SPI2_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(SPI2_IRQn);
 	}
 }
 
@@ -117,6 +260,10 @@ void HAL_RTC_MspInit(RTC_HandleTypeDef *hrtc)
 
 	// 3. Enable the RTC clock
 	__HAL_RCC_RTC_ENABLE();
+
+	// 4. The second alarm restarts the frame period of TIM6, at its priority neither preempts the other
+	HAL_NVIC_SetPriority(RTC_Alarm_IRQn, 15, 0);
+	HAL_NVIC_EnableIRQ(RTC_Alarm_IRQn);
 }
 
 /**
@@ -153,12 +300,57 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
  */
 void HAL_TIM_Base_MspInit(TIM_HandleTypeDef *htim)
 {
-	// Enable clock for the TIM6 peripheral
-	__HAL_RCC_TIM6_CLK_ENABLE();
+	if (htim->Instance == TIM6)
+	{
+		// Enable clock for the TIM6 peripheral
+		__HAL_RCC_TIM6_CLK_ENABLE();
+
+		// Enable the IRQ of TIM6
+		HAL_NVIC_EnableIRQ(TIM6_DAC_IRQn);
+
+		// Setup the priority for TIM6_DAC_IRQn
+		HAL_NVIC_SetPriority(TIM6_DAC_IRQn, 15, 0);
+	}
+	else if (htim->Instance == TIM7)
+	{
+		// Enable clock for the TIM7 peripheral
+		__HAL_RCC_TIM7_CLK_ENABLE();
+
+		// Enable the IRQ of TIM7
+		HAL_NVIC_EnableIRQ(TIM7_IRQn);
+
+		// Higher priority than TIM6 to keep the samples evenly spaced
+		HAL_NVIC_SetPriority(TIM7_IRQn, 14, 0);
+	}
+}
+
+/**
+ * @brief Timer input capture MSP Initialization
+ *
+ * @param htim Timer handle pointer
+ */
+void HAL_TIM_IC_MspInit(TIM_HandleTypeDef *htim)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+	if (htim->Instance == TIM2)
+	{
+		// Enable clock for the TIM2 peripheral
+		__HAL_RCC_TIM2_CLK_ENABLE();
+		__HAL_RCC_GPIOA_CLK_ENABLE();
 
-	// Enable the IRQ of TIM6
-	HAL_NVIC_EnableIRQ(TIM6_DAC_IRQn);
+		/**TIM2 GPIO Configuration
+		PA0     ------> TIM2_CH1
+		*/
+		/* Pulled down so no edge is seen while the ESP32 boots */
+		GPIO_InitStruct.Pin = GPIO_PIN_0;
+		GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+		GPIO_InitStruct.Pull = GPIO_PULLDOWN;
+		GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+		GPIO_InitStruct.Alternate = GPIO_AF1_TIM2;
+		HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
-	// Setup the priority for TIM6_DAC_IRQn
-	HAL_NVIC_SetPriority(TIM6_DAC_IRQn, 15, 0);
+		// Above the sampling timer, the RTC is read as close to the edge as possible
+		HAL_NVIC_SetPriority(TIM2_IRQn, 13, 0);
+		HAL_NVIC_EnableIRQ(TIM2_IRQn);
+	}
 }
@@ -0,0 +1,111 @@
+/**
+ * @file pps.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the PPS phase detector
+ * @date 2023-01-11
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The RTC can only be read to its 122 us subsecond step, and the reading
+ * is truncated. The capture timer and the RTC run from unrelated clocks, so
+ * the truncation is spread evenly over the step from edge to edge, and
+ * averaging several edges with half a step added resolves the phase well
+ * below the step.
+ */
+#include "pps.h"
+#include "timer.h"
+
+#define PPS_HALF_STEP_US    (1000000 / (2 * (RTC_SYNCH_PREDIV + 1)))
+
+static int64_t phaseSumUs;
+static int32_t firstPhaseUs;
+static uint8_t edgeCount;
+static volatile int32_t offsetUs;
+static volatile uint8_t isOffsetReady;
+static volatile uint8_t isDiscardRequested;
+
+static void PPS_OnEdge(uint32_t captureUs);
+
+App_StatusTypeDef PPS_Init(void)
+{
+	phaseSumUs = 0;
+	edgeCount = 0;
+	isOffsetReady = FALSE;
+	isDiscardRequested = FALSE;
+	return Timer_StartCapture(PPS_OnEdge);
+}
+
+App_StatusTypeDef PPS_GetOffset(int32_t *pOffsetUs)
+{
+	if (!isOffsetReady)
+	{
+		return APP_ERROR;
+	}
+	*pOffsetUs = offsetUs;
+	isOffsetReady = FALSE;
+	return APP_OK;
+}
+
+void PPS_Discard(void)
+{
+	/* The sums belong to the interrupt, it clears them on the next edge */
+	isDiscardRequested = TRUE;
+}
+
+/**
+ * @brief Capture interrupt, the ESP32 marked a second boundary
+ */
+static void PPS_OnEdge(uint32_t captureUs)
+{
+	rtcStamp_t stamp;
+	if (APP_OK != RTC_GetStamp(&stamp))
+	{
+		return;
+	}
+	/* Time from the edge to the RTC reading, the counter wraps cleanly in 32 bits */
+	uint32_t ageUs = Timer_GetCaptureCounterUs() - captureUs;
+	if (isDiscardRequested)
+	{
+		isDiscardRequested = FALSE;
+		phaseSumUs = 0;
+		edgeCount = 0;
+	}
+	if (ageUs > PPS_MAX_EDGE_AGE_US)
+	{
+		return;
+	}
+
+	/* Subseconds on the RTC at the edge, folded to within half a second of it */
+	int32_t phaseUs = (int32_t)((RTC_StampToMicros(&stamp) + PPS_HALF_STEP_US - ageUs) % 1000000);
+	if (phaseUs < 0)
+	{
+		phaseUs += 1000000;
+	}
+	if (phaseUs >= 500000)
+	{
+		phaseUs -= 1000000;
+	}
+	/* Near half a second the fold can split the edges, keep them on the side of the first */
+	if (edgeCount && (phaseUs - firstPhaseUs) > 500000)
+	{
+		phaseUs -= 1000000;
+	}
+	else if (edgeCount && (firstPhaseUs - phaseUs) > 500000)
+	{
+		phaseUs += 1000000;
+	}
+	else if (!edgeCount)
+	{
+		firstPhaseUs = phaseUs;
+	}
+	phaseSumUs += phaseUs;
+
+	if (++edgeCount == PPS_AVERAGE_EDGES)
+	{
+		/* An RTC ahead of the edge shows a positive phase and is held back */
+		offsetUs = (int32_t)(-phaseSumUs / PPS_AVERAGE_EDGES);
+		isOffsetReady = TRUE;
+		phaseSumUs = 0;
+		edgeCount = 0;
+	}
+}
@@ -9,7 +9,8 @@
  */
 #include "rtc.h"
 
-static RTC_HandleTypeDef hrtc;
+RTC_HandleTypeDef hrtc;
+static rtcCallback_t secondCallback;
 
 /**
  * @brief Local helper to convert the date and time
@@ -25,8 +26,8 @@ App_StatusTypeDef RTC_Init(RTC_TimeTypeDef *pTime, RTC_DateTypeDef *pDate, uint3
 	 */
 	hrtc.Instance = RTC;
 	hrtc.Init.HourFormat = RTC_HOURFORMAT_24;
-	hrtc.Init.AsynchPrediv = 127;
-	hrtc.Init.SynchPrediv = 255;
+	hrtc.Init.AsynchPrediv = RTC_ASYNCH_PREDIV;
+	hrtc.Init.SynchPrediv = RTC_SYNCH_PREDIV;
 	hrtc.Init.OutPut = RTC_OUTPUT_DISABLE;
 	hrtc.Init.OutPutPolarity = RTC_OUTPUT_POLARITY_LOW;
 	hrtc.Init.OutPutType = RTC_OUTPUT_TYPE_OPENDRAIN;
@@ -81,6 +82,86 @@ App_StatusTypeDef RTC_SetDateTime(RTC_TimeTypeDef *pTime, RTC_DateTypeDef *pDate
 	return APP_OK;
 }
 
+App_StatusTypeDef RTC_GetStamp(rtcStamp_t *pStamp)
+{
+	if (!pStamp || !hrtc.Instance)
+	{
+		return APP_ERROR;
+	}
+	/* Reading the time locks the date until it is read, the pair is consistent */
+	return RTC_GetDateTime(&pStamp->time, &pStamp->date);
+}
+
+uint32_t RTC_DateToDays(const RTC_DateTypeDef *pDate)
+{
+	/* Days before each month of a common year */
+	static const uint16_t daysBeforeMonth[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+	uint32_t year = pDate->Year;
+	/* RTC years are 2000 to 2099, every fourth one is a leap year, 2000 included */
+	uint32_t days = RTC_DAYS_TO_2000 + (year * 365) + ((year + 3) / 4) + daysBeforeMonth[pDate->Month - 1] + pDate->Date - 1;
+	if (!(year & 3U) && pDate->Month > 2)
+	{
+		days++;
+	}
+	return days;
+}
+
+int64_t RTC_StampToMicros(const rtcStamp_t *pStamp)
+{
+	int64_t seconds = ((int64_t)RTC_DateToDays(&pStamp->date) * 86400) +
+		(pStamp->time.Hours * 3600) + (pStamp->time.Minutes * 60) + pStamp->time.Seconds;
+
+	/* The subsecond counter counts down from SecondFraction. Right after a delaying shift it may be above it */
+	int64_t fraction = (int64_t)pStamp->time.SecondFraction - (int64_t)pStamp->time.SubSeconds;
+	return (seconds * 1000000) + ((fraction * 1000000) / ((int64_t)pStamp->time.SecondFraction + 1));
+}
+
+App_StatusTypeDef RTC_Shift(int32_t micros)
+{
+	if (micros <= -1000000 || micros >= 1000000)
+	{
+		return APP_ERROR;
+	}
+	/* Whole subsecond steps, to the nearest */
+	uint32_t steps = (uint32_t)((((int64_t)(micros < 0 ? -micros : micros) * (RTC_SYNCH_PREDIV + 1)) + 500000) / 1000000);
+	if (!steps)
+	{
+		return APP_OK;
+	}
+	/**
+	 * SUBFS adds to the down-counter, holding the clock back. Advancing is
+	 * adding a whole second and holding back the rest of it.
+	 */
+	HAL_StatusTypeDef status = (micros < 0) ?
+		HAL_RTCEx_SetSynchroShift(&hrtc, RTC_SHIFTADD1S_RESET, steps) :
+		HAL_RTCEx_SetSynchroShift(&hrtc, RTC_SHIFTADD1S_SET, (RTC_SYNCH_PREDIV + 1) - steps);
+	return (HAL_OK == status) ? APP_OK : APP_ERROR;
+}
+
+App_StatusTypeDef RTC_StartSecondTick(rtcCallback_t callback)
+{
+	RTC_AlarmTypeDef alarm = {0};
+	if (!callback)
+	{
+		return APP_ERROR;
+	}
+	secondCallback = callback;
+
+	alarm.Alarm = RTC_ALARM_A;
+	alarm.AlarmMask = RTC_ALARMMASK_ALL;
+	alarm.AlarmSubSecondMask = RTC_ALARMSUBSECONDMASK_ALL;
+	if (HAL_OK != HAL_RTC_SetAlarm_IT(&hrtc, &alarm, RTC_FORMAT_BIN))
+	{
+		return APP_ERROR;
+	}
+	return APP_OK;
+}
+
+void HAL_RTC_AlarmAEventCallback(RTC_HandleTypeDef *hrtc)
+{
+	secondCallback();
+}
+
 char *RTC_GetDayString()
 {
 	RTC_TimeTypeDef sTime = {0};
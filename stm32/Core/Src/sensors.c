@@ -0,0 +1,328 @@
+/**
+ * @file sensors.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the BMP280 sensor registry
+ * @date 2022-11-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "sensors.h"
+
+/**
+ * @brief Acquisition state of a bus
+ */
+typedef enum
+{
+    SENSORS_BUS_IDLE = 0,       /* No round in progress */
+    SENSORS_BUS_TRIGGERING,     /* Starting forced conversions, one sensor after the other */
+    SENSORS_BUS_CONVERTING,     /* Waiting for the last triggered conversion to finish */
+    SENSORS_BUS_READING,        /* Reading results, one sensor after the other */
+}sensorsBusState_t;
+
+/**
+ * @brief Bus shared by one or more sensors
+ */
+typedef struct
+{
+    void *handle;                           /* HAL handle of the bus */
+    uint8_t sensors[SENSORS_MAX_COUNT];     /* Registry indices of the sensors on this bus */
+    uint8_t count;                          /* Number of sensors on this bus */
+    uint8_t cursor;                         /* Position in sensors[] of the transfer in flight */
+    uint32_t measTimeMs;                    /* Longest conversion on this bus in ticks, rounded up */
+    uint32_t transferTimeUs;                /* Bus time of one sensor per round */
+    uint32_t convStartTick;                 /* Tick at which the last trigger completed */
+    volatile sensorsBusState_t state;       /* Acquisition state */
+}sensorsBus_t;
+
+static sensorEntry_t sensors[SENSORS_MAX_COUNT];
+static uint8_t sensorCount;
+static sensorsBus_t buses[SENSORS_MAX_BUSES];
+static uint8_t busCount;
+
+static App_StatusTypeDef Sensors_Add(sensorEntry_t *entry, bmp280_config_t *config, uint32_t transferTimeUs);
+static sensorsBus_t *Sensors_FindBus(void *handle);
+static void Sensors_StartTransfer(sensorsBus_t *bus);
+static void Sensors_AdvanceBus(sensorsBus_t *bus);
+static void Sensors_TransferComplete(void *context, App_StatusTypeDef status);
+
+App_StatusTypeDef Sensors_RegisterI2C(I2C_HandleTypeDef *hi2c, uint8_t i2cAddress, bmp280_config_t *config)
+{
+    if (sensorCount >= SENSORS_MAX_COUNT)
+    {
+        return APP_ERROR;
+    }
+    sensorEntry_t *entry = &sensors[sensorCount];
+    memset(entry, 0, sizeof(*entry));
+    if (APP_OK != BMP280_Bus_InitI2C(&entry->bus, hi2c, i2cAddress))
+    {
+        return APP_ERROR;
+    }
+    return Sensors_Add(entry, config, SENSORS_BUS_TIME_US);
+}
+
+#ifdef HAL_FMPI2C_MODULE_ENABLED
+App_StatusTypeDef Sensors_RegisterFMPI2C(FMPI2C_HandleTypeDef *hfmpi2c, uint8_t i2cAddress, bmp280_config_t *config)
+{
+    if (sensorCount >= SENSORS_MAX_COUNT)
+    {
+        return APP_ERROR;
+    }
+    sensorEntry_t *entry = &sensors[sensorCount];
+    memset(entry, 0, sizeof(*entry));
+    if (APP_OK != BMP280_Bus_InitFMPI2C(&entry->bus, hfmpi2c, i2cAddress))
+    {
+        return APP_ERROR;
+    }
+    return Sensors_Add(entry, config, SENSORS_FMPI2C_BUS_TIME_US);
+}
+#endif
+
+App_StatusTypeDef Sensors_RegisterSPI(SPI_HandleTypeDef *hspi, GPIO_TypeDef *csPort, uint16_t csPin, bmp280_config_t *config)
+{
+    if (sensorCount >= SENSORS_MAX_COUNT)
+    {
+        return APP_ERROR;
+    }
+    sensorEntry_t *entry = &sensors[sensorCount];
+    memset(entry, 0, sizeof(*entry));
+    if (APP_OK != BMP280_Bus_InitSPI(&entry->bus, hspi, csPort, csPin))
+    {
+        return APP_ERROR;
+    }
+    return Sensors_Add(entry, config, SENSORS_SPI_BUS_TIME_US);
+}
+
+uint8_t Sensors_GetCount()
+{
+    return sensorCount;
+}
+
+bmp280_t *Sensors_GetDevice(uint8_t index)
+{
+    if (index >= sensorCount)
+    {
+        return NULL;
+    }
+    return &sensors[index].dev;
+}
+
+uint32_t Sensors_GetLeadTimeUs()
+{
+    uint32_t leadTimeUs = 0;
+    for (uint8_t i = 0; i < busCount; i++)
+    {
+        /* One extra tick for the conversion wait, which is polled from SysTick */
+        uint32_t busTimeUs = ((buses[i].measTimeMs + 1U) * 1000U) + (buses[i].count * buses[i].transferTimeUs);
+        if (busTimeUs > leadTimeUs)
+        {
+            leadTimeUs = busTimeUs;
+        }
+    }
+    return leadTimeUs;
+}
+
+App_StatusTypeDef Sensors_StartRound()
+{
+    App_StatusTypeDef status = APP_OK;
+    for (uint8_t i = 0; i < busCount; i++)
+    {
+        sensorsBus_t *bus = &buses[i];
+        if (bus->state != SENSORS_BUS_IDLE)
+        {
+            /* Previous round still running on this bus */
+            status = APP_ERROR;
+            continue;
+        }
+        bus->cursor = 0;
+        bus->state = SENSORS_BUS_TRIGGERING;
+        Sensors_StartTransfer(bus);
+    }
+    return status;
+}
+
+App_StatusTypeDef Sensors_GetReading(uint8_t index, int32_t *temperature, uint32_t *pressure)
+{
+    if (index >= sensorCount || !temperature || !sensors[index].isValid)
+    {
+        return APP_ERROR;
+    }
+    *temperature = sensors[index].temperature;
+    if (pressure)
+    {
+        *pressure = sensors[index].pressure;
+    }
+    return APP_OK;
+}
+
+/**
+ * @brief SysTick hook, moves buses from converting to reading once the conversion time is up
+ */
+void HAL_SYSTICK_Callback(void)
+{
+    for (uint8_t i = 0; i < busCount; i++)
+    {
+        sensorsBus_t *bus = &buses[i];
+        if (bus->state == SENSORS_BUS_CONVERTING && (HAL_GetTick() - bus->convStartTick) > bus->measTimeMs)
+        {
+            bus->cursor = 0;
+            bus->state = SENSORS_BUS_READING;
+            Sensors_StartTransfer(bus);
+        }
+    }
+}
+
+/**
+ * @brief Bring up a sensor on its transport, verify its config and group it with its bus
+ */
+static App_StatusTypeDef Sensors_Add(sensorEntry_t *entry, bmp280_config_t *config, uint32_t transferTimeUs)
+{
+    if (!config)
+    {
+        return APP_ERROR;
+    }
+    sensorsBus_t *bus = Sensors_FindBus(entry->bus.handle);
+    if (!bus)
+    {
+        if (busCount >= SENSORS_MAX_BUSES)
+        {
+            return APP_ERROR;
+        }
+        bus = &buses[busCount];
+        memset(bus, 0, sizeof(*bus));
+        bus->handle = entry->bus.handle;
+        bus->transferTimeUs = transferTimeUs;
+    }
+    if (APP_OK != BMP280_Init(&entry->dev, &entry->bus))
+    {
+        return APP_ERROR;
+    }
+    if (APP_OK != BMP280_SetConfig(&entry->dev, config))
+    {
+        return APP_ERROR;
+    }
+    /* Confirm that the config values have been set corectly */
+    bmp280_config_t readConfig;
+    if (APP_OK != BMP280_GetConfig(&entry->dev, &readConfig))
+    {
+        return APP_ERROR;
+    }
+    /* In forced mode the sensor drops back to sleep once the conversion is done */
+    if (config->filter != readConfig.filter ||
+        (readConfig.mode != config->mode && readConfig.mode != BMP280_MODE_SLEEP) ||
+        config->tempOversampling != readConfig.tempOversampling ||
+        config->pressOversampling != readConfig.pressOversampling ||
+        config->tStandby != readConfig.tStandby)
+    {
+        return APP_ERROR;
+    }
+
+    /* Only commit the bus once a sensor has been found on it */
+    if (bus == &buses[busCount])
+    {
+        busCount++;
+    }
+    uint32_t measTimeMs = (entry->dev.measTimeUs + 999U) / 1000U;
+    if (measTimeMs > bus->measTimeMs)
+    {
+        bus->measTimeMs = measTimeMs;
+    }
+    BMP280_Bus_SetCallback(&entry->bus, Sensors_TransferComplete, bus);
+    bus->sensors[bus->count++] = sensorCount;
+    sensorCount++;
+    return APP_OK;
+}
+
+/**
+ * @brief Find the bus entry of a HAL handle
+ * @return sensorsBus_t* NULL if no sensor has been registered on the bus
+ */
+static sensorsBus_t *Sensors_FindBus(void *handle)
+{
+    for (uint8_t i = 0; i < busCount; i++)
+    {
+        if (buses[i].handle == handle)
+        {
+            return &buses[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start the transfer of the current state for the sensor at the cursor
+ */
+static void Sensors_StartTransfer(sensorsBus_t *bus)
+{
+    bmp280_t *dev = &sensors[bus->sensors[bus->cursor]].dev;
+    App_StatusTypeDef status;
+    if (bus->state == SENSORS_BUS_TRIGGERING)
+    {
+        status = BMP280_TriggerForcedMeasurement_IT(dev);
+    }
+    else
+    {
+        status = BMP280_ReadRaw_IT(dev);
+    }
+    if (APP_OK != status)
+    {
+        Sensors_AdvanceBus(bus);
+    }
+}
+
+/**
+ * @brief Move on to the next sensor of the bus or to the next state
+ */
+static void Sensors_AdvanceBus(sensorsBus_t *bus)
+{
+    bus->cursor++;
+    if (bus->cursor < bus->count)
+    {
+        Sensors_StartTransfer(bus);
+        return;
+    }
+    if (bus->state == SENSORS_BUS_TRIGGERING)
+    {
+        /* Publish the tick before the state, SysTick acts on the state */
+        bus->convStartTick = HAL_GetTick();
+        bus->state = SENSORS_BUS_CONVERTING;
+    }
+    else
+    {
+        bus->state = SENSORS_BUS_IDLE;
+    }
+}
+
+/**
+ * @brief Transport callback, stores a reading and chains the next transfer of the bus
+ * A failing sensor is skipped and keeps its previous reading.
+ */
+static void Sensors_TransferComplete(void *context, App_StatusTypeDef status)
+{
+    sensorsBus_t *bus = context;
+    if (bus->state == SENSORS_BUS_READING && status == APP_OK)
+    {
+        sensorEntry_t *entry = &sensors[bus->sensors[bus->cursor]];
+        int32_t tempAdc;
+        int32_t pressAdc;
+        int32_t temperature;
+        uint32_t pressure = 0;
+        BMP280_GetRawFromBuffer(&entry->dev, &tempAdc, &pressAdc);
+        if (entry->dev.config.pressOversampling != BMP280_SAMPLING_NONE)
+        {
+            BMP280_CompensateBatch(&entry->dev, &tempAdc, &pressAdc, &temperature, &pressure, 1);
+        }
+        else
+        {
+            temperature = BMP280_CompensateTemperature(&entry->dev, tempAdc);
+        }
+        entry->temperature = temperature;
+        entry->pressure = pressure;
+        entry->isValid = TRUE;
+    }
+    if (bus->state == SENSORS_BUS_TRIGGERING || bus->state == SENSORS_BUS_READING)
+    {
+        Sensors_AdvanceBus(bus);
+    }
+}
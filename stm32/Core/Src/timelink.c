@@ -0,0 +1,394 @@
+/**
+ * @file timelink.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the ESP32 time link
+ * @date 2023-01-04
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The DMA writes every byte clocked in to a ring and is only stopped to
+ * recover from an error. Frames are cut out of the ring at the NSS rising
+ * edge, using the DMA position, so the receive path never waits on the
+ * main loop and the main loop never waits on the ESP32.
+ *
+ * The same edge restarts the TX DMA on the latest telemetry frame, which
+ * the ESP32 clocks in during its next exchange at no extra cost.
+ *
+ * The ESP32 only pushes a frame of its own now and then, frames are asked
+ * for with the request line. The same edge lowers it again.
+ */
+#include <string.h>
+#include "timelink.h"
+
+#define TIMELINK_TX_NONE    (0xFFU)
+#define TIMELINK_MODER_INPUT (0x0U)
+#define TIMELINK_MODER_AF   (0x2U)
+
+static SPI_HandleTypeDef *linkSpi;
+static uint8_t isSharedBus;
+static uint8_t rxRing[TIMELINK_RX_BUF_SIZE];
+static uint16_t frameStart;                 /* Ring offset of the exchange being clocked in */
+
+/* Ping-pong frame buffers, filled by the NSS interrupt and emptied by the parser in turn */
+static uint8_t frames[2][TIMESYNC_EXCHANGE_LEN];
+static rtcStamp_t frameStamps[2];
+static uint8_t isFrameStamped[2];
+static volatile uint8_t isFrameReady[2];
+static uint8_t fillIndex;
+static uint8_t parseIndex;
+
+/* Ping-pong telemetry buffers, the DMA sends one while the other is staged */
+static uint8_t txFrames[2][TIMESYNC_EXCHANGE_LEN];
+static volatile uint8_t activeTx;           /* Buffer of the current exchange, moved on by the interrupt */
+static volatile uint8_t nextTx;             /* Buffer for the next exchange, TIMELINK_TX_NONE while staging */
+static uint8_t txSequence;
+static uint8_t ackSequence;
+
+static volatile uint8_t isRequestPending;   /* Raise the request line once it has been low long enough */
+static volatile uint32_t requestLowTick;    /* HAL tick the request line was last lowered */
+
+static timeLinkStats_t linkStats;
+static timeLinkContentCallback_t contentCallback;
+
+static App_StatusTypeDef TimeLink_Start(void);
+static void TimeLink_StartTx(void);
+static void TimeLink_Restart(void);
+static void TimeLink_DriveMiso(uint8_t isDriven);
+static void TimeLink_SetRequest(uint8_t isRaised);
+static void TimeLink_RaisePendingRequest(void);
+static enum timesync_status TimeLink_TakeContent(const uint8_t * exchange);
+
+static inline uint8_t TimeLink_RingByte(uint16_t offset)
+{
+	return rxRing[(frameStart + offset) % TIMELINK_RX_BUF_SIZE];
+}
+
+static inline uint16_t TimeLink_Saturate(uint32_t count)
+{
+	return (count > UINT16_MAX) ? UINT16_MAX : (uint16_t)count;
+}
+
+App_StatusTypeDef TimeLink_Init(SPI_HandleTypeDef *hspi, uint8_t isShared)
+{
+	if (!hspi || !hspi->hdmarx || !hspi->hdmatx)
+	{
+		return APP_ERROR;
+	}
+	linkSpi = hspi;
+	isSharedBus = isShared;
+	memset(&linkStats, 0, sizeof(linkStats));
+	memset(txFrames, 0, sizeof(txFrames));
+	isFrameReady[0] = FALSE;
+	isFrameReady[1] = FALSE;
+	fillIndex = 0;
+	parseIndex = 0;
+	activeTx = 0;
+	nextTx = TIMELINK_TX_NONE;
+
+	/* The ESP32 holds its input lowered while the STM32 boots */
+	TimeLink_SetRequest(FALSE);
+	GPIO_InitTypeDef requestPin = {0};
+	requestPin.Pin = TIMELINK_REQ_PIN;
+	requestPin.Mode = isSharedBus ? GPIO_MODE_OUTPUT_OD : GPIO_MODE_OUTPUT_PP;
+	requestPin.Pull = GPIO_NOPULL;
+	requestPin.Speed = GPIO_SPEED_FREQ_LOW;
+	HAL_GPIO_Init(TIMELINK_REQ_PORT, &requestPin);
+
+	/* PA15 stays the NSS alternate function, its edges reach the EXTI all the same */
+	SYSCFG->EXTICR[3] = (SYSCFG->EXTICR[3] & ~SYSCFG_EXTICR4_EXTI15) | SYSCFG_EXTICR4_EXTI15_PA;
+	EXTI->RTSR |= TIMELINK_NSS_PIN;
+	if (isSharedBus)
+	{
+		/* The falling edge hands MISO to this node */
+		EXTI->FTSR |= TIMELINK_NSS_PIN;
+	}
+	else
+	{
+		EXTI->FTSR &= ~TIMELINK_NSS_PIN;
+	}
+	EXTI->PR = TIMELINK_NSS_PIN;
+	EXTI->IMR |= TIMELINK_NSS_PIN;
+
+	return TimeLink_Start();
+}
+
+App_StatusTypeDef TimeLink_GetTime(timeLinkFrame_t *frame)
+{
+	App_StatusTypeDef result = APP_ERROR;
+	struct timesync_time frameTime;
+	uint8_t sequence;
+
+	TimeLink_RaisePendingRequest();
+	while (isFrameReady[parseIndex])
+	{
+		/* The CRC byte is part of the exchange, decoding checks it */
+		enum timesync_status status = timesync_decode_time(frames[parseIndex], TIMESYNC_EXCHANGE_LEN, &sequence, &frameTime);
+		if (TIMESYNC_OK == status)
+		{
+			frame->time = frameTime;
+			frame->sequence = sequence;
+			frame->isStamped = isFrameStamped[parseIndex];
+			frame->received = frameStamps[parseIndex];
+		}
+		uint8_t isTime = (TIMESYNC_OK == status);
+		if (TIMESYNC_ERR_TYPE == status)
+		{
+			/* Taken before the buffer goes back to the interrupt, the text is not copied */
+			status = TimeLink_TakeContent(frames[parseIndex]);
+		}
+		isFrameReady[parseIndex] = FALSE;
+		parseIndex ^= 1U;
+
+		if (isTime)
+		{
+			linkStats.frames++;
+			ackSequence = sequence;
+			result = APP_OK;
+		}
+		else if (TIMESYNC_ERR_CRC == status)
+		{
+			linkStats.crcErrors++;
+		}
+	}
+	return result;
+}
+
+void TimeLink_SetContentCallback(timeLinkContentCallback_t callback)
+{
+	contentCallback = callback;
+}
+
+void TimeLink_RequestTime(void)
+{
+	/* The output register, the pin of a shared line may be held by another node */
+	uint8_t isRaised = (0U != (TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN)) ^ isSharedBus;
+	if (isRaised)
+	{
+		TimeLink_SetRequest(FALSE);
+	}
+	isRequestPending = TRUE;
+	TimeLink_RaisePendingRequest();
+}
+
+void TimeLink_SetTelemetry(struct timesync_telemetry *telemetry)
+{
+	telemetry->crc_errors = TimeLink_Saturate(linkStats.crcErrors);
+	telemetry->framing_errors = TimeLink_Saturate(linkStats.framingErrors);
+	telemetry->dropped = TimeLink_Saturate(linkStats.dropped);
+	telemetry->ack_sequence = ackSequence;
+
+	/**
+	 * The interrupt only moves to the buffer named by nextTx, so once nextTx
+	 * names neither the one not being sent can be written.
+	 */
+	nextTx = TIMELINK_TX_NONE;
+	__DMB();
+	uint8_t stageIndex = activeTx ^ 1U;
+	timesync_encode_telemetry(txFrames[stageIndex], txSequence++, telemetry);
+	__DMB();
+	nextTx = stageIndex;
+}
+
+void TimeLink_GetStats(timeLinkStats_t *stats)
+{
+	*stats = linkStats;
+}
+
+/**
+ * @brief NSS rising edge, the ESP32 finished an exchange
+ * Runs at TIMELINK_IRQ_PRIORITY, the level of the SPI3 and its DMA
+ * interrupts, so a restart never preempts them nor is preempted by them. On a shared bus the falling edge comes here too.
+ */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	if (GPIO_Pin != TIMELINK_NSS_PIN || !linkSpi)
+	{
+		return;
+	}
+	if (isSharedBus && GPIO_PIN_RESET == HAL_GPIO_ReadPin(TIMELINK_NSS_PORT, TIMELINK_NSS_PIN))
+	{
+		TimeLink_DriveMiso(TRUE);
+		return;
+	}
+	/* T2 of the exchange, taken before anything else */
+	rtcStamp_t stamp = {0};
+	uint8_t isStamped = (APP_OK == RTC_GetStamp(&stamp));
+	if (isSharedBus)
+	{
+		TimeLink_DriveMiso(FALSE);
+	}
+
+	/* Whatever came of it, this exchange answered any request */
+	isRequestPending = FALSE;
+	TimeLink_SetRequest(FALSE);
+
+	/* An overrun or DMA error stopped the reception */
+	if (HAL_SPI_STATE_BUSY_RX != linkSpi->State)
+	{
+		linkStats.framingErrors++;
+		TimeLink_Restart();
+		return;
+	}
+
+	uint16_t end = (uint16_t)((TIMELINK_RX_BUF_SIZE - __HAL_DMA_GET_COUNTER(linkSpi->hdmarx)) % TIMELINK_RX_BUF_SIZE);
+	uint16_t length = (uint16_t)((end + TIMELINK_RX_BUF_SIZE - frameStart) % TIMELINK_RX_BUF_SIZE);
+	if (!length)
+	{
+		/* NSS glitch without clocks */
+		return;
+	}
+
+	/**
+	 * A byte cut short by a glitch leaves its bits in the shift register and
+	 * every later byte shifted, a short exchange leaves telemetry bytes in the
+	 * TX buffer. Only a reset of the SPI gets both back in step, do it now
+	 * while NSS is high and no exchange is coming.
+	 */
+	if (length != TIMESYNC_EXCHANGE_LEN ||
+		TimeLink_RingByte(0) != TIMESYNC_SYNC_0 || TimeLink_RingByte(1) != TIMESYNC_SYNC_1 ||
+		TIMESYNC_HEADER_LEN + TimeLink_RingByte(4) + TIMESYNC_CRC_LEN > TIMESYNC_EXCHANGE_LEN)
+	{
+		linkStats.framingErrors++;
+		TimeLink_Restart();
+		return;
+	}
+
+	if (isFrameReady[fillIndex])
+	{
+		linkStats.dropped++;
+	}
+	else
+	{
+		for (uint16_t i = 0; i < length; i++)
+		{
+			frames[fillIndex][i] = TimeLink_RingByte(i);
+		}
+		frameStamps[fillIndex] = stamp;
+		isFrameStamped[fillIndex] = isStamped;
+		isFrameReady[fillIndex] = TRUE;
+		fillIndex ^= 1U;
+	}
+	frameStart = end;
+	TimeLink_StartTx();
+}
+
+static App_StatusTypeDef TimeLink_Start(void)
+{
+	frameStart = 0;
+	if (HAL_OK != HAL_SPI_Receive_DMA(linkSpi, rxRing, TIMELINK_RX_BUF_SIZE))
+	{
+		return APP_ERROR;
+	}
+	/* Frames are found from the NSS edges, the wrap of the ring needs no interrupt */
+	__HAL_DMA_DISABLE_IT(linkSpi->hdmarx, DMA_IT_HT | DMA_IT_TC);
+
+	/* The HAL has no slave transmit beside a circular receive, the TX stream is driven directly */
+	linkSpi->hdmatx->XferCpltCallback = NULL;
+	linkSpi->hdmatx->XferHalfCpltCallback = NULL;
+	linkSpi->hdmatx->XferErrorCallback = NULL;
+	TimeLink_StartTx();
+	SET_BIT(linkSpi->Instance->CR2, SPI_CR2_TXDMAEN);
+
+	/* The MSP made MISO push-pull, as every reset of the SPI does */
+	if (isSharedBus)
+	{
+		SET_BIT(TIMELINK_MISO_PORT->OTYPER, TIMELINK_MISO_PIN);
+		TimeLink_DriveMiso(GPIO_PIN_RESET == HAL_GPIO_ReadPin(TIMELINK_NSS_PORT, TIMELINK_NSS_PIN));
+	}
+	return APP_OK;
+}
+
+static void TimeLink_StartTx(void)
+{
+	if (TIMELINK_TX_NONE != nextTx)
+	{
+		activeTx = nextTx;
+	}
+	/* The stream has loaded the whole frame by the time NSS rises, unless the exchange was cut short */
+	if (HAL_DMA_STATE_READY != linkSpi->hdmatx->State)
+	{
+		HAL_DMA_Abort(linkSpi->hdmatx);
+	}
+	HAL_DMA_Start_IT(linkSpi->hdmatx, (uint32_t)(uintptr_t)txFrames[activeTx], (uint32_t)(uintptr_t)&linkSpi->Instance->DR,
+					 TIMESYNC_EXCHANGE_LEN);
+}
+
+/**
+ * @brief Switch MISO between the SPI and an input, other nodes drive it while this one is not selected
+ */
+static void TimeLink_DriveMiso(uint8_t isDriven)
+{
+	uint32_t position = 2U * POSITION_VAL(TIMELINK_MISO_PIN);
+	MODIFY_REG(TIMELINK_MISO_PORT->MODER, GPIO_MODER_MODER0 << position,
+			   (isDriven ? TIMELINK_MODER_AF : TIMELINK_MODER_INPUT) << position);
+}
+
+/**
+ * @brief Drive the request line, active low and open-drain on a shared bus
+ */
+static void TimeLink_SetRequest(uint8_t isRaised)
+{
+	if (!isRaised)
+	{
+		requestLowTick = HAL_GetTick();
+	}
+	HAL_GPIO_WritePin(TIMELINK_REQ_PORT, TIMELINK_REQ_PIN, (isRaised ^ isSharedBus) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+/**
+ * @brief Raise the request line of a request once the line has been low
+ * for TIMELINK_REQ_MIN_LOW_MS. An exchange in between answers the request.
+ */
+static void TimeLink_RaisePendingRequest(void)
+{
+	if (!isRequestPending)
+	{
+		return;
+	}
+	/* An exchange ending between the check and the write would answer the request and leave the line raised */
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (isRequestPending && HAL_GetTick() - requestLowTick >= TIMELINK_REQ_MIN_LOW_MS)
+	{
+		isRequestPending = FALSE;
+		TimeLink_SetRequest(TRUE);
+	}
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Hand a content frame to the callback
+ *
+ * @param exchange Frame buffer that was not a time frame
+ * @return enum timesync_status TIMESYNC_ERR_TYPE if it is not a content frame either
+ */
+static enum timesync_status TimeLink_TakeContent(const uint8_t *exchange)
+{
+	struct timesync_content content;
+	uint8_t sequence;
+
+	enum timesync_status status = timesync_decode_content(exchange, TIMESYNC_EXCHANGE_LEN, &sequence, &content);
+	if (TIMESYNC_OK == status)
+	{
+		linkStats.contents++;
+		if (contentCallback)
+		{
+			contentCallback(&content);
+		}
+	}
+	return status;
+}
+
+static void TimeLink_Restart(void)
+{
+	HAL_SPI_DMAStop(linkSpi);
+	HAL_SPI_DeInit(linkSpi);
+	/* Disabling the SPI does not clear a partly shifted byte, a peripheral reset does */
+	__HAL_RCC_SPI3_FORCE_RESET();
+	__HAL_RCC_SPI3_RELEASE_RESET();
+	if (HAL_OK != HAL_SPI_Init(linkSpi))
+	{
+		return;
+	}
+	TimeLink_Start();
+}
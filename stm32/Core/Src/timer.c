@@ -12,16 +12,26 @@
 
 timerLocalData_t timerLocalData;
 
+/**
+ * @brief Local helper to get the input clock of the APB1 timers
+ *
+ * @return uint32_t Timer clock in Hz
+ */
+static uint32_t Timer_GetAPB1TimerClock(void);
+
 App_StatusTypeDef Timer_Init()
 {
 	timerLocalData.htimer6.Instance = TIM6;
 	timerLocalData.htimer6.Init.CounterMode = TIM_COUNTERMODE_UP;
+	/* A frame every 100 ms, rephased onto every RTC second by Timer_Rephase() */
 	timerLocalData.htimer6.Init.Prescaler = 83;
 	timerLocalData.htimer6.Init.Period = 59551 - 1;
 	if (HAL_OK != HAL_TIM_Base_Init(&timerLocalData.htimer6))
 	{
 		return APP_ERROR;
 	}
+
+	timerLocalData.counterClockHz = Timer_GetAPB1TimerClock() / (timerLocalData.htimer6.Init.Prescaler + 1);
 	return APP_OK;
 }
 
@@ -44,7 +54,111 @@ uint8_t Timer_HasTimerExpired()
 	return FALSE;
 }
 
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+void Timer_Rephase()
 {
+	/* Called at the priority of TIM6, its update interrupt can not run in between */
+	__HAL_TIM_SET_COUNTER(&timerLocalData.htimer6, 0);
 	timerLocalData.hasTimerExpired = TRUE;
 }
+
+uint32_t Timer_GetTimeToExpiryUs()
+{
+	uint32_t ticksLeft = __HAL_TIM_GET_AUTORELOAD(&timerLocalData.htimer6) - __HAL_TIM_GET_COUNTER(&timerLocalData.htimer6);
+	return (uint32_t)(((uint64_t)ticksLeft * 1000000U) / timerLocalData.counterClockHz);
+}
+
+App_StatusTypeDef Timer_StartSampling(uint32_t periodUs, timerCallback_t callback)
+{
+	if (!callback || periodUs == 0)
+	{
+		return APP_ERROR;
+	}
+	timerLocalData.samplingCallback = callback;
+
+	/* Count in microseconds */
+	timerLocalData.htimer7.Instance = TIM7;
+	timerLocalData.htimer7.Init.CounterMode = TIM_COUNTERMODE_UP;
+	timerLocalData.htimer7.Init.Prescaler = (Timer_GetAPB1TimerClock() / 1000000U) - 1;
+	timerLocalData.htimer7.Init.Period = periodUs - 1;
+	if (HAL_OK != HAL_TIM_Base_Init(&timerLocalData.htimer7))
+	{
+		return APP_ERROR;
+	}
+	if (HAL_OK != HAL_TIM_Base_Start_IT(&timerLocalData.htimer7))
+	{
+		return APP_ERROR;
+	}
+	return APP_OK;
+}
+
+App_StatusTypeDef Timer_StartCapture(timerCaptureCallback_t callback)
+{
+	TIM_IC_InitTypeDef icConfig = {0};
+	if (!callback)
+	{
+		return APP_ERROR;
+	}
+	timerLocalData.captureCallback = callback;
+
+	/* TIM2 is 32 bit, counting in microseconds it runs freely over any interval of interest */
+	timerLocalData.htimer2.Instance = TIM2;
+	timerLocalData.htimer2.Init.CounterMode = TIM_COUNTERMODE_UP;
+	timerLocalData.htimer2.Init.Prescaler = (Timer_GetAPB1TimerClock() / 1000000U) - 1;
+	timerLocalData.htimer2.Init.Period = 0xFFFFFFFFU;
+	if (HAL_OK != HAL_TIM_IC_Init(&timerLocalData.htimer2))
+	{
+		return APP_ERROR;
+	}
+	icConfig.ICPolarity = TIM_ICPOLARITY_RISING;
+	icConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
+	icConfig.ICPrescaler = TIM_ICPSC_DIV1;
+	icConfig.ICFilter = 0x3;	/* 8 samples at the timer clock, ringing on the wire is ignored */
+	if (HAL_OK != HAL_TIM_IC_ConfigChannel(&timerLocalData.htimer2, &icConfig, TIM_CHANNEL_1))
+	{
+		return APP_ERROR;
+	}
+	if (HAL_OK != HAL_TIM_IC_Start_IT(&timerLocalData.htimer2, TIM_CHANNEL_1))
+	{
+		return APP_ERROR;
+	}
+	return APP_OK;
+}
+
+uint32_t Timer_GetCaptureCounterUs()
+{
+	return __HAL_TIM_GET_COUNTER(&timerLocalData.htimer2);
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	if (htim->Instance == TIM6)
+	{
+		timerLocalData.hasTimerExpired = TRUE;
+	}
+	else if (htim->Instance == TIM7)
+	{
+		timerLocalData.samplingCallback();
+	}
+}
+
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+	if (htim->Instance == TIM2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1)
+	{
+		timerLocalData.captureCallback(HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_1));
+	}
+}
+
+static uint32_t Timer_GetAPB1TimerClock()
+{
+	/* APB1 timers run at twice PCLK1 whenever the APB1 prescaler is not 1 */
+	RCC_ClkInitTypeDef clkConfig;
+	uint32_t flashLatency;
+	HAL_RCC_GetClockConfig(&clkConfig, &flashLatency);
+	uint32_t timerClockHz = HAL_RCC_GetPCLK1Freq();
+	if (clkConfig.APB1CLKDivider != RCC_HCLK_DIV1)
+	{
+		timerClockHz *= 2;
+	}
+	return timerClockHz;
+}
@@ -0,0 +1,264 @@
+/**
+ * @file tscodec.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the time-series codec
+ * @date 2022-12-29
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Gorilla style bit stream, most significant bit first. The first sample
+ * of a block is stored whole. After it, timestamps are stored as the change
+ * of the sampling interval (delta-of-delta) and readings as the change from
+ * the previous one, both zig-zag mapped to unsigned and packed into one of
+ * five buckets picked by the number of leading 1 bits of a prefix.
+ */
+#include <string.h>
+#include "tscodec.h"
+
+#define TSCODEC_BUCKETS     (5)
+
+/**
+ * @brief Bucket with its index in leading 1s, terminated by a 0 except for the last
+ */
+typedef struct
+{
+    uint8_t prefixBits;
+    uint8_t valueBits;
+}tsBucket_t;
+
+/* Steady sampling is the common case, jitter of a few seconds the next */
+static const tsBucket_t timeBuckets[TSCODEC_BUCKETS] = {{1, 0}, {2, 7}, {3, 9}, {4, 12}, {4, 32}};
+/* Minute averages mostly move by a count or two */
+static const tsBucket_t valueBuckets[TSCODEC_BUCKETS] = {{1, 0}, {2, 2}, {3, 5}, {4, 9}, {4, 32}};
+
+static uint8_t TsCodec_PickBucket(const tsBucket_t *buckets, uint32_t value);
+static void TsCodec_PutBits(tsEncoder_t *enc, uint32_t value, uint8_t bits);
+static void TsCodec_PutValue(tsEncoder_t *enc, const tsBucket_t *buckets, uint32_t value);
+static App_StatusTypeDef TsCodec_GetBits(tsDecoder_t *dec, uint8_t bits, uint32_t *value);
+static App_StatusTypeDef TsCodec_GetValue(tsDecoder_t *dec, const tsBucket_t *buckets, uint32_t *value);
+
+static inline uint32_t TsCodec_ZigZag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t TsCodec_UnZigZag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1U);
+}
+
+void TsCodec_InitEncoder(tsEncoder_t *enc, uint8_t *buf, uint16_t capacity)
+{
+    memset(enc, 0, sizeof(*enc));
+    memset(buf, 0, capacity);
+    enc->buf = buf;
+    enc->capacityBits = capacity * 8U;
+}
+
+App_StatusTypeDef TsCodec_ResumeEncoder(tsEncoder_t *enc, uint8_t *buf, uint16_t capacity, uint16_t length, uint16_t count)
+{
+    if (length > capacity)
+    {
+        return APP_ERROR;
+    }
+    tsDecoder_t dec;
+    tsSample_t sample;
+    TsCodec_InitDecoder(&dec, buf, length, count);
+    while (dec.remaining)
+    {
+        if (APP_OK != TsCodec_Decode(&dec, &sample))
+        {
+            return APP_ERROR;
+        }
+    }
+
+    /* Bits are ORed in, everything past the last sample must be clear */
+    if (dec.bitPos & 7U)
+    {
+        buf[dec.bitPos >> 3] &= (uint8_t)(0xFF00U >> (dec.bitPos & 7U));
+    }
+    memset(&buf[(dec.bitPos + 7) >> 3], 0, capacity - ((dec.bitPos + 7) >> 3));
+
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->capacityBits = capacity * 8U;
+    enc->bitPos = dec.bitPos;
+    enc->count = dec.count;
+    enc->prev = dec.prev;
+    enc->prevDelta = dec.prevDelta;
+    return APP_OK;
+}
+
+App_StatusTypeDef TsCodec_Encode(tsEncoder_t *enc, const tsSample_t *sample)
+{
+    if (!enc || !sample || (enc->count && sample->timestamp < enc->prev.timestamp) || enc->count == UINT16_MAX)
+    {
+        return APP_ERROR;
+    }
+
+    if (!enc->count)
+    {
+        if (enc->bitPos + 32 + 16 + 32 > enc->capacityBits)
+        {
+            return APP_ERROR;
+        }
+        TsCodec_PutBits(enc, sample->timestamp, 32);
+        TsCodec_PutBits(enc, (uint16_t)sample->temperature, 16);
+        TsCodec_PutBits(enc, sample->pressure, 32);
+    }
+    else
+    {
+        /* Differences wrap modulo 2^32, the decoder undoes them the same way */
+        uint32_t delta = sample->timestamp - enc->prev.timestamp;
+        uint32_t timeValue = TsCodec_ZigZag((int32_t)(delta - enc->prevDelta));
+        uint32_t tempValue = TsCodec_ZigZag((int32_t)sample->temperature - enc->prev.temperature);
+        uint32_t pressValue = TsCodec_ZigZag((int32_t)(sample->pressure - enc->prev.pressure));
+
+        const tsBucket_t *timeBucket = &timeBuckets[TsCodec_PickBucket(timeBuckets, timeValue)];
+        const tsBucket_t *tempBucket = &valueBuckets[TsCodec_PickBucket(valueBuckets, tempValue)];
+        const tsBucket_t *pressBucket = &valueBuckets[TsCodec_PickBucket(valueBuckets, pressValue)];
+        uint32_t bits = timeBucket->prefixBits + timeBucket->valueBits +
+                        tempBucket->prefixBits + tempBucket->valueBits +
+                        pressBucket->prefixBits + pressBucket->valueBits;
+        if (enc->bitPos + bits > enc->capacityBits)
+        {
+            return APP_ERROR;
+        }
+        TsCodec_PutValue(enc, timeBuckets, timeValue);
+        TsCodec_PutValue(enc, valueBuckets, tempValue);
+        TsCodec_PutValue(enc, valueBuckets, pressValue);
+        enc->prevDelta = delta;
+    }
+    enc->prev = *sample;
+    enc->count++;
+    return APP_OK;
+}
+
+uint16_t TsCodec_GetLength(const tsEncoder_t *enc)
+{
+    return (uint16_t)((enc->bitPos + 7) / 8);
+}
+
+void TsCodec_InitDecoder(tsDecoder_t *dec, const uint8_t *buf, uint16_t length, uint16_t count)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->buf = buf;
+    dec->lengthBits = length * 8U;
+    dec->remaining = count;
+}
+
+App_StatusTypeDef TsCodec_Decode(tsDecoder_t *dec, tsSample_t *sample)
+{
+    if (!dec || !sample || !dec->remaining)
+    {
+        return APP_ERROR;
+    }
+
+    if (!dec->count)
+    {
+        uint32_t timestamp, temperature, pressure;
+        if (APP_OK != TsCodec_GetBits(dec, 32, &timestamp) ||
+            APP_OK != TsCodec_GetBits(dec, 16, &temperature) ||
+            APP_OK != TsCodec_GetBits(dec, 32, &pressure))
+        {
+            return APP_ERROR;
+        }
+        dec->prev.timestamp = timestamp;
+        dec->prev.temperature = (int16_t)temperature;
+        dec->prev.pressure = pressure;
+    }
+    else
+    {
+        uint32_t timeValue, tempValue, pressValue;
+        if (APP_OK != TsCodec_GetValue(dec, timeBuckets, &timeValue) ||
+            APP_OK != TsCodec_GetValue(dec, valueBuckets, &tempValue) ||
+            APP_OK != TsCodec_GetValue(dec, valueBuckets, &pressValue))
+        {
+            return APP_ERROR;
+        }
+        dec->prevDelta += (uint32_t)TsCodec_UnZigZag(timeValue);
+        dec->prev.timestamp += dec->prevDelta;
+        dec->prev.temperature = (int16_t)(dec->prev.temperature + TsCodec_UnZigZag(tempValue));
+        dec->prev.pressure += (uint32_t)TsCodec_UnZigZag(pressValue);
+    }
+    *sample = dec->prev;
+    dec->count++;
+    dec->remaining--;
+    return APP_OK;
+}
+
+static uint8_t TsCodec_PickBucket(const tsBucket_t *buckets, uint32_t value)
+{
+    uint8_t i = 0;
+    while (i < TSCODEC_BUCKETS - 1 && (value >> buckets[i].valueBits))
+    {
+        i++;
+    }
+    return i;
+}
+
+static void TsCodec_PutBits(tsEncoder_t *enc, uint32_t value, uint8_t bits)
+{
+    /* A byte at a time, the buffer is zeroed so bits are ORed in */
+    while (bits)
+    {
+        uint8_t room = 8 - (enc->bitPos & 7U);
+        uint8_t take = (bits < room) ? bits : room;
+        uint8_t chunk = (uint8_t)((value >> (bits - take)) & ((1U << take) - 1U));
+        enc->buf[enc->bitPos >> 3] |= (uint8_t)(chunk << (room - take));
+        enc->bitPos += take;
+        bits -= take;
+    }
+}
+
+static void TsCodec_PutValue(tsEncoder_t *enc, const tsBucket_t *buckets, uint32_t value)
+{
+    uint8_t i = TsCodec_PickBucket(buckets, value);
+    /* i leading 1s, then a 0 unless it is the last bucket */
+    uint32_t prefix = ((1U << buckets[i].prefixBits) - 1U) & ~((i < TSCODEC_BUCKETS - 1) ? 1U : 0U);
+    TsCodec_PutBits(enc, prefix, buckets[i].prefixBits);
+    if (buckets[i].valueBits)
+    {
+        TsCodec_PutBits(enc, value, buckets[i].valueBits);
+    }
+}
+
+static App_StatusTypeDef TsCodec_GetBits(tsDecoder_t *dec, uint8_t bits, uint32_t *value)
+{
+    if (dec->bitPos + bits > dec->lengthBits)
+    {
+        return APP_ERROR;
+    }
+    uint32_t result = 0;
+    while (bits)
+    {
+        uint8_t avail = 8 - (dec->bitPos & 7U);
+        uint8_t take = (bits < avail) ? bits : avail;
+        uint8_t chunk = (uint8_t)((dec->buf[dec->bitPos >> 3] >> (avail - take)) & ((1U << take) - 1U));
+        result = (result << take) | chunk;
+        dec->bitPos += take;
+        bits -= take;
+    }
+    *value = result;
+    return APP_OK;
+}
+
+static App_StatusTypeDef TsCodec_GetValue(tsDecoder_t *dec, const tsBucket_t *buckets, uint32_t *value)
+{
+    uint8_t i = 0;
+    uint32_t bit;
+    while (i < TSCODEC_BUCKETS - 1)
+    {
+        if (APP_OK != TsCodec_GetBits(dec, 1, &bit))
+        {
+            return APP_ERROR;
+        }
+        if (!bit)
+        {
+            break;
+        }
+        i++;
+    }
+    *value = 0;
+    return buckets[i].valueBits ? TsCodec_GetBits(dec, buckets[i].valueBits, value) : APP_OK;
+}
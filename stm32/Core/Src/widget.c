@@ -0,0 +1,134 @@
+/**
+ * @file widget.c
+ * @author Sidharth (sidharth.prabukumar@gmail.com)
+ * @brief Source file of the LCD widgets
+ * @date 2023-01-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <string.h>
+#include "widget.h"
+
+void Widget_Init(void)
+{
+	/* Bar i fills the bottom i + 1 rows of the cell */
+	for (uint8_t i = 0; i < LCD_CUSTOM_CHARS; i++)
+	{
+		uint8_t pattern[8];
+		for (uint8_t line = 0; line < 8; line++)
+		{
+			pattern[line] = (line >= 7 - i) ? 0x1F : 0x00;
+		}
+		LCD_DefineChar(i, pattern);
+	}
+}
+
+void Widget_Render(const widget_t *layout, widgetState_t *state, uint8_t count)
+{
+	uint32_t now = HAL_GetTick();
+	char text[LCD_COLUMNS + 1];
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		const widget_t *widget = &layout[i];
+		uint32_t version = widget->version ? widget->version() : 0;
+
+		if (state[i].isRendered && version == state[i].version &&
+			(0 == widget->periodMs || (now - state[i].renderTick) < widget->periodMs))
+		{
+			continue;
+		}
+		uint8_t width = (widget->width > LCD_COLUMNS) ? LCD_COLUMNS : widget->width;
+		text[0] = '\0';
+		widget->render(text, width);
+		/* Padded, a shorter text clears what a longer one left */
+		for (uint8_t length = strnlen(text, width); length < width; length++)
+		{
+			text[length] = ' ';
+		}
+		text[width] = '\0';
+		LCD_WriteText(widget->row, widget->column, text);
+
+		state[i].version = version;
+		state[i].renderTick = now;
+		state[i].isRendered = TRUE;
+	}
+}
+
+void Widget_Invalidate(widgetState_t *state, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		state[i].isRendered = FALSE;
+	}
+}
+
+char *Widget_FormatTemperature(char *text, int32_t temperature, uint8_t decimals)
+{
+	uint32_t magnitude = (temperature < 0) ? -(uint32_t)temperature : (uint32_t)temperature;
+	char *p = text;
+
+	if (1 == decimals)
+	{
+		/* Rounded to the tenth */
+		magnitude = (magnitude + 5) / 10;
+	}
+	if (temperature < 0 && magnitude)
+	{
+		*p++ = '-';
+	}
+	uint32_t scale = (1 == decimals) ? 10 : 100;
+	uint32_t whole = magnitude / scale;
+	if (whole >= 100)
+	{
+		*p++ = '0' + (whole / 100) % 10;
+	}
+	if (whole >= 10)
+	{
+		*p++ = '0' + (whole / 10) % 10;
+	}
+	*p++ = '0' + whole % 10;
+	*p++ = '.';
+	if (2 == decimals)
+	{
+		*p++ = '0' + (magnitude / 10) % 10;
+	}
+	*p++ = '0' + magnitude % 10;
+	*p = '\0';
+	return text;
+}
+
+void Widget_FormatBars(char *text, const int32_t *values, uint8_t count)
+{
+	int32_t min = INT32_MAX;
+	int32_t max = INT32_MIN;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (WIDGET_NO_VALUE == values[i])
+		{
+			continue;
+		}
+		min = (values[i] < min) ? values[i] : min;
+		max = (values[i] > max) ? values[i] : max;
+	}
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (WIDGET_NO_VALUE == values[i])
+		{
+			text[i] = ' ';
+		}
+		else if (max == min)
+		{
+			/* Flat, half height */
+			text[i] = LCD_CUSTOM_CHAR_CODE(LCD_CUSTOM_CHARS / 2 - 1);
+		}
+		else
+		{
+			int64_t level = ((int64_t)values[i] - min) * (LCD_CUSTOM_CHARS - 1) / ((int64_t)max - min);
+			text[i] = LCD_CUSTOM_CHAR_CODE(level);
+		}
+	}
+	text[count] = '\0';
+}
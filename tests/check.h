@@ -0,0 +1,27 @@
+/**
+ * @file check.h
+ * @brief Assertions of the host tests. A failed check is reported and
+ * counted, the test carries on so one run shows every failure.
+ */
+#pragma once
+
+#include <stdio.h>
+
+static int checkFailures;
+
+#define CHECK(cond)                                                             \
+	do                                                                          \
+	{                                                                           \
+		if (!(cond))                                                            \
+		{                                                                       \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			checkFailures++;                                                    \
+		}                                                                       \
+	} while (0)
+
+/* Exit status of the test */
+static inline int CheckResult(const char *name)
+{
+	printf("%s: %s\n", name, checkFailures ? "FAILED" : "ok");
+	return checkFailures ? 1 : 0;
+}
@@ -0,0 +1,319 @@
+/**
+ * @file stm32f4xx_hal.h
+ * @brief Host stand-in for the parts of the HAL used by the modules under test
+ *
+ * Peripherals are plain memory, the HAL calls a test needs are defined by
+ * the test itself.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+  HAL_OK       = 0x00U,
+  HAL_ERROR    = 0x01U,
+  HAL_BUSY     = 0x02U,
+  HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+#define READ_BIT(REG, BIT)      ((REG) & (BIT))
+#define SET_BIT(REG, BIT)       ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)     ((REG) &= ~(BIT))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)  ((REG) = (((REG) & (~(CLEARMASK))) | (SETMASK)))
+#define POSITION_VAL(VAL)       ((uint32_t)__builtin_ctz(VAL))
+
+/* Backup SRAM, mapped at this address by the tests that use it */
+#define BKPSRAM_BASE            (0x40024000UL)
+
+/* Flash */
+typedef struct
+{
+  volatile uint32_t ACR;
+} FLASH_TypeDef;
+
+static FLASH_TypeDef hostFlashRegisters __attribute__((unused));
+#define FLASH                   (&hostFlashRegisters)
+#define FLASH_ACR_DCEN          (1U << 10)
+#define FLASH_ACR_DCRST         (1U << 12)
+
+typedef struct
+{
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t Sector;
+  uint32_t NbSectors;
+  uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_SECTORS (0x00U)
+#define FLASH_TYPEPROGRAM_WORD  (0x02U)
+#define FLASH_VOLTAGE_RANGE_3   (0x02U)
+#define FLASH_SECTOR_5          (5U)
+
+#define __HAL_FLASH_DATA_CACHE_DISABLE()    CLEAR_BIT(FLASH->ACR, FLASH_ACR_DCEN)
+#define __HAL_FLASH_DATA_CACHE_ENABLE()     SET_BIT(FLASH->ACR, FLASH_ACR_DCEN)
+#define __HAL_FLASH_DATA_CACHE_RESET()      do { SET_BIT(FLASH->ACR, FLASH_ACR_DCRST); CLEAR_BIT(FLASH->ACR, FLASH_ACR_DCRST); } while (0)
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError);
+
+#define HAL_MAX_DELAY           (0xFFFFFFFFU)
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+/* Interrupt mask, there is nothing to mask on the host */
+static inline uint32_t __get_PRIMASK(void) { return 0U; }
+static inline void __set_PRIMASK(uint32_t priMask) { (void)priMask; }
+static inline void __disable_irq(void) { }
+static inline void __DMB(void) { __sync_synchronize(); }
+
+/* GPIO */
+typedef struct
+{
+  volatile uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+
+/* One set of registers shared by the test and the module under test */
+GPIO_TypeDef hostGpioRegisters[3] __attribute__((weak));
+#define GPIOA                   (&hostGpioRegisters[0])
+#define GPIOB                   (&hostGpioRegisters[1])
+#define GPIOC                   (&hostGpioRegisters[2])
+
+typedef struct
+{
+  uint32_t Pin;
+  uint32_t Mode;
+  uint32_t Pull;
+  uint32_t Speed;
+  uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+  GPIO_PIN_RESET = 0U,
+  GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_1              ((uint16_t)0x0002)
+#define GPIO_PIN_3              ((uint16_t)0x0008)
+#define GPIO_PIN_4              ((uint16_t)0x0010)
+#define GPIO_PIN_5              ((uint16_t)0x0020)
+#define GPIO_PIN_6              ((uint16_t)0x0040)
+#define GPIO_PIN_10             ((uint16_t)0x0400)
+#define GPIO_PIN_11             ((uint16_t)0x0800)
+#define GPIO_PIN_15             ((uint16_t)0x8000)
+#define GPIO_MODE_OUTPUT_PP     (0x00000001U)
+#define GPIO_MODE_OUTPUT_OD     (0x00000011U)
+#define GPIO_NOPULL             (0x00000000U)
+#define GPIO_SPEED_FREQ_LOW     (0x00000000U)
+#define GPIO_SPEED_FREQ_HIGH    (0x00000002U)
+#define GPIO_MODER_MODER0       (0x3U)
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+/* External interrupts */
+typedef struct
+{
+  volatile uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+
+typedef struct
+{
+  volatile uint32_t MEMRMP, PMC, EXTICR[4], CMPCR;
+} SYSCFG_TypeDef;
+
+EXTI_TypeDef hostExtiRegisters __attribute__((weak));
+SYSCFG_TypeDef hostSyscfgRegisters __attribute__((weak));
+#define EXTI                    (&hostExtiRegisters)
+#define SYSCFG                  (&hostSyscfgRegisters)
+#define SYSCFG_EXTICR4_EXTI15   (0xF000U)
+#define SYSCFG_EXTICR4_EXTI15_PA (0x0000U)
+
+/* DMA */
+typedef struct
+{
+  volatile uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR;
+} DMA_Stream_TypeDef;
+
+typedef enum
+{
+  HAL_DMA_STATE_RESET = 0x00U,
+  HAL_DMA_STATE_READY = 0x01U,
+  HAL_DMA_STATE_BUSY  = 0x02U
+} HAL_DMA_StateTypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+  DMA_Stream_TypeDef *Instance;
+  volatile HAL_DMA_StateTypeDef State;
+  void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferErrorCallback)(struct __DMA_HandleTypeDef *hdma);
+} DMA_HandleTypeDef;
+
+#define DMA_IT_HT               (0x00000008U)
+#define DMA_IT_TC               (0x00000010U)
+#define __HAL_DMA_GET_COUNTER(h)        ((h)->Instance->NDTR)
+#define __HAL_DMA_DISABLE_IT(h, IT)     ((h)->Instance->CR &= ~(IT))
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+
+/* I2C */
+typedef struct
+{
+  volatile uint32_t CR1, CR2, OAR1, OAR2, DR, SR1, SR2, CCR, TRISE, FLTR;
+} I2C_TypeDef;
+
+typedef struct
+{
+  I2C_TypeDef *Instance;
+} I2C_HandleTypeDef;
+
+#define I2C_MEMADD_SIZE_8BIT    (0x00000001U)
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+/* SPI */
+typedef struct
+{
+  volatile uint32_t CR1, CR2, SR, DR, CRCPR, RXCRCR, TXCRCR, I2SCFGR, I2SPR;
+} SPI_TypeDef;
+
+typedef enum
+{
+  HAL_SPI_STATE_RESET   = 0x00U,
+  HAL_SPI_STATE_READY   = 0x01U,
+  HAL_SPI_STATE_BUSY    = 0x02U,
+  HAL_SPI_STATE_BUSY_TX = 0x03U,
+  HAL_SPI_STATE_BUSY_RX = 0x04U
+} HAL_SPI_StateTypeDef;
+
+typedef struct
+{
+  SPI_TypeDef *Instance;
+  DMA_HandleTypeDef *hdmatx;
+  DMA_HandleTypeDef *hdmarx;
+  volatile HAL_SPI_StateTypeDef State;
+} SPI_HandleTypeDef;
+
+#define SPI_CR2_TXDMAEN         (0x00000002U)
+#define __HAL_RCC_SPI3_FORCE_RESET()        do { } while (0)
+#define __HAL_RCC_SPI3_RELEASE_RESET()      do { } while (0)
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_SPI_DeInit(SPI_HandleTypeDef *hspi);
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi);
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi);
+
+/* Power and clocks */
+#define __HAL_RCC_PWR_CLK_ENABLE()          do { } while (0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()        do { } while (0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()        do { } while (0)
+#define __HAL_RCC_BKPSRAM_CLK_ENABLE()      do { } while (0)
+static inline void HAL_PWR_EnableBkUpAccess(void) { }
+
+/* Cortex-M4 dual 16-bit multiply-accumulate, for builds that take the DSP paths */
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+static inline uint32_t __SMLAD(uint32_t op1, uint32_t op2, uint32_t op3)
+{
+  uint32_t lo = (uint32_t)((int32_t)(int16_t)op1 * (int16_t)op2);
+  uint32_t hi = (uint32_t)((int32_t)(int16_t)(op1 >> 16) * (int16_t)(op2 >> 16));
+  return lo + hi + op3;
+}
+#endif
+
+/* RTC */
+typedef struct
+{
+  volatile uint32_t TR, DR, CR, ISR, PRER, WUTR, CALIBR, ALRMAR, ALRMBR, WPR, SSR, SHIFTR;
+} RTC_TypeDef;
+
+static RTC_TypeDef hostRtcRegisters __attribute__((unused));
+#define RTC                     (&hostRtcRegisters)
+
+typedef struct
+{
+  uint32_t HourFormat;
+  uint32_t AsynchPrediv;
+  uint32_t SynchPrediv;
+  uint32_t OutPut;
+  uint32_t OutPutPolarity;
+  uint32_t OutPutType;
+} RTC_InitTypeDef;
+
+typedef struct
+{
+  uint8_t Hours;
+  uint8_t Minutes;
+  uint8_t Seconds;
+  uint8_t TimeFormat;
+  uint32_t SubSeconds;
+  uint32_t SecondFraction;
+  uint32_t DayLightSaving;
+  uint32_t StoreOperation;
+} RTC_TimeTypeDef;
+
+typedef struct
+{
+  uint8_t WeekDay;
+  uint8_t Month;
+  uint8_t Date;
+  uint8_t Year;
+} RTC_DateTypeDef;
+
+typedef struct
+{
+  RTC_TypeDef *Instance;
+  RTC_InitTypeDef Init;
+} RTC_HandleTypeDef;
+
+typedef struct
+{
+  RTC_TimeTypeDef AlarmTime;
+  uint32_t AlarmMask;
+  uint32_t AlarmSubSecondMask;
+  uint32_t AlarmDateWeekDaySel;
+  uint8_t AlarmDateWeekDay;
+  uint32_t Alarm;
+} RTC_AlarmTypeDef;
+
+#define RTC_HOURFORMAT_24           (0x00000000U)
+#define RTC_OUTPUT_DISABLE          (0x00000000U)
+#define RTC_OUTPUT_POLARITY_LOW     (0x00100000U)
+#define RTC_OUTPUT_TYPE_OPENDRAIN   (0x00000000U)
+#define RTC_FORMAT_BIN              (0x00000000U)
+#define RTC_FORMAT_BCD              (0x00000001U)
+#define RTC_SHIFTADD1S_RESET        (0x00000000U)
+#define RTC_SHIFTADD1S_SET          (0x80000000U)
+#define RTC_ALARM_A                 (0x00000100U)
+#define RTC_ALARMMASK_ALL           (0x80808080U)
+#define RTC_ALARMSUBSECONDMASK_ALL  (0x00000000U)
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc);
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+HAL_StatusTypeDef HAL_RTCEx_SetSynchroShift(RTC_HandleTypeDef *hrtc, uint32_t ShiftAdd1S, uint32_t ShiftSubFS);
+HAL_StatusTypeDef HAL_RTC_SetAlarm_IT(RTC_HandleTypeDef *hrtc, RTC_AlarmTypeDef *sAlarm, uint32_t Format);
+void HAL_RTC_AlarmAEventCallback(RTC_HandleTypeDef *hrtc);
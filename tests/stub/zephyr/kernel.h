@@ -0,0 +1,20 @@
+/**
+ * @file kernel.h
+ * @brief Host stand-in for the parts of the Zephyr kernel the ESP32 modules
+ * under test use. The uptime is the test's, the clock modules are given
+ * their uptimes explicitly.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define CLAMP(val, low, high) (((val) <= (low)) ? (low) : MIN(val, high))
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+extern int64_t hostUptimeTicks;
+
+static inline int64_t k_uptime_ticks(void) { return hostUptimeTicks; }
+/* One tick per microsecond */
+static inline uint64_t k_ticks_to_us_floor64(uint64_t t) { return t; }
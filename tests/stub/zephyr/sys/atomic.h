@@ -0,0 +1,11 @@
+/**
+ * @file atomic.h
+ * @brief Host stand-in for the Zephyr atomics, on the compiler builtins
+ */
+#pragma once
+
+typedef long atomic_t;
+typedef long atomic_val_t;
+
+static inline atomic_val_t atomic_get(const atomic_t *target) { return __atomic_load_n(target, __ATOMIC_SEQ_CST); }
+static inline atomic_val_t atomic_set(atomic_t *target, atomic_val_t value) { return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST); }
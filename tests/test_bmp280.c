@@ -0,0 +1,241 @@
+/**
+ * @file test_bmp280.c
+ * @brief Compensation of the BMP280 readings
+ *
+ * The sensor is a register file behind a fake transport, loaded with the
+ * calibration of the datasheet example, so the calibration goes through
+ * BMP280_Init() as read from the chip. The example conversion must come
+ * out as in the datasheet. BMP280_CompensateBatch() must then give the
+ * same results as the scalar conversions over random readings, with and
+ * without pressure, and its rate is reported.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "check.h"
+#include "bmp280.h"
+
+#define TEST_SAMPLES        (100000U)
+#define TEST_BENCH_ROUNDS   (100U)
+
+/* Datasheet 3.12, 25.08 degrees Celsius and 100656 Pa with the 32-bit formulas */
+#define TEST_ADC_T          (519888)
+#define TEST_ADC_P          (415148)
+#define TEST_TEMPERATURE    (2508)
+#define TEST_PRESSURE       (100656U)
+
+static const uint16_t datasheetCalib[12] = {
+	27504, 26435, (uint16_t)-1000,
+	36477, (uint16_t)-10685, 3024, 2855, 140, (uint16_t)-7, 15500, (uint16_t)-14600, 6000
+};
+
+static uint8_t registers[256];
+
+static int32_t tempAdc[TEST_SAMPLES];
+static int32_t pressAdc[TEST_SAMPLES];
+static int32_t temperature[TEST_SAMPLES];
+static uint32_t pressure[TEST_SAMPLES];
+
+static App_StatusTypeDef FakeRead(bmp280_bus_t *bus, uint8_t regAddr, uint8_t *buf, uint16_t len)
+{
+	memcpy(buf, &registers[regAddr], len);
+	return APP_OK;
+}
+
+static App_StatusTypeDef FakeWrite(bmp280_bus_t *bus, uint8_t regAddr, uint8_t regVal)
+{
+	registers[regAddr] = regVal;
+	return APP_OK;
+}
+
+static const bmp280_bus_ops_t fakeOps = {FakeRead, FakeWrite, NULL, NULL};
+
+/* Cold boot, the calibration is read from the chip */
+App_StatusTypeDef BMP280_Cache_Load(uint32_t busId, uint32_t devId, uint8_t *calib)
+{
+	return APP_ERROR;
+}
+
+App_StatusTypeDef BMP280_Cache_Store(uint32_t busId, uint32_t devId, uint8_t chipId, const uint8_t *calib)
+{
+	return APP_OK;
+}
+
+uint8_t *BMP280_Bus_GetData(bmp280_bus_t *bus)
+{
+	return &registers[BMP280_REG_PRESSDATA];
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return 0;
+}
+
+/**
+ * @brief The 32-bit pressure compensation as printed in the datasheet, section 8.2
+ */
+static uint32_t DatasheetPressure(int32_t adc_P, int32_t adc_T)
+{
+	int32_t dig_T1 = datasheetCalib[0], dig_T2 = (int16_t)datasheetCalib[1], dig_T3 = (int16_t)datasheetCalib[2];
+	int32_t dig_P1 = datasheetCalib[3], dig_P2 = (int16_t)datasheetCalib[4], dig_P3 = (int16_t)datasheetCalib[5];
+	int32_t dig_P4 = (int16_t)datasheetCalib[6], dig_P5 = (int16_t)datasheetCalib[7], dig_P6 = (int16_t)datasheetCalib[8];
+	int32_t dig_P7 = (int16_t)datasheetCalib[9], dig_P8 = (int16_t)datasheetCalib[10], dig_P9 = (int16_t)datasheetCalib[11];
+
+	int32_t var1 = ((((adc_T >> 3) - (dig_T1 << 1))) * dig_T2) >> 11;
+	int32_t var2 = (((((adc_T >> 4) - dig_T1) * ((adc_T >> 4) - dig_T1)) >> 12) * dig_T3) >> 14;
+	int32_t t_fine = var1 + var2;
+
+	uint32_t p;
+	var1 = (t_fine >> 1) - 64000;
+	var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * dig_P6;
+	var2 = var2 + ((var1 * dig_P5) << 1);
+	var2 = (var2 >> 2) + (dig_P4 << 16);
+	var1 = (((dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((dig_P2 * var1) >> 1)) >> 18;
+	var1 = ((32768 + var1) * dig_P1) >> 15;
+	if (var1 == 0)
+	{
+		return 0;
+	}
+	p = (((uint32_t)(1048576 - adc_P)) - (var2 >> 12)) * 3125;
+	if (p < 0x80000000)
+	{
+		p = (p << 1) / ((uint32_t)var1);
+	}
+	else
+	{
+		p = (p / (uint32_t)var1) * 2;
+	}
+	var1 = (dig_P9 * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+	var2 = (((int32_t)(p >> 2)) * dig_P8) >> 13;
+	return (uint32_t)((int32_t)p + ((var1 + var2 + dig_P7) >> 4));
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static void InitDevice(bmp280_t *dev, bmp280_bus_t *bus)
+{
+	memset(registers, 0, sizeof(registers));
+	for (uint8_t i = 0; i < 12; i++)
+	{
+		registers[BMP280_REG_DIG_T1 + (2 * i)] = (uint8_t)datasheetCalib[i];
+		registers[BMP280_REG_DIG_T1 + (2 * i) + 1] = (uint8_t)(datasheetCalib[i] >> 8);
+	}
+	registers[BMP280_REG_CHIPID] = BMP280_CHIPID;
+	memset(bus, 0, sizeof(*bus));
+	bus->ops = &fakeOps;
+	CHECK(APP_OK == BMP280_Init(dev, bus));
+}
+
+/**
+ * @brief The example of the datasheet, read through the registers and converted
+ */
+static void TestDatasheet(bmp280_t *dev)
+{
+	CHECK(dev->temp_calib.dig_T1 == 27504 && dev->temp_calib.dig_T2 == 26435 && dev->temp_calib.dig_T3 == -1000);
+	CHECK(dev->press_calib.dig_P1 == 36477 && dev->press_calib.dig_P2 == -10685 && dev->press_calib.dig_P9 == 6000);
+
+	/* 20-bit readings, left aligned over msb, lsb and the top nibble of xlsb */
+	uint8_t *raw = &registers[BMP280_REG_PRESSDATA];
+	raw[0] = (uint8_t)(TEST_ADC_P >> 12);
+	raw[1] = (uint8_t)(TEST_ADC_P >> 4);
+	raw[2] = (uint8_t)(TEST_ADC_P << 4);
+	raw[3] = (uint8_t)(TEST_ADC_T >> 12);
+	raw[4] = (uint8_t)(TEST_ADC_T >> 4);
+	raw[5] = (uint8_t)(TEST_ADC_T << 4);
+	int32_t t = 0;
+	int32_t p = 0;
+	CHECK(APP_OK == BMP280_ReadRaw(dev, &t, &p));
+	CHECK(t == TEST_ADC_T && p == TEST_ADC_P);
+	BMP280_GetRawFromBuffer(dev, &t, &p);
+	CHECK(t == TEST_ADC_T && p == TEST_ADC_P);
+
+	CHECK(BMP280_CompensateTemperature(dev, TEST_ADC_T) == TEST_TEMPERATURE);
+	CHECK(DatasheetPressure(TEST_ADC_P, TEST_ADC_T) == TEST_PRESSURE);
+
+	const int32_t adcT = TEST_ADC_T;
+	const int32_t adcP = TEST_ADC_P;
+	int32_t outT = 0;
+	uint32_t outP = 0;
+	CHECK(APP_OK == BMP280_CompensateBatch(dev, &adcT, &adcP, &outT, &outP, 1));
+	CHECK(outT == TEST_TEMPERATURE && outP == TEST_PRESSURE);
+}
+
+/**
+ * @brief Random readings of -40 to 85 degrees and 300 to 1100 hPa, the range of the sensor
+ */
+static void TestBatch(bmp280_t *dev)
+{
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		tempAdc[i] = 330000 + (rand() % 380000);
+		pressAdc[i] = 180000 + (rand() % 440000);
+	}
+
+	CHECK(APP_OK == BMP280_CompensateBatch(dev, tempAdc, pressAdc, temperature, pressure, TEST_SAMPLES));
+	for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		int32_t t = BMP280_CompensateTemperature(dev, tempAdc[i]);
+		uint32_t p = DatasheetPressure(pressAdc[i], tempAdc[i]);
+		if ((temperature[i] != t || pressure[i] != p) && mismatches++ < 10)
+		{
+			fprintf(stderr, "sample %u: %d %u, scalar %d %u\n", i, temperature[i], pressure[i], t, p);
+		}
+	}
+	CHECK(mismatches == 0);
+
+	/* Temperature only, the pressure output is left alone */
+	memset(temperature, 0, sizeof(temperature));
+	memset(pressure, 0xA5, sizeof(pressure));
+	CHECK(APP_OK == BMP280_CompensateBatch(dev, tempAdc, NULL, temperature, NULL, TEST_SAMPLES));
+	mismatches = 0;
+	for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		mismatches += (temperature[i] != BMP280_CompensateTemperature(dev, tempAdc[i]));
+		mismatches += (pressure[i] != 0xA5A5A5A5U);
+	}
+	CHECK(mismatches == 0);
+
+	/* Pressure asked for without an output for it */
+	CHECK(APP_OK != BMP280_CompensateBatch(dev, tempAdc, pressAdc, temperature, NULL, TEST_SAMPLES));
+	CHECK(APP_OK != BMP280_CompensateBatch(NULL, tempAdc, NULL, temperature, NULL, TEST_SAMPLES));
+	CHECK(APP_OK == BMP280_CompensateBatch(dev, tempAdc, pressAdc, temperature, pressure, 0));
+}
+
+static void Benchmark(bmp280_t *dev)
+{
+	double start = Seconds();
+	for (uint32_t round = 0; round < TEST_BENCH_ROUNDS; round++)
+	{
+		BMP280_CompensateBatch(dev, tempAdc, pressAdc, temperature, pressure, TEST_SAMPLES);
+	}
+	double withPressure = Seconds() - start;
+	start = Seconds();
+	for (uint32_t round = 0; round < TEST_BENCH_ROUNDS; round++)
+	{
+		BMP280_CompensateBatch(dev, tempAdc, NULL, temperature, NULL, TEST_SAMPLES);
+	}
+	double temperatureOnly = Seconds() - start;
+
+	double samples = (double)TEST_SAMPLES * TEST_BENCH_ROUNDS;
+	printf("  batch %.1f Msamples/s with pressure, %.1f Msamples/s temperature only\n",
+	       samples / withPressure / 1e6, samples / temperatureOnly / 1e6);
+}
+
+int main(void)
+{
+	bmp280_t dev;
+	bmp280_bus_t bus;
+
+	srand(1);
+	InitDevice(&dev, &bus);
+	TestDatasheet(&dev);
+	TestBatch(&dev);
+	Benchmark(&dev);
+	return CheckResult("bmp280");
+}
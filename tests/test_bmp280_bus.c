@@ -0,0 +1,325 @@
+/**
+ * @file test_bmp280_bus.c
+ * @brief I2C and SPI transports of the BMP280
+ *
+ * The HAL calls are mocks that record the bytes sent and the level of
+ * chip select, and fail on demand. Covers the read bit and the write mask
+ * of the SPI address phase, where the data starts in the receive buffer,
+ * the release of chip select on completion and on every error, and that
+ * only one non-blocking transfer is in flight per HAL handle.
+ */
+#include <string.h>
+#include "check.h"
+#include "bmp280_bus.h"
+
+#define TEST_CS_PIN         (0x0010U)
+
+static GPIO_TypeDef csPort;
+static GPIO_PinState csLevel = GPIO_PIN_SET;
+static uint32_t csWrites;
+
+static uint8_t sent[16];            /* Bytes clocked out since the last Reset() */
+static uint16_t sentLength;
+static uint8_t i2cMemAddress;
+static HAL_StatusTypeDef halStatus; /* Returned by the next HAL transfer calls */
+static uint8_t *dmaRx;              /* Receive buffer of the DMA transfer in flight */
+
+static uint32_t completions;
+static App_StatusTypeDef lastStatus;
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if (GPIOx == &csPort && GPIO_Pin == TEST_CS_PIN)
+	{
+		csLevel = PinState;
+		csWrites++;
+	}
+}
+
+static void Record(const uint8_t *data, uint16_t size)
+{
+	for (uint16_t i = 0; i < size && sentLength < sizeof(sent); i++)
+	{
+		sent[sentLength++] = data[i];
+	}
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	/* Only what the sensor can see, with chip select low */
+	if (csLevel == GPIO_PIN_RESET)
+	{
+		Record(pData, Size);
+	}
+	return halStatus;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	for (uint16_t i = 0; i < Size; i++)
+	{
+		pData[i] = (uint8_t)(0xB0 + i);
+	}
+	return halStatus;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size)
+{
+	if (halStatus != HAL_OK)
+	{
+		return halStatus;
+	}
+	if (csLevel == GPIO_PIN_RESET)
+	{
+		Record(pTxData, Size);
+	}
+	/* The sensor drives nothing in the address phase, then the data */
+	pRxData[0] = 0xFF;
+	for (uint16_t i = 1; i < Size; i++)
+	{
+		pRxData[i] = (uint8_t)(0xC0 + i - 1);
+	}
+	dmaRx = pRxData;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	i2cMemAddress = (uint8_t)MemAddress;
+	memset(pData, 0xD0, Size);
+	return halStatus;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	i2cMemAddress = (uint8_t)MemAddress;
+	Record(pData, Size);
+	return halStatus;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	i2cMemAddress = (uint8_t)MemAddress;
+	if (halStatus == HAL_OK)
+	{
+		for (uint16_t i = 0; i < Size; i++)
+		{
+			pData[i] = (uint8_t)(0xE0 + i);
+		}
+	}
+	return halStatus;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	i2cMemAddress = (uint8_t)MemAddress;
+	Record(pData, Size);
+	return halStatus;
+}
+
+static void OnComplete(void *context, App_StatusTypeDef status)
+{
+	completions++;
+	lastStatus = status;
+	CHECK(context == &completions);
+}
+
+static void Reset(void)
+{
+	sentLength = 0;
+	memset(sent, 0, sizeof(sent));
+	halStatus = HAL_OK;
+	dmaRx = NULL;
+	completions = 0;
+	lastStatus = APP_ERROR;
+}
+
+static void TestSPIBlocking(bmp280_bus_t *bus)
+{
+	uint8_t buf[3];
+
+	/* The address goes out with the read bit set, the data comes in as it is */
+	Reset();
+	CHECK(APP_OK == bus->ops->read(bus, 0x88, buf, sizeof(buf)));
+	CHECK(sentLength == 1 && sent[0] == (0x88 | BMP280_SPI_READ));
+	CHECK(buf[0] == 0xB0 && buf[2] == 0xB2);
+	CHECK(csLevel == GPIO_PIN_SET);
+
+	/* The write clears the top bit of the address */
+	Reset();
+	CHECK(APP_OK == bus->ops->write(bus, 0xF4, 0x27));
+	CHECK(sentLength == 2 && sent[0] == (0xF4 & BMP280_SPI_WRITE_MASK) && sent[1] == 0x27);
+	CHECK(csLevel == GPIO_PIN_SET);
+
+	/* A failed transfer still releases chip select */
+	Reset();
+	halStatus = HAL_ERROR;
+	CHECK(APP_OK != bus->ops->read(bus, 0xD0, buf, 1));
+	CHECK(csLevel == GPIO_PIN_SET);
+	CHECK(APP_OK != bus->ops->write(bus, 0xE0, 0xB6));
+	CHECK(csLevel == GPIO_PIN_SET);
+}
+
+static void TestSPIAsync(bmp280_bus_t *bus, SPI_HandleTypeDef *hspi)
+{
+	/* Address, then a dummy byte per data byte. The data lands past the address phase */
+	Reset();
+	CHECK(APP_OK == bus->ops->readAsync(bus, BMP280_REG_PRESSDATA, BMP280_RAW_DATA_LEN));
+	CHECK(csLevel == GPIO_PIN_RESET);
+	CHECK(sentLength == BMP280_RAW_DATA_LEN + 1 && sent[0] == (BMP280_REG_PRESSDATA | BMP280_SPI_READ));
+	CHECK(sent[1] == 0 && sent[BMP280_RAW_DATA_LEN] == 0);
+	CHECK(dmaRx == bus->rxBuf);
+
+	/* Chip select is held until the DMA completes */
+	HAL_SPI_TxRxCpltCallback(hspi);
+	CHECK(csLevel == GPIO_PIN_SET);
+	CHECK(completions == 1 && lastStatus == APP_OK);
+	CHECK(bus->dataOffset == 1);
+	CHECK(BMP280_Bus_GetData(bus)[0] == 0xC0 && BMP280_Bus_GetData(bus)[BMP280_RAW_DATA_LEN - 1] == 0xC5);
+
+	/* Too long for the buffers */
+	CHECK(APP_OK != bus->ops->readAsync(bus, BMP280_REG_PRESSDATA, BMP280_BUS_MAX_ASYNC_LEN + 1));
+
+	/* The write of the async path is masked as well */
+	Reset();
+	CHECK(APP_OK == bus->ops->writeAsync(bus, 0xF4, 0x25));
+	CHECK(sentLength == 2 && sent[0] == (0xF4 & BMP280_SPI_WRITE_MASK) && sent[1] == 0x25);
+	HAL_SPI_TxRxCpltCallback(hspi);
+	CHECK(csLevel == GPIO_PIN_SET && completions == 1);
+
+	/* A transfer error ends the transfer and releases chip select */
+	Reset();
+	CHECK(APP_OK == bus->ops->readAsync(bus, BMP280_REG_TEMPDATA, 3));
+	HAL_SPI_ErrorCallback(hspi);
+	CHECK(csLevel == GPIO_PIN_SET);
+	CHECK(completions == 1 && lastStatus == APP_ERROR);
+
+	/* So does a DMA that would not start, and the handle is free again */
+	Reset();
+	halStatus = HAL_BUSY;
+	CHECK(APP_OK != bus->ops->readAsync(bus, BMP280_REG_TEMPDATA, 3));
+	CHECK(csLevel == GPIO_PIN_SET && completions == 0);
+	halStatus = HAL_OK;
+	CHECK(APP_OK == bus->ops->readAsync(bus, BMP280_REG_TEMPDATA, 3));
+	HAL_SPI_TxRxCpltCallback(hspi);
+	CHECK(completions == 1);
+
+	/* A completion with no transfer of ours is not reported */
+	Reset();
+	HAL_SPI_TxRxCpltCallback(hspi);
+	CHECK(completions == 0);
+}
+
+static void TestI2C(bmp280_bus_t *bus, I2C_HandleTypeDef *hi2c)
+{
+	uint8_t buf[2];
+
+	/* The register address is the memory address, unchanged */
+	Reset();
+	CHECK(APP_OK == bus->ops->read(bus, 0x88, buf, sizeof(buf)));
+	CHECK(i2cMemAddress == 0x88 && buf[1] == 0xD0);
+	CHECK(APP_OK == bus->ops->write(bus, 0xF4, 0x27));
+	CHECK(i2cMemAddress == 0xF4 && sentLength == 1 && sent[0] == 0x27);
+
+	/* No address phase in the data, it starts at the first byte */
+	Reset();
+	CHECK(APP_OK == bus->ops->readAsync(bus, BMP280_REG_PRESSDATA, BMP280_RAW_DATA_LEN));
+	CHECK(i2cMemAddress == BMP280_REG_PRESSDATA);
+	HAL_I2C_MemRxCpltCallback(hi2c);
+	CHECK(completions == 1 && lastStatus == APP_OK);
+	CHECK(bus->dataOffset == 0 && BMP280_Bus_GetData(bus)[0] == 0xE0);
+
+	Reset();
+	CHECK(APP_OK == bus->ops->writeAsync(bus, 0xF4, 0x25));
+	HAL_I2C_MemTxCpltCallback(hi2c);
+	CHECK(completions == 1 && lastStatus == APP_OK);
+
+	Reset();
+	CHECK(APP_OK == bus->ops->readAsync(bus, BMP280_REG_PRESSDATA, 3));
+	HAL_I2C_ErrorCallback(hi2c);
+	CHECK(completions == 1 && lastStatus == APP_ERROR);
+
+	/* A refused start frees the handle */
+	Reset();
+	halStatus = HAL_BUSY;
+	CHECK(APP_OK != bus->ops->readAsync(bus, BMP280_REG_PRESSDATA, 3));
+	CHECK(APP_OK != bus->ops->writeAsync(bus, 0xF4, 0x25));
+	halStatus = HAL_OK;
+	CHECK(APP_OK == bus->ops->writeAsync(bus, 0xF4, 0x25));
+	HAL_I2C_MemTxCpltCallback(hi2c);
+	CHECK(completions == 1);
+}
+
+/**
+ * @brief One transfer in flight per handle, sensors on different handles run together
+ */
+static void TestExclusive(void)
+{
+	I2C_TypeDef i2cInstances[BMP280_BUS_MAX_ACTIVE + 1];
+	I2C_HandleTypeDef handles[BMP280_BUS_MAX_ACTIVE + 1];
+	bmp280_bus_t buses[BMP280_BUS_MAX_ACTIVE + 1];
+	bmp280_bus_t second;
+
+	Reset();
+	for (uint8_t i = 0; i <= BMP280_BUS_MAX_ACTIVE; i++)
+	{
+		handles[i].Instance = &i2cInstances[i];
+		CHECK(APP_OK == BMP280_Bus_InitI2C(&buses[i], &handles[i], BMP280_I2C_ADDRESS_0));
+		BMP280_Bus_SetCallback(&buses[i], OnComplete, &completions);
+	}
+	CHECK(APP_OK == BMP280_Bus_InitI2C(&second, &handles[0], BMP280_I2C_ADDRESS_1));
+	BMP280_Bus_SetCallback(&second, OnComplete, &completions);
+
+	/* The second sensor on a busy handle waits for the first */
+	CHECK(APP_OK == buses[0].ops->readAsync(&buses[0], BMP280_REG_PRESSDATA, 3));
+	CHECK(APP_OK != second.ops->readAsync(&second, BMP280_REG_PRESSDATA, 3));
+	CHECK(APP_OK != buses[0].ops->writeAsync(&buses[0], 0xF4, 0x25));
+
+	/* Other handles are free, up to the size of the table */
+	for (uint8_t i = 1; i < BMP280_BUS_MAX_ACTIVE; i++)
+	{
+		CHECK(APP_OK == buses[i].ops->readAsync(&buses[i], BMP280_REG_PRESSDATA, 3));
+	}
+	CHECK(APP_OK != buses[BMP280_BUS_MAX_ACTIVE].ops->readAsync(&buses[BMP280_BUS_MAX_ACTIVE], BMP280_REG_PRESSDATA, 3));
+
+	/* Each completion goes to the owner of its handle only, and frees it */
+	HAL_I2C_MemRxCpltCallback(&handles[0]);
+	CHECK(completions == 1);
+	HAL_I2C_MemRxCpltCallback(&handles[0]);
+	CHECK(completions == 1);
+	CHECK(APP_OK == second.ops->readAsync(&second, BMP280_REG_PRESSDATA, 3));
+	HAL_I2C_MemRxCpltCallback(&handles[0]);
+	CHECK(completions == 2);
+	for (uint8_t i = 1; i < BMP280_BUS_MAX_ACTIVE; i++)
+	{
+		HAL_I2C_MemRxCpltCallback(&handles[i]);
+	}
+	CHECK(completions == BMP280_BUS_MAX_ACTIVE + 1);
+	CHECK(APP_OK == buses[BMP280_BUS_MAX_ACTIVE].ops->readAsync(&buses[BMP280_BUS_MAX_ACTIVE], BMP280_REG_PRESSDATA, 3));
+	HAL_I2C_MemRxCpltCallback(&handles[BMP280_BUS_MAX_ACTIVE]);
+	CHECK(completions == BMP280_BUS_MAX_ACTIVE + 2);
+}
+
+int main(void)
+{
+	SPI_TypeDef spiInstance;
+	SPI_HandleTypeDef hspi = {.Instance = &spiInstance};
+	I2C_TypeDef i2cInstance;
+	I2C_HandleTypeDef hi2c = {.Instance = &i2cInstance};
+	bmp280_bus_t spiBus;
+	bmp280_bus_t i2cBus;
+
+	CHECK(APP_OK != BMP280_Bus_InitSPI(&spiBus, &hspi, NULL, TEST_CS_PIN));
+	csLevel = GPIO_PIN_RESET;
+	CHECK(APP_OK == BMP280_Bus_InitSPI(&spiBus, &hspi, &csPort, TEST_CS_PIN));
+	CHECK(csLevel == GPIO_PIN_SET);
+	BMP280_Bus_SetCallback(&spiBus, OnComplete, &completions);
+	CHECK(APP_OK == BMP280_Bus_InitI2C(&i2cBus, &hi2c, BMP280_I2C_ADDRESS_0));
+	BMP280_Bus_SetCallback(&i2cBus, OnComplete, &completions);
+
+	TestSPIBlocking(&spiBus);
+	TestSPIAsync(&spiBus, &hspi);
+	TestI2C(&i2cBus, &hi2c);
+	TestExclusive();
+	return CheckResult("bmp280_bus");
+}
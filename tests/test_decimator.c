@@ -0,0 +1,97 @@
+/**
+ * @file test_decimator.c
+ * @brief The FIR decimator against a direct reference filter
+ *
+ * Built twice, once on the plain C dot product and once on the dual MAC
+ * path with __SMLAD emulated, and both must match the reference output
+ * bit for bit.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "decimator.h"
+
+#define TEST_SAMPLES        (100000U)
+
+/* Gain of 2, so a full scale input saturates */
+static const int16_t gainTwoCoeffs[DECIMATOR_MAX_TAPS] = {
+    [0 ... DECIMATOR_MAX_TAPS - 1] = 2048,
+};
+
+typedef int16_t (*signal_t)(uint32_t n);
+
+static int16_t Noise(uint32_t n)
+{
+	return (int16_t)rand();
+}
+
+static int16_t Step(uint32_t n)
+{
+	return ((n / 1000) & 1U) ? INT16_MAX : INT16_MIN;
+}
+
+static int16_t Sine(uint32_t n)
+{
+	return (int16_t)lrint(20000.0 * sin(n * 0.01));
+}
+
+/**
+ * @brief Straight from the definition: sum of the newest numTaps inputs,
+ * oldest first, rounded from Q15 and saturated
+ */
+static int16_t Reference(const int16_t *inputs, uint32_t newest, const int16_t *coeffs, uint16_t numTaps)
+{
+	int64_t acc = 0;
+	for (uint16_t k = 0; k < numTaps; k++)
+	{
+		int64_t n = (int64_t)newest - (numTaps - 1) + k;
+		acc += (n >= 0 ? inputs[n] : 0) * (int64_t)coeffs[k];
+	}
+	acc = (acc + (1 << (DECIMATOR_COEFF_SHIFT - 1))) >> DECIMATOR_COEFF_SHIFT;
+	return (int16_t)(acc > INT16_MAX ? INT16_MAX : (acc < INT16_MIN ? INT16_MIN : acc));
+}
+
+static void TestSignal(signal_t signal, const int16_t *coeffs, uint16_t numTaps, uint16_t factor)
+{
+	static int16_t inputs[TEST_SAMPLES];
+	decimator_t decimator;
+	CHECK(APP_OK == Decimator_Init(&decimator, coeffs, numTaps, factor));
+	uint32_t outputs = 0;
+	uint32_t mismatches = 0;
+	for (uint32_t n = 0; n < TEST_SAMPLES; n++)
+	{
+		int16_t output;
+		inputs[n] = signal(n);
+		if (Decimator_Push(&decimator, inputs[n], &output))
+		{
+			CHECK((n + 1) % factor == 0);
+			mismatches += (output != Reference(inputs, n, coeffs, numTaps));
+			outputs++;
+		}
+	}
+	CHECK(outputs == TEST_SAMPLES / factor);
+	CHECK(mismatches == 0);
+}
+
+int main(void)
+{
+	srand(1);
+	const signal_t signals[] = {Noise, Step, Sine};
+	for (uint8_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+	{
+		TestSignal(signals[i], Decimator_DefaultCoeffs, DECIMATOR_DEFAULT_TAPS, DECIMATOR_DEFAULT_FACTOR);
+		TestSignal(signals[i], Decimator_DefaultCoeffs + 1, DECIMATOR_DEFAULT_TAPS - 2, 3);
+		TestSignal(signals[i], gainTwoCoeffs, DECIMATOR_MAX_TAPS, 1);
+	}
+
+	decimator_t decimator;
+	CHECK(APP_OK != Decimator_Init(&decimator, Decimator_DefaultCoeffs, 3, 1));
+	CHECK(APP_OK != Decimator_Init(&decimator, Decimator_DefaultCoeffs, 0, 1));
+	CHECK(APP_OK != Decimator_Init(&decimator, gainTwoCoeffs, DECIMATOR_MAX_TAPS + 2, 1));
+	CHECK(APP_OK != Decimator_Init(&decimator, Decimator_DefaultCoeffs, DECIMATOR_DEFAULT_TAPS, 0));
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+	return CheckResult("decimator (dual MAC)");
+#else
+	return CheckResult("decimator");
+#endif
+}
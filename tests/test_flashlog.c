@@ -0,0 +1,188 @@
+/**
+ * @file test_flashlog.c
+ * @brief Power cuts at random points of the flash log
+ *
+ * Flash and backup SRAM are mapped at their STM32 addresses. The flash stub
+ * only clears bits, like the real array, and cuts the power after a budget
+ * of program and erase operations: the word being programmed is torn, a
+ * sector being erased is left half erased, and the test restarts from
+ * FlashLog_Init() with the backup SRAM kept. After every restart the log
+ * must hold exactly the records accepted before the cut, oldest ones aside
+ * once sectors were reused.
+ */
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "check.h"
+#include "flashlog.h"
+
+#define TEST_RECORDS        (200000U)   /* Enough to reuse every sector */
+#define TEST_CUT_MAX_OPS    (4000U)     /* Program words between cuts, at most */
+#define TEST_QUERY_CHUNK    (4096U)
+
+static uint8_t *flash;
+static uint32_t opsToCut;
+static jmp_buf powerCut;
+static uint32_t cuts;
+static uint32_t erases;
+
+static flashLogRecord_t accepted[TEST_RECORDS];
+static flashLogRecord_t found[TEST_QUERY_CHUNK];
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	CHECK(TypeProgram == FLASH_TYPEPROGRAM_WORD);
+	CHECK(Address >= FLASHLOG_BASE && Address + 4 <= FLASHLOG_BASE + (FLASHLOG_SECTORS * FLASHLOG_SECTOR_SIZE));
+	CHECK((Address & 3U) == 0);
+	uint32_t *word = (uint32_t *)(uintptr_t)Address;
+	if (!opsToCut--)
+	{
+		/* Some of the bits were cleared when the supply dropped */
+		*word &= (uint32_t)Data | (uint32_t)rand();
+		longjmp(powerCut, 1);
+	}
+	*word &= (uint32_t)Data;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError)
+{
+	CHECK(pEraseInit->Sector >= FLASHLOG_FIRST_SECTOR && pEraseInit->Sector < FLASHLOG_FIRST_SECTOR + FLASHLOG_SECTORS);
+	CHECK(pEraseInit->NbSectors == 1);
+	uint8_t *sector = flash + ((pEraseInit->Sector - FLASHLOG_FIRST_SECTOR) * FLASHLOG_SECTOR_SIZE);
+	/* Erases are rare next to page writes, half of them are cut */
+	if (!opsToCut-- || (rand() % 2))
+	{
+		memset(sector + (FLASHLOG_SECTOR_SIZE / 2), 0xFF, FLASHLOG_SECTOR_SIZE / 2);
+		longjmp(powerCut, 1);
+	}
+	memset(sector, 0xFF, FLASHLOG_SECTOR_SIZE);
+	erases++;
+	*SectorError = 0xFFFFFFFFU;
+	return HAL_OK;
+}
+
+/* Fields only, the padding of a record is not encoded */
+static uint8_t IsSameRecord(const flashLogRecord_t *a, const flashLogRecord_t *b)
+{
+	return a->timestamp == b->timestamp && a->temperature == b->temperature && a->pressure == b->pressure;
+}
+
+static void *MapAt(uintptr_t address, size_t size)
+{
+	void *p = mmap((void *)address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (p != (void *)address)
+	{
+		perror("mmap");
+		exit(2);
+	}
+	return p;
+}
+
+/**
+ * @brief The log must read back as the newest accepted records, each once and in order
+ */
+static void CheckLog(uint32_t acceptedCount, uint8_t isWrapped)
+{
+	uint32_t total = 0;
+	uint32_t first = 0;
+	uint32_t fromTime = 0;
+	uint16_t n;
+	while ((n = FlashLog_Query(fromTime, UINT32_MAX, found, TEST_QUERY_CHUNK)) > 0)
+	{
+		if (!total)
+		{
+			/* Find where the log starts among the accepted records */
+			while (first < acceptedCount && accepted[first].timestamp != found[0].timestamp)
+			{
+				first++;
+			}
+			CHECK(first < acceptedCount);
+			CHECK(isWrapped || first == 0);
+		}
+		for (uint16_t i = 0; i < n; i++)
+		{
+			uint32_t expect = first + total + i;
+			if (expect >= acceptedCount || !IsSameRecord(&found[i], &accepted[expect]))
+			{
+				CHECK(!"record differs from the one accepted");
+				return;
+			}
+		}
+		total += n;
+		fromTime = found[n - 1].timestamp + 1;
+	}
+	CHECK(first + total == acceptedCount);
+}
+
+int main(void)
+{
+	flash = MapAt(FLASHLOG_BASE, FLASHLOG_SECTORS * FLASHLOG_SECTOR_SIZE);
+	MapAt(BKPSRAM_BASE, 0x1000U);
+	memset(flash, 0xFF, FLASHLOG_SECTORS * FLASHLOG_SECTOR_SIZE);
+	srand(1);
+	/* Backup SRAM powers up with random contents */
+	for (uint32_t i = 0; i < 0x1000U; i++)
+	{
+		((uint8_t *)BKPSRAM_BASE)[i] = (uint8_t)rand();
+	}
+
+	/* Readings wander so a page holds about a hundred records. Volatile, they live across the longjmp() */
+	volatile uint32_t timestamp = 1672531200U;
+	volatile int16_t temperature = 2000;
+	volatile uint32_t pressure = 101325;
+	volatile uint32_t acceptedCount = 0;
+
+	volatile uint8_t isStarted = FALSE;
+	opsToCut = 1 + (rand() % TEST_CUT_MAX_OPS);
+	if (setjmp(powerCut))
+	{
+		cuts++;
+		opsToCut = 1 + (rand() % TEST_CUT_MAX_OPS);
+	}
+	/* An erase cut here leaves the log empty, it is opened again */
+	CHECK(APP_OK == FlashLog_Init());
+	if (isStarted)
+	{
+		CheckLog(acceptedCount, erases > FLASHLOG_SECTORS);
+	}
+	isStarted = TRUE;
+
+	while (acceptedCount < TEST_RECORDS)
+	{
+		timestamp += (rand() % 8) ? 60 : 1 + (rand() % 600);
+		temperature += (int16_t)((rand() % 41) - 20);
+		pressure += (uint32_t)((rand() % 401) - 200);
+		uint32_t loggedPressure = ((pressure + (FLASHLOG_PRESSURE_STEP_PA / 2)) / FLASHLOG_PRESSURE_STEP_PA) * FLASHLOG_PRESSURE_STEP_PA;
+		if (APP_OK == FlashLog_Append(timestamp, temperature, pressure))
+		{
+			accepted[acceptedCount++] = (flashLogRecord_t){.timestamp = timestamp, .temperature = temperature, .pressure = loggedPressure};
+		}
+		else
+		{
+			CHECK(!"append failed");
+			break;
+		}
+	}
+
+	/* Last page goes out in one go */
+	opsToCut = UINT32_MAX;
+	CHECK(APP_OK == FlashLog_Flush());
+	CHECK(APP_OK == FlashLog_Init());
+	CheckLog(acceptedCount, TRUE);
+	CHECK(cuts > 10);
+	CHECK(erases > FLASHLOG_SECTORS);
+	printf("%u records, %u power cuts, %u sector erases\n", acceptedCount, cuts, erases);
+	return CheckResult("flashlog");
+}
@@ -0,0 +1,269 @@
+/**
+ * @file test_history.c
+ * @brief Minute history, window and rollups across clock steps
+ *
+ * Scripted cases cover the hour and day boundaries, gaps of hours and days
+ * and steps of the clock back. A random walk of the clock then checks the
+ * window and the rollups in progress against a brute force model.
+ */
+#include <stdlib.h>
+#include "check.h"
+#include "history.h"
+
+#define TEST_START_MINUTE   (27878400U)     /* 2023-01-01 00:00 */
+#define TEST_STEPS          (200000U)
+#define TEST_MAX_SAMPLES    (TEST_STEPS + 1000U)
+
+typedef struct
+{
+	uint32_t minute;
+	int16_t value;
+}sample_t;
+
+/* Committed samples in order, as seen by the minute callback */
+static sample_t committed[TEST_MAX_SAMPLES];
+static uint32_t committedCount;
+static uint32_t now;
+
+static void OnMinute(int16_t temperature, uint32_t epochMinute)
+{
+	committed[committedCount++] = (sample_t){.minute = epochMinute, .value = temperature};
+}
+
+/**
+ * @brief One reading at minute, which commits the reading before it
+ */
+static void Feed(uint32_t minute, int16_t value)
+{
+	now = minute;
+	History_AddReading(value, minute);
+}
+
+/**
+ * @brief One reading a minute from now to now + minutes
+ */
+static void FeedMinutes(uint32_t minutes, int16_t value)
+{
+	for (uint32_t i = 0; i < minutes; i++)
+	{
+		Feed(now + 1, value);
+	}
+}
+
+static uint8_t IsStats(historyStats_t stats, int16_t min, int16_t max, int16_t mean, uint16_t count)
+{
+	return stats.min == min && stats.max == max && stats.mean == mean && stats.count == count;
+}
+
+static void TestScripted(void)
+{
+	historyStats_t stats;
+	CHECK(APP_OK != History_GetWindowStats(&stats));
+
+	/* 00:00 to 02:59 at 10, 20 and 30, then one reading at 03:00 commits 02:59 */
+	now = TEST_START_MINUTE - 1;
+	FeedMinutes(60, 1000);
+	FeedMinutes(60, 2000);
+	FeedMinutes(60, 3000);
+	FeedMinutes(1, 0);
+	CHECK(committedCount == 180 && committed[179].minute == TEST_START_MINUTE + 179);
+	CHECK(APP_OK == History_GetWindowStats(&stats) && IsStats(stats, 3000, 3000, 3000, 60));
+	CHECK(APP_OK == History_GetHourStats(0, &stats) && IsStats(stats, 3000, 3000, 3000, 60));
+	CHECK(APP_OK == History_GetHourStats(1, &stats) && IsStats(stats, 2000, 2000, 2000, 60));
+	CHECK(APP_OK == History_GetHourStats(2, &stats) && IsStats(stats, 1000, 1000, 1000, 60));
+	CHECK(APP_OK == History_GetDayStats(0, &stats) && IsStats(stats, 1000, 3000, 2000, 180));
+
+	/* Off for 30 minutes, the window is still the last hour of the clock: 02:31 to 03:30 */
+	Feed(now + 30, 0);
+	Feed(now + 1, 0);
+	CHECK(APP_OK == History_GetWindowStats(&stats) && IsStats(stats, 0, 3000, (29 * 3000) / 31, 31));
+
+	/* Off for five hours, the hours between are empty */
+	Feed(now + (5 * 60), 4000);
+	Feed(now + 1, 0);
+	CHECK(APP_OK == History_GetWindowStats(&stats) && IsStats(stats, 4000, 4000, 4000, 1));
+	CHECK(APP_OK == History_GetHourStats(0, &stats) && IsStats(stats, 4000, 4000, 4000, 1));
+	for (uint8_t hoursAgo = 1; hoursAgo < 5; hoursAgo++)
+	{
+		CHECK(APP_OK != History_GetHourStats(hoursAgo, &stats));
+	}
+	CHECK(APP_OK == History_GetHourStats(5, &stats) && IsStats(stats, 0, 0, 0, 3));
+
+	/* Back into the hour before, the window starts over and the hour in progress closes */
+	Feed(now - 40, 5000);
+	Feed(now + 1, 0);
+	CHECK(APP_OK == History_GetWindowStats(&stats) && IsStats(stats, 5000, 5000, 5000, 1));
+	CHECK(APP_OK == History_GetHourStats(1, &stats) && IsStats(stats, 0, 4000, 2000, 2));
+
+	/* Back across midnight, today closes as the day before */
+	uint32_t today = now / HISTORY_MINUTES;
+	Feed((today * HISTORY_MINUTES) - 5, 6000);
+	Feed(now + 1, 0);
+	CHECK(APP_OK == History_GetDayStats(0, &stats) && IsStats(stats, 6000, 6000, 6000, 1));
+	CHECK(APP_OK == History_GetDayStats(1, &stats) && stats.max == 5000);
+
+	/* Off for three days, the two days between are empty */
+	Feed(now + (3 * HISTORY_MINUTES), 7000);
+	Feed(now + 1, 0);
+	CHECK(APP_OK == History_GetDayStats(0, &stats) && IsStats(stats, 7000, 7000, 7000, 1));
+	CHECK(APP_OK != History_GetDayStats(1, &stats));
+	CHECK(APP_OK != History_GetDayStats(2, &stats));
+	CHECK(APP_OK == History_GetDayStats(3, &stats) && stats.min == 0 && stats.max == 6000);
+
+	/* Off for longer than every rollup kept, nothing of before is left */
+	Feed(now + ((HISTORY_DAYS + 1) * HISTORY_MINUTES), 8000);
+	Feed(now + 1, 0);
+	for (uint8_t daysAgo = 1; daysAgo <= HISTORY_DAYS; daysAgo++)
+	{
+		CHECK(APP_OK != History_GetDayStats(daysAgo, &stats));
+	}
+	for (uint8_t hoursAgo = 1; hoursAgo <= HISTORY_HOURS; hoursAgo++)
+	{
+		CHECK(APP_OK != History_GetHourStats(hoursAgo, &stats));
+	}
+	CHECK(APP_OK == History_GetWindowStats(&stats) && IsStats(stats, 8000, 8000, 8000, 1));
+}
+
+/**
+ * @brief Brought up to the clock without a reading, as after a restore from the log
+ */
+static void TestAdvance(void)
+{
+	historyStats_t stats;
+	FeedMinutes(30, 1000);
+	uint32_t last = committedCount;
+	uint32_t lastMinute = now;
+
+	/* The minute in progress is committed, and expires with the rest 90 minutes on */
+	History_AdvanceTo(now + 90);
+	CHECK(committedCount == last + 1 && committed[last].minute == lastMinute);
+	CHECK(APP_OK != History_GetWindowStats(&stats));
+	CHECK(APP_OK != History_GetHourStats(0, &stats));
+
+	/* Not a step back for the first reading after, the window goes on from it */
+	History_AdvanceTo(now + 89);
+	Feed(now + 90, 2000);
+	Feed(now + 1, 3000);
+	Feed(now + 1, 0);
+	CHECK(APP_OK == History_GetWindowStats(&stats) && IsStats(stats, 2000, 3000, 2500, 2));
+
+	/* Only the samples older than the window leave, here the first one */
+	History_AdvanceTo(now + HISTORY_WINDOW_MINUTES - 2);
+	CHECK(APP_OK == History_GetWindowStats(&stats) && IsStats(stats, 0, 3000, 1500, 2));
+}
+
+/**
+ * @brief Statistics of committed[from, to) with a minute after minMinute
+ */
+static uint8_t ModelStats(uint32_t from, uint32_t to, uint32_t minMinute, historyStats_t *stats)
+{
+	int32_t sum = 0;
+	uint16_t count = 0;
+	for (uint32_t i = from; i < to; i++)
+	{
+		if (committed[i].minute < minMinute)
+		{
+			continue;
+		}
+		if (!count || committed[i].value < stats->min)
+		{
+			stats->min = committed[i].value;
+		}
+		if (!count || committed[i].value > stats->max)
+		{
+			stats->max = committed[i].value;
+		}
+		sum += committed[i].value;
+		count++;
+	}
+	if (!count)
+	{
+		return 0;
+	}
+	stats->mean = (int16_t)(sum / count);
+	stats->count = count;
+	return 1;
+}
+
+static uint8_t IsSame(App_StatusTypeDef status, const historyStats_t *stats, uint8_t isModel, const historyStats_t *model)
+{
+	if ((APP_OK == status) != isModel)
+	{
+		return 0;
+	}
+	return !isModel || IsStats(*stats, model->min, model->max, model->mean, model->count);
+}
+
+/**
+ * @brief Mostly a minute at a time, with gaps and steps back of random size
+ */
+static void TestRandomWalk(void)
+{
+	/* From a new day on, the window and rollups in progress start over at a step back */
+	Feed(((now / HISTORY_MINUTES) + 2) * HISTORY_MINUTES, 0);
+	uint32_t windowStart = committedCount;
+	uint32_t hourStart = committedCount;
+	uint32_t dayStart = committedCount;
+	uint32_t mismatches = 0;
+	int16_t value = 2000;
+
+	for (uint32_t step = 0; step < TEST_STEPS; step++)
+	{
+		uint32_t r = (uint32_t)rand() % 1000;
+		uint32_t minute = (r < 900) ? now + 1 :
+			(r < 980) ? now + 2 + ((uint32_t)rand() % 120) :
+			(r < 995) ? now - 1 - ((uint32_t)rand() % 120) :
+			now + 2 + ((uint32_t)rand() % (3 * HISTORY_MINUTES));
+		value += (int16_t)((rand() % 41) - 20);
+
+		uint32_t last = committedCount;
+		Feed(minute, value);
+		if (committedCount == last)
+		{
+			continue;
+		}
+		const sample_t *sample = &committed[committedCount - 1];
+		if (last)
+		{
+			const sample_t *prev = &committed[last - 1];
+			if (sample->minute <= prev->minute)
+			{
+				windowStart = committedCount - 1;
+			}
+			if (sample->minute / 60 != prev->minute / 60)
+			{
+				hourStart = committedCount - 1;
+			}
+			if (sample->minute / HISTORY_MINUTES != prev->minute / HISTORY_MINUTES)
+			{
+				dayStart = committedCount - 1;
+			}
+		}
+
+		historyStats_t stats;
+		historyStats_t model;
+		uint32_t minMinute = (sample->minute >= HISTORY_WINDOW_MINUTES) ? sample->minute - HISTORY_WINDOW_MINUTES + 1 : 0;
+		uint8_t isModel = ModelStats(windowStart, committedCount, minMinute, &model);
+		uint8_t isSame = IsSame(History_GetWindowStats(&stats), &stats, isModel, &model);
+		isModel = ModelStats(hourStart, committedCount, 0, &model);
+		isSame &= IsSame(History_GetHourStats(0, &stats), &stats, isModel, &model);
+		isModel = ModelStats(dayStart, committedCount, 0, &model);
+		isSame &= IsSame(History_GetDayStats(0, &stats), &stats, isModel, &model);
+		if (!isSame && mismatches++ < 10)
+		{
+			fprintf(stderr, "step %u: minute %u differs from the model\n", step, sample->minute);
+		}
+	}
+	CHECK(mismatches == 0);
+	CHECK(committedCount < TEST_MAX_SAMPLES);
+}
+
+int main(void)
+{
+	srand(1);
+	History_SetMinuteCallback(OnMinute);
+	TestScripted();
+	TestAdvance();
+	TestRandomWalk();
+	return CheckResult("history");
+}
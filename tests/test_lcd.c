@@ -0,0 +1,326 @@
+/**
+ * @file test_lcd.c
+ * @brief LCD frame buffer and the content patches of the ESP32 on it
+ *
+ * The panel is an HD44780 emulated from the pins: each falling edge of EN
+ * latches a nibble of the 4-bit bus into a command or a data write, the
+ * display RAM is kept with its odd row addressing. LCD_Flush() must send
+ * only the cells changed, one cursor move per run of them, and held cells
+ * must keep their codes against the local text until released. Content
+ * patches must be cut at the edge of the panel and released when their
+ * TTL runs out, across the wrap of the tick too.
+ */
+#include <string.h>
+#include "check.h"
+#include "content.h"
+
+#define PANEL_DDRAM_SIZE    (0x80U)
+
+/* Display RAM address of the first cell of each row */
+static const uint8_t rowAddress[LCD_ROWS] = {0x00, 0x40, 0x14, 0x54};
+
+static uint8_t ddram[PANEL_DDRAM_SIZE];
+static uint8_t cgram[LCD_CUSTOM_CHARS * 8];
+static uint8_t address;
+static uint8_t isCgram;
+static uint8_t isFourBit;
+static uint8_t highNibble;
+static uint8_t isLowNext;
+static uint32_t cursorMoves;
+static uint32_t dataWrites;
+static uint32_t tick;
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return tick;
+}
+
+static uint8_t Pin(GPIO_TypeDef *port, uint16_t pin)
+{
+	return (port->ODR & pin) ? 1U : 0U;
+}
+
+static void PanelWrite(uint8_t isData, uint8_t value)
+{
+	if (isData)
+	{
+		dataWrites++;
+		if (isCgram)
+		{
+			cgram[address % sizeof(cgram)] = value;
+		}
+		else
+		{
+			ddram[address % PANEL_DDRAM_SIZE] = value;
+		}
+		address++;
+	}
+	else if (value & LCD_CMD_SET_DDRAM_ADDR)
+	{
+		cursorMoves++;
+		address = value & 0x7FU;
+		isCgram = FALSE;
+	}
+	else if (value & LCD_CMD_SET_CGRAM_ADDR)
+	{
+		address = value & 0x3FU;
+		isCgram = TRUE;
+	}
+	else if (value == LCD_CMD_DISP_CLR)
+	{
+		memset(ddram, ' ', sizeof(ddram));
+		address = 0;
+		isCgram = FALSE;
+	}
+}
+
+/* A nibble is latched on the falling edge of EN */
+static void PanelLatch(void)
+{
+	uint8_t nibble = (uint8_t)((Pin(LCD_GPIO_PORT_2, LCD_GPIO_D7) << 3) | (Pin(LCD_GPIO_PORT_2, LCD_GPIO_D6) << 2) |
+							   (Pin(LCD_GPIO_PORT_1, LCD_GPIO_D5) << 1) | Pin(LCD_GPIO_PORT_1, LCD_GPIO_D4));
+	if (!isFourBit)
+	{
+		/* Still in the 8-bit mode of power on, the low nibble is not wired */
+		isFourBit = (nibble == 0x2U);
+		return;
+	}
+	if (!isLowNext)
+	{
+		highNibble = nibble;
+		isLowNext = TRUE;
+		return;
+	}
+	isLowNext = FALSE;
+	PanelWrite(Pin(LCD_GPIO_PORT_1, LCD_GPIO_RS), (uint8_t)((highNibble << 4) | nibble));
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	uint8_t isFalling = (GPIOx == LCD_GPIO_PORT_1) && (GPIO_Pin == LCD_GPIO_EN) && Pin(GPIOx, GPIO_Pin) &&
+		(PinState == GPIO_PIN_RESET);
+	if (PinState == GPIO_PIN_SET)
+	{
+		GPIOx->ODR |= GPIO_Pin;
+	}
+	else
+	{
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	}
+	if (isFalling)
+	{
+		PanelLatch();
+	}
+}
+
+/**
+ * @brief Check a row of the panel, rows from 1 as LCD_WriteText()
+ */
+static uint8_t RowIs(uint8_t row, const char *expected)
+{
+	uint8_t isSame = !memcmp(&ddram[rowAddress[row - 1]], expected, LCD_COLUMNS);
+	if (!isSame)
+	{
+		fprintf(stderr, "row %u: \"%.*s\", expected \"%s\"\n", row, LCD_COLUMNS, (const char *)&ddram[rowAddress[row - 1]],
+				expected);
+	}
+	return isSame;
+}
+
+static void Flush(uint32_t *moves, uint32_t *writes)
+{
+	uint32_t movesBefore = cursorMoves;
+	uint32_t writesBefore = dataWrites;
+	LCD_Flush();
+	*moves = cursorMoves - movesBefore;
+	*writes = dataWrites - writesBefore;
+}
+
+static void Patch(uint8_t row, uint8_t column, uint16_t ttl_s, const char *text)
+{
+	struct timesync_content content = {.row = row, .column = column, .ttl_s = ttl_s,
+									   .length = (uint8_t)strlen(text), .text = (const uint8_t *)text};
+	Content_Apply(&content);
+}
+
+/**
+ * @brief Only the changed cells go to the panel, one cursor move per run
+ */
+static void TestFlush(void)
+{
+	uint32_t moves;
+	uint32_t writes;
+
+	LCD_WriteText(1, 1, "Hello");
+	Flush(&moves, &writes);
+	CHECK(moves == 1 && writes == 5);
+	CHECK(RowIs(1, "Hello               "));
+
+	/* Nothing changed, nothing sent, the same text again changes nothing */
+	Flush(&moves, &writes);
+	CHECK(moves == 0 && writes == 0);
+	LCD_WriteText(1, 1, "Hello");
+	Flush(&moves, &writes);
+	CHECK(moves == 0 && writes == 0);
+
+	/* Two runs apart in one row, and one ending on the last column */
+	LCD_WriteText(1, 1, "Hallo  world");
+	LCD_WriteText(2, 18, "end");
+	Flush(&moves, &writes);
+	CHECK(moves == 3 && writes == 1 + 5 + 3);
+	CHECK(RowIs(1, "Hallo  world        "));
+	CHECK(RowIs(2, "                 end"));
+
+	/* Cut at the end of the row, the panel would run on into row 3 */
+	LCD_WriteText(2, 19, "abcdef");
+	Flush(&moves, &writes);
+	CHECK(moves == 1 && writes == 2);
+	CHECK(RowIs(2, "                 eab"));
+	CHECK(RowIs(3, "                    "));
+
+	/* Off the panel */
+	LCD_WriteText(0, 1, "x");
+	LCD_WriteText(LCD_ROWS + 1, 1, "x");
+	LCD_WriteText(1, 0, "x");
+	LCD_WriteText(1, LCD_COLUMNS + 1, "x");
+	Flush(&moves, &writes);
+	CHECK(moves == 0 && writes == 0);
+}
+
+/**
+ * @brief Held cells keep their codes against the local text until released
+ */
+static void TestHeld(void)
+{
+	uint32_t moves;
+	uint32_t writes;
+
+	const uint8_t held[] = {'X', LCD_CUSTOM_CHAR_CODE(1)};
+	LCD_WriteHeld(3, 5, held, sizeof(held));
+	LCD_WriteText(3, 1, "123456789");
+	Flush(&moves, &writes);
+	CHECK(RowIs(3, "1234X\x09" "789           "));
+	CHECK(moves == 1 && writes == 9);
+
+	/* Local text over them changes nothing */
+	LCD_WriteText(3, 4, "abcd");
+	Flush(&moves, &writes);
+	CHECK(RowIs(3, "123aX\x09" "d89           "));
+	CHECK(moves == 2 && writes == 2);
+
+	/* Released cells go blank, until the local text is written again */
+	LCD_Release(3, 5, 2);
+	Flush(&moves, &writes);
+	CHECK(RowIs(3, "123a  d89           "));
+	CHECK(moves == 1 && writes == 2);
+	LCD_WriteText(3, 1, "123456789");
+	Flush(&moves, &writes);
+	CHECK(RowIs(3, "123456789           "));
+
+	/* A clear drops every hold */
+	LCD_WriteHeld(4, 1, held, 1);
+	LCD_DisplayClear();
+	LCD_WriteText(4, 1, "free");
+	Flush(&moves, &writes);
+	CHECK(RowIs(4, "free                "));
+	CHECK(RowIs(1, "                    "));
+
+	/* Custom characters land in the patterns and the panel is back on its display RAM */
+	const uint8_t pattern[8] = {0x1F, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1F};
+	LCD_DefineChar(2, pattern);
+	CHECK(!memcmp(&cgram[2 * 8], pattern, sizeof(pattern)) && !isCgram);
+	LCD_DisplayClear();
+}
+
+/**
+ * @brief Patches are cut at the edge of the panel and released when their TTL runs out
+ */
+static void TestContent(void)
+{
+	uint32_t moves;
+	uint32_t writes;
+
+	tick = 1000;
+	LCD_WriteText(2, 1, "local text here");
+	Patch(1, 2, 30, "hello");
+	Flush(&moves, &writes);
+	CHECK(RowIs(2, "lohelloext here     "));
+	LCD_WriteText(2, 1, "LOCAL TEXT HERE");
+	Flush(&moves, &writes);
+	CHECK(RowIs(2, "LOhelloEXT HERE     "));
+
+	/* Released on the tick the TTL runs out, the local text shows when it is written next */
+	tick += 30U * 1000U - 1U;
+	CHECK(!Content_Expire());
+	tick++;
+	CHECK(Content_Expire());
+	CHECK(!Content_Expire());
+	LCD_WriteText(2, 1, "LOCAL TEXT HERE");
+	Flush(&moves, &writes);
+	CHECK(RowIs(2, "LOCAL TEXT HERE     "));
+
+	/* Cut at the right edge, nothing past the last row or column */
+	Patch(0, LCD_COLUMNS - 3, 10, "edge!");
+	Patch(LCD_ROWS, 0, 10, "gone");
+	Patch(0, LCD_COLUMNS, 10, "gone");
+	Flush(&moves, &writes);
+	CHECK(RowIs(1, "                 edg"));
+	CHECK(RowIs(3, "                    "));
+	CHECK(moves == 1 && writes == 3);
+
+	/* A later patch over part of it keeps that part for its own TTL */
+	tick += 5000;
+	Patch(0, LCD_COLUMNS - 1, 60, "#");
+	tick += 5000;
+	CHECK(Content_Expire());
+	Flush(&moves, &writes);
+	CHECK(RowIs(1, "                   #"));
+
+	/* Without a TTL it stays until covered, then the covered part goes with the patch over it */
+	Patch(3, 0, 0, "pinned");
+	tick += 60U * 1000U;
+	CHECK(Content_Expire());
+	LCD_WriteText(4, 1, "local");
+	Flush(&moves, &writes);
+	CHECK(RowIs(4, "pinned              "));
+	CHECK(RowIs(1, "                    "));
+	Patch(3, 0, 1, "PIN");
+	tick += 1000;
+	CHECK(Content_Expire());
+	LCD_WriteText(4, 1, "local");
+	Flush(&moves, &writes);
+	CHECK(RowIs(4, "locned              "));
+
+	/* Across the wrap of the tick */
+	tick = 0xFFFFFFFFU - 500U;
+	Patch(2, 0, 2, "wrap");
+	tick = 1000;
+	CHECK(!Content_Expire());
+	tick = 1500;
+	CHECK(Content_Expire());
+	tick = 0xFFFFFFFFU - 5000U;
+	Patch(2, 0, 1, "late");
+	tick = 500;
+	CHECK(Content_Expire());
+	Flush(&moves, &writes);
+	CHECK(RowIs(3, "                    "));
+}
+
+int main(void)
+{
+	CHECK(APP_OK == LCD_Init());
+	CHECK(isFourBit && RowIs(1, "                    "));
+
+	TestFlush();
+	TestHeld();
+	TestContent();
+	return CheckResult("lcd");
+}
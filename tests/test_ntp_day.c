@@ -0,0 +1,136 @@
+/**
+ * @file test_ntp_day.c
+ * @brief A day of the SNTP client, the filter, selection, poll interval and disciplined clock together
+ *
+ * Polls go out as ntp_work_handler() sends them: every server at the
+ * interval of ntp_poll, the selected server's filter sample fed to the
+ * clock once. Four servers with random path delays and asymmetries, one of
+ * them a falseticker, and an uptime clock 50 ppm fast whose rate wanders.
+ * The error of the clock is taken before each poll, where it is largest,
+ * and reported with the number of queries.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "disc_clock.h"
+#include "ntp_filter.h"
+
+#define TEST_SERVERS        (4)
+#define TEST_DAY_US         (86400LL * 1000000LL)
+#define TEST_UTC_US         (1700000000LL * 1000000LL)
+#define TEST_DRIFT_PPB      (50000.0)       /* Uptime clock 50 ppm fast */
+#define TEST_WANDER_PPB     (20.0)          /* Random walk of the rate per 64 s */
+#define TEST_FALSE_US       (250000)        /* Falseticker error */
+#define TEST_MAX_ERROR_US   (20000)         /* Once the rate is known */
+
+int64_t hostUptimeTicks;
+
+static int64_t Absolute(int64_t value)
+{
+	return (value < 0) ? -value : value;
+}
+
+/* Uniform in [-1, 1] */
+static double Uniform(void)
+{
+	return (2.0 * rand() / RAND_MAX) - 1.0;
+}
+
+int main(void)
+{
+	struct ntp_peer servers[TEST_SERVERS] = {0};
+	const struct ntp_peer *peers[TEST_SERVERS];
+	struct ntp_poll poll;
+	const int falseticker = 2;
+
+	srand(1);
+	for (int i = 0; i < TEST_SERVERS; i++)
+	{
+		ntp_peer_reset(&servers[i]);
+		servers[i].stratum = 1 + (i % 3);
+		servers[i].root_delay_us = 2000 * i;
+		servers[i].root_dispersion_us = 500 * i;
+		peers[i] = &servers[i];
+	}
+	ntp_poll_init(&poll);
+
+	double driftPpb = TEST_DRIFT_PPB;
+	int64_t uptime_us = 0;
+	int64_t true_us = 0;
+	int64_t last_uptime_us = -1;
+	uint32_t polls = 0;
+	uint32_t queries = 0;
+	uint32_t missed = 0;
+	uint32_t steps = 0;
+	uint32_t falseSelected = 0;
+	uint32_t measured = 0;
+	double errorSum = 0;
+	int64_t errorMax = 0;
+
+	while (true_us < TEST_DAY_US)
+	{
+		/* Work is scheduled on the uptime, the true time runs slower by the drift */
+		int64_t interval_us = (int64_t)ntp_poll_interval_s(&poll) * 1000000LL;
+		uptime_us += interval_us;
+		true_us += (int64_t)llround(interval_us / (1.0 + (driftPpb * 1e-9)));
+		driftPpb += TEST_WANDER_PPB * Uniform() * sqrt(interval_us / 64e6);
+		hostUptimeTicks = uptime_us;
+		int64_t utc_us = TEST_UTC_US + true_us;
+
+		int64_t clock_us;
+		if (disc_clock_has_rate() && disc_clock_now(uptime_us, &clock_us))
+		{
+			int64_t error_us = Absolute(clock_us - utc_us);
+			errorSum += error_us;
+			errorMax = (error_us > errorMax) ? error_us : errorMax;
+			measured++;
+		}
+
+		for (int i = 0; i < TEST_SERVERS; i++)
+		{
+			queries++;
+			if (!(rand() % 20))
+			{
+				ntp_peer_poll(&servers[i], NULL, uptime_us, disc_clock_rate_ppb());
+				continue;
+			}
+			/* Mostly a quiet path, at times a congested one */
+			int64_t delay_us = 2000 + (rand() % 3000) + ((rand() % 8) ? 0 : (rand() % 50000));
+			int64_t asymmetry_us = (rand() % (delay_us + 1)) - (delay_us / 2);
+			int64_t server_us = utc_us + asymmetry_us + ((i == falseticker) ? TEST_FALSE_US : 0);
+			struct ntp_sample sample = {.offset_us = server_us - uptime_us, .delay_us = delay_us,
+										.dispersion_us = NTP_FILTER_PRECISION_US, .local_us = uptime_us};
+			ntp_peer_poll(&servers[i], &sample, uptime_us, disc_clock_rate_ppb());
+		}
+		polls++;
+
+		int selected = ntp_select(peers, TEST_SERVERS, uptime_us);
+		if (selected < 0)
+		{
+			missed++;
+			ntp_poll_update(&poll, NTP_POLL_MISSED, false, 0);
+			continue;
+		}
+		falseSelected += (selected == falseticker);
+		const struct ntp_peer *peer = &servers[selected];
+		if (peer->update_us > last_uptime_us)
+		{
+			int64_t offset_us;
+			bool is_step = disc_clock_update(peer->update_us + peer->update_offset_us, peer->update_us, &offset_us);
+			steps += is_step;
+			ntp_poll_update(&poll, is_step ? NTP_POLL_STEP : NTP_POLL_OK,
+							peer->count == NTP_FILTER_STAGES && disc_clock_has_rate(), offset_us);
+			last_uptime_us = peer->update_us;
+		}
+	}
+
+	printf("  simulated day: %u polls (%u queries, %u at 1 s), clock error mean %.2f ms, max %.2f ms, rate %d ppb of %.0f\n",
+	       polls, queries, (uint32_t)(TEST_DAY_US / 1000000LL) * TEST_SERVERS,
+	       measured ? errorSum / measured / 1000.0 : 0.0, errorMax / 1000.0, disc_clock_rate_ppb(), driftPpb);
+	CHECK(falseSelected == 0);
+	CHECK(steps == 1);
+	CHECK(measured > 0 && errorMax < TEST_MAX_ERROR_US);
+	CHECK(ntp_poll_interval_s(&poll) >= (1U << NTP_POLL_MIN_EXP));
+	CHECK(missed < polls / 100);
+	return CheckResult("ntp_day");
+}
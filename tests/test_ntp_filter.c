@@ -0,0 +1,271 @@
+/**
+ * @file test_ntp_filter.c
+ * @brief Clock filter, source selection and poll interval of the ESP32
+ *
+ * Scripted samples check the choice of the sample of least delay, its
+ * carrying forward at the clock rate, the jitter and the reach. Servers
+ * are then polled with random delays and asymmetries around a true offset,
+ * one of them a falseticker. The falseticker must never be selected and
+ * the interval of the selected server must always hold the true offset.
+ */
+#include <stdlib.h>
+#include "check.h"
+#include "ntp_filter.h"
+
+#define TEST_SERVERS        (5)
+#define TEST_POLLS          (20000U)
+#define TEST_POLL_US        (64000000LL)
+#define TEST_RATE_PPB       (10000)         /* Local clock 10 ppm fast, within NTP_FILTER_PHI_PPM */
+#define TEST_FALSE_US       (250000)        /* Falseticker error, well past the others' distance */
+
+static int64_t Absolute(int64_t value)
+{
+	return (value < 0) ? -value : value;
+}
+
+static struct ntp_sample Sample(int64_t offset_us, int64_t delay_us, int64_t local_us)
+{
+	return (struct ntp_sample){.offset_us = offset_us, .delay_us = delay_us,
+							   .dispersion_us = NTP_FILTER_PRECISION_US, .local_us = local_us};
+}
+
+static void TestFilter(void)
+{
+	struct ntp_peer peer = {0};
+	ntp_peer_reset(&peer);
+
+	/* A single sample is taken as it is, with the precision as jitter */
+	struct ntp_sample sample = Sample(1000, 8000, 0);
+	ntp_peer_poll(&peer, &sample, 0, 0);
+	CHECK(peer.count == 1 && peer.reach == 1);
+	CHECK(peer.offset_us == 1000 && peer.delay_us == 8000);
+	CHECK(peer.jitter_us == NTP_FILTER_PRECISION_US);
+
+	/* The sample of least delay wins, wherever it is in the register */
+	const int64_t delays[NTP_FILTER_STAGES] = {9000, 7000, 12000, 3000, 6000, 15000, 5000};
+	for (uint8_t i = 0; i < NTP_FILTER_STAGES - 1; i++)
+	{
+		int64_t local_us = (i + 1) * TEST_POLL_US;
+		sample = Sample(1000 + (i * 100), delays[i], local_us);
+		ntp_peer_poll(&peer, &sample, local_us, 0);
+	}
+	CHECK(peer.count == NTP_FILTER_STAGES && peer.reach == 0xFF);
+	CHECK(peer.delay_us == 3000 && peer.offset_us == 1300 && peer.update_offset_us == 1300);
+	CHECK(peer.update_us == 4 * TEST_POLL_US);
+	CHECK(peer.jitter_us > 0);
+
+	/* It is carried forward at the rate of the local clock, a fast clock gains on the server */
+	int64_t local_us = NTP_FILTER_STAGES * TEST_POLL_US;
+	sample = Sample(0, 20000, local_us);
+	ntp_peer_poll(&peer, &sample, local_us, TEST_RATE_PPB);
+	CHECK(peer.delay_us == 3000);
+	CHECK(peer.offset_us == 1300 - ((local_us - (4 * TEST_POLL_US)) * TEST_RATE_PPB / 1000000000LL));
+	CHECK(peer.update_offset_us == 1300);
+
+	/* Once the register has wrapped around onto it, the next least delay wins */
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		local_us += TEST_POLL_US;
+		sample = Sample(2000, 20000, local_us);
+		ntp_peer_poll(&peer, &sample, local_us, 0);
+	}
+	CHECK(peer.delay_us == 5000 && peer.offset_us == 1600);
+
+	/* Identical offsets have no jitter */
+	ntp_peer_reset(&peer);
+	for (uint8_t i = 0; i < NTP_FILTER_STAGES; i++)
+	{
+		sample = Sample(-500, 4000 + i, i * TEST_POLL_US);
+		ntp_peer_poll(&peer, &sample, i * TEST_POLL_US, 0);
+	}
+	CHECK(peer.offset_us == -500 && peer.jitter_us == 0);
+
+	/* Missed polls shift the reach, the server is unreachable after eight */
+	const struct ntp_peer *const peers[] = {&peer};
+	CHECK(ntp_select(peers, 1, local_us) == 0);
+	for (uint8_t i = 0; i < NTP_FILTER_STAGES; i++)
+	{
+		CHECK(peer.reach);
+		ntp_peer_poll(&peer, NULL, local_us, 0);
+	}
+	CHECK(peer.reach == 0 && peer.count == NTP_FILTER_STAGES);
+	CHECK(ntp_select(peers, 1, local_us) == -1);
+}
+
+/**
+ * @brief One sample in the filter of each server, as the offsets and delays given
+ */
+static int Select(struct ntp_peer *servers, const int64_t *offsets, const int64_t *delays, int count)
+{
+	const struct ntp_peer *peers[TEST_SERVERS];
+	for (int i = 0; i < count; i++)
+	{
+		struct ntp_sample sample = Sample(offsets[i], delays[i], 0);
+		ntp_peer_reset(&servers[i]);
+		servers[i].stratum = 2;
+		servers[i].root_delay_us = 0;
+		servers[i].root_dispersion_us = 0;
+		ntp_peer_poll(&servers[i], &sample, 0, 0);
+		peers[i] = &servers[i];
+	}
+	return ntp_select(peers, count, 0);
+}
+
+static void TestSelect(void)
+{
+	struct ntp_peer servers[TEST_SERVERS] = {0};
+
+	/* The falseticker is out voted, the closest to UTC of the rest wins */
+	const int64_t offsets[] = {1000, 1200, 900, 300000, 1100};
+	const int64_t delays[] = {8000, 4000, 6000, 1000, 10000};
+	CHECK(Select(servers, offsets, delays, 5) == 1);
+
+	/* Two against two have no majority */
+	const int64_t split[] = {1000, 1100, 500000, 500100};
+	CHECK(Select(servers, split, delays, 4) == -1);
+
+	/* One server is its own majority, unless it is too far from UTC */
+	CHECK(Select(servers, offsets, delays, 1) == 0);
+	const int64_t far[] = {2 * NTP_FILTER_MAX_DISTANCE_US};
+	CHECK(Select(servers, offsets, far, 1) == -1);
+
+	/* Root distance counts, a server far down the tree loses to a close one */
+	Select(servers, offsets, delays, 3);
+	servers[1].root_dispersion_us = 20000;
+	const struct ntp_peer *const peers[] = {&servers[0], &servers[1], &servers[2]};
+	CHECK(ntp_select(peers, 3, 0) == 2);
+	CHECK(ntp_select(peers, 0, 0) == -1);
+}
+
+/**
+ * @brief Servers with random path delays and asymmetries, one of them off by TEST_FALSE_US
+ * A sample is off by at most half its delay, so every truechimer's interval
+ * holds the true offset and the falseticker's does not meet them. The
+ * error of the offset selected is reported.
+ */
+static void TestRandomPolls(void)
+{
+	struct ntp_peer servers[TEST_SERVERS] = {0};
+	const struct ntp_peer *peers[TEST_SERVERS];
+	const int falseticker = 3;
+	uint32_t falseSelected = 0;
+	uint32_t missed = 0;
+	uint32_t outside = 0;
+	int64_t errorSum = 0;
+	int64_t errorMax = 0;
+
+	for (int i = 0; i < TEST_SERVERS; i++)
+	{
+		ntp_peer_reset(&servers[i]);
+		servers[i].stratum = 1 + (i % 3);
+		servers[i].root_delay_us = 2000 * i;
+		servers[i].root_dispersion_us = 500 * i;
+		peers[i] = &servers[i];
+	}
+
+	int64_t trueOffset = 20000;
+	for (uint32_t poll = 0; poll < TEST_POLLS; poll++)
+	{
+		int64_t now_us = (int64_t)poll * TEST_POLL_US;
+		/* The local clock runs fast, the server clocks pull back from it */
+		trueOffset -= (TEST_POLL_US * TEST_RATE_PPB) / 1000000000LL;
+		for (int i = 0; i < TEST_SERVERS; i++)
+		{
+			if (!(rand() % 10))
+			{
+				ntp_peer_poll(&servers[i], NULL, now_us, TEST_RATE_PPB);
+				continue;
+			}
+			/* Mostly a quiet path, at times a congested one */
+			int64_t delay_us = 2000 + (rand() % 3000) + ((rand() % 8) ? 0 : (rand() % 200000));
+			int64_t asymmetry_us = (rand() % (delay_us + 1)) - (delay_us / 2);
+			int64_t offset_us = trueOffset + asymmetry_us + ((i == falseticker) ? TEST_FALSE_US : 0);
+			struct ntp_sample sample = Sample(offset_us, delay_us, now_us);
+			ntp_peer_poll(&servers[i], &sample, now_us, TEST_RATE_PPB);
+		}
+
+		int selected = ntp_select(peers, TEST_SERVERS, now_us);
+		if (selected < 0)
+		{
+			missed++;
+			continue;
+		}
+		falseSelected += (selected == falseticker);
+		int64_t error_us = Absolute(servers[selected].offset_us - trueOffset);
+		errorSum += error_us;
+		errorMax = (error_us > errorMax) ? error_us : errorMax;
+		if (error_us > ntp_peer_distance(&servers[selected], now_us) && outside++ < 10)
+		{
+			fprintf(stderr, "poll %u: server %d off by %lld us\n", poll, selected, (long long)error_us);
+		}
+	}
+	CHECK(falseSelected == 0);
+	CHECK(missed == 0);
+	CHECK(outside == 0);
+
+	uint32_t selectedPolls = TEST_POLLS - missed;
+	printf("  selected offset error mean %.0f us, max %lld us over %u polls\n",
+	       selectedPolls ? (double)errorSum / selectedPolls : 0.0, (long long)errorMax, selectedPolls);
+}
+
+static void TestPollInterval(void)
+{
+	struct ntp_poll poll;
+	ntp_poll_init(&poll);
+	CHECK(ntp_poll_interval_s(&poll) == (1U << NTP_POLL_FAST_EXP));
+
+	/* Fast until settled, then from 64 s */
+	ntp_poll_update(&poll, NTP_POLL_OK, false, 0);
+	CHECK(poll.exponent == NTP_POLL_FAST_EXP);
+	ntp_poll_update(&poll, NTP_POLL_OK, true, 0);
+	CHECK(poll.exponent == NTP_POLL_MIN_EXP);
+
+	/* Doubles after NTP_POLL_HOLD polls well within the budget, up to the maximum */
+	for (uint8_t exponent = NTP_POLL_MIN_EXP; exponent < NTP_POLL_MAX_EXP; exponent++)
+	{
+		for (uint8_t i = 0; i < NTP_POLL_HOLD - 1; i++)
+		{
+			ntp_poll_update(&poll, NTP_POLL_OK, true, NTP_POLL_BUDGET_US / 4);
+		}
+		CHECK(poll.exponent == exponent);
+		ntp_poll_update(&poll, NTP_POLL_OK, true, -NTP_POLL_BUDGET_US / 4);
+		CHECK(poll.exponent == exponent + 1);
+	}
+	for (uint8_t i = 0; i < 2 * NTP_POLL_HOLD; i++)
+	{
+		ntp_poll_update(&poll, NTP_POLL_OK, true, 0);
+	}
+	CHECK(ntp_poll_interval_s(&poll) == (1U << NTP_POLL_MAX_EXP));
+
+	/* Between half the budget and the budget it holds, past the budget it halves */
+	for (uint8_t i = 0; i < 2 * NTP_POLL_HOLD; i++)
+	{
+		ntp_poll_update(&poll, NTP_POLL_OK, true, (3 * NTP_POLL_BUDGET_US) / 4);
+	}
+	CHECK(poll.exponent == NTP_POLL_MAX_EXP);
+	ntp_poll_update(&poll, NTP_POLL_OK, true, -(NTP_POLL_BUDGET_US + 1));
+	CHECK(poll.exponent == NTP_POLL_MAX_EXP - 1);
+
+	/* A missed poll drops to 64 s, a step starts over fast */
+	ntp_poll_update(&poll, NTP_POLL_MISSED, true, 0);
+	CHECK(poll.exponent == NTP_POLL_MIN_EXP);
+	for (uint8_t i = 0; i < 4 * NTP_POLL_HOLD; i++)
+	{
+		ntp_poll_update(&poll, NTP_POLL_OK, true, NTP_POLL_BUDGET_US + 1);
+	}
+	CHECK(poll.exponent == NTP_POLL_MIN_EXP);
+	ntp_poll_update(&poll, NTP_POLL_STEP, true, 1000000);
+	CHECK(poll.exponent == NTP_POLL_FAST_EXP);
+	ntp_poll_update(&poll, NTP_POLL_MISSED, false, 0);
+	CHECK(poll.exponent == NTP_POLL_FAST_EXP);
+}
+
+int main(void)
+{
+	srand(1);
+	TestFilter();
+	TestSelect();
+	TestRandomPolls();
+	TestPollInterval();
+	return CheckResult("ntp_filter");
+}
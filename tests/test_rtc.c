@@ -0,0 +1,152 @@
+/**
+ * @file test_rtc.c
+ * @brief RTC readings to time since 1970
+ *
+ * The RTC HAL calls return a time and date set by the test. Every
+ * date the RTC can hold is checked against timegm() of the C library, and
+ * readings with subseconds against the conversion done in long double.
+ * The second tick must be an alarm on every second, whatever the
+ * subseconds.
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "check.h"
+#include "rtc.h"
+
+#define TEST_STAMPS         (1000000U)
+
+static RTC_TimeTypeDef rtcTime;
+static RTC_DateTypeDef rtcDate;
+static RTC_AlarmTypeDef rtcAlarm;
+static uint32_t ticks;
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	rtcTime = *sTime;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	rtcDate = *sDate;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	*sTime = rtcTime;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	*sDate = rtcDate;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTCEx_SetSynchroShift(RTC_HandleTypeDef *hrtc, uint32_t ShiftAdd1S, uint32_t ShiftSubFS)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetAlarm_IT(RTC_HandleTypeDef *hrtc, RTC_AlarmTypeDef *sAlarm, uint32_t Format)
+{
+	rtcAlarm = *sAlarm;
+	return HAL_OK;
+}
+
+static void OnSecond(void)
+{
+	ticks++;
+}
+
+/**
+ * @brief Every day from 2000-01-01 to 2099-12-31
+ */
+static void TestDays(void)
+{
+	uint32_t days = 0;
+	uint32_t prev = RTC_DAYS_TO_2000 - 1;
+	for (uint8_t year = 0; year < 100; year++)
+	{
+		for (uint8_t month = 1; month <= 12; month++)
+		{
+			for (uint8_t date = 1; date <= 31; date++)
+			{
+				struct tm tm = {.tm_year = 100 + year, .tm_mon = month - 1, .tm_mday = date};
+				time_t t = timegm(&tm);
+				if (tm.tm_mday != date)
+				{
+					/* Past the end of the month */
+					break;
+				}
+				RTC_DateTypeDef rtc = {.Year = year, .Month = month, .Date = date};
+				uint32_t d = RTC_DateToDays(&rtc);
+				CHECK((int64_t)d * 86400 == (int64_t)t);
+				CHECK(d == prev + 1);
+				prev = d;
+				days++;
+			}
+		}
+	}
+	CHECK(days == 36525);
+}
+
+/**
+ * @brief Readings with subseconds, including the ones above SecondFraction after a delaying shift
+ */
+static void TestStamps(void)
+{
+	RTC_TimeTypeDef time = {0};
+	RTC_DateTypeDef date = {.Year = 23, .Month = 1, .Date = 1};
+	CHECK(APP_OK == RTC_Init(&time, &date, RTC_FORMAT_BIN));
+
+	for (uint32_t n = 0; n < TEST_STAMPS; n++)
+	{
+		rtcDate = (RTC_DateTypeDef){.Year = rand() % 100, .Month = 1 + (rand() % 12), .Date = 1 + (rand() % 28)};
+		rtcTime = (RTC_TimeTypeDef){.Hours = rand() % 24, .Minutes = rand() % 60, .Seconds = rand() % 60,
+									.SecondFraction = RTC_SYNCH_PREDIV};
+		rtcTime.SubSeconds = rand() % (RTC_SYNCH_PREDIV + 1 + ((n % 8) ? 0 : 100));
+		rtcStamp_t stamp;
+		CHECK(APP_OK == RTC_GetStamp(&stamp));
+
+		int64_t micros = RTC_StampToMicros(&stamp);
+
+		struct tm tm = {.tm_year = 100 + rtcDate.Year, .tm_mon = rtcDate.Month - 1, .tm_mday = rtcDate.Date,
+						.tm_hour = rtcTime.Hours, .tm_min = rtcTime.Minutes, .tm_sec = rtcTime.Seconds};
+		/* Subseconds to the microsecond, truncated towards zero */
+		long double fraction = ((long double)RTC_SYNCH_PREDIV - rtcTime.SubSeconds) / (RTC_SYNCH_PREDIV + 1);
+		int64_t expect = ((int64_t)timegm(&tm) * 1000000) + (int64_t)(fraction * 1e6L);
+		if (micros != expect)
+		{
+			fprintf(stderr, "%lld us, expected %lld\n", (long long)micros, (long long)expect);
+			CHECK(!"reading converted wrongly");
+			break;
+		}
+	}
+}
+
+static void TestSecondTick(void)
+{
+	CHECK(APP_OK != RTC_StartSecondTick(NULL));
+	CHECK(APP_OK == RTC_StartSecondTick(OnSecond));
+	CHECK(rtcAlarm.Alarm == RTC_ALARM_A);
+	CHECK(rtcAlarm.AlarmMask == RTC_ALARMMASK_ALL);
+	CHECK(rtcAlarm.AlarmSubSecondMask == RTC_ALARMSUBSECONDMASK_ALL);
+	HAL_RTC_AlarmAEventCallback(NULL);
+	CHECK(ticks == 1);
+}
+
+int main(void)
+{
+	srand(1);
+	TestDays();
+	TestStamps();
+	TestSecondTick();
+	return CheckResult("rtc");
+}
@@ -0,0 +1,435 @@
+/**
+ * @file test_timelink.c
+ * @brief Receive path of the ESP32 time link
+ *
+ * The SPI and its DMA are mocks: bytes clocked in are written to the ring
+ * handed to HAL_SPI_Receive_DMA() and count its DMA counter down, as the
+ * circular stream does. The NSS edge is HAL_GPIO_EXTI_Callback() of the
+ * real timelink.c. Covers exchanges across the wrap of the ring, short,
+ * long and garbled exchanges and glitches of NSS, a parser that falls
+ * behind, the hand-off of the telemetry buffers and the pairing of each
+ * frame with the RTC stamp taken at its edge.
+ */
+#include <string.h>
+#include "check.h"
+#include "timelink.h"
+
+#define TEST_EXCHANGES      (500U)
+
+static DMA_Stream_TypeDef rxStream;
+static DMA_Stream_TypeDef txStream;
+static DMA_HandleTypeDef hdmarx = {.Instance = &rxStream};
+static DMA_HandleTypeDef hdmatx = {.Instance = &txStream};
+static SPI_TypeDef spiInstance;
+static SPI_HandleTypeDef hspi = {.Instance = &spiInstance, .hdmatx = &hdmatx, .hdmarx = &hdmarx};
+
+static uint8_t *ring;               /* Given to the receive DMA */
+static uint16_t ringSize;
+static uint32_t receiveStarts;
+static const uint8_t *txSource;     /* Frame the TX DMA was last started on */
+static uint32_t txStarts;
+static uint32_t txAborts;
+static uint16_t txClocked;          /* Bytes of the TX frame clocked out so far */
+
+static GPIO_PinState nssLevel = GPIO_PIN_SET;
+static uint32_t tick;
+static uint8_t isRtcRunning = TRUE;
+static uint32_t stampCount;
+
+static struct timesync_content lastContent;
+static uint32_t contentCount;
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *spi, uint8_t *pData, uint16_t Size)
+{
+	ring = pData;
+	ringSize = Size;
+	rxStream.NDTR = Size;
+	spi->State = HAL_SPI_STATE_BUSY_RX;
+	receiveStarts++;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *spi)
+{
+	spi->State = HAL_SPI_STATE_READY;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DeInit(SPI_HandleTypeDef *spi)
+{
+	spi->State = HAL_SPI_STATE_RESET;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *spi)
+{
+	spi->State = HAL_SPI_STATE_READY;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	txSource = (const uint8_t *)(uintptr_t)SrcAddress;
+	txClocked = 0;
+	hdma->State = HAL_DMA_STATE_BUSY;
+	txStarts++;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+	hdma->State = HAL_DMA_STATE_READY;
+	txAborts++;
+	return HAL_OK;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if (PinState == GPIO_PIN_SET)
+	{
+		GPIOx->ODR |= GPIO_Pin;
+	}
+	else
+	{
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	}
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return nssLevel;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return tick;
+}
+
+/* T2 of each exchange, numbered in the subseconds */
+App_StatusTypeDef RTC_GetStamp(rtcStamp_t *pStamp)
+{
+	if (!isRtcRunning)
+	{
+		return APP_ERROR;
+	}
+	memset(pStamp, 0, sizeof(*pStamp));
+	pStamp->time.SubSeconds = ++stampCount;
+	return APP_OK;
+}
+
+static void OnContent(const struct timesync_content *content)
+{
+	lastContent = *content;
+	contentCount++;
+}
+
+/**
+ * @brief Bytes clocked in by the ESP32, into the ring at the DMA position
+ */
+static void Clock(const uint8_t *bytes, uint16_t length)
+{
+	for (uint16_t i = 0; i < length; i++)
+	{
+		ring[(ringSize - rxStream.NDTR) % ringSize] = bytes[i];
+		rxStream.NDTR = (rxStream.NDTR > 1) ? rxStream.NDTR - 1 : ringSize;
+	}
+	txClocked += length;
+	if (txClocked >= TIMESYNC_EXCHANGE_LEN)
+	{
+		hdmatx.State = HAL_DMA_STATE_READY;
+	}
+}
+
+static void Nss(void)
+{
+	HAL_GPIO_EXTI_Callback(TIMELINK_NSS_PIN);
+}
+
+static void Exchange(const uint8_t *frame)
+{
+	Clock(frame, TIMESYNC_EXCHANGE_LEN);
+	Nss();
+}
+
+static void TimeFrame(uint8_t *frame, uint8_t sequence, uint64_t seconds)
+{
+	struct timesync_time time = {.seconds = seconds, .fraction = sequence * 1000U, .round_trip_us = 1500U};
+	memset(frame, 0, TIMESYNC_EXCHANGE_LEN);
+	timesync_encode_time(frame, sequence, &time);
+}
+
+static timeLinkStats_t Stats(void)
+{
+	timeLinkStats_t stats;
+	TimeLink_GetStats(&stats);
+	return stats;
+}
+
+/**
+ * @brief Every exchange parsed at once, at every offset of the ring
+ */
+static void TestWraparound(void)
+{
+	uint8_t frame[TIMESYNC_EXCHANGE_LEN];
+	timeLinkFrame_t received;
+	uint32_t mismatches = 0;
+	timeLinkStats_t before = Stats();
+
+	for (uint32_t i = 0; i < TEST_EXCHANGES; i++)
+	{
+		TimeFrame(frame, (uint8_t)i, 1700000000ULL + i);
+		Exchange(frame);
+		uint32_t stamp = stampCount;
+		memset(&received, 0, sizeof(received));
+		uint8_t isSame = (APP_OK == TimeLink_GetTime(&received)) && received.sequence == (uint8_t)i &&
+			received.time.seconds == 1700000000ULL + i && received.time.fraction == (uint8_t)i * 1000U &&
+			received.isStamped && received.received.time.SubSeconds == stamp;
+		if (!isSame && mismatches++ < 10)
+		{
+			fprintf(stderr, "exchange %u: frame differs\n", i);
+		}
+		mismatches += (APP_OK == TimeLink_GetTime(&received));
+	}
+	CHECK(mismatches == 0);
+	CHECK(Stats().frames == before.frames + TEST_EXCHANGES);
+	CHECK(Stats().framingErrors == before.framingErrors && Stats().crcErrors == before.crcErrors);
+}
+
+/**
+ * @brief Bad exchanges are counted and the SPI reset, the next good one gets through
+ */
+static void TestBadExchanges(void)
+{
+	uint8_t frame[TIMESYNC_EXCHANGE_LEN + 8];
+	timeLinkFrame_t received;
+	timeLinkStats_t before = Stats();
+	uint32_t starts = receiveStarts;
+
+	/* NSS glitch without clocks, nothing happened */
+	Nss();
+	CHECK(Stats().framingErrors == before.framingErrors && receiveStarts == starts);
+	CHECK(APP_OK != TimeLink_GetTime(&received));
+
+	/* Cut short, the TX stream did not finish either and is restarted */
+	uint32_t aborts = txAborts;
+	TimeFrame(frame, 1, 1000);
+	Clock(frame, TIMESYNC_EXCHANGE_LEN - 9);
+	Nss();
+	CHECK(Stats().framingErrors == before.framingErrors + 1 && receiveStarts == starts + 1);
+	CHECK(txAborts == aborts + 1);
+	CHECK(APP_OK != TimeLink_GetTime(&received));
+
+	/* A byte too many */
+	TimeFrame(frame, 2, 2000);
+	Clock(frame, TIMESYNC_EXCHANGE_LEN + 1);
+	Nss();
+	CHECK(Stats().framingErrors == before.framingErrors + 2 && receiveStarts == starts + 2);
+
+	/* No sync word, as after a byte cut in two */
+	TimeFrame(frame, 3, 3000);
+	frame[0] ^= 0x01;
+	Exchange(frame);
+	CHECK(Stats().framingErrors == before.framingErrors + 3);
+
+	/* A payload length past the end of the exchange */
+	TimeFrame(frame, 4, 4000);
+	frame[4] = TIMESYNC_EXCHANGE_LEN;
+	Exchange(frame);
+	CHECK(Stats().framingErrors == before.framingErrors + 4);
+
+	/* An overrun stopped the reception */
+	TimeFrame(frame, 5, 5000);
+	hspi.State = HAL_SPI_STATE_READY;
+	Exchange(frame);
+	CHECK(Stats().framingErrors == before.framingErrors + 5 && receiveStarts == starts + 5);
+	CHECK(APP_OK != TimeLink_GetTime(&received));
+
+	/* Well framed but corrupt, the parser drops it */
+	TimeFrame(frame, 6, 6000);
+	frame[TIMESYNC_HEADER_LEN + 2] ^= 0x40;
+	Exchange(frame);
+	CHECK(APP_OK != TimeLink_GetTime(&received));
+	CHECK(Stats().crcErrors == before.crcErrors + 1);
+
+	/* In step again from the reset */
+	TimeFrame(frame, 7, 7000);
+	Exchange(frame);
+	CHECK(APP_OK == TimeLink_GetTime(&received) && received.sequence == 7 && received.time.seconds == 7000);
+	CHECK(Stats().framingErrors == before.framingErrors + 5 && Stats().frames == before.frames + 1);
+}
+
+/**
+ * @brief A parser that falls behind gets the newest of the frames held, each with its own stamp
+ */
+static void TestSlowParser(void)
+{
+	uint8_t frame[TIMESYNC_EXCHANGE_LEN];
+	timeLinkFrame_t received;
+	timeLinkStats_t before = Stats();
+
+	/* Both buffers fill, the third frame finds neither free */
+	TimeFrame(frame, 10, 10000);
+	Exchange(frame);
+	TimeFrame(frame, 11, 11000);
+	Exchange(frame);
+	uint32_t secondStamp = stampCount;
+	TimeFrame(frame, 12, 12000);
+	Exchange(frame);
+	CHECK(Stats().dropped == before.dropped + 1);
+	CHECK(APP_OK == TimeLink_GetTime(&received));
+	CHECK(received.sequence == 11 && received.received.time.SubSeconds == secondStamp);
+	CHECK(Stats().frames == before.frames + 2);
+
+	/* Parsed in the order received, whichever buffer the parser stopped at */
+	TimeFrame(frame, 13, 13000);
+	Exchange(frame);
+	CHECK(APP_OK == TimeLink_GetTime(&received) && received.sequence == 13);
+	struct timesync_content content = {.row = 1, .column = 2, .ttl_s = 30, .length = 5, .text = (const uint8_t *)"hello"};
+	memset(frame, 0, sizeof(frame));
+	timesync_encode_content(frame, 14, &content);
+	Exchange(frame);
+	TimeFrame(frame, 15, 15000);
+	Exchange(frame);
+	uint32_t lastStamp = stampCount;
+	uint32_t contents = contentCount;
+	CHECK(APP_OK == TimeLink_GetTime(&received) && received.sequence == 15);
+	CHECK(received.received.time.SubSeconds == lastStamp);
+	CHECK(contentCount == contents + 1 && lastContent.row == 1 && lastContent.column == 2 && lastContent.ttl_s == 30);
+	CHECK(Stats().contents == before.contents + 1);
+
+	/* A frame taken before the RTC runs is not stamped */
+	isRtcRunning = FALSE;
+	TimeFrame(frame, 16, 16000);
+	Exchange(frame);
+	CHECK(APP_OK == TimeLink_GetTime(&received) && received.sequence == 16 && !received.isStamped);
+	isRtcRunning = TRUE;
+}
+
+/**
+ * @brief The telemetry staged goes out from the next exchange on, never the buffer being sent
+ */
+static void TestTelemetry(void)
+{
+	uint8_t frame[TIMESYNC_EXCHANGE_LEN];
+	timeLinkFrame_t received;
+	struct timesync_telemetry telemetry = {.pressure = 100001};
+	struct timesync_telemetry sent;
+	uint8_t sequence;
+
+	TimeFrame(frame, 20, 20000);
+	Exchange(frame);
+	CHECK(APP_OK == TimeLink_GetTime(&received));
+
+	/* Staged, not sent until the next edge */
+	const uint8_t *active = txSource;
+	TimeLink_SetTelemetry(&telemetry);
+	CHECK(txSource == active);
+	TimeFrame(frame, 21, 21000);
+	Exchange(frame);
+	CHECK(txSource != active);
+	CHECK(TIMESYNC_OK == timesync_decode_telemetry(txSource, TIMESYNC_EXCHANGE_LEN, &sequence, &sent));
+	CHECK(sent.pressure == 100001 && sent.ack_sequence == 20);
+	uint8_t firstSequence = sequence;
+
+	/* Nothing new staged, the same frame again */
+	active = txSource;
+	CHECK(APP_OK == TimeLink_GetTime(&received));
+	Exchange(frame);
+	CHECK(txSource == active);
+
+	/* Staged twice before an edge, the frame being sent is left alone and the last one wins */
+	uint8_t copy[TIMESYNC_EXCHANGE_LEN];
+	memcpy(copy, active, sizeof(copy));
+	telemetry.pressure = 100002;
+	TimeLink_SetTelemetry(&telemetry);
+	telemetry.pressure = 100003;
+	TimeLink_SetTelemetry(&telemetry);
+	CHECK(!memcmp(copy, active, sizeof(copy)));
+	Exchange(frame);
+	CHECK(txSource != active);
+	CHECK(TIMESYNC_OK == timesync_decode_telemetry(txSource, TIMESYNC_EXCHANGE_LEN, &sequence, &sent));
+	CHECK(sent.pressure == 100003 && sequence == (uint8_t)(firstSequence + 2));
+
+	/* A reset of the SPI goes on with the frame of the last edge */
+	active = txSource;
+	Clock(frame, 3);
+	Nss();
+	CHECK(txSource == active);
+}
+
+static void TestRequest(void)
+{
+	uint8_t frame[TIMESYNC_EXCHANGE_LEN];
+	timeLinkFrame_t received;
+	TimeFrame(frame, 30, 30000);
+
+	/* Held low for TIMELINK_REQ_MIN_LOW_MS from the last edge before it is raised */
+	tick = 1000;
+	Exchange(frame);
+	TimeLink_RequestTime();
+	CHECK(!(TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN));
+	tick += TIMELINK_REQ_MIN_LOW_MS - 1;
+	TimeLink_GetTime(&received);
+	CHECK(!(TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN));
+	tick++;
+	TimeLink_GetTime(&received);
+	CHECK(TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN);
+
+	/* The exchange answers it */
+	Exchange(frame);
+	CHECK(!(TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN));
+
+	/* A request over an unanswered one lowers the line first */
+	tick += 100;
+	TimeLink_RequestTime();
+	CHECK(TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN);
+	TimeLink_RequestTime();
+	CHECK(!(TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN));
+	tick += TIMELINK_REQ_MIN_LOW_MS;
+	TimeLink_GetTime(&received);
+	CHECK(TIMELINK_REQ_PORT->ODR & TIMELINK_REQ_PIN);
+	Exchange(frame);
+	TimeLink_GetTime(&received);
+}
+
+/**
+ * @brief On a shared bus MISO is only driven while NSS is low
+ */
+static void TestSharedBus(void)
+{
+	uint8_t frame[TIMESYNC_EXCHANGE_LEN];
+	timeLinkFrame_t received;
+	const uint32_t misoMode = GPIO_MODER_MODER0 << (2U * POSITION_VAL(TIMELINK_MISO_PIN));
+
+	CHECK(APP_OK == TimeLink_Init(&hspi, TRUE));
+	CHECK(!(TIMELINK_MISO_PORT->MODER & misoMode));
+	nssLevel = GPIO_PIN_RESET;
+	Nss();
+	CHECK(TIMELINK_MISO_PORT->MODER & misoMode);
+	nssLevel = GPIO_PIN_SET;
+	TimeFrame(frame, 40, 40000);
+	Exchange(frame);
+	CHECK(!(TIMELINK_MISO_PORT->MODER & misoMode));
+	CHECK(APP_OK == TimeLink_GetTime(&received) && received.sequence == 40);
+}
+
+int main(void)
+{
+	SPI_HandleTypeDef noDma = {.Instance = &spiInstance};
+	CHECK(APP_OK != TimeLink_Init(&noDma, FALSE));
+	CHECK(APP_OK == TimeLink_Init(&hspi, FALSE));
+	CHECK(receiveStarts == 1 && txStarts == 1 && ringSize == TIMELINK_RX_BUF_SIZE);
+	TimeLink_SetContentCallback(OnContent);
+
+	TestWraparound();
+	TestBadExchanges();
+	TestSlowParser();
+	TestTelemetry();
+	TestRequest();
+	TestSharedBus();
+	return CheckResult("timelink");
+}
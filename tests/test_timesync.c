@@ -0,0 +1,250 @@
+/**
+ * @file test_timesync.c
+ * @brief Frames of the ESP32 to STM32 time link
+ *
+ * Every frame type is encoded and decoded back, corrupted by every single
+ * and double bit flip and by random triple flips, and read from the wrong
+ * place of a stream of exchanges as after a lost byte. A corrupt or
+ * misaligned frame must never be accepted.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "timesync.h"
+
+#define TEST_ROUNDS         (1000U)
+#define TEST_TRIPLE_FLIPS   (200000U)
+
+typedef enum timesync_status (*decode_t)(const uint8_t *frame, size_t len);
+
+static uint32_t Random32(void)
+{
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static enum timesync_status DecodeTime(const uint8_t *frame, size_t len)
+{
+	uint8_t sequence;
+	struct timesync_time time;
+	return timesync_decode_time(frame, len, &sequence, &time);
+}
+
+static enum timesync_status DecodePoll(const uint8_t *frame, size_t len)
+{
+	return timesync_check_header(frame, len, TIMESYNC_TYPE_POLL, 0);
+}
+
+static enum timesync_status DecodeContent(const uint8_t *frame, size_t len)
+{
+	uint8_t sequence;
+	struct timesync_content content;
+	return timesync_decode_content(frame, len, &sequence, &content);
+}
+
+static enum timesync_status DecodeTelemetry(const uint8_t *frame, size_t len)
+{
+	uint8_t sequence;
+	struct timesync_telemetry telemetry;
+	return timesync_decode_telemetry(frame, len, &sequence, &telemetry);
+}
+
+static void TestTime(void)
+{
+	for (uint32_t round = 0; round < TEST_ROUNDS; round++)
+	{
+		uint8_t frame[TIMESYNC_EXCHANGE_LEN] = {0};
+		struct timesync_time sent = {
+			.seconds = ((uint64_t)Random32() << 32) | Random32(),
+			.fraction = Random32(),
+			.utc_offset_min = (int16_t)((rand() % 1561) - 720),
+			.flags = (rand() % 2) ? TIMESYNC_FLAG_DST : 0,
+			.round_trip_us = Random32(),
+		};
+		struct timesync_time received = {0};
+		uint8_t sequence = 0;
+		CHECK(timesync_encode_time(frame, (uint8_t)round, &sent) == TIMESYNC_TIME_FRAME_LEN);
+		CHECK(timesync_decode_time(frame, sizeof(frame), &sequence, &received) == TIMESYNC_OK);
+		CHECK(sequence == (uint8_t)round);
+		CHECK(received.seconds == sent.seconds && received.fraction == sent.fraction);
+		CHECK(received.utc_offset_min == sent.utc_offset_min && received.flags == sent.flags);
+		CHECK(received.round_trip_us == sent.round_trip_us);
+	}
+}
+
+static void TestContent(void)
+{
+	uint8_t text[TIMESYNC_CONTENT_MAX_TEXT + 4];
+	for (uint32_t round = 0; round < TEST_ROUNDS; round++)
+	{
+		uint8_t frame[TIMESYNC_EXCHANGE_LEN] = {0};
+		for (uint8_t i = 0; i < sizeof(text); i++)
+		{
+			text[i] = (uint8_t)rand();
+		}
+		struct timesync_content sent = {
+			.row = (uint8_t)rand(),
+			.column = (uint8_t)rand(),
+			.ttl_s = (uint16_t)rand(),
+			.length = (uint8_t)(rand() % (sizeof(text) + 1)),
+			.text = text,
+		};
+		uint8_t length = (sent.length > TIMESYNC_CONTENT_MAX_TEXT) ? TIMESYNC_CONTENT_MAX_TEXT : sent.length;
+		struct timesync_content received = {0};
+		uint8_t sequence = 0;
+		size_t frame_len = timesync_encode_content(frame, (uint8_t)round, &sent);
+		CHECK(frame_len == TIMESYNC_HEADER_LEN + TIMESYNC_CONTENT_HEADER_LEN + length + TIMESYNC_CRC_LEN);
+		CHECK(frame_len <= TIMESYNC_EXCHANGE_LEN);
+		CHECK(timesync_decode_content(frame, sizeof(frame), &sequence, &received) == TIMESYNC_OK);
+		CHECK(sequence == (uint8_t)round);
+		CHECK(received.row == sent.row && received.column == sent.column && received.ttl_s == sent.ttl_s);
+		CHECK(received.length == length && !memcmp(received.text, text, length));
+
+		/* A length field past the exchange is never taken */
+		frame[4] = (uint8_t)(TIMESYNC_CONTENT_HEADER_LEN + TIMESYNC_CONTENT_MAX_TEXT + 1 + (rand() % 8));
+		CHECK(timesync_decode_content(frame, sizeof(frame), &sequence, &received) != TIMESYNC_OK);
+	}
+}
+
+static void TestTelemetry(void)
+{
+	for (uint32_t round = 0; round < TEST_ROUNDS; round++)
+	{
+		uint8_t frame[TIMESYNC_EXCHANGE_LEN] = {0};
+		struct timesync_telemetry sent = {
+			.temperature = {(int16_t)Random32(), (rand() % 2) ? TIMESYNC_NO_READING : (int16_t)Random32()},
+			.pressure = Random32(),
+			.rtc_seconds = Random32(),
+			.rtc_offset_us = (int32_t)Random32(),
+			.drift_ppb = (int32_t)Random32(),
+			.crc_errors = (uint16_t)rand(),
+			.framing_errors = (uint16_t)rand(),
+			.dropped = (uint16_t)rand(),
+			.ack_sequence = (uint8_t)rand(),
+			.flags = (uint8_t)rand(),
+		};
+		struct timesync_telemetry received = {0};
+		uint8_t sequence = 0;
+		CHECK(timesync_encode_telemetry(frame, (uint8_t)round, &sent) == TIMESYNC_TELEMETRY_FRAME_LEN);
+		CHECK(timesync_decode_telemetry(frame, sizeof(frame), &sequence, &received) == TIMESYNC_OK);
+		CHECK(sequence == (uint8_t)round);
+		CHECK(received.temperature[0] == sent.temperature[0] && received.temperature[1] == sent.temperature[1]);
+		CHECK(received.pressure == sent.pressure && received.rtc_seconds == sent.rtc_seconds);
+		CHECK(received.rtc_offset_us == sent.rtc_offset_us && received.drift_ppb == sent.drift_ppb);
+		CHECK(received.crc_errors == sent.crc_errors && received.framing_errors == sent.framing_errors);
+		CHECK(received.dropped == sent.dropped && received.ack_sequence == sent.ack_sequence);
+		CHECK(received.flags == sent.flags);
+	}
+}
+
+static void Flip(uint8_t *frame, uint32_t bit)
+{
+	frame[bit / 8] ^= (uint8_t)(1U << (bit % 8));
+}
+
+/**
+ * @brief Every 1 and 2 bit error in the frame and random 3 bit errors are caught
+ */
+static void TestBitFlips(const char *name, const uint8_t *frame, size_t frame_len, decode_t decode)
+{
+	uint8_t corrupt[TIMESYNC_EXCHANGE_LEN];
+	uint32_t bits = (uint32_t)frame_len * 8;
+	uint32_t missed = 0;
+
+	CHECK(decode(frame, TIMESYNC_EXCHANGE_LEN) == TIMESYNC_OK);
+	for (uint32_t i = 0; i < bits; i++)
+	{
+		memcpy(corrupt, frame, sizeof(corrupt));
+		Flip(corrupt, i);
+		missed += (decode(corrupt, sizeof(corrupt)) == TIMESYNC_OK);
+		for (uint32_t j = i + 1; j < bits; j++)
+		{
+			Flip(corrupt, j);
+			missed += (decode(corrupt, sizeof(corrupt)) == TIMESYNC_OK);
+			Flip(corrupt, j);
+		}
+	}
+	for (uint32_t n = 0; n < TEST_TRIPLE_FLIPS; n++)
+	{
+		uint32_t a = Random32() % bits;
+		uint32_t b = Random32() % bits;
+		uint32_t c = Random32() % bits;
+		if (a == b || b == c || a == c)
+		{
+			continue;
+		}
+		memcpy(corrupt, frame, sizeof(corrupt));
+		Flip(corrupt, a);
+		Flip(corrupt, b);
+		Flip(corrupt, c);
+		missed += (decode(corrupt, sizeof(corrupt)) == TIMESYNC_OK);
+	}
+	if (missed)
+	{
+		fprintf(stderr, "%s: %u corrupt frames accepted\n", name, missed);
+	}
+	CHECK(missed == 0);
+}
+
+/**
+ * @brief A frame is only taken whole, from its first byte
+ * Exchanges read from a byte late or early, as after a clock glitch, and
+ * frames one byte short are all refused.
+ */
+static void TestResync(const uint8_t *frame, size_t frame_len, decode_t decode)
+{
+	uint8_t stream[3 * TIMESYNC_EXCHANGE_LEN];
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		memcpy(&stream[i * TIMESYNC_EXCHANGE_LEN], frame, TIMESYNC_EXCHANGE_LEN);
+	}
+	for (size_t offset = 1; offset < TIMESYNC_EXCHANGE_LEN; offset++)
+	{
+		CHECK(decode(&stream[offset], TIMESYNC_EXCHANGE_LEN) != TIMESYNC_OK);
+	}
+	CHECK(decode(&stream[TIMESYNC_EXCHANGE_LEN], TIMESYNC_EXCHANGE_LEN) == TIMESYNC_OK);
+	CHECK(decode(frame, frame_len - 1) == TIMESYNC_ERR_LENGTH);
+	CHECK(decode(frame, frame_len) == TIMESYNC_OK);
+
+	uint8_t other[TIMESYNC_EXCHANGE_LEN];
+	memcpy(other, frame, sizeof(other));
+	other[2] = TIMESYNC_VERSION - 1;
+	CHECK(decode(other, sizeof(other)) == TIMESYNC_ERR_VERSION);
+}
+
+int main(void)
+{
+	srand(1);
+	TestTime();
+	TestContent();
+	TestTelemetry();
+
+	uint8_t frame[TIMESYNC_EXCHANGE_LEN] = {0};
+	struct timesync_time time = {.seconds = 1672531200U, .fraction = 0x80000000U, .utc_offset_min = -240,
+								 .flags = TIMESYNC_FLAG_DST, .round_trip_us = 850};
+	size_t frame_len = timesync_encode_time(frame, 1, &time);
+	TestBitFlips("time", frame, frame_len, DecodeTime);
+	TestResync(frame, frame_len, DecodeTime);
+
+	memset(frame, 0, sizeof(frame));
+	frame_len = timesync_encode_poll(frame, 2);
+	TestBitFlips("poll", frame, frame_len, DecodePoll);
+	TestResync(frame, frame_len, DecodePoll);
+
+	memset(frame, 0, sizeof(frame));
+	const uint8_t text[] = "-12.5us 1013.2hPa";
+	struct timesync_content content = {.row = 2, .column = 3, .ttl_s = 128, .length = sizeof(text) - 1, .text = text};
+	frame_len = timesync_encode_content(frame, 3, &content);
+	TestBitFlips("content", frame, frame_len, DecodeContent);
+	TestResync(frame, frame_len, DecodeContent);
+
+	/* The longest frame, the whole exchange is covered by the CRC */
+	memset(frame, 0, sizeof(frame));
+	struct timesync_telemetry telemetry = {.temperature = {2150, TIMESYNC_NO_READING}, .pressure = 101325,
+										   .rtc_seconds = 1672531200U, .rtc_offset_us = -35, .ack_sequence = 1};
+	frame_len = timesync_encode_telemetry(frame, 4, &telemetry);
+	CHECK(frame_len == TIMESYNC_EXCHANGE_LEN);
+	TestBitFlips("telemetry", frame, frame_len, DecodeTelemetry);
+	TestResync(frame, frame_len, DecodeTelemetry);
+
+	return CheckResult("timesync");
+}
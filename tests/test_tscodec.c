@@ -0,0 +1,233 @@
+/**
+ * @file test_tscodec.c
+ * @brief Round trips of the time-series codec
+ *
+ * Series of steady, noisy and extreme samples are encoded block by block and
+ * must decode to the same samples. Also covers full blocks, resuming a block
+ * and truncated blocks, and reports the size and speed of the codec.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "check.h"
+#include "tscodec.h"
+
+#define TEST_SAMPLES        (20000U)
+#define TEST_BLOCK_SIZE     (488U)      /* Payload of a flash log page */
+
+typedef enum
+{
+	SERIES_STEADY,      /* Logging once a minute indoors */
+	SERIES_NOISY,       /* Readings and interval wander */
+	SERIES_EXTREME,     /* Full range jumps of every field */
+	SERIES_COUNT
+}series_t;
+
+static const char *const seriesNames[SERIES_COUNT] = {"steady", "noisy", "extreme"};
+
+static tsSample_t samples[TEST_SAMPLES];
+static tsSample_t decoded[TEST_SAMPLES];
+static uint8_t blocks[TEST_SAMPLES][TEST_BLOCK_SIZE];
+static uint16_t blockLengths[TEST_SAMPLES];
+static uint16_t blockCounts[TEST_SAMPLES];
+
+static uint32_t Random32(void)
+{
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/* Fields only, the padding of a sample is not encoded */
+static uint8_t IsSameSample(const tsSample_t *a, const tsSample_t *b)
+{
+	return a->timestamp == b->timestamp && a->temperature == b->temperature && a->pressure == b->pressure;
+}
+
+static void MakeSeries(series_t series)
+{
+	tsSample_t s = {.timestamp = 1672531200U, .temperature = 2150, .pressure = 101320};
+	for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		switch (series)
+		{
+		case SERIES_STEADY:
+			s.timestamp += 60;
+			if (!(rand() % 4))
+			{
+				s.temperature += (int16_t)((rand() % 3) - 1);
+			}
+			if (!(rand() % 4))
+			{
+				s.pressure += (uint32_t)(((rand() % 3) - 1) * 10);
+			}
+			break;
+		case SERIES_NOISY:
+			s.timestamp += (rand() % 8) ? 60 : (uint32_t)(rand() % 3600);
+			s.temperature += (int16_t)((rand() % 41) - 20);
+			s.pressure = (rand() % 16) ? s.pressure + (uint32_t)((rand() % 401) - 200) : 0;
+			break;
+		default:
+			s.timestamp += (rand() % 2) ? (Random32() >> (rand() % 32)) : 0;
+			s.temperature = (int16_t)Random32();
+			s.pressure = Random32() >> (rand() % 32);
+			break;
+		}
+		samples[i] = s;
+	}
+}
+
+/**
+ * @return uint32_t Number of blocks
+ */
+static uint32_t EncodeSeries(void)
+{
+	tsEncoder_t enc;
+	uint32_t block = 0;
+	TsCodec_InitEncoder(&enc, blocks[block], TEST_BLOCK_SIZE);
+	for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		if (APP_OK != TsCodec_Encode(&enc, &samples[i]))
+		{
+			/* A full block is left as it was */
+			CHECK(enc.count > 0);
+			blockLengths[block] = TsCodec_GetLength(&enc);
+			blockCounts[block] = enc.count;
+			block++;
+			TsCodec_InitEncoder(&enc, blocks[block], TEST_BLOCK_SIZE);
+			CHECK(APP_OK == TsCodec_Encode(&enc, &samples[i]));
+		}
+	}
+	blockLengths[block] = TsCodec_GetLength(&enc);
+	blockCounts[block] = enc.count;
+	return block + 1;
+}
+
+static uint32_t DecodeSeries(uint32_t blockCount)
+{
+	uint32_t n = 0;
+	for (uint32_t block = 0; block < blockCount; block++)
+	{
+		tsDecoder_t dec;
+		TsCodec_InitDecoder(&dec, blocks[block], blockLengths[block], blockCounts[block]);
+		while (n < TEST_SAMPLES && APP_OK == TsCodec_Decode(&dec, &decoded[n]))
+		{
+			n++;
+		}
+		CHECK(dec.count == blockCounts[block]);
+	}
+	return n;
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static void TestRoundTrip(series_t series)
+{
+	MakeSeries(series);
+	double start = Seconds();
+	uint32_t blockCount = EncodeSeries();
+	double encodeTime = Seconds() - start;
+	start = Seconds();
+	uint32_t n = DecodeSeries(blockCount);
+	double decodeTime = Seconds() - start;
+
+	CHECK(n == TEST_SAMPLES);
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if (!IsSameSample(&samples[i], &decoded[i]))
+		{
+			CHECK(!"sample differs after the round trip");
+			break;
+		}
+	}
+
+	uint32_t bytes = 0;
+	for (uint32_t block = 0; block < blockCount; block++)
+	{
+		bytes += blockLengths[block];
+	}
+	printf("  %-8s %6.2f bytes/sample (raw %zu), encode %5.1f ns, decode %5.1f ns per sample\n",
+	       seriesNames[series], (double)bytes / TEST_SAMPLES, sizeof(tsSample_t),
+	       encodeTime * 1e9 / TEST_SAMPLES, decodeTime * 1e9 / TEST_SAMPLES);
+}
+
+/**
+ * @brief A block continued by a second encoder reads the same as one written in one go
+ */
+static void TestResume(void)
+{
+	MakeSeries(SERIES_NOISY);
+	tsEncoder_t enc;
+	uint8_t whole[TEST_BLOCK_SIZE];
+	uint8_t resumed[TEST_BLOCK_SIZE];
+	TsCodec_InitEncoder(&enc, whole, sizeof(whole));
+	uint16_t count = 0;
+	while (APP_OK == TsCodec_Encode(&enc, &samples[count]))
+	{
+		count++;
+	}
+	uint16_t length = TsCodec_GetLength(&enc);
+
+	uint16_t split = count / 2;
+	TsCodec_InitEncoder(&enc, resumed, sizeof(resumed));
+	for (uint16_t i = 0; i < split; i++)
+	{
+		CHECK(APP_OK == TsCodec_Encode(&enc, &samples[i]));
+	}
+	CHECK(APP_OK == TsCodec_ResumeEncoder(&enc, resumed, sizeof(resumed), TsCodec_GetLength(&enc), split));
+	for (uint16_t i = split; i < count; i++)
+	{
+		CHECK(APP_OK == TsCodec_Encode(&enc, &samples[i]));
+	}
+	CHECK(APP_OK != TsCodec_Encode(&enc, &samples[count]));
+	CHECK(TsCodec_GetLength(&enc) == length);
+	CHECK(!memcmp(whole, resumed, length));
+
+	/* Padding of the last byte can read as a sample or two, not as eight */
+	CHECK(APP_OK != TsCodec_ResumeEncoder(&enc, resumed, sizeof(resumed), length, count + 8));
+}
+
+/**
+ * @brief A cut short block stops with an error, never reads past its length
+ */
+static void TestTruncated(void)
+{
+	MakeSeries(SERIES_EXTREME);
+	tsEncoder_t enc;
+	uint8_t block[TEST_BLOCK_SIZE];
+	TsCodec_InitEncoder(&enc, block, sizeof(block));
+	uint16_t count = 0;
+	while (APP_OK == TsCodec_Encode(&enc, &samples[count]))
+	{
+		count++;
+	}
+	uint16_t length = TsCodec_GetLength(&enc);
+	for (uint16_t cut = 0; cut < length; cut++)
+	{
+		tsDecoder_t dec;
+		tsSample_t sample;
+		uint16_t n = 0;
+		TsCodec_InitDecoder(&dec, block, cut, count);
+		while (APP_OK == TsCodec_Decode(&dec, &sample))
+		{
+			CHECK(IsSameSample(&sample, &samples[n]));
+			n++;
+		}
+		CHECK(n < count);
+	}
+}
+
+int main(void)
+{
+	srand(1);
+	for (series_t series = 0; series < SERIES_COUNT; series++)
+	{
+		TestRoundTrip(series);
+	}
+	TestResume();
+	TestTruncated();
+	return CheckResult("tscodec");
+}
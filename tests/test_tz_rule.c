@@ -0,0 +1,70 @@
+/**
+ * @file test_tz_rule.c
+ * @brief Time zone rule of the ESP32 against the C library
+ *
+ * Built once per rule, with the Kconfig values of the rule and the POSIX
+ * TZ string of the same zone in TEST_TZ. Every hour from 1971 to 2099 and
+ * every second around each change must give the offset and the daylight
+ * saving flag the C library gives.
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "check.h"
+#include "tz_rule.h"
+
+#define TEST_FROM       (31536000LL)    /* 1971 */
+#define TEST_TO         (4102444800LL)  /* 2100 */
+#define TEST_AROUND_S   (2)
+
+static uint32_t mismatches;
+
+static void CheckAt(int64_t utc_s)
+{
+	time_t t = (time_t)utc_s;
+	struct tm local;
+	bool is_dst;
+	localtime_r(&t, &local);
+	int16_t offset_min = tz_rule_offset_min(utc_s, &is_dst);
+	if (offset_min * 60 != local.tm_gmtoff || is_dst != (local.tm_isdst > 0))
+	{
+		if (mismatches++ < 10)
+		{
+			fprintf(stderr, "%lld: %d min%s, C library %ld min%s\n", (long long)utc_s, offset_min,
+			        is_dst ? " DST" : "", local.tm_gmtoff / 60, (local.tm_isdst > 0) ? " DST" : "");
+		}
+	}
+}
+
+int main(void)
+{
+	setenv("TZ", TEST_TZ, 1);
+	tzset();
+
+	uint32_t changes = 0;
+	bool wasDst;
+	tz_rule_offset_min(TEST_FROM, &wasDst);
+	for (int64_t utc_s = TEST_FROM; utc_s < TEST_TO; utc_s += 3600)
+	{
+		bool is_dst;
+		tz_rule_offset_min(utc_s, &is_dst);
+		CheckAt(utc_s);
+		if (is_dst != wasDst)
+		{
+			/* The change is within the last hour, check each second of it */
+			changes++;
+			for (int64_t s = utc_s - 3600 - TEST_AROUND_S; s <= utc_s + TEST_AROUND_S; s++)
+			{
+				CheckAt(s);
+			}
+		}
+		wasDst = is_dst;
+	}
+	CHECK(mismatches == 0);
+#if defined(CONFIG_TZ_DST_NONE)
+	CHECK(changes == 0);
+#else
+	/* Two a year */
+	CHECK(changes == 2 * 129);
+#endif
+	return CheckResult("tz_rule " TEST_TZ);
+}
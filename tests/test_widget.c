@@ -0,0 +1,259 @@
+/**
+ * @file test_widget.c
+ * @brief LCD widgets, when they render and what they format
+ *
+ * The LCD is a mock recording the text written to each cell. A widget
+ * must render on its first call, on a new version of its data and when its
+ * period elapsed, across the wrap of the tick too, and cost nothing more
+ * otherwise. Its text is padded and cut to its width. The temperatures are
+ * checked against their rounding and sign, the bars against negative, flat,
+ * missing and extreme values.
+ */
+#include <string.h>
+#include "check.h"
+#include "widget.h"
+
+#define TEST_WIDGETS        (4)
+
+static char cells[LCD_ROWS][LCD_COLUMNS + 1];
+static uint32_t writes;
+static uint8_t patterns[LCD_CUSTOM_CHARS][8];
+static uint32_t tick;
+
+static uint32_t clockVersion;
+static uint32_t versionCalls;
+static uint32_t renders[TEST_WIDGETS];
+static const char *labelText = "Label";
+
+uint32_t HAL_GetTick(void)
+{
+	return tick;
+}
+
+void LCD_WriteText(uint8_t row, uint8_t column, const char *text)
+{
+	writes++;
+	for (uint8_t i = column - 1; i < LCD_COLUMNS && *text != '\0'; i++, text++)
+	{
+		cells[row - 1][i] = *text;
+	}
+}
+
+void LCD_DefineChar(uint8_t index, const uint8_t pattern[8])
+{
+	memcpy(patterns[index], pattern, 8);
+}
+
+static uint32_t ClockVersion(void)
+{
+	versionCalls++;
+	return clockVersion;
+}
+
+static void RenderClock(char *text, uint8_t width)
+{
+	renders[0]++;
+	strcpy(text, "12:00");
+}
+
+static void RenderLabel(char *text, uint8_t width)
+{
+	renders[1]++;
+	strcpy(text, labelText);
+}
+
+static void RenderTicker(char *text, uint8_t width)
+{
+	renders[2]++;
+	strcpy(text, "tick");
+}
+
+/* Fills the whole buffer, more than the widget is wide */
+static void RenderWide(char *text, uint8_t width)
+{
+	renders[3]++;
+	memset(text, '#', LCD_COLUMNS);
+	text[LCD_COLUMNS] = '\0';
+}
+
+static const widget_t layout[TEST_WIDGETS] = {
+	{1, 1, 8, 0, ClockVersion, RenderClock},
+	{2, 1, 6, 0, NULL, RenderLabel},
+	{3, 1, 5, 1000, NULL, RenderTicker},
+	{4, 3, 30, 0, NULL, RenderWide},
+};
+
+static uint8_t RendersAre(uint32_t clock, uint32_t label, uint32_t ticker, uint32_t wide)
+{
+	return renders[0] == clock && renders[1] == label && renders[2] == ticker && renders[3] == wide;
+}
+
+static void TestRender(void)
+{
+	widgetState_t state[TEST_WIDGETS] = {0};
+
+	/* All on the first call, padded and cut to their width */
+	tick = 5000;
+	memset(cells, '.', sizeof(cells));
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(1, 1, 1, 1));
+	CHECK(!memcmp(cells[0], "12:00   ....", 12));
+	CHECK(!memcmp(cells[1], "Label .", 7));
+	CHECK(!memcmp(cells[3], "..##################", LCD_COLUMNS));
+
+	/* Nothing due, a version call each for those that have one */
+	writes = 0;
+	versionCalls = 0;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(1, 1, 1, 1) && writes == 0 && versionCalls == 1);
+
+	/* A new version renders only its widget */
+	clockVersion++;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(2, 1, 1, 1) && writes == 1);
+
+	/* The period, to the tick */
+	tick += 999;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(2, 1, 1, 1));
+	tick++;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(2, 1, 2, 1));
+
+	/* Without a version nor a period only on invalidation, a shorter text clears the longer */
+	tick += 60000;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(2, 1, 3, 1));
+	labelText = "Lbl";
+	Widget_Invalidate(state, TEST_WIDGETS);
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(3, 2, 4, 2));
+	CHECK(!memcmp(cells[1], "Lbl   .", 7));
+
+	/* Across the wrap of the tick */
+	tick = 0xFFFFFFFFU - 499U;
+	Widget_Invalidate(state, TEST_WIDGETS);
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(4, 3, 5, 3));
+	tick = 499;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(4, 3, 5, 3));
+	tick = 500;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(4, 3, 6, 3));
+	tick = 0xFFFFFFFFU - 1999U;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(4, 3, 7, 3));
+	tick = 0;
+	Widget_Render(layout, state, TEST_WIDGETS);
+	CHECK(RendersAre(4, 3, 8, 3));
+}
+
+static uint8_t TemperatureIs(int32_t temperature, uint8_t decimals, const char *expected)
+{
+	char text[8];
+	Widget_FormatTemperature(text, temperature, decimals);
+	if (strcmp(text, expected))
+	{
+		fprintf(stderr, "%d with %u decimals: \"%s\", expected \"%s\"\n", temperature, decimals, text, expected);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void TestTemperature(void)
+{
+	CHECK(TemperatureIs(2508, 2, "25.08"));
+	CHECK(TemperatureIs(2508, 1, "25.1"));
+	CHECK(TemperatureIs(2504, 1, "25.0"));
+	CHECK(TemperatureIs(2505, 1, "25.1"));
+	CHECK(TemperatureIs(0, 2, "0.00"));
+	CHECK(TemperatureIs(0, 1, "0.0"));
+	CHECK(TemperatureIs(7, 2, "0.07"));
+
+	/* Negative, rounded on the magnitude, no sign on a zero */
+	CHECK(TemperatureIs(-2508, 2, "-25.08"));
+	CHECK(TemperatureIs(-2508, 1, "-25.1"));
+	CHECK(TemperatureIs(-2504, 1, "-25.0"));
+	CHECK(TemperatureIs(-4, 2, "-0.04"));
+	CHECK(TemperatureIs(-4, 1, "0.0"));
+	CHECK(TemperatureIs(-5, 1, "-0.1"));
+	CHECK(TemperatureIs(-4000, 2, "-40.00"));
+
+	/* Rounding carried into another digit */
+	CHECK(TemperatureIs(995, 1, "10.0"));
+	CHECK(TemperatureIs(9995, 1, "100.0"));
+	CHECK(TemperatureIs(-9995, 1, "-100.0"));
+	CHECK(TemperatureIs(8500, 2, "85.00"));
+}
+
+static uint8_t BarsAre(const int32_t *values, uint8_t count, const char *expected)
+{
+	char text[LCD_COLUMNS + 1];
+	memset(text, '?', sizeof(text));
+	Widget_FormatBars(text, values, count);
+	if (memcmp(text, expected, count + 1U))
+	{
+		fprintf(stderr, "bars:");
+		for (uint8_t i = 0; i <= count; i++)
+		{
+			fprintf(stderr, " %d/%d", text[i], expected[i]);
+		}
+		fprintf(stderr, "\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void TestBars(void)
+{
+	/* One level per step from the minimum to the maximum */
+	const int32_t ramp[] = {0, 1, 2, 3, 4, 5, 6, 7};
+	CHECK(BarsAre(ramp, 8, "\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F"));
+	const int32_t negative[] = {-700, -600, -500, -400, -300, -200, -100, 0};
+	CHECK(BarsAre(negative, 8, "\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F"));
+	const int32_t reversed[] = {-5, -10, -15};
+	CHECK(BarsAre(reversed, 3, "\x0F\x0B\x08"));
+
+	/* Levels round down, only the maximum reaches the top */
+	const int32_t coarse[] = {0, 1, 2};
+	CHECK(BarsAre(coarse, 3, "\x08\x0B\x0F"));
+	const int32_t fine[] = {0, 99, 100};
+	CHECK(BarsAre(fine, 3, "\x08\x0E\x0F"));
+
+	/* Flat at half height, gaps empty, a lone value is flat */
+	const int32_t flat[] = {2100, 2100, WIDGET_NO_VALUE, 2100};
+	CHECK(BarsAre(flat, 4, "\x0B\x0B \x0B"));
+	const int32_t single[] = {WIDGET_NO_VALUE, -40};
+	CHECK(BarsAre(single, 2, " \x0B"));
+	const int32_t empty[] = {WIDGET_NO_VALUE, WIDGET_NO_VALUE};
+	CHECK(BarsAre(empty, 2, "  "));
+	CHECK(BarsAre(empty, 0, ""));
+
+	/* The whole range without overflow */
+	const int32_t extreme[] = {INT32_MIN + 1, 0, INT32_MAX};
+	CHECK(BarsAre(extreme, 3, "\x08\x0B\x0F"));
+}
+
+static void TestInit(void)
+{
+	Widget_Init();
+	uint32_t mismatches = 0;
+	for (uint8_t i = 0; i < LCD_CUSTOM_CHARS; i++)
+	{
+		for (uint8_t line = 0; line < 8; line++)
+		{
+			mismatches += (patterns[i][line] != ((line >= 7 - i) ? 0x1F : 0x00));
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+int main(void)
+{
+	TestInit();
+	TestRender();
+	TestTemperature();
+	TestBars();
+	return CheckResult("widget");
+}